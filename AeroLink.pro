@@ -9,26 +9,15 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# 发送流水线公共源码（与 daemon/AeroLinkDaemon.pro 共用）
+include(aerolink_core.pri)
+
 SOURCES += \
-    AuxFileReader.cpp \
-    file_monitor.cpp \
-    image_transfer.cpp \
-    image_utils.cpp \
-    logmanager.cpp \
     main.cpp \
-    mainwindow.cpp \
-    message_transfer.cpp \
-    package_sar_data.cpp
+    mainwindow.cpp
 
 HEADERS += \
-    AuxFileReader.h \
-    file_monitor.h \
-    image_transfer.h \
-    image_utils.h \
-    logmanager.h \
-    mainwindow.h \
-    message_transfer.h \
-    package_sar_data.h
+    mainwindow.h
 
 FORMS += \
     mainwindow.ui
@@ -3,11 +3,13 @@
 #include <iomanip>
 #include <algorithm>
 #include <stdexcept>
+#include <QBuffer>
 #include <QFile>
 #include <QDataStream>
 #include <QString>
 #include <QDebug>
 #include <vector>
+#include "buffer_pool.h"
 
 // 构造函数
 AuxFileReader::AuxFileReader() {
@@ -130,21 +132,32 @@ void AuxFileReader::printVector(const std::string& name, const std::vector<doubl
     std::cout << std::endl;
 }
 
-bool AuxFileReader::read(const QString& filename) {
-    // 1. 打开文件
+// 只解析头信息，不读取后面的运动数据；用于编码前快速获取 amp_bit 等参数
+bool AuxFileReader::readHeader(const QString& filename) {
     QFile file(filename);
     if (!file.open(QIODevice::ReadOnly)) {
         qDebug() << "Error: Could not open file" << file.errorString();
         return false;
     }
+    return readHeader(file);
+}
 
-    // 2. 创建 QDataStream 并设置字节序
-    QDataStream in(&file);
-    // 这里假设数据是 little-endian（小端序），因为大多数现代处理器都是如此。
-    // 如果数据源是其他字节序，您需要修改这里。
+bool AuxFileReader::readHeader(const QByteArray& fileData) {
+    QBuffer buffer;
+    buffer.setData(fileData);
+    buffer.open(QIODevice::ReadOnly);
+    return readHeader(buffer);
+}
+
+bool AuxFileReader::readHeader(QIODevice& device) {
+    QDataStream in(&device);
     in.setByteOrder(QDataStream::LittleEndian);
+    readHeaderFields(in);
+    return in.status() == QDataStream::Ok;
+}
 
-    // 3. 读取所有头文件参数到 m_header 结构体中
+// 按文件中的顺序读取头信息字段
+void AuxFileReader::readHeaderFields(QDataStream& in) {
     // 使用 QDataStream 的 >> 运算符来读取数据
     in >> m_header.op_mode >> m_header.pp_mode >> m_header.Kr_sign;
     in >> m_header.fc >> m_header.fd >> m_header.Br >> m_header.Fsr >> m_header.Tr;
@@ -161,6 +174,39 @@ bool AuxFileReader::read(const QString& filename) {
     in >> m_header.lat11 >> m_header.lng11 >> m_header.lat1N >> m_header.lng1N;
     in >> m_header.latM1 >> m_header.lngM1 >> m_header.latMN >> m_header.lngMN;
     in >> m_header.IMG_TH >> m_header.az_MLK_num;
+}
+
+bool AuxFileReader::read(const QString& filename) {
+    // 1. 打开文件
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Error: Could not open file" << file.errorString();
+        return false;
+    }
+    return read(file);
+}
+
+// 预读到内存中的 AUX 文件（见 FileIngest），解析方式与读盘相同
+bool AuxFileReader::read(const QByteArray& fileData) {
+    QBuffer buffer;
+    buffer.setData(fileData);
+    buffer.open(QIODevice::ReadOnly);
+    return read(buffer);
+}
+
+bool AuxFileReader::read(QIODevice& file) {
+    // 2. 创建 QDataStream 并设置字节序
+    QDataStream in(&file);
+    // 这里假设数据是 little-endian（小端序），因为大多数现代处理器都是如此。
+    // 如果数据源是其他字节序，您需要修改这里。
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    // 3. 读取所有头文件参数到 m_header 结构体中
+    readHeaderFields(in);
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Error: AUX header is truncated.";
+        return false;
+    }
 
     // 4. 读取所有剩余数据
     qint64 remaining_size = file.size() - file.pos();
@@ -170,21 +216,21 @@ bool AuxFileReader::read(const QString& filename) {
         return false;
     }
 
-    QByteArray dataBlock = file.readAll();
+    // 直接读入池化缓冲，避免 readAll 再拷贝一次
+    PooledBuffer dataBlock = BufferPool::instance().acquire(static_cast<size_t>(remaining_size));
+    qint64 bytesRead = file.read(reinterpret_cast<char*>(dataBlock.data()), remaining_size);
     file.close();
 
-    // 5. 将 QByteArray 转换为 std::vector<double>
-    qint64 total_doubles = remaining_size / sizeof(double);
-    std::vector<double> data_aux(total_doubles);
-
     // 检查数据块大小是否正确
-    if (dataBlock.size() != remaining_size) {
+    if (bytesRead != remaining_size) {
         qDebug() << "Error: Read data block size mismatch.";
         return false;
     }
 
-    // 使用 memcpy 将数据从 QByteArray 复制到 vector
-    memcpy(data_aux.data(), dataBlock.data(), remaining_size);
+    // 5. 以 double 数组的方式访问数据块（池化缓冲按 new[] 分配，满足 double 对齐）
+    qint64 total_doubles = remaining_size / sizeof(double);
+    const double* data_aux_begin = reinterpret_cast<const double*>(dataBlock.data());
+    const double* data_aux_end = data_aux_begin + total_doubles;
 
     // 6. 根据 MATLAB 逻辑分区数据
     int64_t pulse_num_matlab = m_header.pulse_num;
@@ -198,10 +244,10 @@ bool AuxFileReader::read(const QString& filename) {
 
     // 7. 填充数据向量
     try {
-        m_ta_ref.assign(data_aux.begin(), data_aux.begin() + pulse_num_matlab);
-        m_x_ref.assign(data_aux.begin() + pulse_num_matlab, data_aux.begin() + pulse_num_matlab * 2);
+        m_ta_ref.assign(data_aux_begin, data_aux_begin + pulse_num_matlab);
+        m_x_ref.assign(data_aux_begin + pulse_num_matlab, data_aux_begin + pulse_num_matlab * 2);
         // ... (其他向量的填充代码不变) ...
-        m_roll.assign(data_aux.begin() + num_ta_ref + num_ta * 9, data_aux.end());
+        m_roll.assign(data_aux_begin + num_ta_ref + num_ta * 9, data_aux_end);
     } catch (const std::out_of_range& e) {
         qDebug() << "Error: Data parsing failed. The file structure might be incorrect.";
         return false;
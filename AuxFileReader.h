@@ -8,6 +8,10 @@
 #include <cmath>   // 用于 M_PI
 #include <QString>
 
+class QByteArray;
+class QDataStream;
+class QIODevice;
+
 // 如果编译器没有定义 M_PI，则定义一个常数
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -88,6 +92,11 @@ public:
 
     // 核心函数：读取并解析 AUX 文件，返回读取是否成功
     bool read(const QString& filename);
+    // 只读取并解析头信息
+    bool readHeader(const QString& filename);
+    // 同上，解析已读入内存的整个文件
+    bool read(const QByteArray& fileData);
+    bool readHeader(const QByteArray& fileData);
 
     // 获取读取到的头信息
     AuxHeader getHeader() const;
@@ -123,6 +132,13 @@ private:
     template<typename T>
     T readValue(std::ifstream& file);
 
+    // 从已打开的设备读取，文件与内存两种来源共用
+    bool read(QIODevice& file);
+    bool readHeader(QIODevice& device);
+
+    // 辅助函数：按文件顺序读取头信息字段
+    void readHeaderFields(QDataStream& in);
+
     // 辅助函数：打印向量的前 N 个元素
     void printVector(const std::string& name, const std::vector<double>& vec, size_t count = 5) const;
 
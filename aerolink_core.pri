@@ -0,0 +1,86 @@
+# 发送流水线的公共源码，GUI 与无界面守护进程共用
+QT += core gui network
+
+CONFIG += c++17
+
+# 可选：找到 libzstd 时启用 zstd 编码
+unix {
+    CONFIG += link_pkgconfig
+    packagesExist(libzstd) {
+        PKGCONFIG += libzstd
+        DEFINES += AEROLINK_HAVE_ZSTD
+    }
+}
+# 可选：Linux 上找到 liburing 时用 io_uring 预读源文件，否则用线程池
+linux {
+    packagesExist(liburing) {
+        PKGCONFIG += liburing
+        DEFINES += AEROLINK_HAVE_LIBURING
+    }
+}
+win32:exists($$(ZSTD_DIR)/include/zstd.h) {
+    INCLUDEPATH += $$(ZSTD_DIR)/include
+    LIBS += -L$$(ZSTD_DIR)/lib -lzstd
+    DEFINES += AEROLINK_HAVE_ZSTD
+}
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/AuxFileReader.cpp \
+    $$PWD/app_config.cpp \
+    $$PWD/backfill.cpp \
+    $$PWD/buffer_pool.cpp \
+    $$PWD/conversion_cache.cpp \
+    $$PWD/dynamic_range.cpp \
+    $$PWD/file_ingest.cpp \
+    $$PWD/file_monitor.cpp \
+    $$PWD/image_codec.cpp \
+    $$PWD/image_transfer.cpp \
+    $$PWD/image_utils.cpp \
+    $$PWD/logmanager.cpp \
+    $$PWD/lz4_block.cpp \
+    $$PWD/message_transfer.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/network_threads.cpp \
+    $$PWD/package_sar_data.cpp \
+    $$PWD/packet_capture.cpp \
+    $$PWD/roi_pyramid.cpp \
+    $$PWD/roi_server.cpp \
+    $$PWD/sar_archive.cpp \
+    $$PWD/sar_file_sender.cpp \
+    $$PWD/sar_link.cpp \
+    $$PWD/sar_tiff.cpp \
+    $$PWD/tile_mosaic.cpp \
+    $$PWD/transfer_progress.cpp \
+    $$PWD/transfer_scheduler.cpp
+
+HEADERS += \
+    $$PWD/AuxFileReader.h \
+    $$PWD/app_config.h \
+    $$PWD/backfill.h \
+    $$PWD/buffer_pool.h \
+    $$PWD/conversion_cache.h \
+    $$PWD/dynamic_range.h \
+    $$PWD/file_ingest.h \
+    $$PWD/file_monitor.h \
+    $$PWD/image_codec.h \
+    $$PWD/image_transfer.h \
+    $$PWD/image_utils.h \
+    $$PWD/logmanager.h \
+    $$PWD/lz4_block.h \
+    $$PWD/message_transfer.h \
+    $$PWD/metrics.h \
+    $$PWD/network_threads.h \
+    $$PWD/package_sar_data.h \
+    $$PWD/packet_capture.h \
+    $$PWD/roi_pyramid.h \
+    $$PWD/roi_server.h \
+    $$PWD/sar_archive.h \
+    $$PWD/sar_file_sender.h \
+    $$PWD/sar_link.h \
+    $$PWD/sar_tiff.h \
+    $$PWD/tile_mosaic.h \
+    $$PWD/transfer_progress.h \
+    $$PWD/transfer_scheduler.h
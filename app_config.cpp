@@ -0,0 +1,288 @@
+#include "app_config.h"
+#include <QSettings>
+#include <QFileInfo>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QtGlobal>
+#include <QStandardPaths>
+
+bool AppConfig::loadFromFile(const QString& iniPath, QString* errorMessage)
+{
+    if (!QFileInfo::exists(iniPath)) {
+        if (errorMessage) {
+            *errorMessage = QString("Config file %1 does not exist.").arg(iniPath);
+        }
+        return false;
+    }
+
+    QSettings settings(iniPath, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError) {
+        if (errorMessage) {
+            *errorMessage = QString("Config file %1 could not be parsed.").arg(iniPath);
+        }
+        return false;
+    }
+
+    settings.beginGroup("sender");
+    mainFolderPath = settings.value("folder", mainFolderPath).toString();
+    activeSubDirs = qMax(1, settings.value("active_subdirs", activeSubDirs).toInt());
+    subDirIdleSec = qMax(0, settings.value("subdir_idle_sec", subDirIdleSec).toInt());
+    ipAddress = settings.value("ip", ipAddress).toString();
+    port = static_cast<quint16>(settings.value("port", port).toUInt());
+    transfer.codec = settings.value("codec", transfer.codec).toString().toLower();
+    transfer.archiveJpg = settings.value("archive_jpg", transfer.archiveJpg).toBool();
+    transfer.jpgQuality = qBound(0, settings.value("jpg_quality", transfer.jpgQuality).toInt(), 100);
+    transfer.zstdLevel = qBound(1, settings.value("zstd_level", transfer.zstdLevel).toInt(), 19);
+    transfer.drc = settings.value("drc", transfer.drc).toString().toLower();
+    transfer.drcClipLow = settings.value("drc_clip_low", transfer.drcClipLow).toDouble();
+    transfer.drcClipHigh = settings.value("drc_clip_high", transfer.drcClipHigh).toDouble();
+    transfer.drcGamma = settings.value("drc_gamma", transfer.drcGamma).toDouble();
+    transfer.quickLook = settings.value("quicklook", transfer.quickLook).toBool();
+    transfer.quickLookMaxSize = qMax(16, settings.value("quicklook_size", transfer.quickLookMaxSize).toInt());
+    transfer.quickLookQuality = qBound(0, settings.value("quicklook_quality", transfer.quickLookQuality).toInt(), 100);
+    transfer.tileSize = qBound(0, settings.value("tile_size", transfer.tileSize).toInt(), 65535);
+    transfer.zeroCopy = settings.value("zero_copy", transfer.zeroCopy).toBool();
+    maxTransfers = qMax(0, settings.value("max_transfers", maxTransfers).toInt());
+    inFlightMiB = qMax(0, settings.value("inflight_mb", inFlightMiB).toInt());
+    multiplexLink = settings.value("multiplex", multiplexLink).toBool();
+    networkThreads = qMax(0, settings.value("network_threads", networkThreads).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("cache");
+    cacheDir = settings.value("dir", cacheDir).toString();
+    cacheMemoryMiB = settings.value("memory_mb", cacheMemoryMiB).toInt();
+    cacheDiskMiB = settings.value("disk_mb", cacheDiskMiB).toInt();
+    settings.endGroup();
+
+    settings.beginGroup("ingest");
+    ingestFiles = qMax(0, settings.value("files", ingestFiles).toInt());
+    ingestMemoryMiB = qMax(0, settings.value("memory_mb", ingestMemoryMiB).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("roi");
+    roiPort = static_cast<quint16>(settings.value("port", roiPort).toUInt());
+    roiTileSize = qBound(16, settings.value("tile_size", roiTileSize).toInt(), 65535);
+    roiQuality = qBound(0, settings.value("quality", roiQuality).toInt(), 100);
+    roiKeepImages = qMax(0, settings.value("keep_images", roiKeepImages).toInt());
+    roiBindAddress = settings.value("bind", roiBindAddress).toString();
+    roiPeerAddress = settings.value("peer", roiPeerAddress).toString();
+    transfer.roiPullOnly = settings.value("pull_only", transfer.roiPullOnly).toBool();
+    settings.endGroup();
+
+    settings.beginGroup("capture");
+    captureDir = settings.value("dir", captureDir).toString();
+    captureSegmentMiB = qBound(1, settings.value("segment_mb", captureSegmentMiB).toInt(), 4095);
+    settings.endGroup();
+
+    settings.beginGroup("metrics");
+    metricsPort = static_cast<quint16>(settings.value("port", metricsPort).toUInt());
+    metricsSummaryIntervalMs = settings.value("summary_interval_ms", metricsSummaryIntervalMs).toInt();
+    settings.endGroup();
+
+    return true;
+}
+
+bool AppConfig::saveToFile(const QString& iniPath) const
+{
+    QSettings settings(iniPath, QSettings::IniFormat);
+
+    settings.beginGroup("sender");
+    settings.setValue("folder", mainFolderPath);
+    settings.setValue("active_subdirs", activeSubDirs);
+    settings.setValue("subdir_idle_sec", subDirIdleSec);
+    settings.setValue("ip", ipAddress);
+    settings.setValue("port", port);
+    settings.setValue("codec", transfer.codec);
+    settings.setValue("archive_jpg", transfer.archiveJpg);
+    settings.setValue("jpg_quality", transfer.jpgQuality);
+    settings.setValue("zstd_level", transfer.zstdLevel);
+    settings.setValue("drc", transfer.drc);
+    settings.setValue("drc_clip_low", transfer.drcClipLow);
+    settings.setValue("drc_clip_high", transfer.drcClipHigh);
+    settings.setValue("drc_gamma", transfer.drcGamma);
+    settings.setValue("quicklook", transfer.quickLook);
+    settings.setValue("quicklook_size", transfer.quickLookMaxSize);
+    settings.setValue("quicklook_quality", transfer.quickLookQuality);
+    settings.setValue("tile_size", transfer.tileSize);
+    settings.setValue("zero_copy", transfer.zeroCopy);
+    settings.setValue("max_transfers", maxTransfers);
+    settings.setValue("inflight_mb", inFlightMiB);
+    settings.setValue("multiplex", multiplexLink);
+    settings.setValue("network_threads", networkThreads);
+    settings.endGroup();
+
+    settings.beginGroup("cache");
+    settings.setValue("dir", cacheDir);
+    settings.setValue("memory_mb", cacheMemoryMiB);
+    settings.setValue("disk_mb", cacheDiskMiB);
+    settings.endGroup();
+
+    settings.beginGroup("ingest");
+    settings.setValue("files", ingestFiles);
+    settings.setValue("memory_mb", ingestMemoryMiB);
+    settings.endGroup();
+
+    settings.beginGroup("roi");
+    settings.setValue("port", roiPort);
+    settings.setValue("tile_size", roiTileSize);
+    settings.setValue("quality", roiQuality);
+    settings.setValue("keep_images", roiKeepImages);
+    settings.setValue("bind", roiBindAddress);
+    settings.setValue("peer", roiPeerAddress);
+    settings.setValue("pull_only", transfer.roiPullOnly);
+    settings.endGroup();
+
+    settings.beginGroup("capture");
+    settings.setValue("dir", captureDir);
+    settings.setValue("segment_mb", captureSegmentMiB);
+    settings.endGroup();
+
+    settings.beginGroup("metrics");
+    settings.setValue("port", metricsPort);
+    settings.setValue("summary_interval_ms", metricsSummaryIntervalMs);
+    settings.endGroup();
+
+    settings.sync();
+    return settings.status() == QSettings::NoError;
+}
+
+QString AppConfig::resolvedCacheDir() const
+{
+    if (!cacheDir.isEmpty()) {
+        return cacheDir;
+    }
+    // 不能放在监控的主文件夹下，否则会被当作新的数据子文件夹
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/conversions";
+}
+
+bool AppConfig::parseArguments(const QStringList& arguments, QString* errorMessage)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("AeroLink SAR image sender");
+    parser.addHelpOption();
+
+    QCommandLineOption configOption({"c", "config"}, "Load settings from INI <file>.", "file");
+    QCommandLineOption folderOption({"f", "folder"}, "Main folder to monitor.", "path");
+    QCommandLineOption ipOption({"i", "ip"}, "Receiver IP address.", "address");
+    QCommandLineOption portOption({"p", "port"}, "Receiver TCP port.", "port");
+    QCommandLineOption metricsPortOption("metrics-port", "Local metrics HTTP port, 0 disables.", "port");
+    QCommandLineOption noArchiveOption("no-jpg-archive", "Do not archive encoded images to disk.");
+    QCommandLineOption jpgQualityOption("jpg-quality", "JPG encode quality 0-100.", "quality");
+    QCommandLineOption codecOption("codec", "Image codec: jpeg, lz4, zstd or png16.", "name");
+    QCommandLineOption zstdLevelOption("zstd-level", "zstd compression level 1-19.", "level");
+    QCommandLineOption drcOption("drc", "Dynamic range mapping for 16/32-bit TIFFs: log, gamma, linear or off.", "mapping");
+    QCommandLineOption quickLookOption("quicklook", "Send a downsampled quick-look before each full image.");
+    QCommandLineOption tileSizeOption("tile-size", "Send JPEG images as independently decodable tiles of this size, 0 to disable.", "pixels");
+    QCommandLineOption multiplexOption("multiplex", "Carry messages and image packets on one shared connection, messages first.");
+    QCommandLineOption roiPortOption("roi-port", "Region-of-interest pull service port, 0 disables.", "port");
+    QCommandLineOption backfillOption("backfill", "Send every TIF/DAT pair under <dir> (recursively), then exit.", "dir");
+    QCommandLineOption backfillStateOption("backfill-state", "Backfill progress file used to resume an interrupted run.", "file");
+    QCommandLineOption cacheDirOption("cache-dir", "Directory of the on-disk conversion cache.", "path");
+    QCommandLineOption captureOption("capture", "Record every outbound packet with timestamp and destination in <dir>.", "dir");
+    parser.addOptions({configOption, folderOption, ipOption, portOption, metricsPortOption, roiPortOption,
+                       noArchiveOption, jpgQualityOption, codecOption, zstdLevelOption, drcOption, quickLookOption,
+                       tileSizeOption, multiplexOption, cacheDirOption, backfillOption, backfillStateOption,
+                       captureOption});
+
+    if (!parser.parse(arguments)) {
+        if (errorMessage) {
+            *errorMessage = parser.errorText();
+        }
+        return false;
+    }
+    if (parser.isSet("help")) {
+        if (errorMessage) {
+            *errorMessage = parser.helpText();
+        }
+        return false;
+    }
+
+    if (parser.isSet(configOption) && !loadFromFile(parser.value(configOption), errorMessage)) {
+        return false;
+    }
+
+    if (parser.isSet(folderOption)) {
+        mainFolderPath = parser.value(folderOption);
+    }
+    if (parser.isSet(ipOption)) {
+        ipAddress = parser.value(ipOption);
+    }
+    if (parser.isSet(portOption)) {
+        bool ok = false;
+        uint value = parser.value(portOption).toUInt(&ok);
+        if (!ok || value == 0 || value > 65535) {
+            if (errorMessage) {
+                *errorMessage = QString("Invalid port: %1").arg(parser.value(portOption));
+            }
+            return false;
+        }
+        port = static_cast<quint16>(value);
+    }
+    if (parser.isSet(metricsPortOption)) {
+        metricsPort = static_cast<quint16>(parser.value(metricsPortOption).toUInt());
+    }
+    if (parser.isSet(roiPortOption)) {
+        roiPort = static_cast<quint16>(parser.value(roiPortOption).toUInt());
+    }
+    if (parser.isSet(cacheDirOption)) {
+        cacheDir = parser.value(cacheDirOption);
+    }
+    if (parser.isSet(captureOption)) {
+        captureDir = parser.value(captureOption);
+    }
+    if (parser.isSet(backfillOption)) {
+        backfillRoot = parser.value(backfillOption);
+    }
+    if (parser.isSet(backfillStateOption)) {
+        backfillStateFile = parser.value(backfillStateOption);
+    }
+    if (parser.isSet(codecOption)) {
+        transfer.codec = parser.value(codecOption).toLower();
+    }
+    if (parser.isSet(zstdLevelOption)) {
+        bool ok = false;
+        int value = parser.value(zstdLevelOption).toInt(&ok);
+        if (!ok || value < 1 || value > 19) {
+            if (errorMessage) {
+                *errorMessage = QString("Invalid zstd level: %1").arg(parser.value(zstdLevelOption));
+            }
+            return false;
+        }
+        transfer.zstdLevel = value;
+    }
+    if (parser.isSet(drcOption)) {
+        transfer.drc = parser.value(drcOption).toLower();
+    }
+    if (parser.isSet(quickLookOption)) {
+        transfer.quickLook = true;
+    }
+    if (parser.isSet(tileSizeOption)) {
+        bool ok = false;
+        int value = parser.value(tileSizeOption).toInt(&ok);
+        if (!ok || value < 0 || value > 65535) {
+            if (errorMessage) {
+                *errorMessage = QString("Invalid tile size: %1").arg(parser.value(tileSizeOption));
+            }
+            return false;
+        }
+        transfer.tileSize = value;
+    }
+    if (parser.isSet(multiplexOption)) {
+        multiplexLink = true;
+    }
+    if (parser.isSet(noArchiveOption)) {
+        transfer.archiveJpg = false;
+    }
+    if (parser.isSet(jpgQualityOption)) {
+        bool ok = false;
+        int value = parser.value(jpgQualityOption).toInt(&ok);
+        if (!ok || value < 0 || value > 100) {
+            if (errorMessage) {
+                *errorMessage = QString("Invalid JPG quality: %1").arg(parser.value(jpgQualityOption));
+            }
+            return false;
+        }
+        transfer.jpgQuality = value;
+    }
+    return true;
+}
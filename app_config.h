@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// ===================== 单幅图像处理选项 =====================
+// 每幅图像的编码与归档方式，随 processAndTransferImage 一起传递
+struct TransferOptions {
+    QString codec = "jpeg";   // 编码方式：jpeg / lz4 / zstd / png16
+    bool archiveJpg = true;   // 是否把编码结果异步归档到 <子文件夹>/jpg（非 JPEG 编码归档到 <子文件夹>/encoded）
+    int jpgQuality = 80;      // JPG 编码质量 0~100
+    int zstdLevel = 3;        // zstd 压缩等级 1~19
+    // 16/32 位幅度图编码为 JPEG 前的动态范围压缩
+    QString drc = "log";      // 映射曲线：log / gamma / linear / off
+    double drcClipLow = 0.5;  // 低端裁剪百分位
+    double drcClipHigh = 99.5;// 高端裁剪百分位
+    double drcGamma = 2.2;
+    // 快视图：先发一幅降采样的低质量 JPEG，全分辨率图像随后发送
+    bool quickLook = false;
+    int quickLookMaxSize = 512;   // 快视图长边像素数
+    int quickLookQuality = 30;    // 快视图 JPEG 质量
+    int tileSize = 0;             // 分块边长（像素），0 表示整幅发送；仅 JPEG 编码支持分块
+    bool roiPullOnly = false;     // 开启感兴趣区域拉取时不主动推送全分辨率图像，只等接收端按需请求
+    bool zeroCopy = true;         // 编码结果的归档已登记在转换缓存里时用 sendfile 直接从归档文件发出（仅 Linux，见 SarFileSender）
+};
+
+// ===================== 运行配置 =====================
+// 图形界面与无界面守护进程共用的发送端配置
+struct AppConfig {
+    QString mainFolderPath = "E:/AIR/小长ISAR/实时数据回传/data";  // 监控的主文件夹
+    int activeSubDirs = 4;                                     // 同时监控的子文件夹数上限
+    int subDirIdleSec = 600;                                   // 子文件夹多久没有新文件后停止监控，0 表示不超时
+    QString ipAddress = "127.0.0.1";                           // 接收端地址
+    quint16 port = 65432;                                      // 接收端端口
+    TransferOptions transfer;                                  // 编码与归档选项
+    int maxTransfers = 4;                                      // 同时进行的传输数上限，0 表示不限
+    int inFlightMiB = 256;                                     // 已打包待发数据的预算，超出时推迟编码，0 表示不限
+    bool multiplexLink = false;                                // 文本消息与图像数据包共用一条连接（SarLink），控制消息优先
+    int networkThreads = 1;                                    // 网络线程数，0 表示传输在主线程上进行（见 NetworkThreads）
+
+    QString cacheDir;                      // 转换缓存磁盘层索引目录，为空时使用系统缓存目录
+    int cacheMemoryMiB = 256;              // 转换缓存内存层上限，0 表示关闭
+    int cacheDiskMiB = 2048;               // 转换缓存磁盘层登记的归档字节数上限，0 表示关闭
+
+    int ingestFiles = 4;                   // 同时预读的源文件数，0 表示关闭预读（见 FileIngest）
+    int ingestMemoryMiB = 512;             // 已预读、尚未处理的源文件占用内存上限
+
+    quint16 roiPort = 0;                   // 感兴趣区域拉取服务端口，0 表示关闭（同时不建立金字塔）
+    int roiTileSize = 256;                 // 金字塔分块边长（像素）
+    int roiQuality = 80;                   // 金字塔分块 JPEG 质量
+    int roiKeepImages = 16;                // 保留金字塔的最近图像数
+    QString roiBindAddress;                // 拉取服务监听的本机地址，为空时监听所有网口
+    QString roiPeerAddress;                // 只接受来自该地址的拉取连接，为空时使用接收端地址
+
+    QString captureDir;                    // 非空时把发出的数据包记录到该目录（见 PacketCapture）
+    int captureSegmentMiB = 256;           // 抓包分段大小
+
+    QString backfillRoot;                  // 非空时进入批量补发模式：发送整棵目录树后退出，不监控新文件
+    QString backfillStateFile;             // 补发进度文件，为空时使用 <backfillRoot>/.aerolink_backfill
+
+    quint16 metricsPort = 9464;            // 本地指标导出端口，0 表示关闭
+    int metricsSummaryIntervalMs = 60000;  // 指标日志摘要周期，<= 0 表示关闭
+
+    // 从 INI 文件加载，文件中没有的键保持当前值
+    bool loadFromFile(const QString& iniPath, QString* errorMessage = nullptr);
+    // 写回 INI 文件
+    bool saveToFile(const QString& iniPath) const;
+    // 转换缓存实际使用的磁盘目录
+    QString resolvedCacheDir() const;
+    // 解析命令行（--config 先加载文件，其余参数覆盖文件中的值）
+    bool parseArguments(const QStringList& arguments, QString* errorMessage = nullptr);
+};
@@ -0,0 +1,360 @@
+#include "backfill.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QPointer>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include "AuxFileReader.h"
+#include "conversion_cache.h"
+#include "file_ingest.h"
+#include "image_codec.h"
+#include "image_transfer.h"
+#include "metrics.h"
+
+namespace {
+
+const char* const kTifFilters[] = { "*.tif", "*.TIF" };
+const int kMaxFailedListed = 20;    // 报告中最多列出的失败文件数
+
+// 与 processAndTransferImage 相同的配对规则：同一文件夹下 <baseName>.dat
+QString auxPathFor(const QFileInfo& tif)
+{
+    return tif.absolutePath() + "/" + tif.baseName() + ".dat";
+}
+
+} // namespace
+
+BackfillJob::BackfillJob(const AppConfig& config, QObject* parent)
+    : QObject(parent),
+    m_config(config),
+    m_pool(new QThreadPool(this)),
+    m_pendingScans(0),
+    m_nextItem(0),
+    m_encoding(0),
+    m_dispatched(0),
+    m_maxOutstanding(0),
+    m_preEncode(false),
+    m_running(false),
+    m_cancelled(false),
+    m_pumping(false)
+{
+    m_pool->setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+BackfillJob::~BackfillJob()
+{
+    // 遍历与编码任务只通过 QPointer 回到本对象，这里等它们结束再释放线程池
+    m_pool->waitForDone();
+}
+
+void BackfillJob::setStateFile(const QString& path)
+{
+    m_stateFilePath = path;
+}
+
+bool BackfillJob::isRunning() const
+{
+    return m_running;
+}
+
+BackfillJob::Report BackfillJob::report() const
+{
+    return m_report;
+}
+
+void BackfillJob::start(const QString& rootDir)
+{
+    if (m_running) {
+        return;
+    }
+    m_rootDir = QDir::cleanPath(rootDir);
+    m_report = Report();
+    m_items.clear();
+    m_ready.clear();
+    m_done.clear();
+    m_nextItem = 0;
+    m_cancelled = false;
+    m_running = true;
+    m_clock.start();
+
+    // 读入已完成列表，再以追加方式打开，每发完一幅写一行
+    if (m_stateFilePath.isEmpty()) {
+        m_stateFilePath = m_rootDir + "/.aerolink_backfill";
+    }
+    m_stateFile.setFileName(m_stateFilePath);
+    if (m_stateFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&m_stateFile);
+        while (!in.atEnd()) {
+            const QString line = in.readLine().trimmed();
+            if (!line.isEmpty()) {
+                m_done.insert(line);
+            }
+        }
+        m_stateFile.close();
+    }
+    if (!m_stateFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Cannot write backfill progress to" << m_stateFilePath << "- this run will not be resumable.";
+    }
+
+    // 预编码的结果通过转换缓存交给发送流水线；分块模式不经过缓存，只能在派发时编码
+    const ImageCodec* codec = imageCodecByName(m_config.transfer.codec);
+    m_preEncode = codec && ConversionCache::instance().enabled()
+        && !(m_config.transfer.tileSize > 0 && codec->id() == CodecId::Jpeg);
+    if (!m_preEncode) {
+        qWarning() << "Backfill cannot pre-encode (conversion cache disabled or tiled mode), images will be encoded one at a time.";
+    }
+    m_maxOutstanding = m_pool->maxThreadCount() * 2;
+
+    // 根目录本身的文件与每个一级子文件夹各自一个遍历任务，并行列目录、配对
+    QStringList scanRoots;
+    scanRoots.append(QString());
+    const QStringList subDirs = QDir(m_rootDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString& name : subDirs) {
+        scanRoots.append(m_rootDir + "/" + name);
+    }
+    m_pendingScans = scanRoots.size();
+    qDebug() << "Backfill scanning" << m_rootDir << "with" << m_pool->maxThreadCount() << "threads";
+
+    class ScanTask : public QRunnable
+    {
+    public:
+        ScanTask(BackfillJob* job, const QString& rootDir, const QString& subDir)
+            : m_job(job), m_rootDir(rootDir), m_subDir(subDir) {}
+
+        void run() override
+        {
+            QStringList filters;
+            for (const char* filter : kTifFilters) {
+                filters.append(filter);
+            }
+            // 空 subDir 表示只看根目录自身的文件，子文件夹由各自的任务负责
+            QDirIterator it(m_subDir.isEmpty() ? m_rootDir : m_subDir, filters, QDir::Files,
+                            m_subDir.isEmpty() ? QDirIterator::NoIteratorFlags : QDirIterator::Subdirectories);
+            QVector<Item> items;
+            int unpaired = 0;
+            while (it.hasNext()) {
+                it.next();
+                const QFileInfo tif = it.fileInfo();
+                if (!QFileInfo::exists(auxPathFor(tif))) {
+                    ++unpaired;
+                    continue;
+                }
+                items.append(Item{tif.absoluteFilePath(), tif.size()});
+            }
+            QPointer<BackfillJob> job = m_job;
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [job, items, unpaired]() {
+                if (job) {
+                    job->onScanned(items, unpaired);
+                }
+            }, Qt::QueuedConnection);
+        }
+
+    private:
+        QPointer<BackfillJob> m_job;
+        QString m_rootDir;
+        QString m_subDir;
+    };
+
+    for (const QString& scanRoot : scanRoots) {
+        m_pool->start(new ScanTask(this, m_rootDir, scanRoot));
+    }
+}
+
+void BackfillJob::onScanned(const QVector<Item>& items, int unpaired)
+{
+    m_report.unpaired += unpaired;
+    m_report.pairs += items.size();
+    for (const Item& item : items) {
+        if (m_done.contains(item.tifPath)) {
+            ++m_report.skipped;
+        } else {
+            m_items.append(item);
+        }
+    }
+    if (--m_pendingScans > 0) {
+        return;
+    }
+
+    // 全部遍历完成后按路径排序，同一架次内按文件夹、文件名的顺序发送
+    std::sort(m_items.begin(), m_items.end(), [](const Item& a, const Item& b) {
+        return a.tifPath < b.tifPath;
+    });
+    qDebug() << "Backfill found" << m_report.pairs << "TIF/DAT pairs," << m_report.skipped << "already sent,"
+             << m_report.unpaired << "TIF without DAT";
+    emit progress(0, m_items.size());
+    pump();
+}
+
+void BackfillJob::cancel()
+{
+    if (!m_running || m_cancelled) {
+        return;
+    }
+    m_cancelled = true;
+    m_ready.clear();
+    qDebug() << "Backfill cancelled, waiting for" << m_encoding + m_dispatched << "image(s) in progress";
+    finishIfIdle();
+}
+
+void BackfillJob::pump()
+{
+    // 同步失败的图像会在派发过程中回调 onImageDone，防止递归
+    if (m_pumping) {
+        return;
+    }
+    m_pumping = true;
+    while (!m_cancelled && m_pendingScans == 0) {
+        if (!m_ready.isEmpty()) {
+            dispatch(m_ready.dequeue());
+            continue;
+        }
+        if (m_nextItem >= m_items.size() || m_encoding + m_dispatched >= m_maxOutstanding) {
+            break;
+        }
+        const int index = m_nextItem++;
+        if (!m_preEncode) {
+            m_ready.enqueue(index);
+            continue;
+        }
+
+        class EncodeTask : public QRunnable
+        {
+        public:
+            EncodeTask(BackfillJob* job, int index, const QString& tifPath, const TransferOptions& options)
+                : m_job(job), m_index(index), m_tifPath(tifPath), m_options(options) {}
+
+            void run() override
+            {
+                // 与发送流水线相同的源描述与缓存键，派发时直接命中缓存
+                const ImageCodec* codec = imageCodecByName(m_options.codec);
+                EncodeSource source;
+                source.path = m_tifPath;
+                const QString auxPath = auxPathFor(QFileInfo(m_tifPath));
+                const IngestedFilePtr aux = FileIngest::instance().get(auxPath);
+                AuxFileReader auxReader;
+                if (aux ? auxReader.readHeader(aux->bytes()) : auxReader.readHeader(auxPath)) {
+                    source.ampBit = static_cast<int>(auxReader.getHeader().amp_bit);
+                }
+                ConversionKey key;
+                QByteArray encoded;
+                if (codec && ConversionCache::makeKey(m_tifPath, codec->cacheParams(source, m_options), &key)
+                    && !ConversionCache::instance().lookup(key, &encoded)) {
+                    bool converted;
+                    {
+                        StageTimer timer(PipelineStage::Convert);
+                        converted = codec->encode(source, m_options, &encoded);
+                    }
+                    // 失败时不写缓存，派发后由流水线重新编码并按失败处理
+                    if (converted) {
+                        ConversionCache::instance().insert(key, encoded);
+                    }
+                }
+                QPointer<BackfillJob> job = m_job;
+                const int index = m_index;
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [job, index]() {
+                    if (job) {
+                        job->onEncoded(index);
+                    }
+                }, Qt::QueuedConnection);
+            }
+
+        private:
+            QPointer<BackfillJob> m_job;
+            int m_index;
+            QString m_tifPath;
+            TransferOptions m_options;
+        };
+
+        // 源文件交给 FileIngest 预读，编码线程从内存取用
+        FileIngest::instance().prefetchImage(m_items.at(index).tifPath);
+        ++m_encoding;
+        m_pool->start(new EncodeTask(this, index, m_items.at(index).tifPath, m_config.transfer));
+    }
+    m_pumping = false;
+    finishIfIdle();
+}
+
+void BackfillJob::onEncoded(int index)
+{
+    --m_encoding;
+    // 取消后不再派发，预编码的结果留在缓存里，下次运行直接使用
+    if (!m_cancelled) {
+        m_ready.enqueue(index);
+    }
+    pump();
+}
+
+void BackfillJob::dispatch(int index)
+{
+    ++m_dispatched;
+    QPointer<BackfillJob> job = this;
+    processAndTransferImage(m_items.at(index).tifPath, m_config.ipAddress, m_config.port, m_config.transfer,
+                            [job, index](bool success) {
+        if (job) {
+            job->onImageDone(index, success);
+        }
+    });
+}
+
+void BackfillJob::onImageDone(int index, bool success)
+{
+    --m_dispatched;
+    const Item& item = m_items.at(index);
+    if (success) {
+        ++m_report.sent;
+        m_report.sourceBytes += item.size;
+        if (m_stateFile.isOpen()) {
+            m_stateFile.write(item.tifPath.toUtf8() + '\n');
+            m_stateFile.flush();
+        }
+    } else {
+        ++m_report.failed;
+        m_report.failedFiles.append(item.tifPath);
+    }
+    emit progress(m_report.sent + m_report.failed, m_items.size());
+    pump();
+}
+
+void BackfillJob::finishIfIdle()
+{
+    if (!m_running || m_pumping || m_pendingScans > 0 || m_encoding > 0 || m_dispatched > 0) {
+        return;
+    }
+    if (!m_cancelled && (m_nextItem < m_items.size() || !m_ready.isEmpty())) {
+        return;
+    }
+    m_running = false;
+    m_report.elapsedMs = m_clock.elapsed();
+    m_stateFile.close();
+    emit finished();
+}
+
+QString BackfillJob::reportText() const
+{
+    const double seconds = qMax<qint64>(1, m_report.elapsedMs) / 1000.0;
+    QString text;
+    QTextStream out(&text);
+    out << "Backfill of " << m_rootDir << (m_cancelled ? " (cancelled)" : "") << "\n"
+        << "  pairs found:    " << m_report.pairs << " (" << m_report.skipped << " already sent, "
+        << m_report.unpaired << " TIF without DAT)\n"
+        << "  sent:           " << m_report.sent << "\n"
+        << "  failed:         " << m_report.failed << "\n"
+        << "  not attempted:  " << qMax(0, static_cast<int>(m_items.size()) - m_report.sent - m_report.failed) << "\n"
+        << "  elapsed:        " << QString::number(seconds, 'f', 1) << " s, "
+        << QString::number(m_report.sent / seconds, 'f', 2) << " images/s, "
+        << QString::number(m_report.sourceBytes / seconds / (1 << 20), 'f', 1) << " MiB/s of source TIF\n"
+        << "  progress file:  " << m_stateFilePath;
+    for (int i = 0; i < m_report.failedFiles.size() && i < kMaxFailedListed; ++i) {
+        out << "\n  failed: " << m_report.failedFiles.at(i);
+    }
+    if (m_report.failedFiles.size() > kMaxFailedListed) {
+        out << "\n  ... and " << m_report.failedFiles.size() - kMaxFailedListed << " more";
+    }
+    return text;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "app_config.h"
+
+class QThreadPool;
+
+/**
+ * @class BackfillJob
+ * @brief 批量补发历史目录树：按子文件夹并行遍历整棵目录树，配对同名 TIF/DAT；
+ * 在全部核心上预先编码进转换缓存，再经正常的发送流水线（调度器、链路）按链路速率送出。
+ * 成功发送的 TIF 逐行追加到进度文件，中断后重新运行会跳过它们；结束时给出汇总报告。只在主线程上使用。
+ */
+class BackfillJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Report {
+        int pairs = 0;              // 找到的 TIF/DAT 对（含已完成的）
+        int unpaired = 0;           // 没有同名 DAT 的 TIF
+        int skipped = 0;            // 进度文件中已记录为完成
+        int sent = 0;
+        int failed = 0;
+        qint64 sourceBytes = 0;     // 本次发送成功的源 TIF 字节数
+        qint64 elapsedMs = 0;
+        QStringList failedFiles;
+    };
+
+    explicit BackfillJob(const AppConfig& config, QObject* parent = nullptr);
+    ~BackfillJob();
+
+    // 进度文件，未设置时使用 <rootDir>/.aerolink_backfill
+    void setStateFile(const QString& path);
+    void start(const QString& rootDir);
+    // 不再派发新的图像，已派发的照常结束后发出 finished
+    void cancel();
+    bool isRunning() const;
+
+    Report report() const;
+    QString reportText() const;
+
+signals:
+    void progress(int done, int total);
+    void finished();
+
+private:
+    struct Item {
+        QString tifPath;
+        qint64 size;
+    };
+
+    void onScanned(const QVector<Item>& items, int unpaired);
+    void onEncoded(int index);
+    void onImageDone(int index, bool success);
+    void pump();
+    void dispatch(int index);
+    void finishIfIdle();
+
+    AppConfig m_config;
+    QString m_rootDir;
+    QString m_stateFilePath;
+    QFile m_stateFile;
+    QSet<QString> m_done;           // 进度文件中已完成的 TIF
+    QVector<Item> m_items;          // 待发送的图像，按路径排序
+    QThreadPool* m_pool;            // 遍历与预编码，线程数等于核心数
+    int m_pendingScans;
+    int m_nextItem;                 // 下一个进入编码/派发的 m_items 下标
+    int m_encoding;                 // 正在预编码的图像数
+    QQueue<int> m_ready;            // 已预编码、等待派发
+    int m_dispatched;               // 已交给发送流水线、尚未结束
+    int m_maxOutstanding;           // 编码中、待派发与发送中的图像总数上限
+    bool m_preEncode;               // 转换缓存开启且不分块时才预编码
+    bool m_running;
+    bool m_cancelled;
+    bool m_pumping;
+    QElapsedTimer m_clock;
+    Report m_report;
+};
@@ -0,0 +1,175 @@
+#include "buffer_pool.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+#include "metrics.h"
+
+// ===================== PooledBuffer =====================
+
+PooledBuffer::PooledBuffer(uint8_t* data, size_t capacity, int sizeClass)
+    : m_data(data),
+    m_size(0),
+    m_capacity(capacity),
+    m_sizeClass(sizeClass)
+{
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : m_data(other.m_data),
+    m_size(other.m_size),
+    m_capacity(other.m_capacity),
+    m_sizeClass(other.m_sizeClass)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+    other.m_sizeClass = -1;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_sizeClass = other.m_sizeClass;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+        other.m_sizeClass = -1;
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+    release();
+}
+
+void PooledBuffer::resize(size_t size)
+{
+    if (size > m_capacity) {
+        PooledBuffer bigger = BufferPool::instance().acquire(size);
+        if (m_size > 0) {
+            memcpy(bigger.data(), m_data, m_size);
+        }
+        *this = std::move(bigger);
+    }
+    m_size = size;
+}
+
+void PooledBuffer::release()
+{
+    if (m_data) {
+        BufferPool::instance().giveBack(m_data, m_capacity, m_sizeClass);
+        m_data = nullptr;
+        m_size = 0;
+        m_capacity = 0;
+        m_sizeClass = -1;
+    }
+}
+
+// ===================== BufferPool =====================
+
+BufferPool& BufferPool::instance()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::BufferPool()
+    : m_maxCachedBytes(size_t(64) << 20),
+    m_stats{0, 0, 0, 0, 0}
+{
+}
+
+int BufferPool::sizeClassFor(size_t size)
+{
+    int bits = kMinClassBits;
+    while (bits <= kMaxClassBits && (size_t(1) << bits) < size) {
+        ++bits;
+    }
+    return bits <= kMaxClassBits ? bits - kMinClassBits : -1;
+}
+
+PooledBuffer BufferPool::acquire(size_t size)
+{
+    const int sizeClass = sizeClassFor(size);
+    const size_t capacity = sizeClass >= 0 ? (size_t(1) << (sizeClass + kMinClassBits)) : size;
+
+    uint8_t* data = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (sizeClass >= 0 && !m_free[sizeClass].empty()) {
+            data = m_free[sizeClass].back();
+            m_free[sizeClass].pop_back();
+            m_stats.cachedBytes -= capacity;
+            ++m_stats.hits;
+        } else {
+            ++m_stats.misses;
+        }
+        m_stats.outstandingBytes += capacity;
+    }
+
+    if (data) {
+        Metrics::instance().addCounter(MetricCounter::PoolHits);
+    } else {
+        Metrics::instance().addCounter(MetricCounter::PoolMisses);
+        data = new uint8_t[capacity];
+    }
+
+    PooledBuffer buffer(data, capacity, sizeClass);
+    buffer.m_size = size;
+    return buffer;
+}
+
+void BufferPool::giveBack(uint8_t* data, size_t capacity, int sizeClass)
+{
+    bool keep = false;
+    size_t cached;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stats.outstandingBytes -= capacity;
+        if (sizeClass >= 0 && m_stats.cachedBytes + capacity <= m_maxCachedBytes) {
+            m_free[sizeClass].push_back(data);
+            m_stats.cachedBytes += capacity;
+            keep = true;
+        } else {
+            ++m_stats.discards;
+        }
+        cached = m_stats.cachedBytes;
+    }
+    Metrics::instance().setGauge(MetricGauge::PoolCachedBytes, static_cast<qint64>(cached));
+    if (!keep) {
+        delete[] data;
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void BufferPool::setMaxCachedBytes(size_t bytes)
+{
+    std::vector<uint8_t*> toFree;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_maxCachedBytes = bytes;
+        // 从最大的级别开始释放，直到低于新上限
+        for (int c = kClassCount - 1; c >= 0 && m_stats.cachedBytes > m_maxCachedBytes; --c) {
+            const size_t capacity = size_t(1) << (c + kMinClassBits);
+            while (!m_free[c].empty() && m_stats.cachedBytes > m_maxCachedBytes) {
+                toFree.push_back(m_free[c].back());
+                m_free[c].pop_back();
+                m_stats.cachedBytes -= capacity;
+                ++m_stats.discards;
+            }
+        }
+    }
+    for (uint8_t* data : toFree) {
+        delete[] data;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QMutex>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BufferPool;
+
+/**
+ * @class PooledBuffer
+ * @brief 从 BufferPool 借出的一块连续内存，析构时自动归还。
+ * 只能移动不能拷贝；内容不做初始化，调用方负责写满用到的部分。
+ */
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer();
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    bool isNull() const { return m_data == nullptr; }
+
+    // 调整有效长度；超出容量时换一块更大的缓冲并保留原有内容
+    void resize(size_t size);
+    // 提前归还
+    void release();
+
+private:
+    friend class BufferPool;
+    PooledBuffer(uint8_t* data, size_t capacity, int sizeClass);
+
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    int m_sizeClass = -1;
+};
+
+/**
+ * @class BufferPool
+ * @brief 按 2 的幂分级的全局缓冲池，供读文件、打包和发送复用。
+ * 稳定运行时每张图像用到的大块内存都从池中取还，不再反复向分配器申请。
+ */
+class BufferPool {
+public:
+    struct Stats {
+        uint64_t hits;          // 命中空闲缓冲
+        uint64_t misses;        // 需要新分配
+        uint64_t discards;      // 归还时超过缓存上限而释放
+        size_t cachedBytes;     // 池中空闲缓冲的总字节数
+        size_t outstandingBytes;// 已借出未归还的总字节数
+    };
+
+    static BufferPool& instance();
+
+    PooledBuffer acquire(size_t size);
+    Stats stats() const;
+
+    // 池中最多缓存的空闲字节数
+    void setMaxCachedBytes(size_t bytes);
+
+private:
+    friend class PooledBuffer;
+
+    static constexpr int kMinClassBits = 12;  // 4 KiB
+    static constexpr int kMaxClassBits = 28;  // 256 MiB，更大的请求直接分配
+    static constexpr int kClassCount = kMaxClassBits - kMinClassBits + 1;
+
+    BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    static int sizeClassFor(size_t size);
+    void giveBack(uint8_t* data, size_t capacity, int sizeClass);
+
+    mutable QMutex m_mutex;
+    std::array<std::vector<uint8_t*>, kClassCount> m_free;
+    size_t m_maxCachedBytes;
+    Stats m_stats;
+};
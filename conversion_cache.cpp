@@ -0,0 +1,407 @@
+#include "conversion_cache.h"
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include "file_ingest.h"
+#include "image_utils.h"
+#include "metrics.h"
+
+namespace {
+
+const qint64 kSampleBytes = 64 * 1024;       // 每段采样长度
+const char* const kIndexSuffix = ".ref";
+
+// 64 位 FNV-1a 的按字处理变体，只用于区分文件内容，不追求密码学强度
+quint64 hashBytes(quint64 h, const char* data, qint64 size)
+{
+    const quint64 prime = 0x100000001b3ULL;
+    qint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+    for (; i < size; ++i) {
+        h = (h ^ static_cast<quint8>(data[i])) * prime;
+    }
+    return h;
+}
+
+} // namespace
+
+QString ConversionKey::digest() const
+{
+    quint64 h = 0xcbf29ce484222325ULL;
+    h = hashBytes(h, reinterpret_cast<const char*>(&sourceSize), sizeof(sourceSize));
+    h = hashBytes(h, reinterpret_cast<const char*>(&sourceMtimeMs), sizeof(sourceMtimeMs));
+    h = hashBytes(h, reinterpret_cast<const char*>(&contentHash), sizeof(contentHash));
+    const QByteArray p = params.toUtf8();
+    h = hashBytes(h, p.constData(), p.size());
+    return QString("%1-%2").arg(contentHash, 16, 16, QChar('0')).arg(h, 16, 16, QChar('0'));
+}
+
+ConversionCache& ConversionCache::instance()
+{
+    static ConversionCache cache;
+    return cache;
+}
+
+ConversionCache::ConversionCache()
+    : m_memoryBudget(qint64(256) << 20),
+    m_diskBudget(0),
+    m_memoryBytes(0),
+    m_diskBytes(0),
+    m_stats{0, 0, 0, 0, 0}
+{
+}
+
+void ConversionCache::configure(const QString& diskDir, qint64 memoryBudget, qint64 diskBudget)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryBudget = qMax<qint64>(0, memoryBudget);
+    m_diskBudget = diskDir.isEmpty() ? 0 : qMax<qint64>(0, diskBudget);
+    m_diskDir = m_diskBudget > 0 ? QDir::cleanPath(diskDir) : QString();
+    evictMemory();
+
+    // 重建磁盘层索引，按修改时间从新到旧排列；归档文件是否仍然有效留到取用时核对
+    m_disk.clear();
+    m_diskLru.clear();
+    m_diskBytes = 0;
+    if (!m_diskDir.isEmpty()) {
+        QDir dir(m_diskDir);
+        if (!dir.exists() && !dir.mkpath(".")) {
+            qWarning() << "Cannot create conversion cache dir:" << m_diskDir;
+            m_diskDir.clear();
+        } else {
+            // 缓存目录由用户指定，可能还有别的文件：只认文件名是摘要、内容能解析的索引，其余一律不碰
+            static const QRegularExpression digestPattern("^[0-9a-f]{16}-[0-9a-f]{16}$");
+            const QFileInfoList files = dir.entryInfoList({QString("*") + kIndexSuffix}, QDir::Files, QDir::Time);
+            for (const QFileInfo& info : files) {
+                // 索引文件一行：归档路径、长度、内容哈希、修改时间，以制表符分隔
+                const QString digest = info.completeBaseName();
+                if (!digestPattern.match(digest).hasMatch()) {
+                    continue;
+                }
+                QFile file(info.filePath());
+                const QList<QByteArray> fields = file.open(QIODevice::ReadOnly) ? file.readLine().trimmed().split('\t')
+                                                                                 : QList<QByteArray>();
+                bool ok = fields.size() == 4;
+                DiskEntry entry;
+                if (ok) {
+                    bool sizeOk, hashOk, timeOk;
+                    entry.archivePath = QString::fromUtf8(fields.at(0));
+                    entry.size = fields.at(1).toLongLong(&sizeOk);
+                    entry.hash = fields.at(2).toULongLong(&hashOk, 16);
+                    entry.modifiedMs = fields.at(3).toLongLong(&timeOk);
+                    ok = sizeOk && hashOk && timeOk;
+                }
+                file.close();
+                if (!ok) {
+                    qWarning() << "Ignoring unreadable conversion cache index:" << info.filePath();
+                    continue;
+                }
+                m_diskLru.push_back(digest);
+                entry.lru = std::prev(m_diskLru.end());
+                m_disk.insert(digest, entry);
+                m_diskBytes += entry.size;
+            }
+            evictDisk();
+        }
+    }
+    m_stats.diskBytes = m_diskBytes;
+}
+
+bool ConversionCache::makeKey(const QString& sourcePath, const QString& params, ConversionKey* key)
+{
+    // 源文件已预读时采样也在内存中完成
+    const IngestedFilePtr ingested = FileIngest::instance().get(sourcePath);
+    QFile sourceFile(sourcePath);
+    QBuffer sourceBuffer;
+    QIODevice& file = ingested ? static_cast<QIODevice&>(sourceBuffer) : sourceFile;
+    if (ingested) {
+        sourceBuffer.setData(ingested->bytes());
+        key->sourceMtimeMs = ingested->modifiedMs;
+    } else {
+        key->sourceMtimeMs = QFileInfo(sourcePath).lastModified().toMSecsSinceEpoch();
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    key->sourceSize = file.size();
+    key->params = params;
+
+    // 只读取头、中、尾三段，避免为算键而完整读一遍大文件
+    QByteArray sample;
+    quint64 h = 0xcbf29ce484222325ULL;
+    const qint64 offsets[] = { 0, (key->sourceSize - kSampleBytes) / 2, key->sourceSize - kSampleBytes };
+    qint64 covered = 0;
+    for (qint64 offset : offsets) {
+        offset = qMax(offset, covered);
+        if (offset >= key->sourceSize) {
+            break;
+        }
+        if (!file.seek(offset)) {
+            return false;
+        }
+        sample = file.read(qMin(kSampleBytes, key->sourceSize - offset));
+        h = hashBytes(h, sample.constData(), sample.size());
+        covered = offset + sample.size();
+    }
+    key->contentHash = h;
+    return true;
+}
+
+bool ConversionCache::lookup(const ConversionKey& key, QByteArray* data)
+{
+    const QString digest = key.digest();
+    DiskEntry entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_memory.find(digest);
+        if (it != m_memory.end()) {
+            m_memoryLru.splice(m_memoryLru.begin(), m_memoryLru, it->lru);
+            *data = it->data;
+            ++m_stats.memoryHits;
+            Metrics::instance().addCounter(MetricCounter::CacheHits);
+            return true;
+        }
+        auto disk = m_disk.find(digest);
+        if (disk == m_disk.end()) {
+            ++m_stats.misses;
+            Metrics::instance().addCounter(MetricCounter::CacheMisses);
+            return false;
+        }
+        m_diskLru.splice(m_diskLru.begin(), m_diskLru, disk->lru);
+        entry = *disk;
+    }
+
+    // 磁盘读取与核对不持锁
+    QByteArray bytes;
+    const bool valid = verifyArchive(&entry, &bytes);
+
+    QMutexLocker locker(&m_mutex);
+    auto disk = m_disk.find(digest);
+    if (!valid || disk == m_disk.end()) {
+        // 归档被删除或改写，登记作废
+        if (!valid) {
+            dropDiskLocked(digest);
+        }
+        ++m_stats.misses;
+        Metrics::instance().addCounter(MetricCounter::CacheMisses);
+        return false;
+    }
+    if (disk->modifiedMs != entry.modifiedMs) {
+        disk->modifiedMs = entry.modifiedMs;
+        writeIndexLocked(digest, *disk);
+    }
+    ++m_stats.diskHits;
+    Metrics::instance().addCounter(MetricCounter::CacheHits);
+    insertMemory(digest, bytes);
+    *data = bytes;
+    return true;
+}
+
+bool ConversionCache::lookupFile(const ConversionKey& key, QString* path)
+{
+    const QString digest = key.digest();
+    DiskEntry entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto disk = m_disk.find(digest);
+        if (disk == m_disk.end()) {
+            return false;
+        }
+        entry = *disk;
+    }
+
+    // 修改时间未变时只需 stat；变了才读一遍比对哈希
+    const bool valid = verifyArchive(&entry, nullptr);
+    QMutexLocker locker(&m_mutex);
+    auto disk = m_disk.find(digest);
+    if (!valid) {
+        dropDiskLocked(digest);
+        return false;
+    }
+    if (disk == m_disk.end()) {
+        return false;
+    }
+    if (disk->modifiedMs != entry.modifiedMs) {
+        disk->modifiedMs = entry.modifiedMs;
+        writeIndexLocked(digest, *disk);
+    }
+    m_diskLru.splice(m_diskLru.begin(), m_diskLru, disk->lru);
+    ++m_stats.diskHits;
+    Metrics::instance().addCounter(MetricCounter::CacheHits);
+    *path = entry.archivePath;
+    return true;
+}
+
+void ConversionCache::insert(const ConversionKey& key, const QByteArray& data)
+{
+    QMutexLocker locker(&m_mutex);
+    insertMemory(key.digest(), data);
+}
+
+void ConversionCache::archive(const ConversionKey& key, const QByteArray& data, const QString& archivePath)
+{
+    bool indexed;
+    {
+        QMutexLocker locker(&m_mutex);
+        indexed = !m_diskDir.isEmpty() && data.size() <= m_diskBudget;
+    }
+    if (!indexed) {
+        archiveBytesAsync(archivePath, data);
+        return;
+    }
+    // 写盘在归档线程上进行，写完才登记，磁盘层里不会有写到一半的条目
+    const QString digest = key.digest();
+    const qint64 size = data.size();
+    const quint64 hash = hashBytes(0xcbf29ce484222325ULL, data.constData(), size);
+    archiveBytesAsync(archivePath, data, [this, digest, archivePath, size, hash](bool written) {
+        if (written) {
+            indexArchive(digest, QFileInfo(archivePath).absoluteFilePath(), size, hash);
+        }
+    });
+}
+
+void ConversionCache::indexArchive(const QString& digest, const QString& archivePath, qint64 size, quint64 hash)
+{
+    DiskEntry entry;
+    entry.archivePath = archivePath;
+    entry.size = size;
+    entry.hash = hash;
+    entry.modifiedMs = QFileInfo(archivePath).lastModified().toMSecsSinceEpoch();
+
+    QMutexLocker locker(&m_mutex);
+    if (m_diskDir.isEmpty()) {
+        return;
+    }
+    auto it = m_disk.find(digest);
+    if (it != m_disk.end()) {
+        m_diskBytes -= it->size;
+        m_diskLru.erase(it->lru);
+    }
+    m_diskLru.push_front(digest);
+    entry.lru = m_diskLru.begin();
+    m_disk.insert(digest, entry);
+    m_diskBytes += size;
+    writeIndexLocked(digest, entry);
+    evictDisk();
+    m_stats.diskBytes = m_diskBytes;
+}
+
+bool ConversionCache::verifyArchive(DiskEntry* entry, QByteArray* data)
+{
+    const QFileInfo info(entry->archivePath);
+    if (!info.exists() || info.size() != entry->size) {
+        return false;
+    }
+    const qint64 modifiedMs = info.lastModified().toMSecsSinceEpoch();
+    if (!data && modifiedMs == entry->modifiedMs) {
+        return true;
+    }
+    QFile file(entry->archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray bytes = file.readAll();
+    if (bytes.size() != entry->size || hashBytes(0xcbf29ce484222325ULL, bytes.constData(), bytes.size()) != entry->hash) {
+        return false;
+    }
+    entry->modifiedMs = modifiedMs;
+    if (data) {
+        *data = bytes;
+    }
+    return true;
+}
+
+bool ConversionCache::enabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memoryBudget > 0 || !m_diskDir.isEmpty();
+}
+
+ConversionCache::Stats ConversionCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void ConversionCache::insertMemory(const QString& digest, const QByteArray& data)
+{
+    if (data.size() > m_memoryBudget) {
+        return;
+    }
+    auto it = m_memory.find(digest);
+    if (it != m_memory.end()) {
+        m_memoryLru.splice(m_memoryLru.begin(), m_memoryLru, it->lru);
+        return;
+    }
+    m_memoryLru.push_front(digest);
+    m_memory.insert(digest, MemoryEntry{data, m_memoryLru.begin()});
+    m_memoryBytes += data.size();
+    evictMemory();
+}
+
+void ConversionCache::evictMemory()
+{
+    while (m_memoryBytes > m_memoryBudget && !m_memoryLru.empty()) {
+        auto it = m_memory.find(m_memoryLru.back());
+        m_memoryBytes -= it->data.size();
+        m_memory.erase(it);
+        m_memoryLru.pop_back();
+    }
+    m_stats.memoryBytes = m_memoryBytes;
+    Metrics::instance().setGauge(MetricGauge::CacheMemoryBytes, m_memoryBytes);
+}
+
+void ConversionCache::evictDisk()
+{
+    // 只删除索引，归档文件属于用户输出，保持不动
+    while (m_diskBytes > m_diskBudget && !m_diskLru.empty()) {
+        dropDiskLocked(m_diskLru.back());
+    }
+}
+
+void ConversionCache::dropDiskLocked(const QString& digest)
+{
+    auto it = m_disk.find(digest);
+    if (it == m_disk.end()) {
+        return;
+    }
+    m_diskBytes -= it->size;
+    m_diskLru.erase(it->lru);
+    m_disk.erase(it);
+    m_stats.diskBytes = m_diskBytes;
+    QFile::remove(indexPath(digest));
+}
+
+void ConversionCache::writeIndexLocked(const QString& digest, const DiskEntry& entry) const
+{
+    // 先写临时文件再改名，重启时不会读到写了一半的索引
+    const QString path = indexPath(digest);
+    QFile file(path + ".part");
+    const QByteArray line = entry.archivePath.toUtf8() + '\t' + QByteArray::number(entry.size) + '\t'
+                            + QByteArray::number(entry.hash, 16) + '\t' + QByteArray::number(entry.modifiedMs) + '\n';
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(line) != line.size()) {
+        qWarning() << "Cannot write conversion cache index:" << file.fileName();
+        file.remove();
+        return;
+    }
+    file.close();
+    QFile::remove(path);
+    QFile::rename(file.fileName(), path);
+}
+
+QString ConversionCache::indexPath(const QString& digest) const
+{
+    return m_diskDir + "/" + digest + kIndexSuffix;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <list>
+
+// 转换缓存的键：源文件身份 + 编码参数
+struct ConversionKey {
+    qint64 sourceSize = 0;
+    qint64 sourceMtimeMs = 0;
+    quint64 contentHash = 0;   // 头、中、尾三段采样的快速哈希
+    QString params;            // 编码参数，例如 "jpg/q80"
+
+    // 十六进制摘要，同时用作磁盘缓存的文件名
+    QString digest() const;
+};
+
+/**
+ * @class ConversionCache
+ * @brief 以内容寻址的编码结果缓存，同一源文件同一参数只编码一次。
+ * 内存层按最近使用淘汰。磁盘层不另存编码结果，而是把归档输出（<子文件夹>/jpg/<name>.jpg 等）登记在缓存键下：
+ * 缓存目录里每个条目只有一个记录归档路径、长度与内容哈希的小索引文件，程序重启后仍然有效。
+ * 归档写完才登记，取用前核对长度与修改时间，归档被改写过时再比对内容哈希，不一致即作废。
+ * 两层各自有字节上限（磁盘层按登记的归档字节数计），超出时淘汰最久未使用的条目；淘汰只删索引，不删归档文件。
+ * 线程安全。
+ */
+class ConversionCache {
+public:
+    struct Stats {
+        quint64 memoryHits;
+        quint64 diskHits;
+        quint64 misses;
+        qint64 memoryBytes;
+        qint64 diskBytes;
+    };
+
+    static ConversionCache& instance();
+
+    // diskDir 为空时只使用内存层；memoryBudget/diskBudget 为 0 时关闭对应层
+    void configure(const QString& diskDir, qint64 memoryBudget, qint64 diskBudget);
+
+    // 读取源文件的大小、修改时间与采样哈希，生成缓存键
+    static bool makeKey(const QString& sourcePath, const QString& params, ConversionKey* key);
+
+    bool lookup(const ConversionKey& key, QByteArray* data);
+    // 磁盘层登记的归档文件仍有效时给出其路径，不读入内存（供零拷贝发送）；未命中不计数，调用方随后照常 lookup。
+    // 主线程、补发编码线程与网络线程上都可能调用；核对归档时可能重新哈希整个文件，读盘在锁外进行
+    bool lookupFile(const ConversionKey& key, QString* path);
+    // 放入内存层
+    void insert(const ConversionKey& key, const QByteArray& data);
+    // 把编码结果异步写到归档路径，写完后登记为磁盘层条目（磁盘层关闭时只写归档）
+    void archive(const ConversionKey& key, const QByteArray& data, const QString& archivePath);
+
+    Stats stats() const;
+    // 至少有一层开启
+    bool enabled() const;
+
+private:
+    struct MemoryEntry {
+        QByteArray data;
+        std::list<QString>::iterator lru;
+    };
+
+    ConversionCache();
+    Q_DISABLE_COPY(ConversionCache)
+
+    struct DiskEntry {
+        QString archivePath;
+        qint64 size;
+        quint64 hash;           // 编码结果的内容哈希
+        qint64 modifiedMs;      // 最近一次确认内容时归档文件的修改时间
+        std::list<QString>::iterator lru;
+    };
+
+    void insertMemory(const QString& digest, const QByteArray& data);
+    void evictMemory();
+    void evictDisk();
+    // 归档写完后登记（归档线程上调用）
+    void indexArchive(const QString& digest, const QString& archivePath, qint64 size, quint64 hash);
+    // 核对归档文件仍是登记时的内容；data 非空时顺带读出内容。不持锁调用
+    static bool verifyArchive(DiskEntry* entry, QByteArray* data);
+    // 以下在持锁时调用
+    void dropDiskLocked(const QString& digest);
+    void writeIndexLocked(const QString& digest, const DiskEntry& entry) const;
+    QString indexPath(const QString& digest) const;
+
+    mutable QMutex m_mutex;
+    QString m_diskDir;
+    qint64 m_memoryBudget;
+    qint64 m_diskBudget;
+
+    QHash<QString, MemoryEntry> m_memory;
+    std::list<QString> m_memoryLru;          // 前端为最近使用
+    qint64 m_memoryBytes;
+
+    QHash<QString, DiskEntry> m_disk;
+    std::list<QString> m_diskLru;            // 前端为最近使用
+    qint64 m_diskBytes;
+
+    Stats m_stats;
+};
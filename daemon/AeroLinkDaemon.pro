@@ -0,0 +1,20 @@
+# 无界面发送守护进程：基于 QCoreApplication，不链接 QtWidgets
+QT -= widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = aerolinkd
+
+include(../aerolink_core.pri)
+
+SOURCES += \
+    daemon_main.cpp \
+    sender_daemon.cpp
+
+HEADERS += \
+    sender_daemon.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,119 @@
+#include <QCoreApplication>
+#include <QImageReader>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <QDebug>
+#include "app_config.h"
+#include "sender_daemon.h"
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+SenderDaemon* g_daemon = nullptr;
+
+void requestShutdown()
+{
+    if (g_daemon) {
+        QMetaObject::invokeMethod(g_daemon, "shutdown", Qt::QueuedConnection, Q_ARG(int, 10000));
+    }
+}
+
+#ifdef Q_OS_UNIX
+// 信号处理函数中只能做异步信号安全的操作：写一个字节到 socketpair，由事件循环接手
+int g_signalFd[2] = { -1, -1 };
+
+void unixSignalHandler(int)
+{
+    char byte = 1;
+    ssize_t ignored = ::write(g_signalFd[0], &byte, sizeof(byte));
+    Q_UNUSED(ignored);
+}
+
+bool installSignalHandlers(QObject* parent)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, g_signalFd) != 0) {
+        qWarning() << "Could not create signal socketpair.";
+        return false;
+    }
+    QSocketNotifier* notifier = new QSocketNotifier(g_signalFd[1], QSocketNotifier::Read, parent);
+    QObject::connect(notifier, &QSocketNotifier::activated, parent, [notifier]() {
+        notifier->setEnabled(false);
+        char byte;
+        ssize_t ignored = ::read(g_signalFd[1], &byte, sizeof(byte));
+        Q_UNUSED(ignored);
+        requestShutdown();
+        notifier->setEnabled(true);
+    });
+
+    struct sigaction action = {};
+    action.sa_handler = unixSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGHUP, &action, nullptr);
+    // 接收端断开时不要被 SIGPIPE 杀死
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+}
+#endif
+
+#ifdef Q_OS_WIN
+BOOL WINAPI consoleCtrlHandler(DWORD type)
+{
+    switch (type) {
+    case CTRL_C_EVENT:
+    case CTRL_BREAK_EVENT:
+    case CTRL_CLOSE_EVENT:
+    case CTRL_SHUTDOWN_EVENT:
+        requestShutdown();
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+bool installSignalHandlers(QObject*)
+{
+    return SetConsoleCtrlHandler(consoleCtrlHandler, TRUE) != 0;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aerolinkd");
+
+    AppConfig config;
+    QString error;
+    if (!config.parseArguments(app.arguments(), &error)) {
+        QTextStream(stderr) << error << Qt::endl;
+        return 1;
+    }
+
+    QImageReader::setAllocationLimit(1024);
+
+    SenderDaemon daemon(config);
+    g_daemon = &daemon;
+    installSignalHandlers(&app);
+    QObject::connect(&daemon, &SenderDaemon::stopped, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+
+    if (!daemon.start()) {
+        return 1;
+    }
+
+    int code = app.exec();
+    g_daemon = nullptr;
+    return code;
+}
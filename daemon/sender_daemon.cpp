@@ -0,0 +1,184 @@
+#include "sender_daemon.h"
+#include <QDir>
+#include <QDebug>
+#include "backfill.h"
+#include "image_codec.h"
+#include "image_transfer.h"
+#include "image_utils.h"
+#include "conversion_cache.h"
+#include "file_ingest.h"
+#include "metrics.h"
+#include "network_threads.h"
+#include "packet_capture.h"
+#include "roi_pyramid.h"
+#include "sar_link.h"
+#include "transfer_progress.h"
+#include "transfer_scheduler.h"
+
+SenderDaemon::SenderDaemon(const AppConfig& config, QObject* parent)
+    : QObject(parent),
+    m_config(config),
+    m_fileMonitor(new FileMonitor(this)),
+    m_drainTimer(new QTimer(this)),
+    m_roiServer(new RoiServer(this)),
+    m_backfill(nullptr),
+    m_graceMs(0),
+    m_shuttingDown(false)
+{
+    connect(m_fileMonitor, &FileMonitor::newTifFileDetected, this, &SenderDaemon::processAndTransferFile);
+    m_drainTimer->setInterval(100);
+    connect(m_drainTimer, &QTimer::timeout, this, &SenderDaemon::checkDrained);
+}
+
+bool SenderDaemon::start()
+{
+    if (m_config.ipAddress.isEmpty() || m_config.port == 0) {
+        qCritical() << "Invalid receiver address:" << m_config.ipAddress << m_config.port;
+        return false;
+    }
+    const bool backfill = !m_config.backfillRoot.isEmpty();
+    if (backfill && !QDir(m_config.backfillRoot).exists()) {
+        qCritical() << "Backfill folder does not exist:" << m_config.backfillRoot;
+        return false;
+    }
+    if (!backfill && !QDir(m_config.mainFolderPath).exists()) {
+        qCritical() << "Monitored folder does not exist:" << m_config.mainFolderPath;
+        return false;
+    }
+
+    if (!imageCodecByName(m_config.transfer.codec)) {
+        qCritical() << "Codec" << m_config.transfer.codec << "is not available, choose one of" << availableImageCodecs();
+        return false;
+    }
+
+    ConversionCache::instance().configure(m_config.resolvedCacheDir(),
+                                          qint64(m_config.cacheMemoryMiB) << 20,
+                                          qint64(m_config.cacheDiskMiB) << 20);
+
+    // 发送调度：并发数与在途字节预算
+    TransferScheduler::instance().configure(m_config.maxTransfers, qint64(m_config.inFlightMiB) << 20);
+
+    // 源文件预读
+    FileIngest::instance().configure(m_config.ingestFiles, size_t(m_config.ingestMemoryMiB) << 20);
+    if (m_config.ingestFiles > 0) {
+        qDebug() << "Prefetching source files with" << FileIngest::instance().backendName();
+    }
+
+    // 网络线程：套接字处理不占用文件监控与调度所在的主线程
+    NetworkThreads::instance().start(m_config.networkThreads);
+
+    // 链路复用：所有图像在一条连接上发送
+    SarLink::instance().configure(m_config.ipAddress, m_config.port, m_config.multiplexLink);
+    connect(&SarLink::instance(), &SarLink::logMessage, this, [](const QString& message) {
+        qDebug().noquote() << message;
+    });
+
+    // 抓包：记录发出的每个数据包
+    if (!m_config.captureDir.isEmpty()
+        && !PacketCapture::instance().open(m_config.captureDir, qint64(m_config.captureSegmentMiB) << 20)) {
+        qCritical() << "Cannot capture packets to" << m_config.captureDir;
+        return false;
+    }
+
+    // 感兴趣区域拉取：只有开启服务时才建立金字塔
+    PyramidStore::instance().configure(m_config.roiTileSize, m_config.roiQuality,
+                                       m_config.roiPort != 0 ? m_config.roiKeepImages : 0);
+    if (m_config.roiPort != 0) {
+        m_roiServer->start(m_config.roiPort,
+                           m_config.roiBindAddress.isEmpty() ? QHostAddress(QHostAddress::Any) : QHostAddress(m_config.roiBindAddress),
+                           QHostAddress(m_config.roiPeerAddress.isEmpty() ? m_config.ipAddress : m_config.roiPeerAddress));
+    }
+
+    if (m_config.metricsPort != 0) {
+        Metrics::instance().startExporter(m_config.metricsPort);
+    }
+    Metrics::instance().startPeriodicSummary(m_config.metricsSummaryIntervalMs);
+
+    qDebug() << "Sending to" << m_config.ipAddress << "port" << m_config.port;
+
+    // 批量补发：发完整棵目录树后打印报告并退出，不监控新文件
+    if (backfill) {
+        m_backfill = new BackfillJob(m_config, this);
+        m_backfill->setStateFile(m_config.backfillStateFile);
+        connect(m_backfill, &BackfillJob::progress, this, [](int done, int total) {
+            if (done % 100 == 0 || done == total) {
+                qDebug() << "Backfill progress:" << done << "/" << total;
+            }
+        });
+        connect(m_backfill, &BackfillJob::finished, this, [this]() {
+            qDebug().noquote() << m_backfill->reportText();
+            if (!m_shuttingDown) {
+                shutdown();
+            }
+        });
+        m_backfill->start(m_config.backfillRoot);
+        return true;
+    }
+
+    m_fileMonitor->setMainFolder(m_config.mainFolderPath);
+    m_fileMonitor->setActiveLimits(m_config.activeSubDirs, m_config.subDirIdleSec);
+    m_fileMonitor->start();
+    return true;
+}
+
+void SenderDaemon::shutdown(int graceMs)
+{
+    if (m_shuttingDown) {
+        // 第二次收到退出请求时不再等待
+        qWarning() << "Forced shutdown, abandoning in-flight transfers.";
+        m_drainTimer->stop();
+        emit stopped();
+        return;
+    }
+    m_shuttingDown = true;
+    m_fileMonitor->stop();
+    if (m_backfill) {
+        // 已派发的图像照常发完，进度文件保留，下次运行从中断处继续
+        m_backfill->cancel();
+    }
+
+    qDebug() << "Shutting down, waiting for in-flight transfers...";
+    m_graceMs = graceMs;
+    m_drainClock.start();
+    m_drainTimer->start();
+    checkDrained();
+}
+
+void SenderDaemon::processAndTransferFile(const QString& filePath)
+{
+    if (m_shuttingDown) {
+        return;
+    }
+    auto result = processAndTransferImage(filePath, m_config.ipAddress, m_config.port, m_config.transfer);
+    if (!result.success) {
+        qWarning() << result.message;
+    }
+}
+
+void SenderDaemon::checkDrained()
+{
+    // 排队的传输与推迟的编码也要等完
+    const TransferScheduler::Stats scheduled = TransferScheduler::instance().stats();
+    int active = TransferProgress::instance().snapshot().activeTransfers + scheduled.queued + scheduled.quickLookQueued
+                 + scheduled.deferred;
+    // 取消的补发等正在预编码的图像收尾、打印报告
+    if (m_backfill && m_backfill->isRunning()) {
+        ++active;
+    }
+    if (active > 0 && m_drainClock.elapsed() < m_graceMs) {
+        return;
+    }
+    if (active > 0) {
+        qWarning() << "Grace period expired with" << active << "transfer(s) still running.";
+    }
+    m_drainTimer->stop();
+    // 排队中的 JPG 归档写完再退出
+    if (!waitForArchiveWrites(m_graceMs)) {
+        qWarning() << "Archive writes still pending at exit.";
+    }
+    PacketCapture::instance().close();
+    FileIngest::instance().shutdown();
+    NetworkThreads::instance().shutdown();
+    qDebug().noquote() << Metrics::instance().summaryText();
+    emit stopped();
+}
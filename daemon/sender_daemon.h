@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "app_config.h"
+#include "file_monitor.h"
+#include "roi_server.h"
+
+/**
+ * @class SenderDaemon
+ * @brief 无界面运行的发送流水线：监控 -> 转换 -> 发送。
+ * 与 MainWindow 使用同一套 FileMonitor 与 processAndTransferImage，只是不依赖任何窗口部件。
+ * 指定 backfillRoot 时改为批量补发：发完整棵历史目录树后退出。
+ */
+class SenderDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SenderDaemon(const AppConfig& config, QObject* parent = nullptr);
+
+    bool start();
+
+public slots:
+    // 停止监控，等待进行中的传输完成（最多 graceMs 毫秒）后发出 stopped
+    void shutdown(int graceMs = 10000);
+
+signals:
+    void stopped();
+
+private slots:
+    void processAndTransferFile(const QString& filePath);
+    void checkDrained();
+
+private:
+    AppConfig m_config;
+    FileMonitor* m_fileMonitor;
+    QTimer* m_drainTimer;
+    RoiServer* m_roiServer;
+    class BackfillJob* m_backfill;      // 仅批量补发模式下创建
+    QElapsedTimer m_drainClock;
+    int m_graceMs;
+    bool m_shuttingDown;
+};
@@ -0,0 +1,279 @@
+#include "dynamic_range.h"
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AEROLINK_DRC_SSE2 1
+#endif
+
+namespace {
+
+const int kBins = 65536;
+const int kMinRowsPerThread = 32;
+
+// 按行分块并行执行 fn(rowBegin, rowEnd, worker)
+template<typename Fn>
+void forEachRowBlock(int height, int workers, Fn fn)
+{
+    if (workers <= 1) {
+        fn(0, height, 0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    const int rowsPerWorker = (height + workers - 1) / workers;
+    for (int w = 1; w < workers; ++w) {
+        const int begin = w * rowsPerWorker;
+        const int end = std::min(height, begin + rowsPerWorker);
+        if (begin < end) {
+            threads.emplace_back(fn, begin, end, w);
+        }
+    }
+    fn(0, std::min(height, rowsPerWorker), 0);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+// 16 位无符号样本：截断到 ampBit 位后左移到 16 位满量程
+void quantizeU16(const uint16_t* src, uint16_t* dst, int count, int effectiveBits)
+{
+    const int shift = 16 - effectiveBits;
+    const uint16_t maxValue = static_cast<uint16_t>((1u << effectiveBits) - 1);
+    int i = 0;
+#ifdef AEROLINK_DRC_SSE2
+    const __m128i vmax = _mm_set1_epi16(static_cast<short>(maxValue));
+    const __m128i vshift = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // min(v, max) = v - sat(v - max)，SSE2 没有无符号 16 位 min
+        v = _mm_sub_epi16(v, _mm_subs_epu16(v, vmax));
+        v = _mm_sll_epi16(v, vshift);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<uint16_t>(std::min(src[i], maxValue) << shift);
+    }
+}
+
+// 32 位无符号样本：按 ampBit 移位到 16 位并饱和
+void quantizeU32(const uint32_t* src, uint16_t* dst, int count, int effectiveBits)
+{
+    for (int i = 0; i < count; ++i) {
+        const uint64_t v = effectiveBits > 16 ? (src[i] >> (effectiveBits - 16))
+                                              : (uint64_t(src[i]) << (16 - effectiveBits));
+        dst[i] = static_cast<uint16_t>(std::min<uint64_t>(v, kBins - 1));
+    }
+}
+
+// 有符号整数样本：幅度非负，负值按 0 处理
+template<typename T>
+void quantizeSigned(const T* src, uint16_t* dst, int count, int effectiveBits)
+{
+    for (int i = 0; i < count; ++i) {
+        const int64_t s = std::max<int64_t>(0, src[i]);
+        const uint64_t v = effectiveBits > 16 ? (uint64_t(s) >> (effectiveBits - 16))
+                                              : (uint64_t(s) << (16 - effectiveBits));
+        dst[i] = static_cast<uint16_t>(std::min<uint64_t>(v, kBins - 1));
+    }
+}
+
+// 浮点样本：乘以比例后饱和到 [0, 65535]
+void quantizeFloat(const float* src, uint16_t* dst, int count, float scale)
+{
+    int i = 0;
+#ifdef AEROLINK_DRC_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vzero = _mm_setzero_ps();
+    const __m128 vmax = _mm_set1_ps(static_cast<float>(kBins - 1));
+    const __m128i vbias = _mm_set1_epi32(32768);
+    const __m128i vflip = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), vscale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), vscale);
+        a = _mm_min_ps(_mm_max_ps(a, vzero), vmax);
+        b = _mm_min_ps(_mm_max_ps(b, vzero), vmax);
+        // 无符号打包：先减 32768 用有符号饱和打包，再翻转最高位
+        const __m128i ia = _mm_sub_epi32(_mm_cvttps_epi32(a), vbias);
+        const __m128i ib = _mm_sub_epi32(_mm_cvttps_epi32(b), vbias);
+        const __m128i packed = _mm_xor_si128(_mm_packs_epi32(ia, ib), vflip);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#endif
+    for (; i < count; ++i) {
+        // NaN 在比较中为 false，落到 0
+        const float v = src[i] * scale;
+        dst[i] = v > 0.0f ? static_cast<uint16_t>(std::min(v, static_cast<float>(kBins - 1))) : 0;
+    }
+}
+
+int effectiveBitsFor(int ampBit, int bitsPerSample)
+{
+    return (ampBit > 0 && ampBit <= bitsPerSample) ? ampBit : bitsPerSample;
+}
+
+} // namespace
+
+bool parseDrcMapping(const QString& name, DrcMapping* mapping)
+{
+    const QString n = name.trimmed().toLower();
+    if (n == "off" || n == "none") {
+        *mapping = DrcMapping::Off;
+    } else if (n == "linear") {
+        *mapping = DrcMapping::Linear;
+    } else if (n == "log") {
+        *mapping = DrcMapping::Log;
+    } else if (n == "gamma") {
+        *mapping = DrcMapping::Gamma;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString drcMappingName(DrcMapping mapping)
+{
+    switch (mapping) {
+    case DrcMapping::Off: return "off";
+    case DrcMapping::Linear: return "linear";
+    case DrcMapping::Log: return "log";
+    case DrcMapping::Gamma: return "gamma";
+    }
+    return "off";
+}
+
+QImage compressDynamicRange(const SarTiffImage& image, int ampBit, const DrcParams& params, DrcResult* result)
+{
+    const SarTiffInfo& info = image.info;
+    const int width = info.width;
+    const int height = info.height;
+    int workers = params.threads > 0 ? params.threads : QThread::idealThreadCount();
+    workers = std::max(1, std::min(workers, height / kMinRowsPerThread));
+
+    // 浮点样本没有固定满量程，先并行求最大值
+    float floatScale = 1.0f;
+    if (info.sampleFormat == SarSampleFormat::Float) {
+        std::vector<float> maxima(workers, 0.0f);
+        forEachRowBlock(height, workers, [&](int begin, int end, int worker) {
+            float m = 0.0f;
+            for (int y = begin; y < end; ++y) {
+                const float* row = reinterpret_cast<const float*>(image.row(y));
+                for (int x = 0; x < width; ++x) {
+                    m = std::max(m, row[x]);  // NaN 不会更新最大值
+                }
+            }
+            maxima[worker] = m;
+        });
+        const float maxValue = *std::max_element(maxima.begin(), maxima.end());
+        floatScale = maxValue > 0.0f ? static_cast<float>(kBins - 1) / maxValue : 0.0f;
+    }
+    const int effectiveBits = effectiveBitsFor(ampBit, info.bitsPerSample);
+
+    // 第一遍：量化到 16 位坐标并统计直方图，每个线程一份直方图
+    PooledBuffer bins = BufferPool::instance().acquire(static_cast<size_t>(width) * height * sizeof(uint16_t));
+    uint16_t* binData = reinterpret_cast<uint16_t*>(bins.data());
+    std::vector<std::vector<uint32_t>> histograms(workers, std::vector<uint32_t>(kBins, 0));
+    forEachRowBlock(height, workers, [&](int begin, int end, int worker) {
+        uint32_t* hist = histograms[worker].data();
+        for (int y = begin; y < end; ++y) {
+            const uint8_t* row = image.row(y);
+            uint16_t* out = binData + static_cast<size_t>(y) * width;
+            switch (info.bitsPerSample) {
+            case 8:
+                for (int x = 0; x < width; ++x) {
+                    out[x] = static_cast<uint16_t>(row[x] << 8);
+                }
+                break;
+            case 16:
+                if (info.sampleFormat == SarSampleFormat::Int) {
+                    quantizeSigned(reinterpret_cast<const int16_t*>(row), out, width, effectiveBits);
+                } else {
+                    quantizeU16(reinterpret_cast<const uint16_t*>(row), out, width, effectiveBits);
+                }
+                break;
+            default:
+                if (info.sampleFormat == SarSampleFormat::Float) {
+                    quantizeFloat(reinterpret_cast<const float*>(row), out, width, floatScale);
+                } else if (info.sampleFormat == SarSampleFormat::Int) {
+                    quantizeSigned(reinterpret_cast<const int32_t*>(row), out, width, effectiveBits);
+                } else {
+                    quantizeU32(reinterpret_cast<const uint32_t*>(row), out, width, effectiveBits);
+                }
+                break;
+            }
+            for (int x = 0; x < width; ++x) {
+                ++hist[out[x]];
+            }
+        }
+    });
+
+    // 合并直方图并求裁剪百分位
+    std::vector<uint64_t> merged(kBins, 0);
+    for (const auto& hist : histograms) {
+        for (int b = 0; b < kBins; ++b) {
+            merged[b] += hist[b];
+        }
+    }
+    const uint64_t total = static_cast<uint64_t>(width) * height;
+    const double lowTarget = total * std::clamp(params.clipLow, 0.0, 100.0) / 100.0;
+    const double highTarget = total * std::clamp(params.clipHigh, 0.0, 100.0) / 100.0;
+    int lowBin = 0;
+    int highBin = kBins - 1;
+    uint64_t cumulative = 0;
+    bool lowFound = false;
+    for (int b = 0; b < kBins; ++b) {
+        cumulative += merged[b];
+        if (!lowFound && cumulative > lowTarget) {
+            lowBin = b;
+            lowFound = true;
+        }
+        if (cumulative >= highTarget) {
+            highBin = b;
+            break;
+        }
+    }
+    if (highBin <= lowBin) {
+        highBin = std::min(kBins - 1, lowBin + 1);
+        lowBin = highBin - 1;
+    }
+    if (result) {
+        result->lowBin = lowBin;
+        result->highBin = highBin;
+    }
+
+    // 查找表：裁剪区间内按映射曲线展开到 0~255
+    uint8_t lut[kBins];
+    const double range = highBin - lowBin;
+    const double logNorm = std::log1p(params.logGain);
+    const double invGamma = params.gamma > 0.0 ? 1.0 / params.gamma : 1.0;
+    for (int b = 0; b < kBins; ++b) {
+        const double t = std::clamp((b - lowBin) / range, 0.0, 1.0);
+        double f = t;
+        if (params.mapping == DrcMapping::Log && logNorm > 0.0) {
+            f = std::log1p(params.logGain * t) / logNorm;
+        } else if (params.mapping == DrcMapping::Gamma) {
+            f = std::pow(t, invGamma);
+        }
+        lut[b] = static_cast<uint8_t>(std::lround(f * 255.0));
+    }
+
+    // 第二遍：按行并行查表。先取一次 bits() 完成 QImage 的写时复制，避免多线程触发分离
+    QImage out(width, height, QImage::Format_Grayscale8);
+    uchar* outBits = out.bits();
+    const size_t stride = static_cast<size_t>(out.bytesPerLine());
+    forEachRowBlock(height, workers, [&](int begin, int end, int) {
+        for (int y = begin; y < end; ++y) {
+            const uint16_t* in = binData + static_cast<size_t>(y) * width;
+            uchar* dst = outBits + y * stride;
+            for (int x = 0; x < width; ++x) {
+                dst[x] = lut[in[x]];
+            }
+        }
+    });
+    return out;
+}
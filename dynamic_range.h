@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+#include "sar_tiff.h"
+
+// 高位深幅度到 8 位的映射曲线
+enum class DrcMapping {
+    Off,        // 不做预处理，交给 QImage 自行转换
+    Linear,
+    Log,
+    Gamma
+};
+
+struct DrcParams {
+    DrcMapping mapping = DrcMapping::Log;
+    double clipLow = 0.5;       // 低端裁剪百分位
+    double clipHigh = 99.5;     // 高端裁剪百分位
+    double gamma = 2.2;         // Gamma 映射的指数（输出 = t^(1/gamma)）
+    double logGain = 64.0;      // 对数映射的增益（输出 = log(1+g*t)/log(1+g)）
+    int threads = 0;            // 工作线程数，0 表示按 CPU 核数
+};
+
+struct DrcResult {
+    int lowBin = 0;             // 裁剪下限（16 位直方图坐标）
+    int highBin = 0;            // 裁剪上限
+};
+
+bool parseDrcMapping(const QString& name, DrcMapping* mapping);
+QString drcMappingName(DrcMapping mapping);
+
+/**
+ * @brief 把 16/32 位 SAR 幅度压缩到 8 位灰度
+ * 第一遍按行并行把样本量化到 16 位直方图坐标并统计直方图（SSE2 向量化），
+ * 按百分位裁剪后生成 65536 项查找表，第二遍按行并行查表输出。
+ * 整数样本按 ampBit 确定满量程（<= 0 时按样本位深），浮点样本按最大值确定满量程。
+ */
+QImage compressDynamicRange(const SarTiffImage& image, int ampBit, const DrcParams& params,
+                            DrcResult* result = nullptr);
@@ -0,0 +1,553 @@
+#include "file_ingest.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <climits>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "metrics.h"
+#ifdef AEROLINK_HAVE_LIBURING
+#include <liburing.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+/**
+ * @class IngestBackend
+ * @brief 实际执行读取的后端；read 只发起读取，完成后在任意线程上回调，失败时文件为空。
+ */
+class IngestBackend {
+public:
+    using Callback = std::function<void(const QString& path, std::shared_ptr<IngestedFile> file)>;
+
+    explicit IngestBackend(Callback callback) : m_callback(std::move(callback)) {}
+    virtual ~IngestBackend() = default;
+
+    virtual const char* name() const = 0;
+    virtual void setConcurrency(int files) { Q_UNUSED(files); }
+    virtual void read(const QString& path) = 0;
+    // 等待已发起的读取全部结束，之后不再接受新的读取
+    virtual void stop() = 0;
+
+protected:
+    // 按读取开始时的文件状态准备结果；缓冲从池中借出，大小即文件大小。
+    // 超过 INT_MAX 的文件无法用 QByteArray 表示，返回空，不预读
+    static std::shared_ptr<IngestedFile> newFile(const QFileInfo& info)
+    {
+        if (info.size() > INT_MAX) {
+            return nullptr;
+        }
+        auto file = std::make_shared<IngestedFile>();
+        file->size = info.size();
+        file->modifiedMs = info.lastModified().toMSecsSinceEpoch();
+        file->data = BufferPool::instance().acquire(static_cast<size_t>(file->size));
+        return file;
+    }
+
+    Callback m_callback;
+};
+
+namespace {
+
+// ===================== 线程池 =====================
+class ThreadIngestBackend : public IngestBackend {
+public:
+    explicit ThreadIngestBackend(Callback callback) : IngestBackend(std::move(callback))
+    {
+        m_pool.setExpiryTimeout(-1);
+    }
+
+    const char* name() const override { return "threads"; }
+    void setConcurrency(int files) override { m_pool.setMaxThreadCount(qMax(1, files)); }
+    void read(const QString& path) override { m_pool.start(new ReadTask(path, m_callback)); }
+    void stop() override { m_pool.waitForDone(); }
+
+private:
+    class ReadTask : public QRunnable
+    {
+    public:
+        ReadTask(const QString& path, const Callback& callback) : m_path(path), m_callback(callback) {}
+
+        void run() override
+        {
+            QFile source(m_path);
+            if (!source.open(QIODevice::ReadOnly)) {
+                m_callback(m_path, nullptr);
+                return;
+            }
+            std::shared_ptr<IngestedFile> file = newFile(QFileInfo(m_path));
+            if (!file) {
+                m_callback(m_path, nullptr);
+                return;
+            }
+            const qint64 bytesRead = source.read(reinterpret_cast<char*>(file->data.data()), file->size);
+            m_callback(m_path, bytesRead == file->size ? file : nullptr);
+        }
+
+    private:
+        QString m_path;
+        Callback m_callback;
+    };
+
+    QThreadPool m_pool;
+};
+
+#ifdef AEROLINK_HAVE_LIBURING
+// ===================== io_uring =====================
+// 每个文件切成 1 MiB 的读请求一起提交，多个文件的请求共用一个环，由一个收割线程处理完成事件。
+// 提交在调用线程与收割线程上都会发生，以 m_ringMutex 保护；完成队列只由收割线程访问。
+class UringIngestBackend : public IngestBackend {
+public:
+    explicit UringIngestBackend(Callback callback) : IngestBackend(std::move(callback)) {}
+
+    ~UringIngestBackend() override
+    {
+        stop();
+        if (m_initialized) {
+            io_uring_queue_exit(&m_ring);
+        }
+    }
+
+    // 内核不支持（或被 seccomp 禁用）时返回 false，由调用方改用线程池
+    bool init()
+    {
+        if (io_uring_queue_init(kQueueDepth, &m_ring, 0) != 0) {
+            return false;
+        }
+        m_initialized = true;
+        m_reaper = QThread::create([this]() { reapLoop(); });
+        m_reaper->start();
+        return true;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    void read(const QString& path) override
+    {
+        std::shared_ptr<IngestedFile> file = newFile(QFileInfo(path));
+        if (!file) {
+            m_callback(path, nullptr);
+            return;
+        }
+        const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            m_callback(path, nullptr);
+            return;
+        }
+        Job* job = new Job;
+        job->path = path;
+        job->fd = fd;
+        job->file = std::move(file);
+        if (job->file->size == 0) {
+            finish(job);
+            return;
+        }
+        QMutexLocker locker(&m_ringMutex);
+        if (m_stopping) {
+            job->failed = true;
+            locker.unlock();
+            finish(job);
+            return;
+        }
+        m_jobs.push_back(job);
+        submitLocked();
+    }
+
+    void stop() override
+    {
+        {
+            QMutexLocker locker(&m_ringMutex);
+            if (!m_reaper || m_stopping) {
+                return;
+            }
+            m_stopping = true;
+            // 未提交完的文件不再继续，已提交的请求照常收割；空操作用于唤醒收割线程
+            for (Job* job : m_jobs) {
+                job->failed = true;
+            }
+            io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+            if (sqe) {
+                io_uring_prep_nop(sqe);
+                io_uring_sqe_set_data(sqe, nullptr);
+                ++m_inFlight;
+                io_uring_submit(&m_ring);
+            }
+        }
+        m_reaper->wait();
+        delete m_reaper;
+        m_reaper = nullptr;
+    }
+
+private:
+    static constexpr unsigned kQueueDepth = 64;
+    static constexpr qint64 kChunkBytes = qint64(1) << 20;
+
+    struct Job {
+        QString path;
+        int fd = -1;
+        std::shared_ptr<IngestedFile> file;
+        qint64 nextOffset = 0;  // 下一个待提交分块的起点
+        int pending = 0;        // 已提交或等待重新提交的分块数
+        bool failed = false;
+    };
+    struct Chunk {
+        Job* job;
+        qint64 offset;
+        unsigned length;
+    };
+
+    // 持锁调用：先补交短读的剩余部分，再按顺序为各文件提交新分块，直到环满
+    void submitLocked()
+    {
+        unsigned queued = 0;
+        auto push = [&](Chunk* chunk) {
+            io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+            if (!sqe) {
+                return false;
+            }
+            io_uring_prep_read(sqe, chunk->job->fd, chunk->job->file->data.data() + chunk->offset, chunk->length,
+                               static_cast<__u64>(chunk->offset));
+            io_uring_sqe_set_data(sqe, chunk);
+            ++m_inFlight;
+            ++queued;
+            return true;
+        };
+        while (!m_retry.empty() && m_inFlight < kQueueDepth) {
+            Chunk* chunk = m_retry.front();
+            if (chunk->job->failed) {
+                m_retry.pop_front();
+                --chunk->job->pending;
+                delete chunk;
+                continue;
+            }
+            if (!push(chunk)) {
+                break;
+            }
+            m_retry.pop_front();
+        }
+        for (Job* job : m_jobs) {
+            while (!job->failed && job->nextOffset < job->file->size && m_inFlight < kQueueDepth) {
+                const qint64 length = qMin(kChunkBytes, job->file->size - job->nextOffset);
+                Chunk* chunk = new Chunk{job, job->nextOffset, static_cast<unsigned>(length)};
+                if (!push(chunk)) {
+                    delete chunk;
+                    break;
+                }
+                job->nextOffset += length;
+                ++job->pending;
+            }
+        }
+        if (queued > 0) {
+            io_uring_submit(&m_ring);
+        }
+    }
+
+    void reapLoop()
+    {
+        std::vector<Job*> done;
+        for (;;) {
+            io_uring_cqe* cqe = nullptr;
+            const int ret = io_uring_wait_cqe(&m_ring, &cqe);
+            if (ret == -EINTR) {
+                continue;
+            }
+            if (ret < 0) {
+                qWarning() << "io_uring wait failed:" << ret;
+                break;
+            }
+            bool exit = false;
+            {
+                QMutexLocker locker(&m_ringMutex);
+                do {
+                    Chunk* chunk = static_cast<Chunk*>(io_uring_cqe_get_data(cqe));
+                    const int res = cqe->res;
+                    io_uring_cqe_seen(&m_ring, cqe);
+                    --m_inFlight;
+                    if (!chunk) {
+                        continue;
+                    }
+                    Job* job = chunk->job;
+                    if (res == -EAGAIN || res == -EINTR || (res > 0 && static_cast<unsigned>(res) < chunk->length)) {
+                        // 短读或被打断：剩余部分重新提交
+                        if (res > 0) {
+                            chunk->offset += res;
+                            chunk->length -= static_cast<unsigned>(res);
+                        }
+                        m_retry.push_back(chunk);
+                        continue;
+                    }
+                    if (res <= 0) {
+                        // 出错，或读到文件尾时仍未读满（文件被截短）
+                        job->failed = true;
+                    }
+                    --job->pending;
+                    delete chunk;
+                } while (io_uring_peek_cqe(&m_ring, &cqe) == 0);
+
+                submitLocked();
+                for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+                    Job* job = *it;
+                    if (job->pending == 0 && (job->failed || job->nextOffset >= job->file->size)) {
+                        done.push_back(job);
+                        it = m_jobs.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                exit = m_stopping && m_inFlight == 0 && m_jobs.empty() && m_retry.empty();
+            }
+            // 回调可能立即发起新的读取，必须在锁外调用
+            for (Job* job : done) {
+                finish(job);
+            }
+            done.clear();
+            if (exit) {
+                break;
+            }
+        }
+    }
+
+    void finish(Job* job)
+    {
+        ::close(job->fd);
+        m_callback(job->path, job->failed ? nullptr : job->file);
+        delete job;
+    }
+
+    io_uring m_ring;
+    bool m_initialized = false;
+    QThread* m_reaper = nullptr;
+    QMutex m_ringMutex;
+    std::deque<Job*> m_jobs;
+    std::deque<Chunk*> m_retry;
+    unsigned m_inFlight = 0;
+    bool m_stopping = false;
+};
+#endif
+
+} // namespace
+
+FileIngest& FileIngest::instance()
+{
+    static FileIngest ingest;
+    return ingest;
+}
+
+FileIngest::FileIngest()
+{
+    auto callback = [this](const QString& path, std::shared_ptr<IngestedFile> file) {
+        onReadFinished(path, std::move(file));
+    };
+#ifdef AEROLINK_HAVE_LIBURING
+    auto uring = std::make_unique<UringIngestBackend>(callback);
+    if (uring->init()) {
+        m_backend = std::move(uring);
+    } else {
+        qWarning() << "io_uring is not available, prefetching source files on threads";
+    }
+#endif
+    if (!m_backend) {
+        m_backend = std::make_unique<ThreadIngestBackend>(callback);
+    }
+    m_backend->setConcurrency(m_maxInFlight);
+}
+
+FileIngest::~FileIngest()
+{
+    shutdown();
+}
+
+void FileIngest::configure(int maxInFlight, size_t maxCachedBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxInFlight = qMax(0, maxInFlight);
+    m_maxCachedBytes = maxCachedBytes;
+    m_backend->setConcurrency(m_maxInFlight);
+    evictLocked();
+}
+
+bool FileIngest::enabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxInFlight > 0;
+}
+
+int FileIngest::maxInFlight() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxInFlight;
+}
+
+const char* FileIngest::backendName() const
+{
+    return m_backend->name();
+}
+
+QString FileIngest::auxPathFor(const QString& tifPath)
+{
+    // 与 processAndTransferImage 相同的配对规则
+    const QFileInfo info(tifPath);
+    return info.absolutePath() + "/" + info.baseName() + ".dat";
+}
+
+void FileIngest::prefetch(const QString& path)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_maxInFlight <= 0 || m_entries.contains(path)) {
+        return;
+    }
+    m_entries.insert(path, Entry());
+    m_queue.enqueue(path);
+    startReads(locker);
+}
+
+void FileIngest::prefetchImage(const QString& tifPath)
+{
+    prefetch(tifPath);
+    const QString auxPath = auxPathFor(tifPath);
+    if (QFileInfo::exists(auxPath)) {
+        prefetch(auxPath);
+    }
+}
+
+void FileIngest::startReads(QMutexLocker& locker)
+{
+    QStringList paths;
+    while (m_reading < m_maxInFlight && !m_queue.isEmpty()) {
+        const QString path = m_queue.dequeue();
+        auto it = m_entries.find(path);
+        // 排队期间已被释放
+        if (it == m_entries.end() || it->state != State::Queued) {
+            continue;
+        }
+        it->state = State::Reading;
+        ++m_reading;
+        paths.append(path);
+    }
+    // 后端可能在 read 内同步回调，发起读取时不能持锁
+    locker.unlock();
+    for (const QString& path : paths) {
+        m_backend->read(path);
+    }
+}
+
+void FileIngest::onReadFinished(const QString& path, std::shared_ptr<IngestedFile> file)
+{
+    QMutexLocker locker(&m_mutex);
+    --m_reading;
+    auto it = m_entries.find(path);
+    // 读取期间已被释放（或释放后又重新排队）时丢弃本次结果
+    if (it != m_entries.end() && it->state == State::Reading) {
+        if (file) {
+            it->state = State::Ready;
+            it->file = std::move(file);
+            it->lru = m_ready.insert(m_ready.end(), path);
+            m_stats.cachedBytes += static_cast<size_t>(it->file->size);
+            ++m_stats.prefetched;
+            evictLocked();
+        } else {
+            it->state = State::Failed;
+        }
+    }
+    startReads(locker);
+}
+
+IngestedFilePtr FileIngest::get(const QString& path)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(path);
+    // 调用方多在主线程或网络线程上，不能等后台读完；本次直接读盘，预读结果留给后续阶段
+    const bool pending = it != m_entries.end() && (it->state == State::Queued || it->state == State::Reading);
+    if (pending || it == m_entries.end() || it->state != State::Ready) {
+        if (it != m_entries.end() && !pending) {
+            m_entries.erase(it);
+        }
+        if (m_maxInFlight > 0) {
+            ++m_stats.misses;
+            Metrics::instance().addCounter(MetricCounter::IngestMisses);
+        }
+        return nullptr;
+    }
+    IngestedFilePtr file = it->file;
+    locker.unlock();
+
+    // 预读之后文件又被改写（写入方尚未写完时就被发现）则不能使用
+    const QFileInfo info(path);
+    if (info.size() != file->size || info.lastModified().toMSecsSinceEpoch() != file->modifiedMs) {
+        locker.relock();
+        it = m_entries.find(path);
+        if (it != m_entries.end() && it->file == file) {
+            dropLocked(it);
+        }
+        ++m_stats.stale;
+        ++m_stats.misses;
+        Metrics::instance().addCounter(MetricCounter::IngestMisses);
+        return nullptr;
+    }
+    locker.relock();
+    ++m_stats.hits;
+    Metrics::instance().addCounter(MetricCounter::IngestHits);
+    return file;
+}
+
+void FileIngest::release(const QString& path)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(path);
+    if (it != m_entries.end()) {
+        dropLocked(it);
+    }
+}
+
+void FileIngest::releaseImage(const QString& tifPath)
+{
+    release(tifPath);
+    release(auxPathFor(tifPath));
+}
+
+void FileIngest::dropLocked(QHash<QString, Entry>::iterator it)
+{
+    if (it->state == State::Ready) {
+        m_stats.cachedBytes -= static_cast<size_t>(it->file->size);
+        m_ready.erase(it->lru);
+        Metrics::instance().setGauge(MetricGauge::IngestCachedBytes, static_cast<qint64>(m_stats.cachedBytes));
+    }
+    m_entries.erase(it);
+}
+
+void FileIngest::evictLocked()
+{
+    while (m_stats.cachedBytes > m_maxCachedBytes && !m_ready.empty()) {
+        dropLocked(m_entries.find(m_ready.front()));
+        ++m_stats.evicted;
+    }
+    Metrics::instance().setGauge(MetricGauge::IngestCachedBytes, static_cast<qint64>(m_stats.cachedBytes));
+}
+
+FileIngest::Stats FileIngest::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void FileIngest::shutdown()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_maxInFlight = 0;
+        m_queue.clear();
+    }
+    m_backend->stop();
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_ready.clear();
+    m_stats.cachedBytes = 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include "buffer_pool.h"
+
+/**
+ * @struct IngestedFile
+ * @brief 预读进内存的一个完整文件，多个阶段共享只读；最后一个引用释放时缓冲归还 BufferPool。
+ */
+struct IngestedFile {
+    PooledBuffer data;
+    qint64 size = 0;            // 读取时的文件大小与修改时刻，取用前据此判断文件是否又被改写
+    qint64 modifiedMs = 0;
+
+    // 不拷贝的 QByteArray 视图，只在持有本对象期间有效；超过 INT_MAX 的文件不会被预读
+    QByteArray bytes() const
+    {
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()));
+    }
+};
+using IngestedFilePtr = std::shared_ptr<const IngestedFile>;
+
+class IngestBackend;
+
+/**
+ * @class FileIngest
+ * @brief 源文件预读层：文件一就绪就把 TIF 与配对的 AUX 整个读进池化缓冲，同时有多个文件在读，
+ * 编码、打包等阶段按路径取用内存中的内容，磁盘延迟不再与 CPU 处理串行。
+ * Linux 上找到 liburing 时用 io_uring 批量提交分块读取，否则用专门的线程池读取。
+ * 没有预读过、尚未读完、读取失败或文件在预读后又变化的路径，get 返回空，调用方照常直接读盘；
+ * 超过 INT_MAX 字节的文件不预读。线程安全，get 不阻塞。
+ */
+class FileIngest {
+public:
+    struct Stats {
+        uint64_t prefetched;    // 读入内存的文件数
+        uint64_t hits;          // get 命中
+        uint64_t misses;        // get 未命中（未预读、尚未读完、读取失败或已淘汰）
+        uint64_t stale;         // 预读后文件又变化而丢弃
+        uint64_t evicted;       // 超出内存上限而淘汰的未取用文件
+        size_t cachedBytes;     // 已读入、尚未释放的字节数
+    };
+
+    static FileIngest& instance();
+
+    // maxInFlight 个文件同时读取，<= 0 时关闭预读；已读入的内容超过 maxCachedBytes 时淘汰最早的
+    void configure(int maxInFlight, size_t maxCachedBytes);
+    bool enabled() const;
+    int maxInFlight() const;
+    // 当前使用的读取方式："io_uring" 或 "threads"
+    const char* backendName() const;
+
+    // 开始预读；已在队列中、正在读或已读入时不做任何事
+    void prefetch(const QString& path);
+    // 预读 TIF 与同一文件夹下的 <baseName>.dat
+    void prefetchImage(const QString& tifPath);
+    // 取预读结果；仍在排队或读取时不等待，返回空，由调用方直接读盘
+    IngestedFilePtr get(const QString& path);
+    // 图像处理完毕，丢弃缓存（已取得的引用仍然有效）
+    void release(const QString& path);
+    void releaseImage(const QString& tifPath);
+
+    Stats stats() const;
+
+    // 停止后台读取并清空缓存
+    void shutdown();
+
+private:
+    enum class State { Queued, Reading, Ready, Failed };
+    struct Entry {
+        State state = State::Queued;
+        IngestedFilePtr file;
+        std::list<QString>::iterator lru;   // 仅 Ready 时有效
+    };
+
+    FileIngest();
+    ~FileIngest();
+    FileIngest(const FileIngest&) = delete;
+    FileIngest& operator=(const FileIngest&) = delete;
+
+    static QString auxPathFor(const QString& tifPath);
+    // 以下均在持锁时调用；startReads 会释放锁后再交给后端
+    void startReads(QMutexLocker& locker);
+    void dropLocked(QHash<QString, Entry>::iterator it);
+    void evictLocked();
+    // 后台读取完成（任意线程）
+    void onReadFinished(const QString& path, std::shared_ptr<IngestedFile> file);
+
+    mutable QMutex m_mutex;
+    std::unique_ptr<IngestBackend> m_backend;
+    QHash<QString, Entry> m_entries;
+    QQueue<QString> m_queue;
+    std::list<QString> m_ready;         // 已读入的路径，最早读完的在前
+    int m_maxInFlight = 4;
+    size_t m_maxCachedBytes = size_t(512) << 20;
+    int m_reading = 0;
+    Stats m_stats = {};
+};
@@ -2,18 +2,50 @@
 #include <QFileInfo>
 #include <QDebug>
 #include <QSet> // 引入 QSet 用于存储已处理的文件路径
+#include <QDateTime>
+#include "file_ingest.h"
+#include "metrics.h"
 
-FileMonitor::FileMonitor(QObject* parent) : QObject(parent) {
+// 预读前要求文件至少这么久没有被改动：Linux 上写入中的文件照样能打开，只能靠修改时间判断是否写完
+static const qint64 kPrefetchSettleMs = 2000;
+
+// 记录从文件最后修改到被发现的延迟
+static void recordDetection(const QString& fullPath) {
+    qint64 ageMs = QFileInfo(fullPath).lastModified().msecsTo(QDateTime::currentDateTime());
+    Metrics::instance().recordStage(PipelineStage::Detect, ageMs * 1000);
+    Metrics::instance().addCounter(MetricCounter::ImagesDetected);
+}
+
+FileMonitor::FileMonitor(QObject* parent)
+    : QObject(parent),
+    m_maxActive(4),
+    m_idleTimeoutSec(600),
+    m_dispatchCursor(0) {
     m_mainWatcher = new QFileSystemWatcher(this);
     m_subWatcher = new QFileSystemWatcher(this);
     connect(m_mainWatcher, &QFileSystemWatcher::directoryChanged, this, &FileMonitor::onMainDirectoryChanged);
     connect(m_subWatcher, &QFileSystemWatcher::directoryChanged, this, &FileMonitor::onSubdirectoryChanged);
+
+    m_dispatchTimer = new QTimer(this);
+    m_dispatchTimer->setSingleShot(true);
+    m_dispatchTimer->setInterval(0);
+    connect(m_dispatchTimer, &QTimer::timeout, this, &FileMonitor::dispatchNext);
+
+    m_idleTimer = new QTimer(this);
+    connect(m_idleTimer, &QTimer::timeout, this, &FileMonitor::retireIdleSubDirs);
+
+    m_clock.start();
 }
 
 void FileMonitor::setMainFolder(const QString& folderPath) {
     m_mainFolderPath = folderPath;
 }
 
+void FileMonitor::setActiveLimits(int maxActive, int idleTimeoutSec) {
+    m_maxActive = qMax(1, maxActive);
+    m_idleTimeoutSec = idleTimeoutSec;
+}
+
 void FileMonitor::start() {
     if (!m_mainFolderPath.isEmpty()) {
         stop(); // 停止所有监控，避免重复添加路径
@@ -24,24 +56,31 @@ void FileMonitor::start() {
         QStringList subDirs = mainDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time);
 
         if (!subDirs.isEmpty()) {
-            m_currentSubDir = mainDir.filePath(subDirs.first());
-            m_subWatcher->addPath(m_currentSubDir);
-            qDebug() << "Watching newest sub-directory:" << m_currentSubDir;
-            emit subDirChanged(m_currentSubDir);
-
-            // 扫描最新子文件夹中的所有TIF文件，并添加到已处理的集合中
-            m_processedFiles.clear(); // 清空旧的集合
-            QDir subDir(m_currentSubDir);
-            QStringList tifFiles = subDir.entryList(QStringList("*.tif"), QDir::Files | QDir::NoDotAndDotDot);
-            for (const QString& fileName : tifFiles) {
-                QString fullPath = subDir.filePath(fileName);
-                m_processedFiles.insert(fullPath); // 将所有现有文件都标记为已处理
-                qDebug() << "Found existing .tif file:" << fullPath;
-                emit newTifFileDetected(fullPath);
+            // 最新的子文件夹总是监控；其余子文件夹在空闲超时内有过修改的也一并监控，总数不超过上限
+            QStringList candidates;
+            const QDateTime now = QDateTime::currentDateTime();
+            for (int i = 0; i < subDirs.size(); ++i) {
+                const QString fullPath = mainDir.filePath(subDirs.at(i));
+                m_knownSubDirs.insert(fullPath);
+                if (candidates.size() >= m_maxActive) {
+                    continue;
+                }
+                const bool recent = m_idleTimeoutSec > 0
+                    && QFileInfo(fullPath).lastModified().secsTo(now) <= m_idleTimeoutSec;
+                if (i == 0 || recent) {
+                    candidates.append(fullPath);
+                }
+            }
+            // 从旧到新加入，最新的子文件夹成为当前子文件夹
+            for (int i = candidates.size() - 1; i >= 0; --i) {
+                activateSubDir(candidates.at(i), true);
             }
         } else {
             qDebug() << "No sub-directories found in main folder.";
         }
+        if (m_idleTimeoutSec > 0) {
+            m_idleTimer->start(qBound(1000, m_idleTimeoutSec * 250, 60000));
+        }
         emit mainDirChanged(m_mainFolderPath);
     } else {
         qDebug() << "Main folder path is empty. Aborting start().";
@@ -49,6 +88,14 @@ void FileMonitor::start() {
 }
 
 void FileMonitor::stop() {
+    m_dispatchTimer->stop();
+    m_idleTimer->stop();
+    m_subDirs.clear();
+    m_knownSubDirs.clear();
+    m_pending.clear();
+    m_dispatchOrder.clear();
+    m_dispatchCursor = 0;
+    m_currentSubDir.clear();
     if (m_mainWatcher->directories().isEmpty() && m_subWatcher->directories().isEmpty()) {
         return;
     }
@@ -61,44 +108,213 @@ QString FileMonitor::getCurrentSubDir() const {
     return m_currentSubDir;
 }
 
-void FileMonitor::onMainDirectoryChanged(const QString& path) {
-    QDir dir(path);
-    QStringList subDirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time);
-
-    if (!subDirs.isEmpty()) {
-        QString latestSubDir = dir.filePath(subDirs.first());
-
-        // 确保新找到的文件夹存在且不是当前监控的文件夹
-        if (m_currentSubDir != latestSubDir && QFileInfo::exists(latestSubDir)) {
-            qDebug() << "Detected new newest sub-directory:" << latestSubDir;
-            // 移除旧的监控
-            m_subWatcher->removePaths(m_subWatcher->directories());
-            // 添加新的监控
-            m_subWatcher->addPath(latestSubDir);
-            // 更新当前子文件夹路径
-            m_currentSubDir = latestSubDir;
-            // 清空已处理文件集合，准备处理新文件夹中的文件
-            m_processedFiles.clear();
-            // 发出信号，通知外部最新子文件夹已切换
-            emit subDirChanged(latestSubDir);
-        }
-    }
-    // 即使没有切换，也发出主目录变化信号（如果需要）
-    emit mainDirChanged(path);
+QStringList FileMonitor::activeSubDirs() const {
+    return m_subDirs.keys();
 }
 
-void FileMonitor::onSubdirectoryChanged(const QString& path) {
-    QDir dir(path);
+int FileMonitor::pendingFiles() const {
+    int count = 0;
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        count += it.value().size();
+    }
+    return count;
+}
+
+void FileMonitor::activateSubDir(const QString& subDir, bool preexisting) {
+    m_knownSubDirs.insert(subDir);
+    if (m_subDirs.contains(subDir)) {
+        return;
+    }
+    // 超出上限时先停止最久没有新文件的子文件夹
+    while (m_subDirs.size() >= m_maxActive) {
+        QString oldest;
+        qint64 oldestActivity = 0;
+        for (auto it = m_subDirs.constBegin(); it != m_subDirs.constEnd(); ++it) {
+            if (oldest.isEmpty() || it.value().lastActivityMs < oldestActivity) {
+                oldest = it.key();
+                oldestActivity = it.value().lastActivityMs;
+            }
+        }
+        retireSubDir(oldest);
+    }
+
+    m_subDirs[subDir].lastActivityMs = m_clock.elapsed();
+    m_subWatcher->addPath(subDir);
+    m_currentSubDir = subDir;
+    qDebug() << "Watching sub-directory:" << subDir << "(" << m_subDirs.size() << "active)";
+    emit subDirChanged(subDir);
+
+    // 监控建立之前已经写入的文件也要处理
+    scanSubDir(subDir, preexisting);
+}
+
+void FileMonitor::retireSubDir(const QString& subDir) {
+    if (!m_subDirs.contains(subDir)) {
+        return;
+    }
+    // 停止前最后扫描一次，已发现的文件照常派发完
+    scanSubDir(subDir, false);
+    m_subDirs.remove(subDir);
+    m_subWatcher->removePath(subDir);
+    auto pending = m_pending.find(subDir);
+    if (pending != m_pending.end() && pending->isEmpty()) {
+        m_pending.erase(pending);
+        const int index = m_dispatchOrder.indexOf(subDir);
+        m_dispatchOrder.removeAt(index);
+        if (m_dispatchCursor > index) {
+            --m_dispatchCursor;
+        }
+        if (m_dispatchCursor >= m_dispatchOrder.size()) {
+            m_dispatchCursor = 0;
+        }
+    }
+    qDebug() << "Stopped watching sub-directory:" << subDir;
+    if (m_currentSubDir == subDir) {
+        // 当前子文件夹改为剩下的活跃文件夹中最近有新文件的一个
+        m_currentSubDir.clear();
+        qint64 latestActivity = -1;
+        for (auto it = m_subDirs.constBegin(); it != m_subDirs.constEnd(); ++it) {
+            if (it.value().lastActivityMs > latestActivity) {
+                m_currentSubDir = it.key();
+                latestActivity = it.value().lastActivityMs;
+            }
+        }
+    }
+    emit subDirRetired(subDir);
+}
+
+void FileMonitor::scanSubDir(const QString& subDir, bool preexisting) {
+    auto state = m_subDirs.find(subDir);
+    if (state == m_subDirs.end()) {
+        return;
+    }
+    QDir dir(subDir);
     QStringList currentFiles = dir.entryList(QStringList("*.tif"), QDir::Files | QDir::NoDotAndDotDot);
 
-    // 找出新增的文件
+    // 找出新增的文件，放进该子文件夹的派发队列
+    bool found = false;
     for (const QString& fileName : currentFiles) {
         QString fullPath = dir.filePath(fileName);
-        if (!m_processedFiles.contains(fullPath)) {
-            // 这是新文件，发出信号并添加到已处理集合
+        if (state->processedFiles.contains(fullPath)) {
+            continue;
+        }
+        state->processedFiles.insert(fullPath);
+        if (preexisting) {
+            qDebug() << "Found existing .tif file:" << fullPath;
+            // 启动前已存在的文件不计入发现延迟
+            Metrics::instance().addCounter(MetricCounter::ImagesDetected);
+        } else {
             qDebug() << "New .tif file detected:" << fullPath;
-            emit newTifFileDetected(fullPath);
-            m_processedFiles.insert(fullPath);
+            recordDetection(fullPath);
+        }
+        if (!m_pending.contains(subDir)) {
+            m_dispatchOrder.append(subDir);
+        }
+        m_pending[subDir].enqueue(fullPath);
+        found = true;
+    }
+    if (found) {
+        state->lastActivityMs = m_clock.elapsed();
+        if (!m_dispatchTimer->isActive()) {
+            m_dispatchTimer->start();
+        }
+    }
+}
+
+void FileMonitor::onMainDirectoryChanged(const QString& path) {
+    QDir dir(path);
+    // 从旧到新处理，同时出现多个新子文件夹时最新的一个成为当前子文件夹
+    QStringList subDirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time | QDir::Reversed);
+
+    for (const QString& name : subDirs) {
+        const QString fullPath = dir.filePath(name);
+        if (m_knownSubDirs.contains(fullPath) || !QFileInfo::exists(fullPath)) {
+            continue;
+        }
+        qDebug() << "Detected new sub-directory:" << fullPath;
+        activateSubDir(fullPath, false);
+    }
+
+    // 被删除的子文件夹不再监控
+    const QStringList active = m_subDirs.keys();
+    for (const QString& subDir : active) {
+        if (!QFileInfo::exists(subDir)) {
+            retireSubDir(subDir);
+        }
+    }
+    emit mainDirChanged(path);
+}
+
+void FileMonitor::onSubdirectoryChanged(const QString& path) {
+    scanSubDir(path, false);
+}
+
+void FileMonitor::dispatchNext() {
+    // 从上次派发的下一个子文件夹开始轮流取，每次只派发一个文件
+    const int count = m_dispatchOrder.size();
+    for (int i = 0; i < count; ++i) {
+        const int index = (m_dispatchCursor + i) % count;
+        const QString subDir = m_dispatchOrder.at(index);
+        QQueue<QString>& queue = m_pending[subDir];
+        if (queue.isEmpty()) {
+            continue;
+        }
+        const QString fullPath = queue.dequeue();
+        m_dispatchCursor = index + 1;
+        // 已停止监控的子文件夹排空后移出轮询
+        if (queue.isEmpty() && !m_subDirs.contains(subDir)) {
+            m_pending.remove(subDir);
+            m_dispatchOrder.removeAt(index);
+            m_dispatchCursor = index;
+        }
+        if (!m_dispatchOrder.isEmpty()) {
+            m_dispatchCursor %= m_dispatchOrder.size();
+        }
+        // 处理这幅图像期间，后面几幅已写完的源文件在后台读入内存；
+        // 本幅尚未经过就绪检查，不在这里预读，由 processAndTransferImage 确认文件就绪后处理
+        prefetchUpcoming(FileIngest::instance().maxInFlight());
+        emit newTifFileDetected(fullPath);
+        break;
+    }
+    if (pendingFiles() > 0 && !m_dispatchTimer->isActive()) {
+        m_dispatchTimer->start();
+    }
+}
+
+// 按派发顺序（各子文件夹轮流）预读接下来的 count 幅图像；只预读大小非零、修改时间已稳定 kPrefetchSettleMs 的文件，
+// 可能仍在写入的文件这次跳过，之后每次派发时再检查，不等待
+void FileMonitor::prefetchUpcoming(int count) {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const int folders = m_dispatchOrder.size();
+    for (int depth = 0; count > 0; ++depth) {
+        bool more = false;
+        for (int i = 0; i < folders && count > 0; ++i) {
+            const QQueue<QString>& queue = m_pending[m_dispatchOrder.at((m_dispatchCursor + i) % folders)];
+            if (depth < queue.size()) {
+                const QFileInfo info(queue.at(depth));
+                if (info.size() > 0 && now - info.lastModified().toMSecsSinceEpoch() >= kPrefetchSettleMs) {
+                    FileIngest::instance().prefetchImage(queue.at(depth));
+                }
+                --count;
+                more = true;
+            }
+        }
+        if (!more) {
+            break;
+        }
+    }
+}
+
+void FileMonitor::retireIdleSubDirs() {
+    if (m_idleTimeoutSec <= 0) {
+        return;
+    }
+    // 当前（最新的）子文件夹即使空闲也保持监控，否则安静一段时间后新文件会被漏掉
+    const qint64 now = m_clock.elapsed();
+    const QStringList active = m_subDirs.keys();
+    for (const QString& subDir : active) {
+        if (subDir != m_currentSubDir && now - m_subDirs.value(subDir).lastActivityMs > qint64(m_idleTimeoutSec) * 1000) {
+            retireSubDir(subDir);
         }
     }
 }
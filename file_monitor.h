@@ -2,30 +2,74 @@
 #include <QObject>
 #include <QFileSystemWatcher>
 #include <QString>
+#include <QStringList>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
 
+/**
+ * @class FileMonitor
+ * @brief 监控主文件夹下一组活跃子文件夹中新出现的 TIF 文件。
+ * 新建的子文件夹加入活跃集合，旧文件夹继续监控，直到空闲超时或超出数量上限，
+ * 迟到写入上一个文件夹的图像和多个传感器并行写入的文件夹都能被发现。
+ * 各文件夹发现的文件分别排队，按文件夹轮流逐个派发，单个文件夹的突发不会挡住其他文件夹。
+ */
 class FileMonitor : public QObject {
     Q_OBJECT
 public:
     explicit FileMonitor(QObject* parent = nullptr);
     void setMainFolder(const QString& folderPath);
+    // maxActive：同时监控的子文件夹数上限（至少 1）；idleTimeoutSec：子文件夹多久没有新文件后停止监控，<= 0 表示不超时
+    void setActiveLimits(int maxActive, int idleTimeoutSec);
     void start();
     void stop();
+    // 最新的活跃子文件夹
     QString getCurrentSubDir() const;
+    QStringList activeSubDirs() const;
+    // 已发现、尚未派发的文件数
+    int pendingFiles() const;
 
 signals:
     void newTifFileDetected(const QString& tifPath);
     void mainDirChanged(const QString& mainDir);
+    // 子文件夹开始被监控
     void subDirChanged(const QString& subDir);
+    // 子文件夹因空闲或超出上限停止监控
+    void subDirRetired(const QString& subDir);
 
 private slots:
     void onMainDirectoryChanged(const QString& path);
     void onSubdirectoryChanged(const QString& path);
+    void dispatchNext();
+    void retireIdleSubDirs();
 
 private:
+    struct SubDirState {
+        QSet<QString> processedFiles;   // 已发现的 TIF
+        qint64 lastActivityMs = 0;      // 最近一次发现新文件（或开始监控）的时刻
+    };
+
+    void activateSubDir(const QString& subDir, bool preexisting);
+    void retireSubDir(const QString& subDir);
+    void scanSubDir(const QString& subDir, bool preexisting);
+    void prefetchUpcoming(int count);
+
     QFileSystemWatcher* m_mainWatcher;
     QFileSystemWatcher* m_subWatcher;
     QString m_mainFolderPath;
     QString m_currentSubDir;
-    QSet<QString> m_processedFiles;
+    int m_maxActive;
+    int m_idleTimeoutSec;
+    QHash<QString, SubDirState> m_subDirs;  // 活跃子文件夹
+    QSet<QString> m_knownSubDirs;           // 见过的全部子文件夹，停止监控的不再重新加入
+    // 按子文件夹排队等待派发的 TIF；停止监控的文件夹排空后才移除
+    QHash<QString, QQueue<QString>> m_pending;
+    QStringList m_dispatchOrder;            // 轮流派发的顺序，与 m_pending 的键一致
+    int m_dispatchCursor;
+    QElapsedTimer m_clock;
+    QTimer* m_dispatchTimer;                // 零间隔定时器，每轮事件循环派发一个文件
+    QTimer* m_idleTimer;
 };
@@ -0,0 +1,251 @@
+#include "image_codec.h"
+#include <QBuffer>
+#include <QFile>
+#include <QImage>
+#include <QDebug>
+#include <QtEndian>
+#include "file_ingest.h"
+#include "lz4_block.h"
+#include "image_utils.h"
+#ifdef AEROLINK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// 解码端的原始长度来自对端，分配前先限制：不超过 1 GiB（也就在 QByteArray 的 int 长度以内）
+const quint64 kMaxDecodedBytes = quint64(1) << 30;
+// LZ4 块的压缩比不会超过约 255 倍
+const quint64 kLz4MaxRatio = 256;
+
+bool decodedSizeAcceptable(quint64 rawSize)
+{
+    if (rawSize > kMaxDecodedBytes) {
+        qDebug() << "Rejecting decoded size" << rawSize << "above limit" << kMaxDecodedBytes;
+        return false;
+    }
+    return true;
+}
+
+// 读取整个源文件；已预读时直接引用内存中的内容，data 只在 ingested 存活期间有效
+bool readWholeFile(const QString& path, QByteArray* data, IngestedFilePtr* ingested)
+{
+    *ingested = FileIngest::instance().get(path);
+    if (*ingested) {
+        *data = (*ingested)->bytes();
+        return true;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to open source file:" << path;
+        return false;
+    }
+    *data = file.readAll();
+    return data->size() == file.size();
+}
+
+// ===================== JPEG =====================
+class JpegCodec : public ImageCodec {
+public:
+    CodecId id() const override { return CodecId::Jpeg; }
+    QString name() const override { return "jpeg"; }
+    QString fileExtension() const override { return "jpg"; }
+    uint8_t parameter(const TransferOptions& options) const override { return static_cast<uint8_t>(options.jpgQuality); }
+
+    bool encode(const EncodeSource& source, const TransferOptions& options, QByteArray* encoded) const override
+    {
+        return encodeSarTiffToJpg(source.path, *encoded, options.jpgQuality, source.ampBit, drcParamsFromOptions(options));
+    }
+    QString cacheParams(const EncodeSource& source, const TransferOptions& options) const override
+    {
+        // 动态范围压缩的参数也会改变输出
+        return ImageCodec::cacheParams(source, options)
+               + QString("/%1/%2/%3/%4").arg(drcMappingName(drcParamsFromOptions(options).mapping))
+                     .arg(options.drcClipLow).arg(options.drcClipHigh).arg(options.drcGamma);
+    }
+
+    bool decode(const QByteArray& encoded, QByteArray* fileData) const override
+    {
+        *fileData = encoded;
+        return !encoded.isEmpty();
+    }
+};
+
+// ===================== LZ4 =====================
+// 数据段：4 字节小端原始长度 + LZ4 块
+class Lz4Codec : public ImageCodec {
+public:
+    CodecId id() const override { return CodecId::Lz4; }
+    QString name() const override { return "lz4"; }
+    QString fileExtension() const override { return "tif"; }
+
+    bool encode(const EncodeSource& source, const TransferOptions& options, QByteArray* encoded) const override
+    {
+        Q_UNUSED(options);
+        QByteArray raw;
+        IngestedFilePtr ingested;
+        if (!readWholeFile(source.path, &raw, &ingested)) {
+            return false;
+        }
+        const size_t rawSize = static_cast<size_t>(raw.size());
+        encoded->resize(static_cast<int>(4 + lz4::compressBound(rawSize)));
+        qToLittleEndian<quint32>(static_cast<quint32>(rawSize), encoded->data());
+        const size_t packed = lz4::compress(reinterpret_cast<const uint8_t*>(raw.constData()), rawSize,
+                                            reinterpret_cast<uint8_t*>(encoded->data()) + 4, encoded->size() - 4);
+        if (packed == 0) {
+            return false;
+        }
+        encoded->resize(static_cast<int>(4 + packed));
+        return true;
+    }
+    bool decode(const QByteArray& encoded, QByteArray* fileData) const override
+    {
+        if (encoded.size() < 4) {
+            return false;
+        }
+        const quint32 rawSize = qFromLittleEndian<quint32>(encoded.constData());
+        if (!decodedSizeAcceptable(rawSize) || rawSize > quint64(encoded.size() - 4) * kLz4MaxRatio) {
+            return false;
+        }
+        fileData->resize(static_cast<int>(rawSize));
+        if (fileData->size() != static_cast<int>(rawSize)) {
+            return false;
+        }
+        // 按实际分配的长度解压，长度不符即失败
+        return lz4::decompress(reinterpret_cast<const uint8_t*>(encoded.constData()) + 4, encoded.size() - 4,
+                               reinterpret_cast<uint8_t*>(fileData->data()), static_cast<size_t>(fileData->size()));
+    }
+};
+
+// ===================== zstd =====================
+class ZstdCodec : public ImageCodec {
+public:
+    CodecId id() const override { return CodecId::Zstd; }
+    QString name() const override { return "zstd"; }
+    QString fileExtension() const override { return "tif"; }
+    uint8_t parameter(const TransferOptions& options) const override { return static_cast<uint8_t>(options.zstdLevel); }
+#ifdef AEROLINK_HAVE_ZSTD
+    bool encode(const EncodeSource& source, const TransferOptions& options, QByteArray* encoded) const override
+    {
+        QByteArray raw;
+        IngestedFilePtr ingested;
+        if (!readWholeFile(source.path, &raw, &ingested)) {
+            return false;
+        }
+        encoded->resize(static_cast<int>(ZSTD_compressBound(raw.size())));
+        const size_t packed = ZSTD_compress(encoded->data(), encoded->size(), raw.constData(), raw.size(), options.zstdLevel);
+        if (ZSTD_isError(packed)) {
+            qDebug() << "zstd compression failed:" << ZSTD_getErrorName(packed);
+            return false;
+        }
+        encoded->resize(static_cast<int>(packed));
+        return true;
+    }
+    bool decode(const QByteArray& encoded, QByteArray* fileData) const override
+    {
+        const unsigned long long rawSize = ZSTD_getFrameContentSize(encoded.constData(), encoded.size());
+        if (rawSize == ZSTD_CONTENTSIZE_ERROR || rawSize == ZSTD_CONTENTSIZE_UNKNOWN || !decodedSizeAcceptable(rawSize)) {
+            return false;
+        }
+        fileData->resize(static_cast<int>(rawSize));
+        if (fileData->size() != static_cast<int>(rawSize)) {
+            return false;
+        }
+        const size_t unpacked = ZSTD_decompress(fileData->data(), fileData->size(), encoded.constData(), encoded.size());
+        return !ZSTD_isError(unpacked) && unpacked == rawSize;
+    }
+#else
+    bool available() const override { return false; }
+    bool encode(const EncodeSource&, const TransferOptions&, QByteArray*) const override { return false; }
+    bool decode(const QByteArray&, QByteArray*) const override { return false; }
+#endif
+};
+
+// ===================== 16 位 PNG =====================
+class Png16Codec : public ImageCodec {
+public:
+    CodecId id() const override { return CodecId::Png16; }
+    QString name() const override { return "png16"; }
+    QString fileExtension() const override { return "png"; }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    bool encode(const EncodeSource& source, const TransferOptions& options, QByteArray* encoded) const override
+    {
+        Q_UNUSED(options);
+        QImage image;
+        if (!loadImageFile(source.path, &image)) {
+            qDebug() << "Failed to load image:" << source.path;
+            return false;
+        }
+        // 8 位源图按 x257 扩展到 16 位，高位深源图原样保留
+        const QImage gray = image.convertToFormat(QImage::Format_Grayscale16);
+        encoded->clear();
+        QBuffer buffer(encoded);
+        buffer.open(QIODevice::WriteOnly);
+        return gray.save(&buffer, "PNG");
+    }
+#else
+    bool available() const override { return false; }
+    bool encode(const EncodeSource&, const TransferOptions&, QByteArray*) const override { return false; }
+#endif
+    bool decode(const QByteArray& encoded, QByteArray* fileData) const override
+    {
+        *fileData = encoded;
+        return !encoded.isEmpty();
+    }
+};
+
+const JpegCodec kJpeg;
+const Lz4Codec kLz4;
+const ZstdCodec kZstd;
+const Png16Codec kPng16;
+const ImageCodec* const kCodecs[] = { &kJpeg, &kLz4, &kZstd, &kPng16 };
+
+} // namespace
+
+DrcParams drcParamsFromOptions(const TransferOptions& options)
+{
+    DrcParams params;
+    if (!parseDrcMapping(options.drc, &params.mapping)) {
+        params.mapping = DrcMapping::Log;
+    }
+    params.clipLow = options.drcClipLow;
+    params.clipHigh = options.drcClipHigh;
+    params.gamma = options.drcGamma;
+    return params;
+}
+
+QString ImageCodec::cacheParams(const EncodeSource& source, const TransferOptions& options) const
+{
+    return QString("%1/%2/amp%3").arg(name()).arg(parameter(options)).arg(source.ampBit);
+}
+
+const ImageCodec* imageCodecById(uint8_t id)
+{
+    for (const ImageCodec* codec : kCodecs) {
+        if (static_cast<uint8_t>(codec->id()) == id) {
+            return codec->available() ? codec : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const ImageCodec* imageCodecByName(const QString& name)
+{
+    for (const ImageCodec* codec : kCodecs) {
+        if (codec->name().compare(name, Qt::CaseInsensitive) == 0) {
+            return codec->available() ? codec : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+QStringList availableImageCodecs()
+{
+    QStringList names;
+    for (const ImageCodec* codec : kCodecs) {
+        if (codec->available()) {
+            names << codec->name();
+        }
+    }
+    return names;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include "app_config.h"
+#include "dynamic_range.h"
+
+// 编码方式编号，写入 SAR_DataInfo::codec_id，接收端据此解码。
+// 旧版本发送端该字节恒为 0，对应 JPEG。
+enum class CodecId : uint8_t {
+    Jpeg = 0,       // 8 位 JPEG，有损
+    Lz4 = 1,        // 原始 TIF 文件 + LZ4 块压缩，无损，编码开销最小
+    Zstd = 2,       // 原始 TIF 文件 + zstd 压缩，无损，压缩率更高
+    Png16 = 3       // 16 位灰度 PNG，保留高位深幅度，无损
+};
+
+// 一幅待编码的图像
+struct EncodeSource {
+    QString path;       // 源 TIF 路径
+    int ampBit = 0;     // AUX 中的幅度位数，0 表示未知
+};
+
+/**
+ * @class ImageCodec
+ * @brief 源 TIF 到待发送字节流的编码方式。
+ * encode 在发送端把源文件编码为数据段；decode 在接收端把数据段还原为可直接保存的文件内容。
+ */
+class ImageCodec {
+public:
+    virtual ~ImageCodec() = default;
+
+    virtual CodecId id() const = 0;
+    // 配置与命令行中使用的名称
+    virtual QString name() const = 0;
+    // 归档文件与接收端保存时使用的扩展名
+    virtual QString fileExtension() const = 0;
+    // 当前构建是否支持（可选依赖库缺失时为 false）
+    virtual bool available() const { return true; }
+
+    // 写入 SAR_DataInfo::codec_param 的参数（JPEG 质量、zstd 等级等）
+    virtual uint8_t parameter(const TransferOptions& options) const { Q_UNUSED(options); return 0; }
+    virtual bool encode(const EncodeSource& source, const TransferOptions& options, QByteArray* encoded) const = 0;
+    virtual bool decode(const QByteArray& encoded, QByteArray* fileData) const = 0;
+
+    // 转换缓存键中的编码参数部分
+    virtual QString cacheParams(const EncodeSource& source, const TransferOptions& options) const;
+};
+
+// 由发送选项得到动态范围压缩参数，未知的映射名按 log 处理
+DrcParams drcParamsFromOptions(const TransferOptions& options);
+
+// 按编号或名称查找编码器，未知或当前构建不支持时返回 nullptr
+const ImageCodec* imageCodecById(uint8_t id);
+const ImageCodec* imageCodecByName(const QString& name);
+// 当前构建支持的所有编码器名称
+QStringList availableImageCodecs();
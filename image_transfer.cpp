@@ -1,22 +1,59 @@
 #include <QTimer>
-#include <QFileDialog>
 #include <QElapsedTimer>
 #include "image_utils.h"
 #include "image_transfer.h"
 #include "package_sar_data.h"
 #include "AuxFileReader.h"
+#include "buffer_pool.h"
+#include "conversion_cache.h"
+#include "file_ingest.h"
+#include "image_codec.h"
+#include "metrics.h"
+#include "network_threads.h"
+#include "packet_capture.h"
+#include "roi_pyramid.h"
+#include "sar_file_sender.h"
+#include "sar_link.h"
+#include "transfer_progress.h"
+#include "transfer_scheduler.h"
 #include <QFileInfo>
 #include <QDebug>
-#include <QFileInfo>
 #include <QFile>
-#include <QDebug>
 #include <QBuffer>
 #include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QMutex>
+#include <bitset>
+#include <cerrno>
+
+static bool encodeAndSendImage(const EncodeSource& source, const QString& auxPath, const ImageCodec* codec,
+                               const TransferOptions& options, const QString& ipAddress, quint16 port,
+                               uint16_t imageNumber, QString* message, const ImageDoneCallback& onDone);
+static bool canSendFromFile(const QString& ip, quint16 port);
+static SarPacketTransferManager* sendImageFileZeroCopy(const QString& filePath, const QString& imageName,
+                                                       const QString& auxPath, const QString& ip, quint16 port,
+                                                       const SarImageMeta& meta);
+
+// 读取 AUX 文件（headerOnly 时只读头信息）；已由 FileIngest 预读时从内存解析
+static bool readAuxFile(AuxFileReader* reader, const QString& auxPath, bool headerOnly)
+{
+    if (IngestedFilePtr file = FileIngest::instance().get(auxPath)) {
+        return headerOnly ? reader->readHeader(file->bytes()) : reader->read(file->bytes());
+    }
+    return headerOnly ? reader->readHeader(auxPath) : reader->read(auxPath);
+}
 
-ImageTransferResult processAndTransferImage(const QString &filePath, const QString &ipAddress, quint16 port)
+ImageTransferResult processAndTransferImage(const QString &filePath, const QString &ipAddress, quint16 port,
+                                            const TransferOptions &options, const ImageDoneCallback &onDone)
 {
     ImageTransferResult result;
     result.success = false;
+    auto done = [&onDone](bool success) {
+        if (onDone) {
+            onDone(success);
+        }
+    };
 
     const int MAX_AUX_RETRIES = 10;
     const int AUX_RETRY_DELAY_MS = 500;
@@ -24,12 +61,21 @@ ImageTransferResult processAndTransferImage(const QString &filePath, const QStri
     if (QFileInfo(filePath).suffix().toLower() != "tif") {
         result.message = QString("File %1 is not TIF, skip.").arg(filePath);
         qDebug() << result.message;
+        done(false);
         return result;
     }
 
-    if (!waitForFileRelease(filePath)) {
+    bool released;
+    {
+        StageTimer timer(PipelineStage::FileReady);
+        released = waitForFileRelease(filePath);
+    }
+    if (!released) {
+        Metrics::instance().recordError(MetricError::FileLocked);
+        Metrics::instance().addCounter(MetricCounter::ImagesFailed);
         result.message = QString("File %1 is locked for too long, give up processing.").arg(filePath);
         qDebug() << result.message;
+        done(false);
         return result;
     }
 
@@ -40,84 +86,509 @@ ImageTransferResult processAndTransferImage(const QString &filePath, const QStri
         result.message = QString("Maximum retries reached for AUX file for TIF %1. Giving up.").arg(filePath);
         qDebug() << result.message;
         auxFileRetries.remove(filePath); // Clean up the retry count for this file
+        Metrics::instance().setGauge(MetricGauge::AuxWaitQueue, auxFileRetries.size());
+        Metrics::instance().recordError(MetricError::AuxMissing);
+        Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+        done(false);
         return result;
     }
 
     QFileInfo fileInfo(filePath);
     QString sourceDir = fileInfo.absolutePath();
-    QString jpgDir = sourceDir + "/jpg";
-    QString jpgPath = jpgDir + "/" + fileInfo.baseName() + ".jpg";
-
-    QDir dir(jpgDir);
-    if (!dir.exists()) {
-        dir.mkpath(".");
-    }
-
-    if (convertTiffToJpg(filePath, jpgPath)) {
-        QString auxPath = sourceDir + "/" + fileInfo.baseName() + ".dat";
-        QFileInfo auxInfo(auxPath);
-
-        if (auxInfo.exists() && auxInfo.isFile()) {
-            qDebug() << "Found AUX file. Starting transfer.";
-            auxFileRetries.remove(filePath); // Remove from retry list
-            if (sendImage(jpgPath, auxPath, ipAddress, port)) {
-                result.success = true;
-                result.message = QString("Package and send started successfully: %1 + %2").arg(jpgPath, auxPath);
-            } else {
-                result.message = QString("Package or send failed to start: %1 + %2").arg(jpgPath, auxPath);
-            }
-        } else {
-            qDebug() << QString("No matching AUX file for TIF %1, waiting... (Attempt %2/%3)").arg(filePath).arg(currentRetryCount + 1).arg(MAX_AUX_RETRIES);
-            auxFileRetries[filePath] = currentRetryCount + 1;
-            QTimer::singleShot(AUX_RETRY_DELAY_MS, QCoreApplication::instance(), [=]() {
-                processAndTransferImage(filePath, ipAddress, port);
+    QString auxPath = sourceDir + "/" + fileInfo.baseName() + ".dat";
+    QFileInfo auxInfo(auxPath);
+
+    // 先确认 AUX 已到达，再编码，避免等待期间反复编码同一幅图
+    if (!auxInfo.exists() || !auxInfo.isFile()) {
+        qDebug() << QString("No matching AUX file for TIF %1, waiting... (Attempt %2/%3)").arg(filePath).arg(currentRetryCount + 1).arg(MAX_AUX_RETRIES);
+        auxFileRetries[filePath] = currentRetryCount + 1;
+        Metrics::instance().setGauge(MetricGauge::AuxWaitQueue, auxFileRetries.size());
+        QTimer::singleShot(AUX_RETRY_DELAY_MS, QCoreApplication::instance(), [=]() {
+            processAndTransferImage(filePath, ipAddress, port, options, onDone);
+        });
+        result.message = QString("No matching AUX file, waiting: %1").arg(auxPath);
+        return result;
+    }
+    qDebug() << "Found AUX file. Starting transfer.";
+    auxFileRetries.remove(filePath); // Remove from retry list
+    Metrics::instance().setGauge(MetricGauge::AuxWaitQueue, auxFileRetries.size());
+
+    // 已打包待发的数据超出预算时先不编码，等传输释放预算后再处理这幅图像；
+    // 文件已确认就绪，推迟期间先在后台读进内存（立即编码时预读来不及完成，直接读盘）
+    if (!TransferScheduler::instance().admitOrDefer([=]() {
+            processAndTransferImage(filePath, ipAddress, port, options, onDone);
+        })) {
+        FileIngest::instance().prefetchImage(filePath);
+        result.success = true;
+        result.message = QString("Send budget exhausted, conversion deferred: %1").arg(filePath);
+        qDebug() << result.message;
+        return result;
+    }
+
+    // 这幅图像的编码、打包全部结束（或失败）后释放预读的内容
+    const ImageDoneCallback imageDone = [filePath, onDone](bool success) {
+        FileIngest::instance().releaseImage(filePath);
+        if (onDone) {
+            onDone(success);
+        }
+    };
+
+    const ImageCodec* codec = imageCodecByName(options.codec);
+    if (!codec) {
+        Metrics::instance().recordError(MetricError::ConvertFailed);
+        Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+        result.message = QString("Codec %1 is not available in this build, abandon transfer.").arg(options.codec);
+        qDebug() << result.message;
+        imageDone(false);
+        return result;
+    }
+
+    // 幅度位数决定高位深图像的满量程，编码前先只读 AUX 头
+    EncodeSource source;
+    source.path = filePath;
+    AuxFileReader auxHeaderReader;
+    if (readAuxFile(&auxHeaderReader, auxPath, true)) {
+        source.ampBit = static_cast<int>(auxHeaderReader.getHeader().amp_bit);
+    }
+
+    const uint16_t fullImageNumber = allocateImageNumber();
+    if (fullImageNumber == 0) {
+        Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+        result.message = QString("No free image number, abandon transfer: %1").arg(filePath);
+        qWarning() << result.message;
+        imageDone(false);
+        return result;
+    }
+    // 全分辨率图像的编号从这里起一直占用，直到这幅图像处理结束（含快视图与全图的传输）
+    const ImageDoneCallback fullImageDone = [imageDone, fullImageNumber](bool success) {
+        releaseImageNumber(fullImageNumber);
+        imageDone(success);
+    };
+
+    // 开启感兴趣区域拉取时，在后台为这幅图像建立分块金字塔，接收端随后按图像编号请求细节
+    const bool pyramid = PyramidStore::instance().enabled();
+    if (pyramid) {
+        PyramidStore::instance().buildAsync(fullImageNumber, filePath, auxPath, source.ampBit, drcParamsFromOptions(options));
+    }
+    const bool pushFullImage = !(pyramid && options.roiPullOnly);
+
+    // 快视图优先：先发降采样的快视图，它发送完成后再编码发送全分辨率图像，
+    // 地面第一眼看到图像的时间因此与原图大小基本无关
+    if (options.quickLook) {
+        QByteArray quickLookData;
+        const bool encoded = encodeQuickLookJpg(filePath, quickLookData, options.quickLookMaxSize, options.quickLookQuality,
+                                                source.ampBit, drcParamsFromOptions(options));
+        SarPacketTransferManager* quickLookTransfer = nullptr;
+        if (encoded) {
+            // 快视图的编号由 sendImageData 分配，随快视图的传输结束释放
+            SarImageMeta quickLookMeta;
+            quickLookMeta.codecId = static_cast<uint8_t>(CodecId::Jpeg);
+            quickLookMeta.codecParam = static_cast<uint8_t>(options.quickLookQuality);
+            quickLookMeta.imageKind = SarImageQuickLook;
+            quickLookMeta.refImageNumber = fullImageNumber;
+            quickLookTransfer = sendImageData(reinterpret_cast<const uint8_t*>(quickLookData.constData()),
+                                              static_cast<size_t>(quickLookData.size()),
+                                              fileInfo.baseName() + "_quicklook.jpg", auxPath, ipAddress, port,
+                                              quickLookMeta);
+        }
+        if (quickLookTransfer) {
+            // 无论快视图成功与否都继续发送全分辨率图像
+            QObject::connect(quickLookTransfer, &SarPacketTransferManager::finished, QCoreApplication::instance(),
+                             [=](bool quickLookSent) {
+                if (!pushFullImage) {
+                    fullImageDone(quickLookSent);
+                    return;
+                }
+                QString message;
+                encodeAndSendImage(source, auxPath, codec, options, ipAddress, port, fullImageNumber, &message, fullImageDone);
+                qDebug() << message;
             });
-            result.message = QString("No matching AUX file, waiting: %1").arg(auxPath);
+            result.success = true;
+            result.message = pushFullImage ? QString("Quick-look sent, full image queued: %1").arg(filePath)
+                                           : QString("Quick-look sent, full image held for ROI pull: %1").arg(filePath);
+            qDebug() << result.message;
+            return result;
         }
-    } else {
-        result.message = QString("TIF file %1 convert failed, abandon transfer.").arg(filePath);
+        qWarning() << "Quick-look failed, sending full image directly:" << filePath;
+    } else if (!pushFullImage) {
+        result.success = true;
+        result.message = QString("Full image held for ROI pull: %1").arg(filePath);
+        qDebug() << result.message;
+        fullImageDone(true);
+        return result;
     }
+
+    result.success = encodeAndSendImage(source, auxPath, codec, options, ipAddress, port, fullImageNumber,
+                                        &result.message, fullImageDone);
     qDebug() << result.message;
     return result;
 }
 
+// 编码并发送全分辨率图像；onDone 在失败时立即调用，成功启动时在传输结束后调用
+static bool encodeAndSendImage(const EncodeSource& source, const QString& auxPath, const ImageCodec* codec,
+                               const TransferOptions& options, const QString& ipAddress, quint16 port,
+                               uint16_t imageNumber, QString* message, const ImageDoneCallback& onDone)
+{
+    auto fail = [&](const QString& reason) {
+        *message = reason;
+        if (onDone) {
+            onDone(false);
+        }
+        return false;
+    };
+    auto started = [&](SarPacketTransferManager* manager, const QString& note) {
+        // 传输可能运行在网络线程上，完成通知排队回到主线程
+        if (onDone) {
+            QObject::connect(manager, &SarPacketTransferManager::finished, QCoreApplication::instance(), onDone);
+        }
+        *message = note;
+        return true;
+    };
+
+    QFileInfo fileInfo(source.path);
+    QString encodedName = fileInfo.baseName() + "." + codec->fileExtension();
+    QString archivePath = fileInfo.absolutePath() + (codec->id() == CodecId::Jpeg ? "/jpg/" : "/encoded/") + encodedName;
+
+    SarImageMeta meta;
+    meta.imageNumber = imageNumber;
+    meta.codecId = static_cast<uint8_t>(codec->id());
+    meta.codecParam = codec->parameter(options);
+
+    // 分块模式：各分块独立编码为 JPG，接收端逐块显示；分块结果不进转换缓存，
+    // 整幅 JPG 归档改在归档线程上编码
+    if (options.tileSize > 0 && codec->id() == CodecId::Jpeg) {
+        QVector<EncodedTile> tiles;
+        QImage image;
+        bool tiled;
+        {
+            StageTimer timer(PipelineStage::Convert);
+            tiled = encodeTiledJpg(source.path, options.tileSize, options.jpgQuality, source.ampBit,
+                                   drcParamsFromOptions(options), &tiles, &image);
+        }
+        if (!tiled) {
+            Metrics::instance().recordError(MetricError::ConvertFailed);
+            Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+            return fail(QString("TIF file %1 tiled convert failed, abandon transfer.").arg(source.path));
+        }
+        if (options.archiveJpg) {
+            archiveImageAsync(archivePath, image, options.jpgQuality);
+        }
+        SarPacketTransferManager* manager = sendTiledImageData(tiles, image.size(), encodedName, auxPath, ipAddress, port, meta);
+        if (!manager) {
+            Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+            return fail(QString("Tiled package or send failed to start: %1 + %2").arg(encodedName, auxPath));
+        }
+        return started(manager, QString("Tiled package and send started successfully: %1 (%2 tiles) + %3")
+                                    .arg(encodedName).arg(tiles.size()).arg(auxPath));
+    }
+
+    // 在内存中编码，编码结果直接交给打包器，不再落盘后重新读回；
+    // 同一源文件同一参数的编码结果由转换缓存提供，重试和重启后不再重复编码
+    QByteArray encodedData;
+    ConversionKey cacheKey;
+    const bool keyed = ConversionCache::makeKey(source.path, codec->cacheParams(source, options), &cacheKey);
+
+    // 编码结果的归档已登记在转换缓存里时直接从归档文件零拷贝发送；归档缺失时要用到编码数据，仍读进内存
+    QString cachedFile;
+    if (keyed && options.zeroCopy && canSendFromFile(ipAddress, port)
+        && (!options.archiveJpg || QFileInfo::exists(archivePath))
+        && ConversionCache::instance().lookupFile(cacheKey, &cachedFile)) {
+        if (SarPacketTransferManager* manager = sendImageFileZeroCopy(cachedFile, encodedName, auxPath, ipAddress, port, meta)) {
+            return started(manager, QString("Zero-copy send started from cached encoding: %1 + %2").arg(encodedName, auxPath));
+        }
+    }
+
+    const bool cached = keyed && ConversionCache::instance().lookup(cacheKey, &encodedData);
+    if (!cached) {
+        bool converted;
+        {
+            StageTimer timer(PipelineStage::Convert);
+            converted = codec->encode(source, options, &encodedData);
+        }
+        if (!converted) {
+            Metrics::instance().recordError(MetricError::ConvertFailed);
+            Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+            return fail(QString("TIF file %1 convert failed, abandon transfer.").arg(source.path));
+        }
+        if (keyed) {
+            ConversionCache::instance().insert(cacheKey, encodedData);
+        }
+    } else {
+        qDebug() << "Using cached encoding for" << source.path;
+    }
+
+    // 归档只是旁路输出，放到后台线程写盘，不影响发送；写完后登记为转换缓存的磁盘层条目
+    if (options.archiveJpg && (!cached || !QFileInfo::exists(archivePath))) {
+        if (keyed) {
+            ConversionCache::instance().archive(cacheKey, encodedData, archivePath);
+        } else {
+            archiveBytesAsync(archivePath, encodedData);
+        }
+    }
+
+    SarPacketTransferManager* manager = sendImageData(reinterpret_cast<const uint8_t*>(encodedData.constData()),
+                                                      static_cast<size_t>(encodedData.size()),
+                                                      encodedName, auxPath, ipAddress, port, meta);
+    if (!manager) {
+        Metrics::instance().addCounter(MetricCounter::ImagesFailed);
+        return fail(QString("Package or send failed to start: %1 + %2").arg(encodedName, auxPath));
+    }
+    return started(manager, QString("Package and send started successfully: %1 + %2").arg(encodedName, auxPath));
+}
+
+// 已分配、尚未释放的图像编号；分配与释放可能在不同的网络线程上
+struct ImageNumberPool {
+    QMutex mutex;
+    std::bitset<65536> inUse;
+    uint16_t last = 0;
+};
+
+static ImageNumberPool& imageNumberPool()
+{
+    static ImageNumberPool pool;
+    return pool;
+}
+
+uint16_t allocateImageNumber()
+{
+    ImageNumberPool& pool = imageNumberPool();
+    QMutexLocker locker(&pool.mutex);
+    // 0 表示未分配，编号在 1~65535 间循环，跳过仍被占用的编号，避免与在途图像重号
+    for (uint32_t i = 1; i <= 65535; ++i) {
+        const uint16_t number = static_cast<uint16_t>((pool.last + i - 1) % 65535 + 1);
+        if (!pool.inUse.test(number)) {
+            pool.inUse.set(number);
+            pool.last = number;
+            return number;
+        }
+    }
+    return 0;
+}
+
+void releaseImageNumber(uint16_t number)
+{
+    if (number == 0) {
+        return;
+    }
+    ImageNumberPool& pool = imageNumberPool();
+    QMutexLocker locker(&pool.mutex);
+    pool.inUse.reset(number);
+}
+
 bool sendImage(const QString& imagePath, const QString& auxPath, const QString& ip, quint16 port) {
-    // 1. 读取图像文件内容到 QByteArray
+    if (canSendFromFile(ip, port)
+        && sendImageFileZeroCopy(imagePath, QFileInfo(imagePath).fileName(), auxPath, ip, port, SarImageMeta())) {
+        return true;
+    }
+
+    // 已预读时直接发送内存中的内容
+    if (IngestedFilePtr file = FileIngest::instance().get(imagePath)) {
+        return sendImageData(file->data.data(), file->data.size(), QFileInfo(imagePath).fileName(), auxPath, ip, port) != nullptr;
+    }
+
+    // 读取图像文件内容到池化缓冲
     QFile imageFile(imagePath);
     if (!imageFile.open(QIODevice::ReadOnly)) {
         qCritical() << "Failed to open image file:" << imagePath;
         return false;
     }
-    QByteArray imageData = imageFile.readAll();
+    const qint64 imageSize = imageFile.size();
+    PooledBuffer imageData = BufferPool::instance().acquire(static_cast<size_t>(imageSize));
+    if (imageFile.read(reinterpret_cast<char*>(imageData.data()), imageSize) != imageSize) {
+        qCritical() << "Failed to read image file:" << imagePath;
+        return false;
+    }
+    imageFile.close();
+
+    return sendImageData(imageData.data(), imageData.size(), QFileInfo(imagePath).fileName(), auxPath, ip, port) != nullptr;
+}
 
-    // 2. 读取 AUX 文件并填充 AuxHeader
+// 读取 AUX 文件并封装 SAR_DataInfo 的公共部分
+static bool readSarDataInfo(const QString& auxPath, const SarImageMeta& meta, SAR_DataInfo* dataInfo)
+{
     AuxFileReader auxReader;
-    if (!auxReader.read(auxPath)) {
+    bool auxOk;
+    {
+        StageTimer timer(PipelineStage::AuxRead);
+        auxOk = readAuxFile(&auxReader, auxPath, false);
+    }
+    if (!auxOk) {
+        Metrics::instance().recordError(MetricError::AuxReadFailed);
         qCritical() << "Failed to open aux file:" << auxPath;
         return false;
     }
-    AuxHeader auxHeader = auxReader.getHeader();
-
-    // 3. 封装 SAR_DataInfo
-    SAR_DataInfo dataInfo = createSarDataInfo(auxHeader);
-
-    // 4. 将 QByteArray 转换为 std::vector<uint8_t>
-    std::vector<uint8_t> imageDataVec(imageData.begin(), imageData.end());
+    *dataInfo = createSarDataInfo(auxReader.getHeader());
+    dataInfo->codec_id = meta.codecId;
+    dataInfo->codec_param = meta.codecParam;
+    dataInfo->image_kind = meta.imageKind;
+    dataInfo->ref_image_number = meta.refImageNumber;
+    return true;
+}
 
-    // 5. 使用 SarPacketizer 类来生成所有数据包
-    SarPacketizer* packetizer = new SarPacketizer(dataInfo, imageDataVec, 1);
-    qDebug() << "Generated" << packetizer->getTotalPackets() << "packets.";
+// 复用链路上快视图的轮询权重（每轮连续写出的数据包数）
+static const int kQuickLookLinkWeight = 4;
 
-    // 6. 创建新的 SarPacketTransferManager 并启动传输
-    SarPacketTransferManager* transferManager = new SarPacketTransferManager(packetizer);
-    QObject::connect(transferManager, &SarPacketTransferManager::finished, transferManager, [transferManager, packetizer](bool success) {
+// 把传输交给调度器，传输结束后连同打包器（可为空）自动释放，并释放本次发送分配的图像编号 ownedNumbers；
+// bytes 计入在途字节预算
+static SarPacketTransferManager* startPacketTransfer(SarPacketTransferManager* transferManager, SarPacketizer* packetizer,
+                                                     qint64 bytes, const QString& imageName,
+                                                     const QString& ip, quint16 port, bool quickLook,
+                                                     const QVector<uint16_t>& ownedNumbers)
+{
+    transferManager->setImageName(imageName);
+    // 快视图只有几十 KB，在复用链路上加大权重，让它尽快越过正在发送的大图
+    if (quickLook) {
+        transferManager->setLinkWeight(kQuickLookLinkWeight);
+    }
+    QObject::connect(transferManager, &SarPacketTransferManager::finished, transferManager, [transferManager, packetizer, quickLook, ownedNumbers](bool success) {
         qDebug() << "Transfer finished with success:" << success;
+        for (uint16_t number : ownedNumbers) {
+            releaseImageNumber(number);
+        }
+        // 快视图只是全图的前导，不计入图像发送数
+        if (quickLook) {
+            if (success) {
+                Metrics::instance().addCounter(MetricCounter::QuickLooksSent);
+            }
+        } else {
+            Metrics::instance().addCounter(success ? MetricCounter::ImagesSent : MetricCounter::ImagesFailed);
+        }
         delete packetizer;
         transferManager->deleteLater();
     });
-    transferManager->startTransfer(ip, port);
+    // 由调度器决定何时发起连接；排队期间打包数据计入发送预算
+    TransferScheduler::instance().submit(transferManager, ip, port, bytes, quickLook);
 
-    return true;
+    return transferManager;
+}
+
+// 零拷贝发送直接写套接字描述符；复用链路与抓包都要用到用户态的数据包，这两种情况照常打包
+static bool canSendFromFile(const QString& ip, quint16 port)
+{
+    return SarFileSender::supported() && !SarLink::instance().carries(ip, port) && !PacketCapture::instance().isOpen();
+}
+
+// 从磁盘上已编码好的文件零拷贝发送；读取 AUX 或打开文件失败时返回 nullptr，由调用方改走内存打包
+static SarPacketTransferManager* sendImageFileZeroCopy(const QString& filePath, const QString& imageName,
+                                                       const QString& auxPath, const QString& ip, quint16 port,
+                                                       const SarImageMeta& meta)
+{
+    SAR_DataInfo dataInfo;
+    if (!readSarDataInfo(auxPath, meta, &dataInfo)) {
+        return nullptr;
+    }
+    const uint16_t ownedNumber = meta.imageNumber != 0 ? 0 : allocateImageNumber();
+    const uint16_t imageNumber = meta.imageNumber != 0 ? meta.imageNumber : ownedNumber;
+    if (imageNumber == 0) {
+        qCritical() << "No free image number for" << imageName;
+        return nullptr;
+    }
+
+    // 只生成帧头，图像数据留在文件里
+    QElapsedTimer packetizeTimer;
+    packetizeTimer.start();
+    std::unique_ptr<SarFileSender> fileSender(new SarFileSender);
+    QString error;
+    if (!fileSender->open(filePath, dataInfo, imageNumber, &error)) {
+        qWarning().noquote() << error;
+        releaseImageNumber(ownedNumber);
+        return nullptr;
+    }
+    Metrics::instance().recordStage(PipelineStage::Packetize, packetizeTimer.nsecsElapsed() / 1000);
+    qDebug() << "Prepared" << fileSender->totalPackets() << "packets for zero-copy send from" << filePath;
+
+    // 数据在页缓存里，不占用在途字节预算
+    return startPacketTransfer(new SarPacketTransferManager(fileSender.release()), nullptr, 0, imageName, ip, port,
+                               meta.imageKind == SarImageQuickLook, {ownedNumber});
+}
+
+SarPacketTransferManager* sendImageData(const uint8_t* imageData, size_t imageSize, const QString& imageName,
+                                        const QString& auxPath, const QString& ip, quint16 port,
+                                        const SarImageMeta& meta) {
+    // 1. 读取 AUX 文件并封装 SAR_DataInfo
+    SAR_DataInfo dataInfo;
+    if (!readSarDataInfo(auxPath, meta, &dataInfo)) {
+        return nullptr;
+    }
+    const uint16_t ownedNumber = meta.imageNumber != 0 ? 0 : allocateImageNumber();
+    const uint16_t imageNumber = meta.imageNumber != 0 ? meta.imageNumber : ownedNumber;
+    if (imageNumber == 0) {
+        qCritical() << "No free image number for" << imageName;
+        return nullptr;
+    }
+
+    // 2. 使用 SarPacketizer 类来生成所有数据包，打包器自带一份拷贝，调用方的缓冲随后即可释放
+    QElapsedTimer packetizeTimer;
+    packetizeTimer.start();
+    SarPacketizer* packetizer = new SarPacketizer(dataInfo, imageData, imageSize, imageNumber);
+    Metrics::instance().recordStage(PipelineStage::Packetize, packetizeTimer.nsecsElapsed() / 1000);
+    qDebug() << "Generated" << packetizer->getTotalPackets() << "packets.";
+
+    // 3. 创建新的 SarPacketTransferManager 并启动传输
+    return startPacketTransfer(new SarPacketTransferManager(packetizer), packetizer,
+                               static_cast<qint64>(packetizer->getTotalBytes()), imageName, ip, port,
+                               meta.imageKind == SarImageQuickLook, {ownedNumber});
+}
+
+SarPacketTransferManager* sendTiledImageData(const QVector<EncodedTile>& tiles, const QSize& mosaicSize,
+                                             const QString& imageName, const QString& auxPath,
+                                             const QString& ip, quint16 port, const SarImageMeta& meta) {
+    if (tiles.isEmpty() || tiles.size() > 0xFFFF || mosaicSize.width() > 0xFFFF || mosaicSize.height() > 0xFFFF) {
+        qCritical() << "Cannot send" << tiles.size() << "tiles of a" << mosaicSize << "image:" << imageName;
+        return nullptr;
+    }
+    // 整幅图像与各分块的编号都要在传输期间保持占用；编号不够时整体放弃，已分配的立即释放
+    QVector<uint16_t> ownedNumbers;
+    auto releaseOwned = [&ownedNumbers]() {
+        for (uint16_t number : ownedNumbers) {
+            releaseImageNumber(number);
+        }
+    };
+    SarImageMeta tileMeta = meta;
+    tileMeta.imageKind = SarImageTile;
+    tileMeta.refImageNumber = meta.imageNumber;
+    if (tileMeta.refImageNumber == 0) {
+        tileMeta.refImageNumber = allocateImageNumber();
+        ownedNumbers.append(tileMeta.refImageNumber);
+    }
+    QVector<uint16_t> tileNumbers;
+    tileNumbers.reserve(tiles.size());
+    for (int i = 0; i < tiles.size(); ++i) {
+        tileNumbers.append(allocateImageNumber());
+        ownedNumbers.append(tileNumbers.last());
+    }
+    if (ownedNumbers.contains(0)) {
+        qCritical() << "Not enough free image numbers for" << tiles.size() << "tiles:" << imageName;
+        releaseOwned();
+        return nullptr;
+    }
+    SAR_DataInfo dataInfo;
+    if (!readSarDataInfo(auxPath, tileMeta, &dataInfo)) {
+        releaseOwned();
+        return nullptr;
+    }
+    dataInfo.tile_count = static_cast<uint16_t>(tiles.size());
+    dataInfo.mosaic_cols = static_cast<uint16_t>(mosaicSize.width());
+    dataInfo.mosaic_rows = static_cast<uint16_t>(mosaicSize.height());
+
+    // 每个分块是一条带独立图像编号的完整消息，接收端各自重组、各自解码；
+    // 所有分块按行优先装进同一个打包器，在一条连接上依次发出
+    QElapsedTimer packetizeTimer;
+    packetizeTimer.start();
+    SarPacketizer* packetizer = new SarPacketizer;
+    for (int i = 0; i < tiles.size(); ++i) {
+        const EncodedTile& tile = tiles.at(i);
+        dataInfo.tile_index = static_cast<uint16_t>(i);
+        dataInfo.tile_x = static_cast<uint16_t>(tile.rect.x());
+        dataInfo.tile_y = static_cast<uint16_t>(tile.rect.y());
+        packetizer->appendMessage(dataInfo, reinterpret_cast<const uint8_t*>(tile.data.constData()),
+                                  static_cast<size_t>(tile.data.size()), tileNumbers.at(i));
+    }
+    Metrics::instance().recordStage(PipelineStage::Packetize, packetizeTimer.nsecsElapsed() / 1000);
+    qDebug() << "Generated" << packetizer->getTotalPackets() << "packets for" << tiles.size() << "tiles.";
+
+    return startPacketTransfer(new SarPacketTransferManager(packetizer), packetizer,
+                               static_cast<qint64>(packetizer->getTotalBytes()), imageName, ip, port, false, ownedNumbers);
 }
 
 /**
@@ -129,7 +600,15 @@ SarPacketTransferManager::SarPacketTransferManager(SarPacketizer* packetizer, QO
     : QObject(parent),
     m_packetizer(packetizer),
     m_socket(new QTcpSocket(this)), // m_socket作为SarPacketTransferManager的子对象，当父对象销毁时自动销毁
-    m_currentPacketIndex(0)
+    m_writeNotifier(nullptr),
+    m_currentPacketIndex(0),
+    m_progressId(0),
+    m_totalBytes(0),
+    m_bytesWritten(0),
+    m_firstByteRecorded(false),
+    m_finished(false),
+    m_linked(false),
+    m_linkWeight(1)
 {
     // 连接套接字的信号到对应的槽函数
     connect(m_socket, &QTcpSocket::connected, this, &SarPacketTransferManager::onSocketConnected);
@@ -138,6 +617,42 @@ SarPacketTransferManager::SarPacketTransferManager(SarPacketizer* packetizer, QO
     connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::errorOccurred), this, &SarPacketTransferManager::onSocketError);
 }
 
+/**
+ * @brief 零拷贝发送的构造函数
+ * @param fileSender 已打开文件、生成好帧头的发送器，由本对象接管
+ * @param parent 父QObject，用于自动内存管理
+ */
+SarPacketTransferManager::SarPacketTransferManager(SarFileSender* fileSender, QObject* parent)
+    : SarPacketTransferManager(static_cast<SarPacketizer*>(nullptr), parent)
+{
+    m_fileSender.reset(fileSender);
+}
+
+SarPacketTransferManager::~SarPacketTransferManager() = default;
+
+/**
+ * @brief 设置进度显示用的图像文件名
+ * @param name 文件名
+ */
+void SarPacketTransferManager::setImageName(const QString& name)
+{
+    m_imageName = name;
+}
+
+/**
+ * @brief 设置复用链路上的轮询权重
+ * @param weight 每轮连续写出的数据包数，至少为 1
+ */
+void SarPacketTransferManager::setLinkWeight(int weight)
+{
+    m_linkWeight = qMax(1, weight);
+}
+
+int SarPacketTransferManager::linkWeight() const
+{
+    return m_linkWeight;
+}
+
 /**
  * @brief 启动数据传输
  * @param ip 目标主机的IP地址
@@ -147,7 +662,35 @@ void SarPacketTransferManager::startTransfer(const QString& ip, quint16 port)
 {
     m_ip = ip;
     m_port = port;
+    QThread* ioThread = NetworkThreads::instance().threadFor(ip, port);
+    if (!ioThread) {
+        beginTransfer();
+        return;
+    }
+    // 先回到事件循环：调用方在同一调用链里还会连接 finished，移到网络线程后传输可能立即结束；
+    // 移动时已投递给本对象的事件随之转到网络线程
+    QMetaObject::invokeMethod(this, [this, ioThread]() {
+        moveToThread(ioThread);
+        QMetaObject::invokeMethod(this, &SarPacketTransferManager::beginTransfer, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief 在传输所在的线程上发起连接，或挂到复用链路上
+ */
+void SarPacketTransferManager::beginTransfer()
+{
     qDebug() << "Connecting to host:" << m_ip << "on port" << m_port;
+    m_transferTimer.start();
+    m_totalBytes = static_cast<qint64>(m_packetizer ? m_packetizer->getTotalBytes() : m_fileSender->totalBytes());
+    m_progressId = TransferProgress::instance().beginImage(m_imageName, m_totalBytes);
+    // 开启链路复用时交给 SarLink，与文本消息共用一条连接；
+    // 分线程后复用地址才改过来的，不在 SarLink 的线程上，仍单独建连；零拷贝发送也单独建连
+    if (m_packetizer && SarLink::instance().carries(m_ip, m_port) && SarLink::instance().thread() == thread()) {
+        m_linked = true;
+        SarLink::instance().attachImage(this);
+        return;
+    }
     m_socket->connectToHost(m_ip, m_port);
 }
 
@@ -168,10 +711,53 @@ void SarPacketTransferManager::onSocketConnected()
  */
 void SarPacketTransferManager::onBytesWritten(qint64 bytes)
 {
-    Q_UNUSED(bytes);
+    accountBytesWritten(bytes);
     sendNextPacket();
 }
 
+/**
+ * @brief 记录已写出的字节：进度、字节计数与首末字节时刻
+ * @param bytes 本次写出的字节数
+ */
+void SarPacketTransferManager::accountBytesWritten(qint64 bytes)
+{
+    Metrics::instance().addCounter(MetricCounter::BytesSent, static_cast<quint64>(bytes));
+    TransferProgress::instance().addBytes(m_progressId, bytes);
+    m_bytesWritten += bytes;
+    if (!m_firstByteRecorded) {
+        m_firstByteRecorded = true;
+        Metrics::instance().recordStage(PipelineStage::FirstByteSent, m_transferTimer.nsecsElapsed() / 1000);
+    }
+    if (m_bytesWritten >= m_totalBytes) {
+        Metrics::instance().recordStage(PipelineStage::LastByteSent, m_transferTimer.nsecsElapsed() / 1000);
+    }
+}
+
+bool SarPacketTransferManager::hasLinkPacket() const
+{
+    return !m_finished && m_packetizer->hasNextPacket();
+}
+
+/**
+ * @brief 取出下一个数据包交给 SarLink 写出，调用前需确认 hasLinkPacket()
+ */
+SarPacketView SarPacketTransferManager::takeLinkPacket()
+{
+    SarPacketView packet = m_packetizer->nextPacketView();
+    Metrics::instance().addCounter(MetricCounter::PacketsSent);
+    if (PacketCapture::instance().isOpen()) {
+        PacketCapture::instance().record(packet.data, packet.size, m_ip, m_port);
+    }
+    m_currentPacketIndex++;
+    return packet;
+}
+
+// 所有数据包都已取出并确认写出
+bool SarPacketTransferManager::linkDrained() const
+{
+    return !m_packetizer->hasNextPacket() && m_bytesWritten >= m_totalBytes;
+}
+
 /**
  * @brief 套接字断开连接时的槽函数
  * 告知外部传输已完成
@@ -180,7 +766,7 @@ void SarPacketTransferManager::onSocketDisconnected()
 {
     qDebug() << "Disconnected from host.";
     // 通常在所有数据发送完毕后，我们期望断开连接，所以这里可以认为是成功
-    emit finished(true);
+    finish(true);
 }
 
 /**
@@ -191,7 +777,8 @@ void SarPacketTransferManager::onSocketDisconnected()
 void SarPacketTransferManager::onSocketError(QAbstractSocket::SocketError socketError)
 {
     qWarning() << "Socket error:" << m_socket->errorString() << "Error code:" << socketError;
-    emit finished(false);
+    Metrics::instance().recordError(MetricError::SocketError);
+    finish(false);
 }
 
 /**
@@ -200,20 +787,89 @@ void SarPacketTransferManager::onSocketError(QAbstractSocket::SocketError socket
  */
 void SarPacketTransferManager::sendNextPacket()
 {
+    if (m_fileSender) {
+        sendFromFile();
+        return;
+    }
     if (m_packetizer->hasNextPacket()) {
-        std::vector<uint8_t> packetDataVec = m_packetizer->getNextPacket();
-        QByteArray packetData(reinterpret_cast<const char*>(packetDataVec.data()), packetDataVec.size());
-
-        qint64 bytesWritten = m_socket->write(packetData);
+        // 直接从打包器的缓冲写入套接字，不再经过 vector/QByteArray 中转
+        SarPacketView packet = m_packetizer->nextPacketView();
+        qint64 bytesWritten = m_socket->write(reinterpret_cast<const char*>(packet.data), static_cast<qint64>(packet.size));
         if (bytesWritten == -1) {
             qWarning() << "Failed to write packet to socket:" << m_socket->errorString();
-            emit finished(false);
+            Metrics::instance().recordError(MetricError::WriteFailed);
+            finish(false);
             return;
         }
         qDebug() << "Sent packet" << m_currentPacketIndex + 1 << "of" << m_packetizer->getTotalPackets();
+        Metrics::instance().addCounter(MetricCounter::PacketsSent);
+        if (PacketCapture::instance().isOpen()) {
+            PacketCapture::instance().record(packet.data, packet.size, m_ip, m_port);
+        }
         m_currentPacketIndex++;
     } else {
         qDebug() << "All packets sent successfully. Disconnecting.";
         m_socket->disconnectFromHost();
     }
 }
+
+// 零拷贝发送每次可写时最多写出的字节数，写满后回到事件循环
+static const qint64 kFileSendBurstBytes = qint64(1) << 20;
+
+/**
+ * @brief 零拷贝发送：套接字可写时从文件写出，发送缓冲满后等待下一次可写
+ * 数据不经过 QTcpSocket 的写缓冲，直接写套接字描述符，因此不会有 bytesWritten 信号
+ */
+void SarPacketTransferManager::sendFromFile()
+{
+    if (m_finished) {
+        return;
+    }
+    const int fd = static_cast<int>(m_socket->socketDescriptor());
+    if (!m_writeNotifier) {
+        SarFileSender::setCork(fd, true);
+        m_writeNotifier = new QSocketNotifier(m_socket->socketDescriptor(), QSocketNotifier::Write, this);
+        connect(m_writeNotifier, &QSocketNotifier::activated, this, &SarPacketTransferManager::sendFromFile);
+    }
+    const size_t packetsBefore = m_fileSender->packetsSent();
+    const qint64 written = m_fileSender->sendTo(fd, kFileSendBurstBytes);
+    if (written < 0) {
+        qWarning() << "Failed to send file data to socket:" << qt_error_string(errno);
+        Metrics::instance().recordError(MetricError::WriteFailed);
+        finish(false);
+        m_socket->abort();
+        return;
+    }
+    Metrics::instance().addCounter(MetricCounter::PacketsSent, m_fileSender->packetsSent() - packetsBefore);
+    if (written > 0) {
+        accountBytesWritten(written);
+    }
+    if (!m_fileSender->done()) {
+        return;
+    }
+    m_writeNotifier->setEnabled(false);
+    SarFileSender::setCork(fd, false);
+    qDebug() << "All packets sent successfully. Disconnecting.";
+    m_socket->disconnectFromHost();
+}
+
+/**
+ * @brief 结束传输并只发出一次 finished 信号
+ * 套接字出错后通常还会触发 disconnected，避免重复通知导致重复释放
+ * @param success 传输是否成功
+ */
+void SarPacketTransferManager::finish(bool success)
+{
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    // 套接字随后关闭，不能再监听它的描述符
+    if (m_writeNotifier) {
+        m_writeNotifier->setEnabled(false);
+    }
+    if (m_progressId != 0) {
+        TransferProgress::instance().endImage(m_progressId, m_totalBytes - m_bytesWritten);
+    }
+    emit finished(success);
+}
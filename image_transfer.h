@@ -10,9 +10,13 @@
 #include <QFile>
 #include <QTimer>
 #include <QDebug>
+#include <functional>
+#include <memory>
 
 // 业务通用类型
 #include "package_sar_data.h"
+#include "app_config.h"
+#include "image_utils.h"
 
 // ===================== 业务通用类型 =====================
 // 文件状态（主窗口和传输模块共用）
@@ -28,18 +32,62 @@ struct ImageTransferResult {
     QString message;
 };
 
-// 单文件处理（TIF转JPG、AUX打包、TCP发送）
-ImageTransferResult processAndTransferImage(const QString &filePath, const QString &ipAddress, quint16 port);
+// 一幅图像处理结束时的通知：success 为 false 表示放弃或发送失败
+using ImageDoneCallback = std::function<void(bool success)>;
 
-bool sendImage(const QString& tifPath, const QString& auxPath, const QString& ip, quint16 port);
+// 单文件处理（TIF在内存中按配置的编码方式编码、AUX打包、TCP发送，编码结果可选异步归档）
+// onDone 非空时，无论同步失败、等待 AUX/预算后重试还是异步传输结束，都恰好调用一次；
+// 只发快视图、全分辨率图像留待感兴趣区域拉取时，快视图结束即视为完成
+ImageTransferResult processAndTransferImage(const QString &filePath, const QString &ipAddress, quint16 port,
+                                            const TransferOptions &options = TransferOptions(),
+                                            const ImageDoneCallback &onDone = ImageDoneCallback());
+
+class SarPacketTransferManager;
+class SarFileSender;
+class QSocketNotifier;
+
+// 一幅图像写入 SAR_DataInfo 的标识与编码信息
+struct SarImageMeta {
+    uint16_t imageNumber = 0;       // 为 0 时由 sendImageData 分配；非 0 时由调用方负责释放
+    uint8_t codecId = 0;            // CodecId，供接收端选择解码器
+    uint8_t codecParam = 0;
+    uint8_t imageKind = SarImageFull;
+    uint16_t refImageNumber = 0;    // 快视图对应的全分辨率图像编号
+};
+
+// 分配图像编号，1~65535 循环，跳过已分配且尚未释放的编号；全部占用时返回 0，调用方应放弃发送
+uint16_t allocateImageNumber();
+// 携带该编号的传输结束后释放编号（0 忽略）；sendImageData 等自行分配的编号在传输结束时自动释放
+void releaseImageNumber(uint16_t number);
+
+// 发送磁盘上已编码好的图像文件；Linux 上直接从文件零拷贝发送（见 SarFileSender）
+bool sendImage(const QString& imagePath, const QString& auxPath, const QString& ip, quint16 port);
+// 发送内存中已编码好的图像，imageData 只在调用期间使用；
+// 返回已启动的传输（完成后自动销毁，可连接其 finished 信号），失败时返回 nullptr
+SarPacketTransferManager* sendImageData(const uint8_t* imageData, size_t imageSize, const QString& imageName,
+                                        const QString& auxPath, const QString& ip, quint16 port,
+                                        const SarImageMeta& meta = SarImageMeta());
+// 分块发送：每个分块作为一条独立消息（image_kind 为分块，ref_image_number 为 meta.imageNumber），
+// 在同一连接上按顺序发出；mosaicSize 为整幅图像尺寸
+SarPacketTransferManager* sendTiledImageData(const QVector<EncodedTile>& tiles, const QSize& mosaicSize,
+                                             const QString& imageName, const QString& auxPath,
+                                             const QString& ip, quint16 port, const SarImageMeta& meta = SarImageMeta());
 
 // ===================== 高级批量传输类 =====================
-// 支持信号/槽的批量传输工具
+// 支持信号/槽的批量传输工具。启用网络线程时 startTransfer 把对象移到 NetworkThreads 分配的线程上，
+// 此后套接字与 finished 信号都在该线程上，跨线程的接收者应使用排队连接
 class SarPacketTransferManager : public QObject {
     Q_OBJECT
 
 public:
     explicit SarPacketTransferManager(SarPacketizer* packetizer, QObject* parent = nullptr);
+    // 从磁盘文件零拷贝发送，接管 fileSender；不经过复用链路，始终单独建连
+    explicit SarPacketTransferManager(SarFileSender* fileSender, QObject* parent = nullptr);
+    ~SarPacketTransferManager() override;
+    void setImageName(const QString& name);
+    // 复用链路上的轮询权重：每轮连续写出的数据包数，默认 1
+    void setLinkWeight(int weight);
+    int linkWeight() const;
     void startTransfer(const QString& ip, quint16 port);
 
 signals:
@@ -50,14 +98,35 @@ private slots:
     void onBytesWritten(qint64 bytes);
     void onSocketDisconnected();
     void onSocketError(QAbstractSocket::SocketError socketError);
+    void sendFromFile();
 
 private:
+    // 复用链路（SarLink）逐包取数据并回报写出进度
+    friend class SarLink;
+    bool hasLinkPacket() const;
+    SarPacketView takeLinkPacket();
+    bool linkDrained() const;
+
+    void beginTransfer();
     void sendNextPacket();
+    void accountBytesWritten(qint64 bytes);
+    void finish(bool success);
 
 private:
-    SarPacketizer* m_packetizer;
+    SarPacketizer* m_packetizer;                // 零拷贝发送时为空
+    std::unique_ptr<SarFileSender> m_fileSender;
     QTcpSocket* m_socket;
+    QSocketNotifier* m_writeNotifier;           // 零拷贝发送时等待套接字可写
     QString m_ip;
     quint16 m_port;
     size_t m_currentPacketIndex;
+    QString m_imageName;            // 用于进度显示的文件名
+    quint64 m_progressId;           // TransferProgress 中的传输编号
+    qint64 m_totalBytes;
+    qint64 m_bytesWritten;
+    QElapsedTimer m_transferTimer;  // 从发起连接开始计时
+    bool m_firstByteRecorded;
+    bool m_finished;
+    bool m_linked;                  // 由 SarLink 发送，不使用自己的套接字
+    int m_linkWeight;
 };
@@ -5,6 +5,13 @@
 #include <QImageReader>
 #include <QThread>
 #include <QDebug>
+#include <QBuffer>
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include "file_ingest.h"
+#include "metrics.h"
+#include "sar_tiff.h"
 
 bool convertTiffToJpg(const QString &inputPath, const QString &outputPath)
 {
@@ -33,6 +40,207 @@ bool convertTiffToJpg(const QString &inputPath, const QString &outputPath)
     return true;
 }
 
+bool loadImageFile(const QString &inputPath, QImage *image)
+{
+    if (IngestedFilePtr file = FileIngest::instance().get(inputPath)) {
+        return image->loadFromData(file->bytes());
+    }
+    return image->load(inputPath);
+}
+
+bool encodeTiffToJpg(const QString &inputPath, QByteArray &jpgData, int quality)
+{
+    QImage image;
+    if (!loadImageFile(inputPath, &image)) {
+        qDebug() << "Failed to load image:" << inputPath;
+        return false;
+    }
+    jpgData.clear();
+    QBuffer buffer(&jpgData);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "JPG", quality)) {
+        qDebug() << "Failed to encode JPG in memory:" << inputPath;
+        return false;
+    }
+    return true;
+}
+
+bool loadSarTiffImage(const QString &inputPath, int ampBit, const DrcParams &drc, QImage *image)
+{
+    // 文件已预读时探测、解码都在内存中完成
+    const IngestedFilePtr file = FileIngest::instance().get(inputPath);
+    SarTiffInfo info;
+    const bool probed = file ? probeSarTiff(file->bytes(), &info) : probeSarTiff(inputPath, &info);
+    if (drc.mapping == DrcMapping::Off || !probed || info.bitsPerSample <= 8) {
+        if (!(file ? image->loadFromData(file->bytes()) : image->load(inputPath))) {
+            qDebug() << "Failed to load image:" << inputPath;
+            return false;
+        }
+        return true;
+    }
+
+    SarTiffImage tiff;
+    QString error;
+    if (!(file ? readSarTiff(file->bytes(), &tiff, &error) : readSarTiff(inputPath, &tiff, &error))) {
+        qDebug() << "Failed to read SAR TIFF:" << inputPath << error;
+        return false;
+    }
+    StageTimer timer(PipelineStage::Preprocess);
+    *image = compressDynamicRange(tiff, ampBit, drc);
+    return true;
+}
+
+bool encodeImageToJpg(const QImage &image, QByteArray &jpgData, int quality)
+{
+    jpgData.clear();
+    QBuffer buffer(&jpgData);
+    buffer.open(QIODevice::WriteOnly);
+    return image.save(&buffer, "JPG", quality);
+}
+
+bool encodeSarTiffToJpg(const QString &inputPath, QByteArray &jpgData, int quality, int ampBit, const DrcParams &drc)
+{
+    QImage image;
+    if (!loadSarTiffImage(inputPath, ampBit, drc, &image)) {
+        return false;
+    }
+    if (!encodeImageToJpg(image, jpgData, quality)) {
+        qDebug() << "Failed to encode JPG in memory:" << inputPath;
+        return false;
+    }
+    return true;
+}
+
+bool encodeQuickLookJpg(const QString &inputPath, QByteArray &jpgData, int maxSize, int quality, int ampBit, const DrcParams &drc)
+{
+    QImage image;
+    if (!loadSarTiffImage(inputPath, ampBit, drc, &image)) {
+        return false;
+    }
+    if (image.width() > maxSize || image.height() > maxSize) {
+        // 平滑缩放在缩小时按面积平均，能压住相干斑造成的混叠
+        image = image.scaled(maxSize, maxSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    if (!encodeImageToJpg(image, jpgData, quality)) {
+        qDebug() << "Failed to encode quick-look JPG:" << inputPath;
+        return false;
+    }
+    return true;
+}
+
+bool encodeTiledJpg(const QString &inputPath, int tileSize, int quality, int ampBit, const DrcParams &drc,
+                    QVector<EncodedTile> *tiles, QImage *image)
+{
+    QImage source;
+    if (tileSize <= 0 || !loadSarTiffImage(inputPath, ampBit, drc, &source)) {
+        return false;
+    }
+    tiles->clear();
+    for (int y = 0; y < source.height(); y += tileSize) {
+        for (int x = 0; x < source.width(); x += tileSize) {
+            EncodedTile tile;
+            tile.rect = QRect(x, y, qMin(tileSize, source.width() - x), qMin(tileSize, source.height() - y));
+            if (!encodeImageToJpg(source.copy(tile.rect), tile.data, quality)) {
+                qDebug() << "Failed to encode JPG tile" << tile.rect << "of" << inputPath;
+                return false;
+            }
+            tiles->append(tile);
+        }
+    }
+    if (image) {
+        *image = source;
+    }
+    return true;
+}
+
+namespace {
+
+// 归档写入只占一个后台线程，避免与雷达写盘争抢磁盘
+QThreadPool* archivePool()
+{
+    static QThreadPool* pool = [] {
+        QThreadPool* p = new QThreadPool;
+        p->setMaxThreadCount(1);
+        p->setExpiryTimeout(-1);
+        return p;
+    }();
+    return pool;
+}
+
+class ArchiveWriteTask : public QRunnable
+{
+public:
+    ArchiveWriteTask(const QString &outputPath, const QByteArray &data, const std::function<void(bool)> &onWritten)
+        : m_outputPath(outputPath), m_data(data), m_quality(0), m_onWritten(onWritten) {}
+    ArchiveWriteTask(const QString &outputPath, const QImage &image, int quality)
+        : m_outputPath(outputPath), m_image(image), m_quality(quality) {}
+
+    void run() override
+    {
+        const bool written = write();
+        if (m_onWritten) {
+            m_onWritten(written);
+        }
+    }
+
+private:
+    bool write()
+    {
+        if (!m_image.isNull() && !encodeImageToJpg(m_image, m_data, m_quality)) {
+            qDebug() << "Failed to encode archive JPG:" << m_outputPath;
+            Metrics::instance().recordError(MetricError::ArchiveFailed);
+            return false;
+        }
+        QDir destinationDir(QFileInfo(m_outputPath).absolutePath());
+        if (!destinationDir.exists() && !destinationDir.mkpath(".")) {
+            qDebug() << "Failed to create archive dir:" << destinationDir.absolutePath();
+            Metrics::instance().recordError(MetricError::ArchiveFailed);
+            return false;
+        }
+        const QString partPath = m_outputPath + ".part";
+        QFile file(partPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(m_data) != m_data.size()) {
+            qDebug() << "Failed to write archive file:" << partPath;
+            file.remove();
+            Metrics::instance().recordError(MetricError::ArchiveFailed);
+            return false;
+        }
+        file.close();
+        QFile::remove(m_outputPath);
+        if (!QFile::rename(partPath, m_outputPath)) {
+            qDebug() << "Failed to rename archive file:" << partPath;
+            QFile::remove(partPath);
+            Metrics::instance().recordError(MetricError::ArchiveFailed);
+            return false;
+        }
+        return true;
+    }
+
+    QString m_outputPath;
+    QByteArray m_data;  // 隐式共享，排队时不拷贝
+    QImage m_image;     // 非空时先在归档线程上编码为 JPG
+    int m_quality;
+    std::function<void(bool)> m_onWritten;
+};
+
+} // namespace
+
+void archiveBytesAsync(const QString &outputPath, const QByteArray &data, const std::function<void(bool)> &onWritten)
+{
+    archivePool()->start(new ArchiveWriteTask(outputPath, data, onWritten));
+}
+
+void archiveImageAsync(const QString &outputPath, const QImage &image, int quality)
+{
+    archivePool()->start(new ArchiveWriteTask(outputPath, image, quality));
+}
+
+bool waitForArchiveWrites(int msecs)
+{
+    return archivePool()->waitForDone(msecs);
+}
+
 bool waitForFileRelease(const QString &filePath, int maxRetries, int waitMs)
 {
     QFile file(filePath);
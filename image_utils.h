@@ -1,7 +1,43 @@
 #pragma once
 #include <QString>
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <functional>
+#include "dynamic_range.h"
+
+// 独立编码的一个分块，rect 为分块在整幅图像中的像素范围
+struct EncodedTile {
+    QRect rect;
+    QByteArray data;
+};
 
 // 图像工具函数
 bool convertTiffToJpg(const QString &inputPath, const QString &outputPath);
+// 读取图像文件；已由 FileIngest 预读时从内存解码
+bool loadImageFile(const QString &inputPath, QImage *image);
+// 读取 TIF 并得到可直接编码的 8 位图像；16/32 位幅度图先按 drc 做动态范围压缩
+bool loadSarTiffImage(const QString &inputPath, int ampBit, const DrcParams &drc, QImage *image);
+// 把内存中的图像编码为 JPG
+bool encodeImageToJpg(const QImage &image, QByteArray &jpgData, int quality);
+// 在内存中把 TIF 编码为 JPG，不经过磁盘
+bool encodeTiffToJpg(const QString &inputPath, QByteArray &jpgData, int quality = 80);
+// 同上；16/32 位幅度图先按 drc 做动态范围压缩再编码，其余格式与 encodeTiffToJpg 相同
+bool encodeSarTiffToJpg(const QString &inputPath, QByteArray &jpgData, int quality, int ampBit, const DrcParams &drc);
+// 生成快视图：长边缩到 maxSize 以内的低质量 JPG
+bool encodeQuickLookJpg(const QString &inputPath, QByteArray &jpgData, int maxSize, int quality, int ampBit, const DrcParams &drc);
+// 分块模式：把 TIF 按 tileSize×tileSize 切块，每块独立编码为 JPG，按行优先排列；
+// image 非空时同时返回整幅 8 位图像，供归档使用
+bool encodeTiledJpg(const QString &inputPath, int tileSize, int quality, int ampBit, const DrcParams &drc,
+                    QVector<EncodedTile> *tiles, QImage *image = nullptr);
+// 把已编码的数据交给后台线程写入磁盘（先写 .part 再改名），不阻塞调用方；
+// onWritten 非空时在归档线程上以是否写成功调用
+void archiveBytesAsync(const QString &outputPath, const QByteArray &data,
+                       const std::function<void(bool)> &onWritten = std::function<void(bool)>());
+// 同上，JPG 编码也放到归档线程上完成
+void archiveImageAsync(const QString &outputPath, const QImage &image, int quality);
+// 等待所有排队的归档写入完成，msecs < 0 表示一直等待
+bool waitForArchiveWrites(int msecs = -1);
 // 文件处理工具
 bool waitForFileRelease(const QString &filePath, int maxRetries = 50, int waitMs = 200);
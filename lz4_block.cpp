@@ -0,0 +1,197 @@
+#include "lz4_block.h"
+#include <cstring>
+#include <vector>
+
+namespace lz4 {
+
+namespace {
+
+const int kHashLog = 16;
+const size_t kMinMatch = 4;
+const size_t kLastLiterals = 5;   // 最后 5 字节必须是字面量
+const size_t kMfLimit = 12;       // 最后一个匹配必须在结尾 12 字节之前开始
+const size_t kMaxOffset = 65535;
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - kHashLog);
+}
+
+// 写入 LZ4 的变长长度（15 之后按 255 累加）
+inline bool writeLength(size_t length, uint8_t*& op, const uint8_t* oend)
+{
+    while (length >= 255) {
+        if (op >= oend) {
+            return false;
+        }
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= oend) {
+        return false;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return true;
+}
+
+inline bool readLength(size_t& length, const uint8_t*& ip, const uint8_t* iend)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+bool emitSequence(const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength,
+                  uint8_t*& op, const uint8_t* oend)
+{
+    if (op >= oend) {
+        return false;
+    }
+    uint8_t* token = op++;
+    *token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (literalLength >= 15 && !writeLength(literalLength - 15, op, oend)) {
+        return false;
+    }
+    if (static_cast<size_t>(oend - op) < literalLength) {
+        return false;
+    }
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0) {
+        return true;  // 最后一个序列只有字面量
+    }
+    if (oend - op < 2) {
+        return false;
+    }
+    *op++ = static_cast<uint8_t>(offset & 0xFF);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    const size_t ml = matchLength - kMinMatch;
+    *token |= static_cast<uint8_t>(ml >= 15 ? 15 : ml);
+    return ml < 15 || writeLength(ml - 15, op, oend);
+}
+
+} // namespace
+
+size_t compressBound(size_t srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+    uint8_t* op = dst;
+    const uint8_t* oend = dst + dstCapacity;
+    size_t anchor = 0;
+
+    if (srcSize > kMfLimit) {
+        std::vector<uint32_t> table(size_t(1) << kHashLog, 0);
+        const size_t matchStartLimit = srcSize - kMfLimit;
+        const size_t matchEndLimit = srcSize - kLastLiterals;
+        size_t ip = 1;
+        table[hash4(read32(src))] = 0;
+
+        while (ip < matchStartLimit) {
+            const uint32_t sequence = read32(src + ip);
+            const uint32_t h = hash4(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            if (ref >= ip || ip - ref > kMaxOffset || read32(src + ref) != sequence) {
+                ++ip;
+                continue;
+            }
+
+            // 向前扩展匹配
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            // 向后扩展匹配
+            size_t end = ip + kMinMatch;
+            size_t refEnd = ref + kMinMatch;
+            while (end < matchEndLimit && src[end] == src[refEnd]) {
+                ++end;
+                ++refEnd;
+            }
+
+            if (!emitSequence(src + anchor, ip - anchor, ip - ref, end - ip, op, oend)) {
+                return 0;
+            }
+            ip = end;
+            anchor = ip;
+            if (ip < matchStartLimit) {
+                table[hash4(read32(src + ip - 2))] = static_cast<uint32_t>(ip - 2);
+            }
+        }
+    }
+
+    if (!emitSequence(src + anchor, srcSize - anchor, 0, 0, op, oend)) {
+        return 0;
+    }
+    return static_cast<size_t>(op - dst);
+}
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + dstSize;
+
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength, ip, iend)) {
+            return false;
+        }
+        if (static_cast<size_t>(iend - ip) < literalLength || static_cast<size_t>(oend - op) < literalLength) {
+            return false;
+        }
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+        if (ip == iend) {
+            break;  // 最后一个序列
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) {
+            return false;
+        }
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(matchLength, ip, iend)) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if (static_cast<size_t>(oend - op) < matchLength) {
+            return false;
+        }
+        // 匹配可能与输出重叠，逐字节复制
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < matchLength; ++i) {
+            op[i] = match[i];
+        }
+        op += matchLength;
+    }
+    return op == oend;
+}
+
+} // namespace lz4
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 块格式（不含帧头）的最小实现，与 liblz4 的 LZ4_compress_default / LZ4_decompress_safe 互通。
+// 只用于低算力平台上的快速无损压缩，不依赖第三方库。
+namespace lz4 {
+
+// 压缩结果的最大可能长度
+size_t compressBound(size_t srcSize);
+// 返回压缩后的字节数，dstCapacity 不足时返回 0
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+// 解压到恰好 dstSize 字节，数据损坏或长度不符时返回 false
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+} // namespace lz4
@@ -11,19 +11,49 @@
 #include "logmanager.h"
 #include <QImageReader>
 #include <QThread>
+#include <cmath>
 #include "image_transfer.h"
 #include "file_monitor.h"
 #include "message_transfer.h"
+#include "conversion_cache.h"
+#include "file_ingest.h"
+#include "image_codec.h"
+#include "metrics.h"
+#include "network_threads.h"
+#include "packet_capture.h"
+#include "roi_pyramid.h"
+#include "roi_server.h"
+#include "sar_link.h"
+#include "transfer_progress.h"
+#include "transfer_scheduler.h"
 
-QString mainFolderPath = "E:/AIR/小长ISAR/实时数据回传/data";
+// 程序目录下的可选配置文件，与守护进程的 --config 格式相同
+const QString configFileName = "aerolink.ini";
 
-QString ipAddress = "127.0.0.1";
-quint16 port = 65432;
+// 界面刷新传输进度的周期
+int progressRefreshIntervalMs = 500;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_fileSize(0)
+    , m_bytesWrittenTotal(0)
+    , m_avgBytesPerSec(0.0)
+    , m_roiServer(nullptr)
 {
+    // 有配置文件时用它覆盖默认配置
+    QString configPath = QCoreApplication::applicationDirPath() + "/" + configFileName;
+    if (QFileInfo::exists(configPath)) {
+        QString error;
+        if (!m_config.loadFromFile(configPath, &error)) {
+            qWarning() << error;
+        }
+    }
+    if (!imageCodecByName(m_config.transfer.codec)) {
+        qWarning() << "Codec" << m_config.transfer.codec << "is not available, falling back to jpeg.";
+        m_config.transfer.codec = "jpeg";
+    }
+
     fileMonitor = new FileMonitor(this);
     connect(fileMonitor, &FileMonitor::newTifFileDetected, this, &MainWindow::processAndTransferFile);
     // 可选：连接 mainDirChanged、subDirChanged 信号做UI更新
@@ -31,7 +61,9 @@ MainWindow::MainWindow(QWidget *parent)
     ui->ipAddressLineEdit->setPlaceholderText("请输入 IP 地址");
     ui->portLineEdit->setPlaceholderText("请输入端口号");
     ui->pathLineEdit->setPlaceholderText("请输入监控文件夹路径"); // ✅ 设置路径编辑框占位符
-    ui->pathLineEdit->setText(mainFolderPath); // ✅ 将硬编码路径设为默认值
+    ui->pathLineEdit->setText(m_config.mainFolderPath); // ✅ 将配置路径设为默认值
+    ui->ipAddressLineEdit->setText(m_config.ipAddress);
+    ui->portLineEdit->setText(QString::number(m_config.port));
 
     connect(&LogManager::instance(), &LogManager::logMessage, this, &MainWindow::onLogMessage);
 
@@ -41,13 +73,77 @@ MainWindow::MainWindow(QWidget *parent)
 
     qRegisterMetaType<qint64>("qint64");
 
-    // 初始化消息传输类
-    m_messageTransfer = new MessageTransfer(this);
+    // 网络线程：SarLink、消息通道与图像传输的套接字都不在界面线程上处理
+    NetworkThreads::instance().start(m_config.networkThreads);
+
+    // 初始化消息传输类，没有父对象才能移到网络线程
+    m_messageTransfer = new MessageTransfer;
+    if (QThread* controlThread = NetworkThreads::instance().controlThread()) {
+        m_messageTransfer->moveToThread(controlThread);
+    }
     connect(m_messageTransfer, &MessageTransfer::logMessage, this, &MainWindow::onLogMessage);
+
+    // 转换缓存
+    ConversionCache::instance().configure(m_config.resolvedCacheDir(),
+                                          qint64(m_config.cacheMemoryMiB) << 20,
+                                          qint64(m_config.cacheDiskMiB) << 20);
+
+    // 发送调度：并发数与在途字节预算
+    TransferScheduler::instance().configure(m_config.maxTransfers, qint64(m_config.inFlightMiB) << 20);
+
+    // 源文件预读
+    FileIngest::instance().configure(m_config.ingestFiles, size_t(m_config.ingestMemoryMiB) << 20);
+
+    // 链路复用：消息与图像共用一条连接
+    SarLink::instance().configure(m_config.ipAddress, m_config.port, m_config.multiplexLink);
+    connect(&SarLink::instance(), &SarLink::logMessage, this, &MainWindow::onLogMessage);
+
+    // 抓包：记录发出的每个数据包
+    if (!m_config.captureDir.isEmpty()
+        && !PacketCapture::instance().open(m_config.captureDir, qint64(m_config.captureSegmentMiB) << 20)) {
+        qWarning() << "Cannot capture packets to" << m_config.captureDir;
+    }
+
+    // 感兴趣区域拉取：只有开启服务时才建立金字塔
+    PyramidStore::instance().configure(m_config.roiTileSize, m_config.roiQuality,
+                                       m_config.roiPort != 0 ? m_config.roiKeepImages : 0);
+    if (m_config.roiPort != 0) {
+        m_roiServer = new RoiServer(this);
+        m_roiServer->start(m_config.roiPort,
+                           m_config.roiBindAddress.isEmpty() ? QHostAddress(QHostAddress::Any) : QHostAddress(m_config.roiBindAddress),
+                           QHostAddress(m_config.roiPeerAddress.isEmpty() ? m_config.ipAddress : m_config.roiPeerAddress));
+    }
+
+    // 启动指标导出与周期性摘要
+    if (m_config.metricsPort != 0) {
+        Metrics::instance().startExporter(m_config.metricsPort);
+    }
+    Metrics::instance().startPeriodicSummary(m_config.metricsSummaryIntervalMs);
+
+    // 定时采样传输层计数器，发送路径上不产生任何逐包信号
+    ui->progressBar->setValue(0);
+    m_progressTimer = new QTimer(this);
+    connect(m_progressTimer, &QTimer::timeout, this, &MainWindow::updateTransferProgress);
+    m_progressClock.start();
+    m_progressTimer->start(progressRefreshIntervalMs);
 }
 
 MainWindow::~MainWindow()
 {
+    PacketCapture::instance().close();
+    FileIngest::instance().shutdown();
+    // 消息通道的套接字与定时器只能在所在线程上销毁，且须在网络线程结束之前；
+    // deleteLater 投递的事件在线程退出后不会再被处理
+    MessageTransfer* messageTransfer = m_messageTransfer;
+    m_messageTransfer = nullptr;
+    if (messageTransfer->thread() != thread()) {
+        QMetaObject::invokeMethod(messageTransfer, [messageTransfer]() {
+            delete messageTransfer;
+        }, Qt::BlockingQueuedConnection);
+    } else {
+        delete messageTransfer;
+    }
+    NetworkThreads::instance().shutdown();
     delete ui;
 }
 
@@ -56,7 +152,7 @@ void MainWindow::on_sendMessageButton_clicked()
 {
     QString message = ui->messageLineEdit->text().trimmed();
     if (!message.isEmpty()) {
-        m_messageTransfer->sendMessage(message, ipAddress, port);
+        m_messageTransfer->sendMessage(message, m_config.ipAddress, m_config.port);
         ui->messageLineEdit->clear();
     }
 }
@@ -64,22 +160,24 @@ void MainWindow::on_sendMessageButton_clicked()
 // “开始监控”按钮的槽函数
 void MainWindow::on_pushButton_clicked()
 {
-    ipAddress = ui->ipAddressLineEdit->text();
-    port = ui->portLineEdit->text().toUShort();
+    m_config.ipAddress = ui->ipAddressLineEdit->text();
+    m_config.port = ui->portLineEdit->text().toUShort();
 
-    if (ipAddress.isEmpty() || port == 0) {
+    if (m_config.ipAddress.isEmpty() || m_config.port == 0) {
         qDebug() << "请正确填写IP地址与端口号！";
         QMessageBox::warning(this, "警告", "请正确填写IP地址与端口号！");
         return;
     }
+    SarLink::instance().configure(m_config.ipAddress, m_config.port, m_config.multiplexLink);
 
-    mainFolderPath = ui->pathLineEdit->text();
-    if (!QDir(mainFolderPath).exists()) {
-        qDebug() << "错误：指定的监控路径不存在：" << mainFolderPath;
+    m_config.mainFolderPath = ui->pathLineEdit->text();
+    if (!QDir(m_config.mainFolderPath).exists()) {
+        qDebug() << "错误：指定的监控路径不存在：" << m_config.mainFolderPath;
         QMessageBox::warning(this, "警告", "指定的监控文件夹不存在。");
         return;
     }
-    fileMonitor->setMainFolder(mainFolderPath);
+    fileMonitor->setMainFolder(m_config.mainFolderPath);
+    fileMonitor->setActiveLimits(m_config.activeSubDirs, m_config.subDirIdleSec);
     fileMonitor->start();
     updateStatistics();
 }
@@ -104,7 +202,7 @@ void MainWindow::processAndTransferFile(const QString &filePath)
 {
     // ipAddress = ui->ipAddressLineEdit->text();
     // port = ui->portLineEdit->text().toUShort();
-    auto result = processAndTransferImage(filePath, ipAddress, port);
+    auto result = processAndTransferImage(filePath, m_config.ipAddress, m_config.port, m_config.transfer);
     m_fileStatus[filePath] = result.success ? Success : Failure;
     updateStatistics();
 }
@@ -145,3 +243,55 @@ void MainWindow::updateStatistics()
 
 
 
+
+// 定时刷新速度、进度条与剩余时间
+void MainWindow::updateTransferProgress()
+{
+    const TransferProgress::Snapshot snap = TransferProgress::instance().snapshot();
+
+    qint64 elapsedMs = m_progressClock.restart();
+    if (elapsedMs <= 0) {
+        return;
+    }
+
+    // 瞬时速率：本采样周期内写出的字节
+    qint64 delta = snap.totalSent - m_bytesWrittenTotal;
+    m_bytesWrittenTotal = snap.totalSent;
+    m_fileSize = snap.currentSize;
+    double instantBytesPerSec = delta * 1000.0 / elapsedMs;
+
+    // 平均速率：时间常数约 5 秒的指数滑动平均，空闲时不衰减，保证 ETA 稳定
+    if (snap.activeTransfers > 0 || delta > 0) {
+        const double alpha = 1.0 - std::exp(-elapsedMs / 5000.0);
+        m_avgBytesPerSec = m_avgBytesPerSec <= 0.0
+                               ? instantBytesPerSec
+                               : m_avgBytesPerSec + alpha * (instantBytesPerSec - m_avgBytesPerSec);
+    }
+
+    if (ui->progressBar) {
+        int percent = m_fileSize > 0 ? static_cast<int>(snap.currentSent * 100 / m_fileSize) : 0;
+        ui->progressBar->setValue(qBound(0, percent, 100));
+    }
+
+    if (ui->label_currentFile) {
+        QString name = snap.currentFile.isEmpty() ? QString("无") : snap.currentFile;
+        ui->label_currentFile->setText(QString("当前发送的文件：%1（%2/%3 KB，进行中 %4 个）")
+                                           .arg(name)
+                                           .arg(snap.currentSent / 1024)
+                                           .arg(m_fileSize / 1024)
+                                           .arg(snap.activeTransfers));
+    }
+
+    if (ui->label_speed) {
+        QString eta = "--";
+        if (snap.pendingBytes > 0 && m_avgBytesPerSec > 1.0) {
+            eta = QString("%1 s").arg(snap.pendingBytes / m_avgBytesPerSec, 0, 'f', 1);
+        } else if (snap.pendingBytes == 0) {
+            eta = "0 s";
+        }
+        ui->label_speed->setText(QString("传输速度：%1 Mbps（平均 %2 Mbps） 剩余时间：%3")
+                                     .arg(instantBytesPerSec * 8.0 / 1e6, 0, 'f', 2)
+                                     .arg(m_avgBytesPerSec * 8.0 / 1e6, 0, 'f', 2)
+                                     .arg(eta));
+    }
+}
@@ -4,9 +4,11 @@
 #include <QMainWindow>
 #include <QQueue>
 #include <QMap>
+#include <QElapsedTimer>
 #include "file_monitor.h"
 #include "message_transfer.h"
 #include "image_transfer.h"
+#include "app_config.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -31,10 +33,12 @@ private slots:
     void on_sendMessageButton_clicked();
     void onLogMessage(const QString &message);
     void updateStatistics();
+    void updateTransferProgress();
     void processAndTransferFile(const QString &filePath);
 
 private:
     Ui::MainWindow *ui;
+    AppConfig m_config;   // 发送端配置（监控路径、接收端地址等）
     QFileSystemWatcher* m_mainWatcher; // 新增：主文件夹监控器
     QFileSystemWatcher* m_subWatcher;  // 新增：子文件夹监控器
 
@@ -43,7 +47,15 @@ private:
     qint64 m_fileSize;
     qint64 m_bytesWrittenTotal;
 
+    // 传输进度采样
+    QTimer* m_progressTimer;
+    QElapsedTimer m_progressClock;
+    double m_avgBytesPerSec;   // 指数滑动平均速率
+
     // 消息传输类
     class MessageTransfer* m_messageTransfer;
+
+    // 感兴趣区域拉取服务，未开启时为空
+    class RoiServer* m_roiServer;
 };
 #endif // MAINWINDOW_H
@@ -1,37 +1,179 @@
 #include "message_transfer.h"
+#include <QtEndian>
 #include <QDebug>
+#include <QThread>
+#include "metrics.h"
+#include "sar_link.h"
 
 MessageTransfer::MessageTransfer(QObject* parent)
-    : QObject(parent)
+    : QObject(parent),
+    m_port(0),
+    m_flushTimer(new QTimer(this)),
+    m_reconnectTimer(new QTimer(this)),
+    m_backoffMs(kInitialBackoffMs)
 {
     m_socket = new QTcpSocket(this);
-    connect(m_socket, &QTcpSocket::connected, this, &MessageTransfer::connected);
-    connect(m_socket, &QTcpSocket::disconnected, this, &MessageTransfer::disconnected);
+    connect(m_socket, &QTcpSocket::connected, this, &MessageTransfer::onConnected);
+    connect(m_socket, &QTcpSocket::disconnected, this, &MessageTransfer::onDisconnected);
     connect(m_socket, &QTcpSocket::readyRead, this, &MessageTransfer::readyRead);
     connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::errorOccurred),
-            this, &MessageTransfer::errorOccurred);
+            this, &MessageTransfer::onErrorOccurred);
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(0);
+    connect(m_flushTimer, &QTimer::timeout, this, &MessageTransfer::flushQueue);
+
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &MessageTransfer::reconnect);
+
+    m_clock.start();
 }
 
 MessageTransfer::~MessageTransfer() {}
 
 void MessageTransfer::sendMessage(const QString& message, const QString& ipAddress, quint16 port)
 {
-    if (m_socket->state() == QAbstractSocket::UnconnectedState) {
-        m_socket->connectToHost(ipAddress, port);
-        if (!m_socket->waitForConnected(3000)) {
-            emit logMessage("Unable to connect to server: " + m_socket->errorString());
-            return;
+    // 通道运行在网络线程上时，界面线程的调用排队转过去
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { sendMessage(message, ipAddress, port); }, Qt::QueuedConnection);
+        return;
+    }
+    // 开启链路复用时作为控制帧与图像共用连接，并优先于图像数据包发出
+    if (SarLink::instance().carries(ipAddress, port)) {
+        if (SarLink::instance().sendControl(message.toUtf8())) {
+            emit logMessage(QString("Message queued on shared link, %1 control message(s) pending")
+                                .arg(SarLink::instance().stats().controlQueued));
+        } else {
+            emit logMessage(QString("Message exceeds %1 bytes and cannot be sent on the shared link").arg(kSarControlPayloadMax));
+        }
+        return;
+    }
+
+    if (ipAddress != m_ipAddress || port != m_port) {
+        m_ipAddress = ipAddress;
+        m_port = port;
+        m_backoffMs = kInitialBackoffMs;
+        m_reconnectTimer->stop();
+        if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+            m_socket->abort();
         }
     }
+
+    const QByteArray payload = message.toUtf8();
+    QueuedMessage queued;
+    queued.frame.resize(4);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), reinterpret_cast<uchar*>(queued.frame.data()));
+    queued.frame.append(payload);
+    queued.enqueuedNs = m_clock.nsecsElapsed();
+    m_queue.enqueue(queued);
+    while (m_queue.size() > kMaxQueuedMessages) {
+        m_queue.dequeue();
+        Metrics::instance().addCounter(MetricCounter::MessagesDropped);
+    }
+    publishQueueDepth();
+
     if (m_socket->state() == QAbstractSocket::ConnectedState) {
-        m_socket->write(message.toUtf8());
-        m_socket->flush();
-        emit logMessage("Message sent: " + message);
+        m_flushTimer->start();
     } else {
-        emit logMessage("Failed to send message: not connected.");
+        ensureConnected();
     }
 }
 
 QTcpSocket* MessageTransfer::socket() const {
     return m_socket;
 }
+
+int MessageTransfer::queuedMessages() const
+{
+    return m_queue.size();
+}
+
+void MessageTransfer::ensureConnected()
+{
+    // 正在连接或等待重连时不重复发起
+    if (m_socket->state() != QAbstractSocket::UnconnectedState || m_reconnectTimer->isActive()) {
+        return;
+    }
+    m_socket->connectToHost(m_ipAddress, m_port);
+}
+
+void MessageTransfer::reconnect()
+{
+    if (m_queue.isEmpty()) {
+        return;
+    }
+    Metrics::instance().addCounter(MetricCounter::MessageReconnects);
+    ensureConnected();
+}
+
+void MessageTransfer::scheduleReconnect()
+{
+    if (m_queue.isEmpty() || m_reconnectTimer->isActive()) {
+        return;
+    }
+    emit logMessage(QString("Message channel retrying in %1 ms, %2 message(s) queued.").arg(m_backoffMs).arg(m_queue.size()));
+    m_reconnectTimer->start(m_backoffMs);
+    m_backoffMs = qMin(m_backoffMs * 2, kMaxBackoffMs);
+}
+
+void MessageTransfer::onConnected()
+{
+    m_backoffMs = kInitialBackoffMs;
+    // 已经按批合并写入，关闭 Nagle 让每批立即发出
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    emit logMessage("Message channel connected to " + m_ipAddress + ":" + QString::number(m_port));
+    emit connected();
+    flushQueue();
+}
+
+void MessageTransfer::onDisconnected()
+{
+    emit disconnected();
+    scheduleReconnect();
+}
+
+void MessageTransfer::onErrorOccurred(QAbstractSocket::SocketError socketError)
+{
+    emit logMessage("Message channel error: " + m_socket->errorString());
+    emit errorOccurred(socketError);
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        m_socket->abort();
+        scheduleReconnect();
+    }
+}
+
+void MessageTransfer::flushQueue()
+{
+    if (m_queue.isEmpty() || m_socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    // 一批消息拼成一次写入
+    QByteArray batch;
+    for (const QueuedMessage& queued : m_queue) {
+        batch.append(queued.frame);
+    }
+    if (m_socket->write(batch) != batch.size()) {
+        emit logMessage("Failed to send message: " + m_socket->errorString());
+        Metrics::instance().recordError(MetricError::WriteFailed);
+        m_socket->abort();
+        scheduleReconnect();
+        return;
+    }
+
+    const qint64 now = m_clock.nsecsElapsed();
+    const int count = m_queue.size();
+    while (!m_queue.isEmpty()) {
+        const QueuedMessage queued = m_queue.dequeue();
+        Metrics::instance().recordStage(PipelineStage::MessageSend, (now - queued.enqueuedNs) / 1000);
+    }
+    Metrics::instance().addCounter(MetricCounter::MessagesSent, static_cast<quint64>(count));
+    Metrics::instance().addCounter(MetricCounter::MessageBytesSent, static_cast<quint64>(batch.size()));
+    publishQueueDepth();
+    emit logMessage(QString("Message sent: %1 message(s), %2 bytes").arg(count).arg(batch.size()));
+}
+
+void MessageTransfer::publishQueueDepth()
+{
+    Metrics::instance().setGauge(MetricGauge::MessageQueueDepth, m_queue.size());
+}
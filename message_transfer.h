@@ -3,7 +3,17 @@
 
 #include <QObject>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QQueue>
+#include <QElapsedTimer>
 
+/**
+ * @class MessageTransfer
+ * @brief 异步文本消息通道：消息先进入发送队列，连接建立后按 4 字节大端长度前缀分帧写出。
+ * 同一轮事件循环内的多条消息合并为一次写入；连接失败或断开时按指数退避自动重连，
+ * 全程不阻塞调用线程。目标地址由 SarLink 复用时改为交给链路作为控制帧发送。
+ * 可移到网络线程上运行，sendMessage 可从任意线程调用，logMessage 应以排队连接接收。
+ */
 class MessageTransfer : public QObject
 {
     Q_OBJECT
@@ -11,8 +21,10 @@ public:
     explicit MessageTransfer(QObject* parent = nullptr);
     ~MessageTransfer();
 
+    // 入队后立即返回；目标地址变化时断开旧连接并连到新地址。其他线程调用时排队转到通道所在线程
     void sendMessage(const QString& message, const QString& ipAddress, quint16 port);
     QTcpSocket* socket() const;
+    int queuedMessages() const;
 
 signals:
     void logMessage(const QString& message);
@@ -21,8 +33,35 @@ signals:
     void readyRead();
     void errorOccurred(QAbstractSocket::SocketError socketError);
 
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onErrorOccurred(QAbstractSocket::SocketError socketError);
+    void flushQueue();
+    void reconnect();
+
 private:
+    struct QueuedMessage {
+        QByteArray frame;       // 长度前缀 + UTF-8 内容
+        qint64 enqueuedNs;
+    };
+
+    static const int kMaxQueuedMessages = 1000;     // 超出时丢弃最早的消息
+    static const int kInitialBackoffMs = 250;
+    static const int kMaxBackoffMs = 30000;
+
+    void ensureConnected();
+    void scheduleReconnect();
+    void publishQueueDepth();
+
     QTcpSocket* m_socket;
+    QString m_ipAddress;
+    quint16 m_port;
+    QQueue<QueuedMessage> m_queue;
+    QTimer* m_flushTimer;       // 零间隔单次定时器，把同一轮事件循环内的消息合并写出
+    QTimer* m_reconnectTimer;
+    int m_backoffMs;
+    QElapsedTimer m_clock;
 };
 
 #endif // MESSAGE_TRANSFER_H
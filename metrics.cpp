@@ -0,0 +1,360 @@
+#include "metrics.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// 导出端口上一条连接的请求：请求头收齐之前的数据先缓存
+struct ExporterRequest {
+    QByteArray header;
+    bool answered = false;
+};
+// 请求头超过该长度仍未结束时断开连接
+const int kMaxRequestHeaderBytes = 8192;
+
+const char* const kStageNames[] = {
+    "detect", "file_ready", "convert", "preprocess", "aux_read", "packetize", "first_byte_sent", "last_byte_sent",
+    "message_send"
+};
+const char* const kCounterNames[] = {
+    "images_detected_total", "images_sent_total", "images_failed_total", "quicklooks_sent_total",
+    "packets_sent_total", "bytes_sent_total",
+    "buffer_pool_hits_total", "buffer_pool_misses_total",
+    "conversion_cache_hits_total", "conversion_cache_misses_total",
+    "roi_requests_total", "roi_tiles_sent_total", "conversions_deferred_total",
+    "messages_sent_total", "message_bytes_sent_total", "messages_dropped_total", "message_reconnects_total",
+    "link_reconnects_total", "capture_packets_total", "capture_dropped_total",
+    "ingest_hits_total", "ingest_misses_total"
+};
+const char* const kGaugeNames[] = {
+    "transfers_in_flight", "aux_wait_queue", "buffer_pool_cached_bytes",
+    "conversion_cache_memory_bytes", "pyramid_bytes", "transfer_queue_depth", "transfer_inflight_bytes",
+    "conversion_backlog", "message_queue_depth", "link_control_queue", "link_active_images",
+    "ingest_cached_bytes", "quicklook_queue_depth"
+};
+const char* const kErrorNames[] = {
+    "file_locked", "convert_failed", "aux_missing", "aux_read_failed", "socket_error", "write_failed",
+    "archive_failed"
+};
+
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == static_cast<size_t>(PipelineStage::Count), "stage names");
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == static_cast<size_t>(MetricCounter::Count), "counter names");
+static_assert(sizeof(kGaugeNames) / sizeof(kGaugeNames[0]) == static_cast<size_t>(MetricGauge::Count), "gauge names");
+static_assert(sizeof(kErrorNames) / sizeof(kErrorNames[0]) == static_cast<size_t>(MetricError::Count), "error names");
+
+// 导出的分位数
+const double kQuantiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+int highestBit(quint64 value)
+{
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+} // namespace
+
+// ===================== LatencyHistogram =====================
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < static_cast<quint64>(kSubBucketCount)) {
+        return static_cast<int>(value);
+    }
+    int shift = highestBit(value) - kSubBucketBits;
+    int sub = static_cast<int>((value >> shift) & (kSubBucketCount - 1));
+    return (shift + 1) * kSubBucketCount + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < kSubBucketCount) {
+        return static_cast<quint64>(index);
+    }
+    int shift = index / kSubBucketCount - 1;
+    quint64 sub = static_cast<quint64>(index % kSubBucketCount);
+    quint64 lower = (static_cast<quint64>(kSubBucketCount) + sub) << shift;
+    return lower + ((quint64(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(qint64 micros)
+{
+    quint64 value = micros < 0 ? 0 : static_cast<quint64>(micros);
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 currentMax = m_max.load(std::memory_order_relaxed);
+    while (value > currentMax && !m_max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const { return m_count.load(std::memory_order_relaxed); }
+quint64 LatencyHistogram::sumMicros() const { return m_sum.load(std::memory_order_relaxed); }
+quint64 LatencyHistogram::maxMicros() const { return m_max.load(std::memory_order_relaxed); }
+
+quint64 LatencyHistogram::percentile(double p) const
+{
+    quint64 total = count();
+    if (total == 0) {
+        return 0;
+    }
+    quint64 target = static_cast<quint64>(std::ceil(total * std::clamp(p, 0.0, 100.0) / 100.0));
+    target = std::max<quint64>(target, 1);
+
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min(bucketUpperBound(i), maxMicros());
+        }
+    }
+    return maxMicros();
+}
+
+// ===================== Metrics =====================
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics(QObject* parent)
+    : QObject(parent),
+    m_server(nullptr),
+    m_summaryTimer(nullptr),
+    m_lastSummaryBytes(0)
+{
+    for (auto& c : m_counters) c.store(0, std::memory_order_relaxed);
+    for (auto& g : m_gauges) g.store(0, std::memory_order_relaxed);
+    for (auto& e : m_errors) e.store(0, std::memory_order_relaxed);
+    m_summaryClock.start();
+}
+
+void Metrics::recordStage(PipelineStage stage, qint64 micros)
+{
+    m_stages[static_cast<size_t>(stage)].record(micros);
+}
+
+void Metrics::addCounter(MetricCounter counter, quint64 delta)
+{
+    m_counters[static_cast<size_t>(counter)].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void Metrics::setGauge(MetricGauge gauge, qint64 value)
+{
+    m_gauges[static_cast<size_t>(gauge)].store(value, std::memory_order_relaxed);
+}
+
+void Metrics::adjustGauge(MetricGauge gauge, qint64 delta)
+{
+    m_gauges[static_cast<size_t>(gauge)].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void Metrics::recordError(MetricError error)
+{
+    m_errors[static_cast<size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+const LatencyHistogram& Metrics::histogram(PipelineStage stage) const
+{
+    return m_stages[static_cast<size_t>(stage)];
+}
+
+quint64 Metrics::counter(MetricCounter counter) const
+{
+    return m_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+qint64 Metrics::gauge(MetricGauge gauge) const
+{
+    return m_gauges[static_cast<size_t>(gauge)].load(std::memory_order_relaxed);
+}
+
+quint64 Metrics::errors(MetricError error) const
+{
+    return m_errors[static_cast<size_t>(error)].load(std::memory_order_relaxed);
+}
+
+QString Metrics::prometheusText() const
+{
+    QStringList lines;
+
+    // 各阶段延迟，以 summary 类型导出（单位秒）
+    lines << "# HELP aerolink_stage_latency_seconds Per-stage pipeline latency.";
+    lines << "# TYPE aerolink_stage_latency_seconds summary";
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        const LatencyHistogram& h = m_stages[i];
+        for (double q : kQuantiles) {
+            lines << QString("aerolink_stage_latency_seconds{stage=\"%1\",quantile=\"%2\"} %3")
+                         .arg(kStageNames[i]).arg(q / 100.0).arg(h.percentile(q) / 1e6, 0, 'g', 9);
+        }
+        lines << QString("aerolink_stage_latency_seconds_sum{stage=\"%1\"} %2").arg(kStageNames[i]).arg(h.sumMicros() / 1e6, 0, 'g', 12);
+        lines << QString("aerolink_stage_latency_seconds_count{stage=\"%1\"} %2").arg(kStageNames[i]).arg(h.count());
+    }
+
+    for (size_t i = 0; i < m_counters.size(); ++i) {
+        lines << QString("# TYPE aerolink_%1 counter").arg(kCounterNames[i]);
+        lines << QString("aerolink_%1 %2").arg(kCounterNames[i]).arg(m_counters[i].load(std::memory_order_relaxed));
+    }
+
+    for (size_t i = 0; i < m_gauges.size(); ++i) {
+        lines << QString("# TYPE aerolink_%1 gauge").arg(kGaugeNames[i]);
+        lines << QString("aerolink_%1 %2").arg(kGaugeNames[i]).arg(m_gauges[i].load(std::memory_order_relaxed));
+    }
+
+    lines << "# TYPE aerolink_errors_total counter";
+    for (size_t i = 0; i < m_errors.size(); ++i) {
+        lines << QString("aerolink_errors_total{kind=\"%1\"} %2").arg(kErrorNames[i]).arg(m_errors[i].load(std::memory_order_relaxed));
+    }
+
+    return lines.join('\n') + '\n';
+}
+
+QString Metrics::summaryText()
+{
+    // 计算距上次摘要以来的平均吞吐
+    quint64 bytes = counter(MetricCounter::BytesSent);
+    qint64 elapsedMs = m_summaryClock.restart();
+    double mbps = elapsedMs > 0 ? (bytes - m_lastSummaryBytes) * 8.0 / 1000.0 / elapsedMs : 0.0;
+    m_lastSummaryBytes = bytes;
+
+    QStringList parts;
+    parts << QString("[Metrics] sent=%1 failed=%2 rate=%3Mbps inflight=%4 queued=%5 quicklookQueued=%8 deferred=%6 auxWait=%7")
+                 .arg(counter(MetricCounter::ImagesSent))
+                 .arg(counter(MetricCounter::ImagesFailed))
+                 .arg(mbps, 0, 'f', 2)
+                 .arg(gauge(MetricGauge::TransfersInFlight))
+                 .arg(gauge(MetricGauge::TransferQueueDepth))
+                 .arg(gauge(MetricGauge::ConversionBacklog))
+                 .arg(gauge(MetricGauge::AuxWaitQueue))
+                 .arg(gauge(MetricGauge::QuickLookQueueDepth));
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        const LatencyHistogram& h = m_stages[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        parts << QString("%1 p50=%2ms p99=%3ms")
+                     .arg(kStageNames[i])
+                     .arg(h.percentile(50) / 1000.0, 0, 'f', 1)
+                     .arg(h.percentile(99) / 1000.0, 0, 'f', 1);
+    }
+    quint64 totalErrors = 0;
+    for (const auto& e : m_errors) {
+        totalErrors += e.load(std::memory_order_relaxed);
+    }
+    parts << QString("errors=%1").arg(totalErrors);
+    return parts.join(" | ");
+}
+
+bool Metrics::startExporter(quint16 port)
+{
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &Metrics::onExporterConnection);
+    }
+    if (m_server->isListening()) {
+        m_server->close();
+    }
+    // 只监听回环地址，避免把指标暴露到数据链上
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Metrics exporter failed to listen on port" << port << ":" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "Metrics exporter listening on http://127.0.0.1:" + QString::number(port) + "/metrics";
+    return true;
+}
+
+void Metrics::stopExporter()
+{
+    if (m_server) {
+        m_server->close();
+    }
+}
+
+void Metrics::startPeriodicSummary(int intervalMs)
+{
+    if (!m_summaryTimer) {
+        m_summaryTimer = new QTimer(this);
+        connect(m_summaryTimer, &QTimer::timeout, this, &Metrics::onPeriodicSummary);
+    }
+    if (intervalMs <= 0) {
+        m_summaryTimer->stop();
+        return;
+    }
+    m_summaryClock.restart();
+    m_lastSummaryBytes = counter(MetricCounter::BytesSent);
+    m_summaryTimer->start(intervalMs);
+}
+
+void Metrics::onPeriodicSummary()
+{
+    qDebug().noquote() << summaryText();
+}
+
+void Metrics::onExporterConnection()
+{
+    while (QTcpSocket* client = m_server->nextPendingConnection()) {
+        connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+        // 请求可能分多个报文段到达，按连接缓存到请求头结束再解析
+        auto request = std::make_shared<ExporterRequest>();
+        connect(client, &QTcpSocket::readyRead, client, [this, client, request]() {
+            if (request->answered) {
+                // 每条连接只应答一个请求，之后的数据丢弃
+                client->readAll();
+                return;
+            }
+            request->header.append(client->readAll());
+            if (!request->header.contains("\r\n\r\n")) {
+                if (request->header.size() > kMaxRequestHeaderBytes) {
+                    client->abort();
+                }
+                return;
+            }
+            request->answered = true;
+            const QList<QByteArray> requestLine = request->header.left(request->header.indexOf("\r\n")).trimmed().split(' ');
+            request->header.clear();
+
+            QByteArray body;
+            QByteArray status;
+            if (requestLine.size() >= 2 && requestLine[0] == "GET"
+                && (requestLine[1] == "/metrics" || requestLine[1] == "/")) {
+                status = "200 OK";
+                body = prometheusText().toUtf8();
+            } else {
+                status = "404 Not Found";
+                body = "not found\n";
+            }
+
+            QByteArray response = "HTTP/1.0 " + status + "\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                                  "Connection: close\r\n\r\n" + body;
+            client->write(response);
+            client->disconnectFromHost();
+        });
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QTcpServer>
+#include <QElapsedTimer>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// ===================== 流水线阶段 =====================
+// 从 TIF 落盘到最后一个数据包发出的各个阶段
+enum class PipelineStage {
+    Detect,         // 文件修改时间 -> FileMonitor 发现文件
+    FileReady,      // 等待文件释放（waitForFileRelease）
+    Convert,        // TIF 转换编码
+    Preprocess,     // 高位深幅度压缩到 8 位（包含在 Convert 内）
+    AuxRead,        // 读取并解析 AUX 文件
+    Packetize,      // 生成 SAR_DataInfo 与全部数据包
+    FirstByteSent,  // 开始连接 -> 第一个字节写入套接字
+    LastByteSent,   // 开始连接 -> 最后一个字节写入套接字
+    MessageSend,    // 文本消息入队 -> 写入套接字
+    Count
+};
+
+// 累加计数器
+enum class MetricCounter {
+    ImagesDetected,
+    ImagesSent,
+    ImagesFailed,
+    QuickLooksSent,     // 快视图发送完成（不计入 ImagesSent）
+    PacketsSent,
+    BytesSent,
+    PoolHits,           // BufferPool 命中空闲缓冲
+    PoolMisses,         // BufferPool 新分配
+    CacheHits,          // ConversionCache 命中（内存或磁盘）
+    CacheMisses,        // ConversionCache 未命中，需要重新编码
+    RoiRequests,        // 收到的感兴趣区域请求
+    RoiTilesSent,       // 应答感兴趣区域请求发出的分块
+    ConversionsDeferred,// 因发送预算耗尽而推迟的编码
+    MessagesSent,       // MessageTransfer 写出的文本消息
+    MessageBytesSent,   // MessageTransfer 写出的字节（含长度前缀）
+    MessagesDropped,    // 发送队列溢出丢弃的消息
+    MessageReconnects,  // 消息通道的重连次数
+    LinkReconnects,     // SarLink 复用链路的重连次数
+    CapturePackets,     // PacketCapture 记录的数据包
+    CaptureDropped,     // 写盘积压时 PacketCapture 丢弃的数据包
+    IngestHits,         // 编码、打包阶段取用到 FileIngest 预读的文件
+    IngestMisses,       // 预读开启时仍需直接读盘的文件
+    Count
+};
+
+// 瞬时量（队列深度等）
+enum class MetricGauge {
+    TransfersInFlight,  // 正在进行的 SarPacketTransferManager 数量
+    AuxWaitQueue,       // 等待 AUX 文件出现的 TIF 数量
+    PoolCachedBytes,    // BufferPool 中空闲缓冲的总字节数
+    CacheMemoryBytes,   // ConversionCache 内存层占用字节数
+    PyramidBytes,       // PyramidStore 中已编码分块的总字节数
+    TransferQueueDepth, // TransferScheduler 中已打包、等待发起的传输数
+    InFlightBytes,      // 排队与进行中的传输占用的打包字节数
+    ConversionBacklog,  // 等待发送预算的编码请求数
+    MessageQueueDepth,  // MessageTransfer 发送队列中的消息数
+    LinkControlQueue,   // SarLink 中等待写出的控制消息数
+    LinkActiveImages,   // 挂在 SarLink 上尚未发完的图像传输数
+    IngestCachedBytes,  // FileIngest 已读入内存、尚未释放的字节数
+    QuickLookQueueDepth, // TransferScheduler 快视图通道中等待发起的传输数
+    Count
+};
+
+// 错误计数
+enum class MetricError {
+    FileLocked,
+    ConvertFailed,
+    AuxMissing,
+    AuxReadFailed,
+    SocketError,
+    WriteFailed,
+    ArchiveFailed,      // JPG 归档写盘失败
+    Count
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief HDR 风格的对数-线性延迟直方图，单位微秒。
+ * 每个 2 的幂区间再均分为 16 个子桶，相对误差约 6%；记录操作只有几次原子加法，无锁。
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(qint64 micros);
+    void reset();
+
+    quint64 count() const;
+    quint64 sumMicros() const;
+    quint64 maxMicros() const;
+    // p 取值 0~100，返回所在桶的上界
+    quint64 percentile(double p) const;
+
+private:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketUpperBound(int index);
+
+    std::array<std::atomic<quint64>, kBucketCount> m_buckets;
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<quint64> m_max;
+};
+
+/**
+ * @class Metrics
+ * @brief 全局指标注册表：各阶段延迟直方图、吞吐计数、队列深度与错误计数。
+ * 可通过本地 HTTP 端点以 Prometheus 文本格式导出，也可周期性输出到日志。
+ */
+class Metrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static Metrics& instance();
+
+    void recordStage(PipelineStage stage, qint64 micros);
+    void addCounter(MetricCounter counter, quint64 delta = 1);
+    void setGauge(MetricGauge gauge, qint64 value);
+    void adjustGauge(MetricGauge gauge, qint64 delta);
+    void recordError(MetricError error);
+
+    const LatencyHistogram& histogram(PipelineStage stage) const;
+    quint64 counter(MetricCounter counter) const;
+    qint64 gauge(MetricGauge gauge) const;
+    quint64 errors(MetricError error) const;
+
+    // Prometheus 文本格式（text/plain; version=0.0.4）
+    QString prometheusText() const;
+    // 适合写入日志的单行摘要
+    QString summaryText();
+
+    // 在本机回环地址上启动 HTTP 导出端点（GET /metrics）
+    bool startExporter(quint16 port);
+    void stopExporter();
+    // 周期性输出摘要到日志，intervalMs <= 0 时关闭
+    void startPeriodicSummary(int intervalMs);
+
+private slots:
+    void onExporterConnection();
+    void onPeriodicSummary();
+
+private:
+    explicit Metrics(QObject* parent = nullptr);
+    Q_DISABLE_COPY(Metrics)
+
+    std::array<LatencyHistogram, static_cast<size_t>(PipelineStage::Count)> m_stages;
+    std::array<std::atomic<quint64>, static_cast<size_t>(MetricCounter::Count)> m_counters;
+    std::array<std::atomic<qint64>, static_cast<size_t>(MetricGauge::Count)> m_gauges;
+    std::array<std::atomic<quint64>, static_cast<size_t>(MetricError::Count)> m_errors;
+
+    QTcpServer* m_server;
+    QTimer* m_summaryTimer;
+    QElapsedTimer m_summaryClock;
+    quint64 m_lastSummaryBytes;
+};
+
+/**
+ * @class StageTimer
+ * @brief 作用域计时器，析构时把耗时记录到对应阶段。
+ */
+class StageTimer {
+public:
+    explicit StageTimer(PipelineStage stage) : m_stage(stage) { m_timer.start(); }
+    ~StageTimer() { Metrics::instance().recordStage(m_stage, m_timer.nsecsElapsed() / 1000); }
+
+private:
+    PipelineStage m_stage;
+    QElapsedTimer m_timer;
+};
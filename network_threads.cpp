@@ -0,0 +1,68 @@
+#include "network_threads.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThread>
+#include "sar_link.h"
+
+NetworkThreads& NetworkThreads::instance()
+{
+    static NetworkThreads threads;
+    return threads;
+}
+
+NetworkThreads::~NetworkThreads()
+{
+    shutdown();
+}
+
+void NetworkThreads::start(int count)
+{
+    if (count <= 0 || !m_threads.isEmpty()) {
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        QThread* thread = new QThread;
+        thread->setObjectName(QString("aerolink-net-%1").arg(i));
+        thread->start(QThread::HighPriority);
+        m_threads.append(thread);
+    }
+    SarLink::instance().moveToThread(m_threads.first());
+    qDebug() << "Transport running on" << count << "network thread(s)";
+}
+
+void NetworkThreads::shutdown()
+{
+    if (m_threads.isEmpty()) {
+        return;
+    }
+    // moveToThread 只能在对象当前所在的线程上调用，收回 SarLink 要在网络线程里完成
+    QThread* mainThread = QCoreApplication::instance() ? QCoreApplication::instance()->thread() : nullptr;
+    QMetaObject::invokeMethod(&SarLink::instance(), [mainThread]() {
+        SarLink::instance().stop(mainThread);
+    }, Qt::BlockingQueuedConnection);
+    for (QThread* thread : m_threads) {
+        thread->quit();
+    }
+    for (QThread* thread : m_threads) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+}
+
+QThread* NetworkThreads::controlThread() const
+{
+    return m_threads.isEmpty() ? nullptr : m_threads.first();
+}
+
+QThread* NetworkThreads::threadFor(const QString& ip, quint16 port)
+{
+    if (m_threads.isEmpty()) {
+        return nullptr;
+    }
+    if (SarLink::instance().carries(ip, port)) {
+        return m_threads.first();
+    }
+    m_next = (m_next + 1) % m_threads.size();
+    return m_threads.at(m_next);
+}
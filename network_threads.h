@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+class QThread;
+
+/**
+ * @class NetworkThreads
+ * @brief 传输层专用的网络线程，每个线程各自运行事件循环。
+ * 套接字就绪、bytesWritten 处理和逐包写出都在这些线程上进行，不再与界面重绘、文件监控争抢主线程。
+ * 复用链路 SarLink 与消息通道固定在第 0 个线程；各自建连的图像传输启动时按轮转分到一个线程，
+ * 直到结束都在该线程上。与界面之间只通过排队信号和 TransferProgress/Metrics 的原子计数通信；
+ * 传输路径上用到的其他单例（PacketCapture、ConversionCache、FileIngest、图像编号分配）都可在网络线程上调用。
+ * 未启动（线程数为 0）时一切仍在主线程上进行。
+ */
+class NetworkThreads
+{
+public:
+    static NetworkThreads& instance();
+
+    // 在主线程上启动 count 个网络线程并把 SarLink 移到第 0 个线程；count <= 0 或已启动时不做任何事
+    void start(int count);
+    // 把 SarLink 收回主线程并结束全部网络线程；尚未结束的传输随线程一起放弃。
+    // 移到网络线程上的其他对象（如 MessageTransfer）须在此之前在其所在线程上销毁
+    void shutdown();
+
+    int count() const { return m_threads.size(); }
+    // SarLink 与消息通道所在的线程，未启动时为 nullptr
+    QThread* controlThread() const;
+    // 发往 ip:port 的图像传输应运行的线程：走复用链路时跟随 SarLink，否则轮转；未启动时为 nullptr
+    QThread* threadFor(const QString& ip, quint16 port);
+
+private:
+    NetworkThreads() = default;
+    ~NetworkThreads();
+    NetworkThreads(const NetworkThreads&) = delete;
+    NetworkThreads& operator=(const NetworkThreads&) = delete;
+
+    QVector<QThread*> m_threads;
+    int m_next = 0;             // 只在主线程上访问
+};
@@ -3,9 +3,13 @@
 #include <fstream>
 #include <vector>
 #include <cstring> // For memcpy
+#include <algorithm>
+#include <chrono>
+#include "buffer_pool.h"
+#include "sar_archive.h"
 
-// 计算校验和的私有辅助函数
-static uint8_t calculate_checksum(const uint8_t* data, size_t length) {
+// 计算校验和
+uint8_t calculate_checksum(const uint8_t* data, size_t length) {
     uint8_t sum = 0;
     for (size_t i = 0; i < length; ++i) {
         sum += data[i];
@@ -15,7 +19,8 @@ static uint8_t calculate_checksum(const uint8_t* data, size_t length) {
 
 // 封装 SAR_DataInfo 的核心函数
 SAR_DataInfo createSarDataInfo(const AuxHeader& auxHeader) {
-    SAR_DataInfo dataInfo;
+    // 先整体清零，备用字段与编码方式默认为 0（JPEG）
+    SAR_DataInfo dataInfo = {};
 
     // 帧头 (0d): 固定值 0x55AA
     dataInfo.frame_header = 0x55AA;
@@ -118,82 +123,308 @@ SAR_DataInfo createSarDataInfo(const AuxHeader& auxHeader) {
     return dataInfo;
 }
 
+SAR_RoiRequest createSarRoiRequest(uint16_t image_number, uint8_t level,
+                                   uint16_t tile_col0, uint16_t tile_row0, uint16_t tile_col1, uint16_t tile_row1) {
+    SAR_RoiRequest request = {};
+    request.fixed_value = kSarRoiRequestMagic;
+    request.image_number = image_number;
+    request.level = level;
+    request.tile_col0 = tile_col0;
+    request.tile_row0 = tile_row0;
+    request.tile_col1 = tile_col1;
+    request.tile_row1 = tile_row1;
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&request);
+    request.checksum = calculate_checksum(ptr + 2, sizeof(SAR_RoiRequest) - 2 - sizeof(uint8_t));
+    return request;
+}
+
+std::vector<uint8_t> createSarControlFrame(const uint8_t* payload, size_t length) {
+    std::vector<uint8_t> frame;
+    if (length > kSarControlPayloadMax) {
+        return frame;
+    }
+    SAR_Frame frame_header = {};
+    frame_header.fixed_value = kSarControlFrameMagic;
+    frame_header.image_size = static_cast<uint32_t>(length);
+    frame_header.current_packet = 1;
+    frame_header.total_packets = 1;
+    frame_header.data_length = static_cast<uint16_t>(length);
+    frame_header.checksum = calculate_checksum(payload, length);
+
+    frame.resize(sizeof(SAR_Frame) + length);
+    memcpy(frame.data(), &frame_header, sizeof(SAR_Frame));
+    if (length > 0) {
+        memcpy(frame.data() + sizeof(SAR_Frame), payload, length);
+    }
+    return frame;
+}
+
+// SarRoiRequestParser 类的实现
+std::vector<SAR_RoiRequest> SarRoiRequestParser::feed(const uint8_t* data, size_t length) {
+    std::vector<SAR_RoiRequest> requests;
+    m_stream.insert(m_stream.end(), data, data + length);
+
+    size_t offset = 0;
+    while (m_stream.size() - offset >= sizeof(SAR_RoiRequest)) {
+        SAR_RoiRequest request;
+        memcpy(&request, m_stream.data() + offset, sizeof(SAR_RoiRequest));
+        const uint8_t expected = calculate_checksum(m_stream.data() + offset + 2, sizeof(SAR_RoiRequest) - 2 - sizeof(uint8_t));
+        if (request.fixed_value != kSarRoiRequestMagic || request.checksum != expected) {
+            ++m_resyncBytes;
+            ++offset;
+            continue;
+        }
+        requests.push_back(request);
+        offset += sizeof(SAR_RoiRequest);
+    }
+    m_stream.erase(m_stream.begin(), m_stream.begin() + static_cast<std::ptrdiff_t>(offset));
+    return requests;
+}
+
 // SarPacketizer 类的构造函数实现
 SarPacketizer::SarPacketizer(const SAR_DataInfo& data_info, const std::vector<uint8_t>& image_data, uint16_t image_number)
-    : m_currentPacketIndex(0) {
+    : SarPacketizer(data_info, image_data.data(), image_data.size(), image_number) {
+}
 
-    // 协议文档中指出每个数据包的数据部分（SAR_Frame的第21d字节开始）最长为4096字节
-    const size_t packet_data_length = 4096;
+SarPacketizer::SarPacketizer()
+    : m_totalPackets(0), m_totalBytes(0), m_currentPacketIndex(0), m_readOffset(0) {
+}
 
-    // 首先，将 SAR_DataInfo 和图像数据拼接成一个完整的“数据信息”
-    size_t data_info_fixed_size = sizeof(SAR_DataInfo);
-    size_t total_message_size = data_info_fixed_size + image_data.size();
+SarPacketizer::SarPacketizer(const SAR_DataInfo& data_info, const uint8_t* image_data, size_t image_size, uint16_t image_number)
+    : SarPacketizer() {
+    appendMessage(data_info, image_data, image_size, image_number);
+}
 
-    // 完整的“数据信息”
-    std::vector<uint8_t> full_message(total_message_size);
-    memcpy(full_message.data(), &data_info, data_info_fixed_size);
-    memcpy(full_message.data() + data_info_fixed_size, image_data.data(), image_data.size());
+// 生成一条消息的全部数据包，接在已有数据包之后
+void SarPacketizer::appendMessage(const SAR_DataInfo& data_info, const uint8_t* image_data, size_t image_size, uint16_t image_number) {
+    // 数据信息（SAR_DataInfo + 图像数据）的总长度
+    const size_t data_info_fixed_size = sizeof(SAR_DataInfo);
+    const size_t total_message_size = data_info_fixed_size + image_size;
 
     // 根据协议， SAR_DataInfo 的 data_length 字段表示从该字段开始到消息内容结束的长度
-    // 也就是 full_message 的总大小
-    memcpy(full_message.data() + 2, &total_message_size, sizeof(uint32_t));
+    // 直接修正头部副本，不再把头和图像拼接成一条完整消息
+    SAR_DataInfo header = data_info;
+    header.data_length = static_cast<uint32_t>(total_message_size);
 
     // 重新计算并填充 SAR_DataInfo 内部的校验和
-    uint8_t internal_checksum = calculate_checksum(full_message.data() + 2, data_info_fixed_size - 2 - sizeof(uint8_t));
-    full_message[data_info_fixed_size - sizeof(uint8_t)] = internal_checksum;
-
-    // 计算总包数
-    size_t total_packets = (total_message_size + packet_data_length - 1) / packet_data_length;
+    const uint8_t* header_bytes = reinterpret_cast<const uint8_t*>(&header);
+    header.checksum = calculate_checksum(header_bytes + 2, data_info_fixed_size - 2 - sizeof(uint8_t));
+
+    // 计算本条消息的包数，所有数据包首尾相接放在一块池化缓冲中
+    const size_t message_packets = (total_message_size + kPacketDataLength - 1) / kPacketDataLength;
+    const size_t message_bytes = message_packets * sizeof(SAR_Frame) + total_message_size;
+    m_storage.resize(m_totalBytes + message_bytes);
+
+    uint8_t* out = m_storage.data() + m_totalBytes;
+    m_totalPackets += message_packets;
+    m_totalBytes += message_bytes;
+    for (size_t i = 0; i < message_packets; ++i) {
+        // 获取当前数据包的数据块
+        const size_t current_data_offset = i * kPacketDataLength;
+        const size_t bytes_to_send = std::min(total_message_size - current_data_offset, kPacketDataLength);
+        uint8_t* payload = out + sizeof(SAR_Frame);
+
+        // 写入数据：数据块可能跨越数据信息头与图像数据的边界
+        size_t copied = 0;
+        if (current_data_offset < data_info_fixed_size) {
+            copied = std::min(data_info_fixed_size - current_data_offset, bytes_to_send);
+            memcpy(payload, header_bytes + current_data_offset, copied);
+        }
+        if (copied < bytes_to_send) {
+            memcpy(payload + copied, image_data + (current_data_offset + copied - data_info_fixed_size), bytes_to_send - copied);
+        }
 
-    // 遍历并生成每一个数据包，存储在内部的 m_packets 向量中
-    for (uint16_t i = 0; i < total_packets; ++i) {
         SAR_Frame frame_header = {};
-        frame_header.fixed_value = 0x90E9;
+        frame_header.fixed_value = kSarFrameMagic;
         frame_header.image_number = image_number;
-        frame_header.image_size = static_cast<uint32_t>(image_data.size());
-        frame_header.current_packet = i + 1;
-        frame_header.total_packets = static_cast<uint16_t>(total_packets);
-
-        // 获取当前数据包的数据块
-        size_t current_data_offset = i * packet_data_length;
-        size_t bytes_to_send = std::min(total_message_size - current_data_offset, (size_t)packet_data_length);
-
-        // 准备数据包，大小为当前数据块的实际长度
-        std::vector<uint8_t> packet_data(sizeof(SAR_Frame) + bytes_to_send);
-
+        frame_header.image_size = static_cast<uint32_t>(image_size);
+        frame_header.current_packet = static_cast<uint16_t>(i + 1);
+        frame_header.total_packets = static_cast<uint16_t>(message_packets);
+        // 数据信息字节数：接收端据此切分数据流，最后一包可能不足 4096
+        frame_header.data_length = static_cast<uint16_t>(bytes_to_send);
         // 计算数据包的校验和
-        uint8_t packet_checksum = calculate_checksum(full_message.data() + current_data_offset, bytes_to_send);
-        frame_header.checksum = packet_checksum;
+        frame_header.checksum = calculate_checksum(payload, bytes_to_send);
 
         // 写入帧头
-        memcpy(packet_data.data(), &frame_header, sizeof(SAR_Frame));
-        // 写入数据
-        memcpy(packet_data.data() + sizeof(SAR_Frame), full_message.data() + current_data_offset, bytes_to_send);
-
-        m_packets.push_back(packet_data);
+        memcpy(out, &frame_header, sizeof(SAR_Frame));
+        out += sizeof(SAR_Frame) + bytes_to_send;
     }
 }
 
 // 检查是否还有下一个数据包
 bool SarPacketizer::hasNextPacket() const {
-    return m_currentPacketIndex < m_packets.size();
+    return m_currentPacketIndex < m_totalPackets;
 }
 
-// 获取下一个数据包
-std::vector<uint8_t> SarPacketizer::getNextPacket() {
-    if (hasNextPacket()) {
-        return m_packets[m_currentPacketIndex++];
+// 获取下一个数据包（不拷贝，指向内部缓冲）
+SarPacketView SarPacketizer::nextPacketView() {
+    if (!hasNextPacket()) {
+        return {nullptr, 0};
     }
-    return {};
+    // 各条消息的最后一包可能不足 4096 字节，按帧头中的长度前进
+    const uint8_t* packet = m_storage.data() + m_readOffset;
+    SAR_Frame frame_header;
+    memcpy(&frame_header, packet, sizeof(SAR_Frame));
+    const size_t size = sizeof(SAR_Frame) + frame_header.data_length;
+    m_readOffset += size;
+    ++m_currentPacketIndex;
+    return {packet, size};
+}
+
+// 获取下一个数据包（拷贝一份）
+std::vector<uint8_t> SarPacketizer::getNextPacket() {
+    SarPacketView view = nextPacketView();
+    return std::vector<uint8_t>(view.data, view.data + view.size);
 }
 
 // 获取总包数
 size_t SarPacketizer::getTotalPackets() const {
-    return m_packets.size();
+    return m_totalPackets;
+}
+
+// 获取所有数据包的总字节数
+size_t SarPacketizer::getTotalBytes() const {
+    return m_totalBytes;
+}
+
+// SarReassembler 类的实现
+// 流式解析：缓冲不完整的数据，按 image_number 把数据包写回各自的完整消息中
+std::vector<SarReassembledMessage> SarReassembler::feed(const uint8_t* data, size_t length,
+                                                        std::vector<std::vector<uint8_t>>* controlMessages) {
+    std::vector<SarReassembledMessage> completed;
+    m_stream.insert(m_stream.end(), data, data + length);
+
+    size_t offset = 0;
+    for (;;) {
+        if (m_stream.size() - offset < sizeof(SAR_Frame)) {
+            break;
+        }
+        SAR_Frame frame_header;
+        memcpy(&frame_header, m_stream.data() + offset, sizeof(SAR_Frame));
+
+        // 帧头失步：逐字节向后寻找下一个固定值
+        if (frame_header.fixed_value != kSarFrameMagic && frame_header.fixed_value != kSarControlFrameMagic) {
+            ++m_resyncBytes;
+            ++offset;
+            continue;
+        }
+        if (m_stream.size() - offset < sizeof(SAR_Frame) + frame_header.data_length) {
+            break;
+        }
+        const uint8_t* payload = m_stream.data() + offset + sizeof(SAR_Frame);
+        offset += sizeof(SAR_Frame) + frame_header.data_length;
+
+        if (frame_header.fixed_value == kSarControlFrameMagic) {
+            if (calculate_checksum(payload, frame_header.data_length) != frame_header.checksum) {
+                ++m_badPackets;
+            } else if (controlMessages) {
+                controlMessages->emplace_back(payload, payload + frame_header.data_length);
+            }
+            continue;
+        }
+
+        if (frame_header.current_packet == 0 || frame_header.current_packet > frame_header.total_packets) {
+            ++m_badPackets;
+            continue;
+        }
+        // 图像大小、总包数与本包长度必须自洽：总包数为 ceil((170 + 图像大小) / 4096)，
+        // 除最后一包外都是满包；总包数是 16 位，消息长度因此也不超过 65535 × 4096 字节
+        const size_t message_size = sizeof(SAR_DataInfo) + static_cast<size_t>(frame_header.image_size);
+        const size_t expected_packets = (message_size + kPacketDataLength - 1) / kPacketDataLength;
+        const size_t index = frame_header.current_packet - 1;
+        const size_t data_offset = index * kPacketDataLength;
+        if (expected_packets != frame_header.total_packets
+            || frame_header.data_length != std::min(kPacketDataLength, message_size - data_offset)) {
+            ++m_badPackets;
+            continue;
+        }
+        if (calculate_checksum(payload, frame_header.data_length) != frame_header.checksum) {
+            ++m_badPackets;
+            continue;
+        }
+
+        const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        auto it = m_partials.find(frame_header.image_number);
+        if (it != m_partials.end() && it->second.message.size() != message_size) {
+            // 同一编号、不同大小：正在重组的图像仍有数据到达时当作坏包，空闲超时后才认为编号已被复用
+            if (now_ms - it->second.lastActivityMs < kPartialTimeoutMs) {
+                ++m_badPackets;
+                continue;
+            }
+            m_pendingBytes -= it->second.message.size();
+            m_partials.erase(it);
+            it = m_partials.end();
+        }
+        if (it == m_partials.end()) {
+            // 放不下时拒绝新图像，而不是挤掉仍在接收的图像（一个误判的帧头不应打断正常重组）
+            expirePartials(now_ms);
+            if (m_partials.size() >= kMaxPartials || m_pendingBytes + message_size > kMaxPendingBytes) {
+                ++m_badPackets;
+                continue;
+            }
+            PartialMessage fresh;
+            fresh.total_packets = frame_header.total_packets;
+            fresh.message.assign(message_size, 0);
+            fresh.received.assign(frame_header.total_packets, false);
+            m_pendingBytes += message_size;
+            it = m_partials.emplace(frame_header.image_number, std::move(fresh)).first;
+        }
+        PartialMessage& partial = it->second;
+        partial.lastActivityMs = now_ms;
+
+        if (!partial.received[index]) {
+            memcpy(partial.message.data() + data_offset, payload, frame_header.data_length);
+            partial.received[index] = true;
+            ++partial.received_count;
+        }
+
+        if (partial.received_count == partial.total_packets) {
+            SarReassembledMessage message;
+            message.image_number = frame_header.image_number;
+            memcpy(&message.data_info, partial.message.data(), sizeof(SAR_DataInfo));
+            uint8_t internal_checksum = calculate_checksum(partial.message.data() + 2, sizeof(SAR_DataInfo) - 2 - sizeof(uint8_t));
+            message.data_info_valid = (message.data_info.checksum == internal_checksum);
+            message.image_data.assign(partial.message.begin() + sizeof(SAR_DataInfo), partial.message.end());
+            completed.push_back(std::move(message));
+            m_pendingBytes -= partial.message.size();
+            m_partials.erase(it);
+        }
+    }
+
+    m_stream.erase(m_stream.begin(), m_stream.begin() + offset);
+    return completed;
+}
+
+void SarReassembler::expirePartials(int64_t nowMs) {
+    for (auto it = m_partials.begin(); it != m_partials.end();) {
+        if (nowMs - it->second.lastActivityMs >= kPartialTimeoutMs) {
+            m_pendingBytes -= it->second.message.size();
+            it = m_partials.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// 尚未收齐的图像数
+size_t SarReassembler::pendingImages() const {
+    return m_partials.size();
+}
+
+// 校验失败或越界而被丢弃的数据包数
+uint64_t SarReassembler::badPackets() const {
+    return m_badPackets;
+}
+
+// 为重新同步帧头跳过的字节数
+uint64_t SarReassembler::resyncBytes() const {
+    return m_resyncBytes;
 }
 
 // 核心解包函数实现
-bool unpackage_sar_data(const std::string& input_filename, const std::string& output_image_filename) {
+bool unpackage_sar_data(const std::string& input_filename, const std::string& output_image_filename,
+                        SarArchive* archive) {
     std::ifstream file(input_filename, std::ios::binary);
     if (!file) {
         std::cerr << "Error: Cannot open file " << input_filename << std::endl;
@@ -202,6 +433,7 @@ bool unpackage_sar_data(const std::string& input_filename, const std::string& ou
 
     std::vector<uint8_t> full_message;
     uint16_t total_packets = 0;
+    uint16_t image_number = 0;
 
     // 逐个数据包读取并拼接
     for (;;) {
@@ -218,14 +450,21 @@ bool unpackage_sar_data(const std::string& input_filename, const std::string& ou
             return false;
         }
 
+        // 复用链路的抓包中夹有控制帧，跳过其消息部分
+        if (frame_header.fixed_value == kSarControlFrameMagic) {
+            file.seekg(frame_header.data_length, std::ios::cur);
+            continue;
+        }
+
         // 验证帧头固定值
-        if (frame_header.fixed_value != 0x90E9) {
+        if (frame_header.fixed_value != kSarFrameMagic) {
             std::cerr << "Error: Frame header fixed value mismatch, file may be corrupted." << std::endl;
             return false;
         }
 
         if (total_packets == 0) {
             total_packets = frame_header.total_packets;
+            image_number = frame_header.image_number;
             std::cout << "Total packets: " << total_packets << std::endl;
             std::cout << "Image size: " << frame_header.image_size << " bytes" << std::endl;
         }
@@ -306,5 +545,16 @@ bool unpackage_sar_data(const std::string& input_filename, const std::string& ou
         std::cerr << "Failed to save image to '" << output_image_filename << "'." << std::endl;
     }
 
+    if (archive) {
+        const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const int64_t id = archive->append(image_number, data_info, image_data.data(), image_data.size(), now_ms);
+        if (id < 0) {
+            std::cerr << "Failed to append image to the archive." << std::endl;
+            return false;
+        }
+        std::cout << "Image archived as record " << id << "." << std::endl;
+    }
+
     return true;
 }
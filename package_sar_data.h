@@ -6,8 +6,10 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <map>
 #include <QByteArray>
 #include "AuxFileReader.h"
+#include "buffer_pool.h"
 
 // 确保结构体按照1字节对齐，以匹配协议的字节布局
 #pragma pack(1)
@@ -24,6 +26,13 @@ struct SAR_Frame {
     uint8_t checksum;         // 20d, 校验和
 };
 
+// SAR_DataInfo::image_kind 的取值
+enum SarImageKind : uint8_t {
+    SarImageFull = 0,           // 全分辨率图像
+    SarImageQuickLook = 1,      // 降采样快视图，ref_image_number 指向全分辨率图像
+    SarImageTile = 2            // 独立编码的分块，ref_image_number 为所属整幅图像的编号
+};
+
 // 协议 1.2 数据信息格式
 struct SAR_DataInfo {
     uint16_t frame_header;      // 0d, 0x55AA
@@ -53,7 +62,18 @@ struct SAR_DataInfo {
     uint8_t img_time_m;         // 47d, 成像时间，分
     uint8_t img_time_s;         // 48d, 成像时间，秒
     uint8_t img_time_ms;        // 49d, 成像时间，毫秒
-    uint8_t reserved2[48];      // 50d, 备用
+    uint8_t codec_id;           // 50d, 图像编码方式（见 image_codec.h 中的 CodecId，0 为 JPEG）
+    uint8_t codec_param;        // 51d, 编码参数（JPEG 质量、zstd 等级等）
+    uint8_t image_kind;         // 52d, 图像类型（见 SarImageKind，0 为全分辨率图像）
+    uint16_t ref_image_number;  // 53d, 快视图/分块所对应的全分辨率图像编号
+    uint16_t tile_index;        // 55d, 分块序号（行优先，从 0 开始）
+    uint16_t tile_count;        // 57d, 整幅图像的分块总数
+    uint16_t tile_x;            // 59d, 分块左上角列坐标（像素）
+    uint16_t tile_y;            // 61d, 分块左上角行坐标（像素）
+    uint16_t mosaic_cols;       // 63d, 整幅图像宽度（像素）
+    uint16_t mosaic_rows;       // 65d, 整幅图像高度（像素）
+    uint8_t pyramid_level;      // 67d, 分块所在的金字塔层级，0 为全分辨率
+    uint8_t reserved2[30];      // 68d, 备用
 
     // SAR成像时的参数
     int16_t top_left_alt;       // 98d, 图像左上点相对高度
@@ -85,42 +105,160 @@ struct SAR_DataInfo {
     uint8_t checksum;           // 169d, 校验和
 };
 
+// 接收端 -> 发送端的感兴趣区域请求：取图像 image_number 第 level 层中
+// 列 tile_col0~tile_col1、行 tile_row0~tile_row1（含两端）的分块
+struct SAR_RoiRequest {
+    uint16_t fixed_value;       // 0d, 固定值0x52A5
+    uint16_t image_number;      // 2d, 全分辨率图像编号
+    uint8_t level;              // 4d, 金字塔层级，0 为全分辨率，每升一级宽高减半
+    uint16_t tile_col0;         // 5d, 起始分块列
+    uint16_t tile_row0;         // 7d, 起始分块行
+    uint16_t tile_col1;         // 9d, 结束分块列
+    uint16_t tile_row1;         // 11d, 结束分块行
+    uint8_t checksum;           // 13d, 校验和（不含固定值）
+};
+
 #pragma pack()
 
-// // 计算校验和的私有辅助函数
-// static uint8_t calculate_checksum(const uint8_t* data, size_t length);
+const uint16_t kSarRoiRequestMagic = 0x52A5;
+const uint16_t kSarFrameMagic = 0x90E9;
+// 控制帧：沿用 SAR_Frame 帧头，固定值改为 0x90EA，image_number 为 0，
+// 单包携带一条不超过 4096 字节的控制消息（image_size 与 data_length 均为消息长度）
+const uint16_t kSarControlFrameMagic = 0x90EA;
+const size_t kSarControlPayloadMax = 4096;
+
+// 计算校验和（逐字节累加，取低 8 位）
+uint8_t calculate_checksum(const uint8_t* data, size_t length);
 
 // 封装 SAR_DataInfo 的核心函数
 SAR_DataInfo createSarDataInfo(const AuxHeader& auxHeader);
 
+// 生成带校验和的感兴趣区域请求
+SAR_RoiRequest createSarRoiRequest(uint16_t image_number, uint8_t level,
+                                   uint16_t tile_col0, uint16_t tile_row0, uint16_t tile_col1, uint16_t tile_row1);
+
+// 生成一个完整的控制帧（帧头 + 消息），消息超过 kSarControlPayloadMax 时返回空
+std::vector<uint8_t> createSarControlFrame(const uint8_t* payload, size_t length);
+
+/**
+ * @class SarRoiRequestParser
+ * @brief 发送端的请求流解析：从 TCP 字节流中切分 SAR_RoiRequest，固定值或校验和不对时逐字节重新同步。
+ */
+class SarRoiRequestParser {
+public:
+    std::vector<SAR_RoiRequest> feed(const uint8_t* data, size_t length);
+    uint64_t resyncBytes() const { return m_resyncBytes; }
+
+private:
+    std::vector<uint8_t> m_stream;
+    uint64_t m_resyncBytes = 0;
+};
+
+// 指向打包器内部缓冲的一个数据包（帧头 + 数据部分）
+struct SarPacketView {
+    const uint8_t* data;
+    size_t size;
+};
+
 /**
  * @class SarPacketizer
  * @brief 负责将完整的SAR数据（数据信息头+图像数据）分割成可发送的数据包。
- * 它将所有数据包预先生成并存储在内存中，然后通过迭代器式的方法逐个返回。
+ * 所有数据包预先生成并首尾相接地存放在一块从 BufferPool 借来的缓冲中，然后通过迭代器式的方法逐个返回。
+ * 一个打包器可以依次装入多条消息（如同一幅图像的各个分块），在同一连接上按装入顺序发送。
  */
 class SarPacketizer {
 public:
     // 构造函数：初始化并生成所有数据包
+    SarPacketizer();
     SarPacketizer(const SAR_DataInfo& data_info, const std::vector<uint8_t>& image_data, uint16_t image_number);
+    SarPacketizer(const SAR_DataInfo& data_info, const uint8_t* image_data, size_t image_size, uint16_t image_number);
+
+    // 追加一条消息的全部数据包
+    void appendMessage(const SAR_DataInfo& data_info, const uint8_t* image_data, size_t image_size, uint16_t image_number);
 
     // 检查是否还有下一个数据包可获取
     bool hasNextPacket() const;
 
-    // 获取下一个数据包。返回一个包含帧头和数据部分的完整数据包。
+    // 获取下一个数据包，不拷贝；返回的指针在打包器销毁前有效
+    // 注意：如果已无数据包，返回 {nullptr, 0}
+    SarPacketView nextPacketView();
+
+    // 获取下一个数据包的拷贝。返回一个包含帧头和数据部分的完整数据包。
     // 注意：如果已无数据包，此函数将返回空vector。
     std::vector<uint8_t> getNextPacket();
 
     // 获取总包数
     size_t getTotalPackets() const;
 
-    // QByteArray getPacket(size_t index) const;
+    // 获取所有数据包（含帧头）的总字节数
+    size_t getTotalBytes() const;
 
 private:
-    std::vector<std::vector<uint8_t>> m_packets; // 存储所有生成的完整数据包
-    size_t m_currentPacketIndex;                 // 当前数据包的索引
+    static constexpr size_t kPacketDataLength = 4096; // 每包数据部分最长 4096 字节
+
+    PooledBuffer m_storage;        // 所有生成的完整数据包
+    size_t m_totalPackets;
+    size_t m_totalBytes;
+    size_t m_currentPacketIndex;   // 当前数据包的索引
+    size_t m_readOffset;           // 当前数据包在缓冲中的偏移
 };
 
-// 解包 SAR 数据文件
-bool unpackage_sar_data(const std::string& input_filename, const std::string& output_image_filename);
+// 重组完成的一条消息
+struct SarReassembledMessage {
+    uint16_t image_number;           // SAR_Frame 中的图像编号
+    SAR_DataInfo data_info;          // 消息开头的数据信息
+    bool data_info_valid;            // 数据信息内部校验和是否正确
+    std::vector<uint8_t> image_data; // 数据信息之后的图像数据
+};
+
+/**
+ * @class SarReassembler
+ * @brief 接收端的流式重组器：从 TCP 字节流中切分 SAR_Frame，按图像编号拼回完整消息。
+ * 数据包可以乱序，不同图像的数据包也可以交错到达；单包校验失败只会让所属图像缺包。
+ * 复用链路上夹在数据包之间的控制帧单独取出，不影响图像重组。
+ * 帧头只有 8 位校验和保护，分配前先核对图像大小、总包数与数据长度是否自洽；
+ * 未完成的图像超过 kPartialTimeoutMs 没有新数据包即丢弃；同时重组的图像数与字节数都有上限，超出时新图像的数据包被丢弃。
+ */
+class SarReassembler {
+public:
+    // 追加收到的字节，返回本次新收齐的消息；controlMessages 非空时追加本次收到的控制消息，
+    // 为空时控制帧被跳过
+    std::vector<SarReassembledMessage> feed(const uint8_t* data, size_t length,
+                                            std::vector<std::vector<uint8_t>>* controlMessages = nullptr);
+
+    size_t pendingImages() const;
+    uint64_t badPackets() const;
+    uint64_t resyncBytes() const;
+
+    static constexpr int64_t kPartialTimeoutMs = 30000;             // 未完成图像的空闲超时
+    static constexpr size_t kMaxPartials = 64;                       // 同时重组的图像数上限
+    static constexpr size_t kMaxPendingBytes = size_t(1) << 30;      // 同时重组的消息字节数上限
+
+private:
+    static constexpr size_t kPacketDataLength = 4096;
+
+    struct PartialMessage {
+        uint16_t total_packets = 0;
+        uint16_t received_count = 0;
+        int64_t lastActivityMs = 0;
+        std::vector<uint8_t> message;
+        std::vector<bool> received;
+    };
+
+    // 丢弃空闲超时的图像
+    void expirePartials(int64_t nowMs);
+
+    std::vector<uint8_t> m_stream;                    // 尚未解析的字节
+    std::map<uint16_t, PartialMessage> m_partials;    // 按图像编号组织的未完成消息
+    size_t m_pendingBytes = 0;                        // m_partials 中消息缓冲的总字节数
+    uint64_t m_badPackets = 0;
+    uint64_t m_resyncBytes = 0;
+};
+
+class SarArchive;
+
+// 解包 SAR 数据文件；archive 非空时同时把图像追加到归档，接收时刻取当前时间
+bool unpackage_sar_data(const std::string& input_filename, const std::string& output_image_filename,
+                        SarArchive* archive = nullptr);
 
 #endif // PACKAGE_SAR_DATA_H
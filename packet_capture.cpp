@@ -0,0 +1,395 @@
+#include "packet_capture.h"
+#include <QDebug>
+#include <QDir>
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QThread>
+#include <chrono>
+#include <cstring>
+#include "metrics.h"
+#include "package_sar_data.h"
+
+namespace {
+
+const char* const kImagesFileName = "images.idx";
+const char* const kLocationsFileName = "images.loc";
+
+qint64 nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+PacketCapture& PacketCapture::instance()
+{
+    static PacketCapture capture;
+    return capture;
+}
+
+PacketCapture::PacketCapture()
+    : m_segmentBytes(0),
+    m_open(false),
+    m_segment(0),
+    m_segmentOffset(0),
+    m_locationCount(0),
+    m_lastIpv4(0),
+    m_pendingBytes(0),
+    m_recorded(0),
+    m_dropped(0),
+    m_stopping(false),
+    m_writer(nullptr),
+    m_fileSegment(0)
+{
+}
+
+PacketCapture::~PacketCapture()
+{
+    close();
+}
+
+QString PacketCapture::segmentDataPath(const QString& dir, quint32 segment)
+{
+    return QString("%1/seg-%2.sar").arg(dir).arg(segment, 6, 10, QChar('0'));
+}
+
+QString PacketCapture::segmentIndexPath(const QString& dir, quint32 segment)
+{
+    return QString("%1/seg-%2.pkt").arg(dir).arg(segment, 6, 10, QChar('0'));
+}
+
+bool PacketCapture::open(const QString& dir, qint64 segmentBytes)
+{
+    close();
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Cannot create capture directory" << dir;
+        return false;
+    }
+    m_dir = QDir(dir).absolutePath();
+    // 分段内偏移为 32 位
+    m_segmentBytes = qBound<qint64>(1 << 20, segmentBytes, qint64(0xFFFFFFFF));
+
+    // 接着已有的最大分段编号往后写，不改动已有文件
+    m_segment = 1;
+    const QStringList existing = QDir(m_dir).entryList(QStringList("seg-*.sar"), QDir::Files, QDir::Name);
+    if (!existing.isEmpty()) {
+        m_segment = existing.last().mid(4, 6).toUInt() + 1;
+    }
+    m_segmentOffset = 0;
+    m_openImages.clear();
+
+    m_imagesFile.setFileName(m_dir + "/" + kImagesFileName);
+    m_locationsFile.setFileName(m_dir + "/" + kLocationsFileName);
+    if (!m_imagesFile.open(QIODevice::WriteOnly | QIODevice::Append)
+        || !m_locationsFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Cannot open capture index in" << m_dir;
+        m_imagesFile.close();
+        m_locationsFile.close();
+        return false;
+    }
+    // 写了一半的位置记录对齐到整条，之后的消息引用的下标才正确
+    const qint64 whole = m_locationsFile.size() / qint64(sizeof(SarCaptureLocation)) * qint64(sizeof(SarCaptureLocation));
+    if (whole != m_locationsFile.size()) {
+        m_locationsFile.resize(whole);
+    }
+    const qint64 wholeImages = m_imagesFile.size() / qint64(sizeof(SarCaptureImage)) * qint64(sizeof(SarCaptureImage));
+    if (wholeImages != m_imagesFile.size()) {
+        m_imagesFile.resize(wholeImages);
+    }
+    m_locationCount = static_cast<quint64>(whole / qint64(sizeof(SarCaptureLocation)));
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_batch = Batch();
+        m_pendingBytes = 0;
+        m_recorded = 0;
+        m_dropped = 0;
+        m_stopping = false;
+    }
+    m_fileSegment = 0;
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->start(QThread::LowPriority);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_open.store(true, std::memory_order_release);
+    }
+    qDebug() << "Capturing outbound packets to" << m_dir << "from segment" << m_segment;
+    return true;
+}
+
+void PacketCapture::close()
+{
+    {
+        // 置为关闭后，已越过无锁判断的 record 持锁时会再次确认并放弃
+        QMutexLocker locker(&m_mutex);
+        if (!m_open.load(std::memory_order_relaxed)) {
+            return;
+        }
+        m_open.store(false, std::memory_order_release);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    m_writer->wait();
+    delete m_writer;
+    m_writer = nullptr;
+    m_dataFile.close();
+    m_indexFile.close();
+    m_imagesFile.close();
+    m_locationsFile.close();
+    // 没有收齐的消息不进入消息索引，它们的数据包仍在分段文件中
+    m_openImages.clear();
+}
+
+void PacketCapture::record(const uint8_t* packet, size_t size, const QString& ip, quint16 port)
+{
+    if (!m_open.load(std::memory_order_acquire) || size < sizeof(SAR_Frame)) {
+        return;
+    }
+    SAR_Frame header;
+    memcpy(&header, packet, sizeof(header));
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_open.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (m_pendingBytes + qint64(size) > kMaxPendingBytes) {
+        // 磁盘跟不上：丢弃这个数据包，所属消息不再进入消息索引
+        ++m_dropped;
+        m_openImages.remove(header.image_number);
+        Metrics::instance().addCounter(MetricCounter::CaptureDropped);
+        return;
+    }
+
+    if (m_segmentOffset > 0 && m_segmentOffset + qint64(size) > m_segmentBytes) {
+        ++m_segment;
+        m_segmentOffset = 0;
+    }
+    if (m_batch.chunks.isEmpty() || m_batch.chunks.last().segment != m_segment) {
+        m_batch.chunks.append(Chunk{m_segment, QByteArray(), QByteArray()});
+    }
+    Chunk& chunk = m_batch.chunks.last();
+
+    SarCapturePacket entry;
+    entry.timestamp_ns = nowNs();
+    entry.offset = static_cast<uint32_t>(m_segmentOffset);
+    // 目的地址通常不变，只在变化时重新解析
+    if (ip != m_lastIp) {
+        m_lastIp = ip;
+        bool ok = false;
+        m_lastIpv4 = QHostAddress(ip).toIPv4Address(&ok);
+        if (!ok) {
+            m_lastIpv4 = 0;
+        }
+    }
+    entry.dest_ipv4 = m_lastIpv4;
+    entry.dest_port = port;
+    entry.image_number = header.image_number;
+    entry.current_packet = header.current_packet;
+    entry.total_packets = header.total_packets;
+    chunk.frames.append(reinterpret_cast<const char*>(packet), static_cast<int>(size));
+    chunk.packets.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    m_segmentOffset += qint64(size);
+    m_pendingBytes += qint64(size);
+    m_batch.bytes += qint64(size);
+    ++m_recorded;
+    Metrics::instance().addCounter(MetricCounter::CapturePackets);
+
+    // 消息的第一个数据包开启一条记录，最后一个数据包写入消息索引
+    if (header.fixed_value == kSarFrameMagic) {
+        if (header.current_packet == 1) {
+            OpenImage& open = m_openImages[header.image_number];
+            memset(&open.image, 0, sizeof(open.image));
+            open.image.image_number = header.image_number;
+            open.image.image_size = header.image_size;
+            open.image.dest_ipv4 = entry.dest_ipv4;
+            open.image.dest_port = port;
+            open.image.first_ns = entry.timestamp_ns;
+            open.locations.clear();
+        }
+        auto it = m_openImages.find(header.image_number);
+        if (it != m_openImages.end() && it->locations.size() + 1 == header.current_packet) {
+            it->locations.append(SarCaptureLocation{m_segment, entry.offset});
+            if (header.current_packet == header.total_packets) {
+                it->image.packets = header.total_packets;
+                it->image.last_ns = entry.timestamp_ns;
+                it->image.first_location = m_locationCount;
+                m_batch.images.append(reinterpret_cast<const char*>(&it->image), sizeof(SarCaptureImage));
+                m_batch.locations.append(reinterpret_cast<const char*>(it->locations.constData()),
+                                         it->locations.size() * int(sizeof(SarCaptureLocation)));
+                m_locationCount += static_cast<quint64>(it->locations.size());
+                m_openImages.erase(it);
+            }
+        } else if (it != m_openImages.end()) {
+            // 数据包不连续（前面有丢弃），这条消息不进入消息索引
+            m_openImages.erase(it);
+        }
+    }
+
+    if (m_batch.bytes >= kBatchBytes) {
+        m_wake.wakeOne();
+    }
+}
+
+PacketCapture::Stats PacketCapture::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return Stats{m_recorded, m_dropped, m_pendingBytes, m_segment};
+}
+
+void PacketCapture::writerLoop()
+{
+    for (;;) {
+        Batch batch;
+        bool stopping;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_stopping && m_batch.bytes < kBatchBytes) {
+                m_wake.wait(&m_mutex, kFlushIntervalMs);
+            }
+            std::swap(batch, m_batch);
+            stopping = m_stopping;
+        }
+        if (!batch.chunks.isEmpty() || !batch.images.isEmpty()) {
+            writeBatch(batch);
+            QMutexLocker locker(&m_mutex);
+            m_pendingBytes -= batch.bytes;
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool PacketCapture::writeBatch(Batch& batch)
+{
+    bool ok = true;
+    for (const Chunk& chunk : batch.chunks) {
+        if (chunk.segment != m_fileSegment || !m_dataFile.isOpen()) {
+            m_dataFile.close();
+            m_indexFile.close();
+            m_dataFile.setFileName(segmentDataPath(m_dir, chunk.segment));
+            m_indexFile.setFileName(segmentIndexPath(m_dir, chunk.segment));
+            m_fileSegment = chunk.segment;
+            if (!m_dataFile.open(QIODevice::WriteOnly | QIODevice::Append)
+                || !m_indexFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+                qWarning() << "Cannot open capture segment" << m_dataFile.fileName();
+                ok = false;
+                continue;
+            }
+        }
+        // 先写数据再写索引，索引中出现的数据包一定已经落盘
+        ok = m_dataFile.write(chunk.frames) == chunk.frames.size() && ok;
+        m_dataFile.flush();
+        ok = m_indexFile.write(chunk.packets) == chunk.packets.size() && ok;
+        m_indexFile.flush();
+    }
+    if (!batch.locations.isEmpty()) {
+        ok = m_locationsFile.write(batch.locations) == batch.locations.size() && ok;
+        m_locationsFile.flush();
+    }
+    if (!batch.images.isEmpty()) {
+        ok = m_imagesFile.write(batch.images) == batch.images.size() && ok;
+        m_imagesFile.flush();
+    }
+    if (!ok) {
+        qWarning() << "Capture write failed in" << m_dir;
+    }
+    return ok;
+}
+
+// ===================== PacketCaptureReader =====================
+
+bool PacketCaptureReader::open(const QString& dir, QString* errorMessage)
+{
+    m_dir = dir;
+    m_images.clear();
+    m_segmentFile.close();
+    m_openSegment = 0;
+
+    QFile imagesFile(dir + "/" + kImagesFileName);
+    if (!imagesFile.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = QString("Cannot open %1").arg(imagesFile.fileName());
+        }
+        return false;
+    }
+    const QByteArray data = imagesFile.readAll();
+    m_images.resize(data.size() / int(sizeof(SarCaptureImage)));
+    memcpy(m_images.data(), data.constData(), m_images.size() * sizeof(SarCaptureImage));
+
+    m_locationsFile.close();
+    m_locationsFile.setFileName(dir + "/" + kLocationsFileName);
+    if (!m_locationsFile.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = QString("Cannot open %1").arg(m_locationsFile.fileName());
+        }
+        return false;
+    }
+    return true;
+}
+
+int PacketCaptureReader::findImage(quint16 imageNumber) const
+{
+    for (int i = m_images.size() - 1; i >= 0; --i) {
+        if (m_images.at(i).image_number == imageNumber) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QVector<int> PacketCaptureReader::findImages(quint16 imageNumber) const
+{
+    QVector<int> result;
+    for (int i = 0; i < m_images.size(); ++i) {
+        if (m_images.at(i).image_number == imageNumber) {
+            result.append(i);
+        }
+    }
+    return result;
+}
+
+bool PacketCaptureReader::readImage(int index, QByteArray* packets, QString* errorMessage)
+{
+    auto fail = [errorMessage](const QString& message) {
+        if (errorMessage) {
+            *errorMessage = message;
+        }
+        return false;
+    };
+    if (index < 0 || index >= m_images.size()) {
+        return fail(QString("No captured image at index %1").arg(index));
+    }
+    const SarCaptureImage& image = m_images.at(index);
+    QVector<SarCaptureLocation> locations(image.packets);
+    const qint64 locationBytes = qint64(image.packets) * qint64(sizeof(SarCaptureLocation));
+    if (!m_locationsFile.seek(qint64(image.first_location) * qint64(sizeof(SarCaptureLocation)))
+        || m_locationsFile.read(reinterpret_cast<char*>(locations.data()), locationBytes) != locationBytes) {
+        return fail("Capture location index is truncated");
+    }
+
+    packets->clear();
+    for (const SarCaptureLocation& location : locations) {
+        if (!m_segmentFile.isOpen() || location.segment != m_openSegment) {
+            m_segmentFile.close();
+            m_segmentFile.setFileName(PacketCapture::segmentDataPath(m_dir, location.segment));
+            m_openSegment = location.segment;
+            if (!m_segmentFile.open(QIODevice::ReadOnly)) {
+                return fail(QString("Cannot open %1").arg(m_segmentFile.fileName()));
+            }
+        }
+        SAR_Frame header;
+        if (!m_segmentFile.seek(location.offset)
+            || m_segmentFile.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header))) {
+            return fail(QString("Packet at %1:%2 is missing").arg(location.segment).arg(location.offset));
+        }
+        const QByteArray payload = m_segmentFile.read(header.data_length);
+        if (payload.size() != header.data_length) {
+            return fail(QString("Packet at %1:%2 is truncated").arg(location.segment).arg(location.offset));
+        }
+        packets->append(reinterpret_cast<const char*>(&header), sizeof(header));
+        packets->append(payload);
+    }
+    return true;
+}
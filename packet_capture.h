@@ -0,0 +1,167 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <cstdint>
+
+class QThread;
+
+#pragma pack(1)
+
+// 分段索引文件（seg-NNNNNN.pkt）中的一条记录，与分段数据文件（seg-NNNNNN.sar）中的数据包一一对应
+struct SarCapturePacket {
+    int64_t timestamp_ns;       // 交给套接字的时刻（Unix 纳秒）
+    uint32_t offset;            // 数据包在分段数据文件中的偏移
+    uint32_t dest_ipv4;         // 目的地址，非 IPv4 时为 0
+    uint16_t dest_port;
+    uint16_t image_number;      // 以下三项取自帧头，便于不读数据文件就能筛选
+    uint16_t current_packet;
+    uint16_t total_packets;
+};
+
+// images.idx 中的一条记录：一条消息的全部数据包都已记录
+struct SarCaptureImage {
+    uint16_t image_number;
+    uint16_t packets;
+    uint32_t image_size;        // 帧头中的消息总字节数
+    uint32_t dest_ipv4;
+    uint16_t dest_port;
+    uint16_t reserved;
+    int64_t first_ns;           // 第一个与最后一个数据包的时刻
+    int64_t last_ns;
+    uint64_t first_location;    // 在 images.loc 中的下标，其后 packets 个位置依次为各数据包
+};
+
+// images.loc 中的一个数据包位置
+struct SarCaptureLocation {
+    uint32_t segment;
+    uint32_t offset;
+};
+
+#pragma pack()
+
+/**
+ * @class PacketCapture
+ * @brief 记录发出的每个 SAR_Frame，用于排查问题与重新投递。目录内的文件：
+ *   seg-NNNNNN.sar   按发送顺序首尾相接的数据包（与线上字节一致，可直接交给 unpackage_sar_data 或回放工具）
+ *   seg-NNNNNN.pkt   每个数据包一条 SarCapturePacket：时刻与目的地址
+ *   images.idx/.loc  每条收齐的消息一条 SarCaptureImage 及其各数据包的位置，按编号取图无需扫描数据文件
+ * 分段写满 segmentBytes 后换下一个文件；重新打开时从新的分段开始，已有文件只追加不改写。
+ * 发送路径上只把数据包拷进内存批次，由后台线程攒批写盘；积压超过上限时丢弃新的数据包并计数，
+ * 不会拖慢发送。open/close 只在主线程调用；record 在主线程与各网络线程上都会调用，记录状态受锁保护。
+ */
+class PacketCapture
+{
+public:
+    struct Stats {
+        qint64 recordedPackets;
+        qint64 droppedPackets;
+        qint64 pendingBytes;    // 已记录、尚未写盘的字节
+        quint32 segment;        // 当前分段编号
+    };
+
+    static PacketCapture& instance();
+
+    bool open(const QString& dir, qint64 segmentBytes);
+    // 写完积压的批次后停止后台线程
+    void close();
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+    // 记录一个已交给套接字的数据包（帧头 + 数据），可在任意线程调用
+    void record(const uint8_t* packet, size_t size, const QString& ip, quint16 port);
+
+    Stats stats() const;
+
+    static QString segmentDataPath(const QString& dir, quint32 segment);
+    static QString segmentIndexPath(const QString& dir, quint32 segment);
+
+private:
+    // 同一分段内连续的一段数据包
+    struct Chunk {
+        quint32 segment;
+        QByteArray frames;
+        QByteArray packets;     // SarCapturePacket 数组
+    };
+    struct Batch {
+        QVector<Chunk> chunks;
+        QByteArray images;      // SarCaptureImage 数组
+        QByteArray locations;   // SarCaptureLocation 数组
+        qint64 bytes = 0;
+    };
+    // 尚未收齐的消息，按图像编号组织
+    struct OpenImage {
+        SarCaptureImage image;
+        QVector<SarCaptureLocation> locations;
+    };
+
+    static const qint64 kBatchBytes = 1 << 20;          // 攒够后立即唤醒写盘线程
+    static const int kFlushIntervalMs = 100;            // 不足一批时的最长等待
+    static const qint64 kMaxPendingBytes = 64 << 20;    // 积压上限，超出时丢弃
+
+    PacketCapture();
+    ~PacketCapture();
+    Q_DISABLE_COPY(PacketCapture)
+
+    void writerLoop();
+    bool writeBatch(Batch& batch);
+
+    QString m_dir;
+    qint64 m_segmentBytes;
+    // 发送路径上先无锁判断，持锁后再确认一次；只在持 m_mutex 时修改
+    std::atomic<bool> m_open;
+
+    // 以下由 record 在持 m_mutex 时修改；open/close 在 m_open 为 false 时初始化与清理
+    quint32 m_segment;
+    qint64 m_segmentOffset;
+    quint64 m_locationCount;
+    QHash<quint16, OpenImage> m_openImages;
+    QString m_lastIp;
+    quint32 m_lastIpv4;
+
+    // 各发送线程与写盘线程共享，受 m_mutex 保护
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    Batch m_batch;
+    qint64 m_pendingBytes;
+    qint64 m_recorded;
+    qint64 m_dropped;
+    bool m_stopping;
+
+    // 以下由写盘线程独占
+    QThread* m_writer;
+    QFile m_dataFile;
+    QFile m_indexFile;
+    quint32 m_fileSegment;
+    QFile m_imagesFile;
+    QFile m_locationsFile;
+};
+
+/**
+ * @class PacketCaptureReader
+ * @brief 读取 PacketCapture 的记录目录：按图像编号从消息索引找到各数据包的位置，只读取这些数据包。
+ */
+class PacketCaptureReader
+{
+public:
+    bool open(const QString& dir, QString* errorMessage = nullptr);
+
+    const QVector<SarCaptureImage>& images() const { return m_images; }
+    // 该编号最近一次记录的消息在 images() 中的下标，没有时返回 -1（编号循环使用，早先的同号消息用 findImages）
+    int findImage(quint16 imageNumber) const;
+    QVector<int> findImages(quint16 imageNumber) const;
+    // 按原发送顺序拼接该消息的全部数据包（帧头 + 数据），即 unpackage_sar_data 读取的格式
+    bool readImage(int index, QByteArray* packets, QString* errorMessage = nullptr);
+
+private:
+    QString m_dir;
+    QVector<SarCaptureImage> m_images;
+    QFile m_locationsFile;
+    QFile m_segmentFile;
+    quint32 m_openSegment = 0;
+};
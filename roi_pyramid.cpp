@@ -0,0 +1,237 @@
+#include "roi_pyramid.h"
+#include <QImage>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+#include "AuxFileReader.h"
+#include "file_ingest.h"
+#include "image_utils.h"
+#include "metrics.h"
+
+namespace {
+
+// 金字塔在单独的后台线程上建立，不与编码和归档争抢
+QThreadPool* pyramidPool()
+{
+    static QThreadPool* pool = [] {
+        QThreadPool* p = new QThreadPool;
+        p->setMaxThreadCount(1);
+        p->setExpiryTimeout(-1);
+        return p;
+    }();
+    return pool;
+}
+
+// 把一层图像切块并编码
+bool encodeLevel(const QImage& image, int tileSize, int quality, ImagePyramid::Level* level)
+{
+    level->size = image.size();
+    level->cols = (image.width() + tileSize - 1) / tileSize;
+    level->rows = (image.height() + tileSize - 1) / tileSize;
+    level->tiles.clear();
+    level->tiles.reserve(level->cols * level->rows);
+    for (int row = 0; row < level->rows; ++row) {
+        for (int col = 0; col < level->cols; ++col) {
+            const QRect rect(col * tileSize, row * tileSize,
+                             qMin(tileSize, image.width() - col * tileSize), qMin(tileSize, image.height() - row * tileSize));
+            QByteArray jpg;
+            if (!encodeImageToJpg(image.copy(rect), jpg, quality)) {
+                return false;
+            }
+            level->tiles.append(jpg);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+qint64 ImagePyramid::byteSize() const
+{
+    qint64 bytes = 0;
+    for (const Level& level : levels) {
+        for (const QByteArray& tile : level.tiles) {
+            bytes += tile.size();
+        }
+    }
+    return bytes;
+}
+
+PyramidStore& PyramidStore::instance()
+{
+    static PyramidStore store;
+    return store;
+}
+
+PyramidStore::PyramidStore()
+    : m_tileSize(256),
+    m_quality(80),
+    m_keepImages(0),
+    m_bytes(0)
+{
+}
+
+void PyramidStore::configure(int tileSize, int quality, int keepImages)
+{
+    QMutexLocker locker(&m_mutex);
+    m_tileSize = qMax(16, tileSize);
+    m_quality = qBound(0, quality, 100);
+    m_keepImages = qMax(0, keepImages);
+    while (static_cast<int>(m_pyramids.size()) > m_keepImages) {
+        m_bytes -= m_pyramids.back()->byteSize();
+        m_pyramids.pop_back();
+    }
+    Metrics::instance().setGauge(MetricGauge::PyramidBytes, m_bytes);
+}
+
+bool PyramidStore::enabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_keepImages > 0;
+}
+
+void PyramidStore::buildAsync(uint16_t imageNumber, const QString& tifPath, const QString& auxPath, int ampBit, const DrcParams& drc)
+{
+    class BuildTask : public QRunnable
+    {
+    public:
+        BuildTask(uint16_t imageNumber, const QString& tifPath, const QString& auxPath, int ampBit, const DrcParams& drc,
+                  int tileSize, int quality)
+            : m_imageNumber(imageNumber), m_tifPath(tifPath), m_auxPath(auxPath), m_ampBit(ampBit), m_drc(drc),
+            m_tileSize(tileSize), m_quality(quality) {}
+
+        void run() override
+        {
+            auto pyramid = std::make_shared<ImagePyramid>();
+            pyramid->imageNumber = m_imageNumber;
+            pyramid->tileSize = m_tileSize;
+            pyramid->quality = m_quality;
+
+            // 图像仍在发送时源文件通常还留在 FileIngest 中，直接从内存读取
+            const IngestedFilePtr aux = FileIngest::instance().get(m_auxPath);
+            AuxFileReader auxReader;
+            QImage image;
+            if (!(aux ? auxReader.read(aux->bytes()) : auxReader.read(m_auxPath))
+                || !loadSarTiffImage(m_tifPath, m_ampBit, m_drc, &image)) {
+                qWarning() << "Failed to build pyramid for" << m_tifPath;
+                return;
+            }
+            // 应答分块共用的数据信息，分块相关字段在应答时逐块填写
+            pyramid->dataInfo = createSarDataInfo(auxReader.getHeader());
+            pyramid->dataInfo.codec_id = 0;    // CodecId::Jpeg
+            pyramid->dataInfo.codec_param = static_cast<uint8_t>(m_quality);
+            pyramid->dataInfo.image_kind = SarImageTile;
+            pyramid->dataInfo.ref_image_number = m_imageNumber;
+
+            // 逐层减半，直到整层只剩一个分块
+            for (;;) {
+                ImagePyramid::Level level;
+                if (!encodeLevel(image, m_tileSize, m_quality, &level)) {
+                    qWarning() << "Failed to encode pyramid level" << pyramid->levels.size() << "of" << m_tifPath;
+                    return;
+                }
+                pyramid->levels.append(level);
+                if ((level.cols == 1 && level.rows == 1) || pyramid->levels.size() >= 0xFF) {
+                    break;
+                }
+                image = image.scaled(qMax(1, image.width() / 2), qMax(1, image.height() / 2),
+                                     Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+            PyramidStore::instance().insert(pyramid);
+        }
+
+    private:
+        uint16_t m_imageNumber;
+        QString m_tifPath;
+        QString m_auxPath;
+        int m_ampBit;
+        DrcParams m_drc;
+        int m_tileSize;
+        int m_quality;
+    };
+
+    int tileSize;
+    int quality;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_keepImages <= 0) {
+            return;
+        }
+        tileSize = m_tileSize;
+        quality = m_quality;
+    }
+    pyramidPool()->start(new BuildTask(imageNumber, tifPath, auxPath, ampBit, drc, tileSize, quality));
+}
+
+bool PyramidStore::waitForBuilds(int msecs)
+{
+    return pyramidPool()->waitForDone(msecs);
+}
+
+void PyramidStore::insert(std::shared_ptr<const ImagePyramid> pyramid)
+{
+    QMutexLocker locker(&m_mutex);
+    // 图像编号循环使用，同号的旧金字塔直接替换
+    for (auto it = m_pyramids.begin(); it != m_pyramids.end(); ++it) {
+        if ((*it)->imageNumber == pyramid->imageNumber) {
+            m_bytes -= (*it)->byteSize();
+            m_pyramids.erase(it);
+            break;
+        }
+    }
+    m_bytes += pyramid->byteSize();
+    m_pyramids.push_front(std::move(pyramid));
+    while (static_cast<int>(m_pyramids.size()) > m_keepImages) {
+        m_bytes -= m_pyramids.back()->byteSize();
+        m_pyramids.pop_back();
+    }
+    Metrics::instance().setGauge(MetricGauge::PyramidBytes, m_bytes);
+}
+
+bool PyramidStore::tiles(uint16_t imageNumber, int level, int col0, int row0, int col1, int row1,
+                         QVector<PyramidTile>* out, ImagePyramid::Level* levelInfo, SAR_DataInfo* dataInfo) const
+{
+    std::shared_ptr<const ImagePyramid> pyramid;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = std::find_if(m_pyramids.begin(), m_pyramids.end(),
+                               [imageNumber](const std::shared_ptr<const ImagePyramid>& p) { return p->imageNumber == imageNumber; });
+        if (it == m_pyramids.end()) {
+            return false;
+        }
+        pyramid = *it;
+    }
+    if (level < 0 || level >= pyramid->levels.size()) {
+        return false;
+    }
+
+    // 金字塔建成后不再修改，出锁后可以直接读取
+    const ImagePyramid::Level& l = pyramid->levels.at(level);
+    col0 = qMax(0, col0);
+    row0 = qMax(0, row0);
+    col1 = qMin(col1, l.cols - 1);
+    row1 = qMin(row1, l.rows - 1);
+    out->clear();
+    for (int row = row0; row <= row1; ++row) {
+        for (int col = col0; col <= col1; ++col) {
+            PyramidTile tile;
+            tile.index = row * l.cols + col;
+            tile.rect = QRect(col * pyramid->tileSize, row * pyramid->tileSize,
+                              qMin(pyramid->tileSize, l.size.width() - col * pyramid->tileSize),
+                              qMin(pyramid->tileSize, l.size.height() - row * pyramid->tileSize));
+            tile.jpg = l.tiles.at(tile.index);
+            out->append(tile);
+        }
+    }
+    if (levelInfo) {
+        levelInfo->size = l.size;
+        levelInfo->cols = l.cols;
+        levelInfo->rows = l.rows;
+    }
+    if (dataInfo) {
+        *dataInfo = pyramid->dataInfo;
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include "dynamic_range.h"
+#include "package_sar_data.h"
+
+// 金字塔中的一个已编码分块
+struct PyramidTile {
+    int index = 0;          // 层内行优先序号
+    QRect rect;             // 在该层图像中的像素范围
+    QByteArray jpg;
+};
+
+// 一幅图像的多分辨率分块金字塔，第 0 层为全分辨率，每升一层宽高减半
+struct ImagePyramid {
+    struct Level {
+        QSize size;
+        int cols = 0;       // 分块列数
+        int rows = 0;       // 分块行数
+        QVector<QByteArray> tiles;
+    };
+
+    uint16_t imageNumber = 0;
+    SAR_DataInfo dataInfo = {};     // 建立金字塔时由 AUX 生成，应答分块时复用
+    int tileSize = 0;
+    int quality = 0;
+    QVector<Level> levels;
+
+    qint64 byteSize() const;
+};
+
+/**
+ * @class PyramidStore
+ * @brief 发送端的金字塔仓库：整幅图像发出后在后台线程上建立分块金字塔，
+ * 按图像编号保存最近若干幅，供感兴趣区域请求按层级、分块范围取用。线程安全。
+ */
+class PyramidStore {
+public:
+    static PyramidStore& instance();
+
+    // keepImages 为 0 时不建立金字塔
+    void configure(int tileSize, int quality, int keepImages);
+    bool enabled() const;
+
+    // 在后台线程上读取 TIF、逐层缩小并分块编码，完成后以 imageNumber 入库
+    void buildAsync(uint16_t imageNumber, const QString& tifPath, const QString& auxPath, int ampBit, const DrcParams& drc);
+    // 等待排队的金字塔全部建完，msecs < 0 表示一直等待
+    bool waitForBuilds(int msecs = -1);
+
+    // 取出 level 层中列 col0~col1、行 row0~row1 的分块（范围会裁到该层实际大小）；
+    // 图像或层级不存在时返回 false
+    bool tiles(uint16_t imageNumber, int level, int col0, int row0, int col1, int row1,
+               QVector<PyramidTile>* out, ImagePyramid::Level* levelInfo = nullptr, SAR_DataInfo* dataInfo = nullptr) const;
+
+private:
+    PyramidStore();
+    Q_DISABLE_COPY(PyramidStore)
+
+    void insert(std::shared_ptr<const ImagePyramid> pyramid);
+
+    mutable QMutex m_mutex;
+    int m_tileSize;
+    int m_quality;
+    int m_keepImages;
+    std::list<std::shared_ptr<const ImagePyramid>> m_pyramids;   // 前端为最新
+    qint64 m_bytes;
+};
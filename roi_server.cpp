@@ -0,0 +1,191 @@
+#include "roi_server.h"
+#include <QDebug>
+#include <QPointer>
+#include "image_transfer.h"
+#include "metrics.h"
+#include "roi_pyramid.h"
+#include "transfer_scheduler.h"
+
+namespace {
+// 套接字缓冲中待发的字节低于该水位时才续写下一批数据包
+const qint64 kReplyHighWaterBytes = 256 * 1024;
+// 每条连接排队的请求数上限，超出的请求直接丢弃
+const int kMaxQueuedRequests = 64;
+}
+
+RoiServer::RoiServer(QObject* parent)
+    : QObject(parent),
+    m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &RoiServer::onNewConnection);
+}
+
+bool RoiServer::start(quint16 port, const QHostAddress& bindAddress, const QHostAddress& peerAddress)
+{
+    if (m_server->isListening()) {
+        m_server->close();
+    }
+    // 请求来自地面接收端，需要在数据链所在的网口上监听
+    if (!m_server->listen(bindAddress, port)) {
+        qWarning() << "ROI server failed to listen on" << bindAddress << "port" << port << ":" << m_server->errorString();
+        return false;
+    }
+    m_peerAddress = peerAddress;
+    if (m_peerAddress.isNull()) {
+        qWarning() << "ROI peer address is not an IP address, all ROI connections will be rejected";
+    }
+    qDebug() << "ROI server listening on" << bindAddress << "port" << port << "for" << peerAddress;
+    return true;
+}
+
+void RoiServer::stop()
+{
+    m_server->close();
+}
+
+quint16 RoiServer::serverPort() const
+{
+    return m_server->serverPort();
+}
+
+void RoiServer::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        if (!socket->peerAddress().isEqual(m_peerAddress, QHostAddress::ConvertV4MappedToIPv4)) {
+            qWarning() << "Rejected ROI connection from" << socket->peerAddress();
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        m_clients.insert(socket, std::make_shared<Client>());
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            const std::shared_ptr<Client> client = m_clients.value(socket);
+            if (!client) {
+                return;
+            }
+            const QByteArray data = socket->readAll();
+            const auto requests = client->parser.feed(reinterpret_cast<const uint8_t*>(data.constData()),
+                                                      static_cast<size_t>(data.size()));
+            for (const SAR_RoiRequest& request : requests) {
+                Metrics::instance().addCounter(MetricCounter::RoiRequests);
+                if (client->requests.size() >= kMaxQueuedRequests) {
+                    qWarning() << "Too many queued ROI requests, dropped request for image" << request.image_number;
+                    continue;
+                }
+                client->requests.enqueue(request);
+            }
+            pump(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() {
+            pump(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            if (const std::shared_ptr<Client> client = m_clients.take(socket)) {
+                releaseNumbers(&client->replyNumbers);
+                releaseNumbers(&client->drainingNumbers);
+            }
+            socket->deleteLater();
+        });
+    }
+}
+
+void RoiServer::pump(QTcpSocket* socket)
+{
+    const std::shared_ptr<Client> client = m_clients.value(socket);
+    if (!client) {
+        return;
+    }
+    while (socket->bytesToWrite() < kReplyHighWaterBytes) {
+        if (!client->reply || !client->reply->hasNextPacket()) {
+            if (client->reply) {
+                // 应答已全部写入套接字缓冲，编号等缓冲排空后释放
+                client->drainingNumbers += client->replyNumbers;
+                client->replyNumbers.clear();
+                client->reply.reset();
+            }
+            if (client->requests.isEmpty() || client->deferred) {
+                break;
+            }
+            // 已打包待发的数据超出预算时，应答与图像编码一样等传输释放预算后再继续
+            QPointer<QTcpSocket> guard(socket);
+            if (!TransferScheduler::instance().admitOrDefer([this, guard, client]() {
+                    client->deferred = false;
+                    if (guard) {
+                        pump(guard);
+                    }
+                })) {
+                client->deferred = true;
+                break;
+            }
+            prepareReply(client.get(), client->requests.dequeue());
+            continue;
+        }
+        const SarPacketView packet = client->reply->nextPacketView();
+        if (socket->write(reinterpret_cast<const char*>(packet.data), static_cast<qint64>(packet.size)) == -1) {
+            qWarning() << "Failed to write ROI reply:" << socket->errorString();
+            Metrics::instance().recordError(MetricError::WriteFailed);
+            socket->abort();
+            return;
+        }
+        Metrics::instance().addCounter(MetricCounter::PacketsSent);
+    }
+    if (socket->bytesToWrite() == 0) {
+        releaseNumbers(&client->drainingNumbers);
+    }
+}
+
+bool RoiServer::prepareReply(Client* client, const SAR_RoiRequest& request)
+{
+    QVector<PyramidTile> tiles;
+    ImagePyramid::Level level;
+    SAR_DataInfo dataInfo;
+    if (!PyramidStore::instance().tiles(request.image_number, request.level,
+                                        request.tile_col0, request.tile_row0, request.tile_col1, request.tile_row1,
+                                        &tiles, &level, &dataInfo)) {
+        qWarning() << "ROI request for unknown image" << request.image_number << "level" << request.level;
+        return false;
+    }
+
+    // 应答与分块发送的格式相同，另在 pyramid_level 中注明层级
+    dataInfo.tile_count = static_cast<uint16_t>(level.cols * level.rows);
+    dataInfo.mosaic_cols = static_cast<uint16_t>(level.size.width());
+    dataInfo.mosaic_rows = static_cast<uint16_t>(level.size.height());
+    dataInfo.pyramid_level = request.level;
+    QVector<uint16_t> numbers;
+    numbers.reserve(tiles.size());
+    for (int i = 0; i < tiles.size(); ++i) {
+        const uint16_t number = allocateImageNumber();
+        if (number == 0) {
+            qWarning() << "No free image number for ROI reply of image" << request.image_number;
+            releaseNumbers(&numbers);
+            return false;
+        }
+        numbers.append(number);
+    }
+
+    std::unique_ptr<SarPacketizer> packetizer(new SarPacketizer);
+    for (int i = 0; i < tiles.size(); ++i) {
+        const PyramidTile& tile = tiles.at(i);
+        dataInfo.tile_index = static_cast<uint16_t>(tile.index);
+        dataInfo.tile_x = static_cast<uint16_t>(tile.rect.x());
+        dataInfo.tile_y = static_cast<uint16_t>(tile.rect.y());
+        packetizer->appendMessage(dataInfo, reinterpret_cast<const uint8_t*>(tile.jpg.constData()),
+                                  static_cast<size_t>(tile.jpg.size()), numbers.at(i));
+    }
+    client->reply = std::move(packetizer);
+    client->replyNumbers = numbers;
+
+    Metrics::instance().addCounter(MetricCounter::RoiTilesSent, static_cast<quint64>(tiles.size()));
+    qDebug() << "Answering ROI request for image" << request.image_number << "level" << request.level
+             << "with" << tiles.size() << "tiles";
+    return true;
+}
+
+void RoiServer::releaseNumbers(QVector<uint16_t>* numbers)
+{
+    for (uint16_t number : *numbers) {
+        releaseImageNumber(number);
+    }
+    numbers->clear();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QQueue>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+#include <memory>
+#include "package_sar_data.h"
+
+/**
+ * @class RoiServer
+ * @brief 感兴趣区域拉取服务：接收端连上来发送 SAR_RoiRequest，发送端从 PyramidStore 取出
+ * 对应层级与范围的分块，按分块模式打包后在同一连接上应答。只有被请求的细节才经过数据链。
+ * 每条连接的请求排队逐个应答，只在套接字缓冲低于水位时续写，并受 TransferScheduler 的字节预算约束；
+ * 只接受来自接收端地址的连接。只在主线程上使用。
+ */
+class RoiServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RoiServer(QObject* parent = nullptr);
+
+    // 在 bindAddress 上监听，只接受来自 peerAddress 的连接
+    bool start(quint16 port, const QHostAddress& bindAddress, const QHostAddress& peerAddress);
+    void stop();
+    // 实际监听的端口（start 传 0 时由系统分配）
+    quint16 serverPort() const;
+
+private slots:
+    void onNewConnection();
+
+private:
+    // 一条连接的应答状态：同一时刻只打包一个请求的应答，其余请求排队
+    struct Client {
+        SarRoiRequestParser parser;
+        QQueue<SAR_RoiRequest> requests;
+        std::unique_ptr<SarPacketizer> reply;   // 正在写出的应答
+        QVector<uint16_t> replyNumbers;         // 正在写出的应答分块占用的图像编号
+        QVector<uint16_t> drainingNumbers;      // 已全部写入套接字缓冲、尚未发出的应答占用的编号
+        bool deferred = false;                  // 预算耗尽，正等待调度器恢复
+    };
+
+    void pump(QTcpSocket* socket);
+    bool prepareReply(Client* client, const SAR_RoiRequest& request);
+    void releaseNumbers(QVector<uint16_t>* numbers);
+
+    QTcpServer* m_server;
+    QHostAddress m_peerAddress;
+    QHash<QTcpSocket*, std::shared_ptr<Client>> m_clients;
+};
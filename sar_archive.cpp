@@ -0,0 +1,460 @@
+#include "sar_archive.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+const char* const kDataFileName = "frames.dat";
+const char* const kIndexFileName = "frames.idx";
+const char* const kTreeFileName = "footprints.rtree";
+const uint32_t kTreeMagic = 0x54524153;    // "SART"
+const uint32_t kTreeVersion = 1;
+
+#pragma pack(1)
+struct TreeFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t entries;       // 覆盖的记录数
+    uint32_t leaf_count;
+    uint32_t node_count;
+};
+#pragma pack()
+
+const uint64_t kRecordOverhead = sizeof(SarArchiveRecordHeader) + sizeof(SAR_DataInfo);
+
+int32_t toLsb(double deg) {
+    const double lsb = std::round(deg / kSarLatLngLsbDeg);
+    return static_cast<int32_t>(std::max<double>(INT32_MIN, std::min<double>(INT32_MAX, lsb)));
+}
+
+SarArchiveEntry makeEntry(const SarArchiveRecordHeader& header, const SAR_DataInfo& info, uint64_t offset) {
+    SarArchiveEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = offset;
+    entry.image_bytes = header.image_bytes;
+    entry.image_number = header.image_number;
+    entry.image_kind = info.image_kind;
+    entry.received_ms = header.received_ms;
+    const int32_t lngs[] = { info.top_left_lng, info.bottom_left_lng, info.bottom_right_lng, info.top_right_lng };
+    const int32_t lats[] = { info.top_left_lat, info.bottom_left_lat, info.bottom_right_lat, info.top_right_lat };
+    entry.min_lng = *std::min_element(lngs, lngs + 4);
+    entry.max_lng = *std::max_element(lngs, lngs + 4);
+    entry.min_lat = *std::min_element(lats, lats + 4);
+    entry.max_lat = *std::max_element(lats, lats + 4);
+    return entry;
+}
+
+uint64_t fileSize(const std::string& path) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : static_cast<uint64_t>(size);
+}
+
+// 按 STR（Sort-Tile-Recursive）顺序重排 order：先按中心经度切成若干竖条，条内按中心纬度排序，
+// 之后每 fanout 个相邻元素组成一个节点，节点的外包矩形彼此重叠很少
+template <typename BoxOf>
+void strSort(std::vector<uint32_t>& order, size_t fanout, BoxOf boxOf) {
+    const size_t count = order.size();
+    const size_t groups = (count + fanout - 1) / fanout;
+    const size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(groups))));
+    const size_t perSlice = std::max<size_t>(1, slices) * fanout;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const auto& ba = boxOf(a);
+        const auto& bb = boxOf(b);
+        return int64_t(ba.min_lng) + ba.max_lng < int64_t(bb.min_lng) + bb.max_lng;
+    });
+    for (size_t begin = 0; begin < count; begin += perSlice) {
+        const size_t end = std::min(count, begin + perSlice);
+        std::sort(order.begin() + begin, order.begin() + end, [&](uint32_t a, uint32_t b) {
+            const auto& ba = boxOf(a);
+            const auto& bb = boxOf(b);
+            return int64_t(ba.min_lat) + ba.max_lat < int64_t(bb.min_lat) + bb.max_lat;
+        });
+    }
+}
+
+} // namespace
+
+SarArchive::SarArchive()
+    : m_dataSize(0),
+    m_open(false),
+    m_leafCount(0),
+    m_treeEntries(0) {
+}
+
+SarArchive::~SarArchive() {
+    close();
+}
+
+bool SarArchive::isOpen() const {
+    return m_open;
+}
+
+size_t SarArchive::size() const {
+    return m_entries.size();
+}
+
+const SarArchiveEntry& SarArchive::entry(uint64_t id) const {
+    return m_entries[id];
+}
+
+bool SarArchive::open(const std::string& dir) {
+    close();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    m_dir = dir;
+
+    if (!loadIndex() || !recoverTail()) {
+        close();
+        return false;
+    }
+    m_dataOut.open(m_dir + "/" + kDataFileName, std::ios::binary | std::ios::app);
+    m_indexOut.open(m_dir + "/" + kIndexFileName, std::ios::binary | std::ios::app);
+    m_dataIn.open(m_dir + "/" + kDataFileName, std::ios::binary);
+    if (!m_dataOut || !m_indexOut || !m_dataIn) {
+        std::cerr << "Error: Cannot open archive files in " << m_dir << std::endl;
+        close();
+        return false;
+    }
+    m_open = true;
+    loadSpatialIndex();
+    maybeRebuild();
+    return true;
+}
+
+void SarArchive::close() {
+    m_dataOut.close();
+    m_indexOut.close();
+    m_dataIn.close();
+    m_dataOut.clear();
+    m_indexOut.clear();
+    m_dataIn.clear();
+    m_open = false;
+    m_dataSize = 0;
+    m_entries.clear();
+    m_nodes.clear();
+    m_leafIds.clear();
+    m_leafCount = 0;
+    m_treeEntries = 0;
+}
+
+// 读入索引文件，丢弃数据文件中没有完整记录的尾部索引
+bool SarArchive::loadIndex() {
+    const std::string indexPath = m_dir + "/" + kIndexFileName;
+    m_dataSize = fileSize(m_dir + "/" + kDataFileName);
+    const uint64_t count = fileSize(indexPath) / sizeof(SarArchiveEntry);
+    m_entries.resize(count);
+    if (count > 0) {
+        std::ifstream in(indexPath, std::ios::binary);
+        in.read(reinterpret_cast<char*>(m_entries.data()), count * sizeof(SarArchiveEntry));
+        if (static_cast<uint64_t>(in.gcount()) != count * sizeof(SarArchiveEntry)) {
+            std::cerr << "Error: Failed to read archive index " << indexPath << std::endl;
+            return false;
+        }
+    }
+    while (!m_entries.empty()) {
+        const SarArchiveEntry& last = m_entries.back();
+        if (last.offset + kRecordOverhead + last.image_bytes <= m_dataSize) {
+            break;
+        }
+        m_entries.pop_back();
+    }
+    return true;
+}
+
+// 从最后一条索引之后扫描数据文件：补回完整记录的索引，截掉写了一半的记录
+bool SarArchive::recoverTail() {
+    const std::string dataPath = m_dir + "/" + kDataFileName;
+    const std::string indexPath = m_dir + "/" + kIndexFileName;
+    uint64_t offset = 0;
+    if (!m_entries.empty()) {
+        offset = m_entries.back().offset + kRecordOverhead + m_entries.back().image_bytes;
+    }
+    const size_t indexed = m_entries.size();
+
+    if (offset < m_dataSize) {
+        std::ifstream in(dataPath, std::ios::binary);
+        while (offset + kRecordOverhead <= m_dataSize) {
+            SarArchiveRecordHeader header;
+            SAR_DataInfo info;
+            in.seekg(static_cast<std::streamoff>(offset));
+            in.read(reinterpret_cast<char*>(&header), sizeof(header));
+            in.read(reinterpret_cast<char*>(&info), sizeof(info));
+            if (!in || header.magic != kSarArchiveRecordMagic
+                || offset + kRecordOverhead + header.image_bytes > m_dataSize) {
+                break;
+            }
+            m_entries.push_back(makeEntry(header, info, offset));
+            offset += kRecordOverhead + header.image_bytes;
+        }
+    }
+
+    std::error_code ec;
+    if (offset < m_dataSize) {
+        std::cerr << "Archive: dropping " << (m_dataSize - offset) << " incomplete bytes at the end of " << dataPath << std::endl;
+        std::filesystem::resize_file(dataPath, offset, ec);
+        if (ec) {
+            std::cerr << "Error: Cannot truncate " << dataPath << ": " << ec.message() << std::endl;
+            return false;
+        }
+        m_dataSize = offset;
+    }
+    // 索引文件按恢复后的内容整体重写（只在异常退出后发生）
+    if (m_entries.size() != indexed || fileSize(indexPath) != m_entries.size() * sizeof(SarArchiveEntry)) {
+        std::ofstream out(indexPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(m_entries.data()), m_entries.size() * sizeof(SarArchiveEntry));
+        if (!out) {
+            std::cerr << "Error: Cannot rewrite archive index " << indexPath << std::endl;
+            return false;
+        }
+        std::cerr << "Archive: index of " << m_dir << " recovered, " << (m_entries.size() - indexed) << " record(s) re-indexed" << std::endl;
+    }
+    return true;
+}
+
+int64_t SarArchive::append(uint16_t image_number, const SAR_DataInfo& info, const uint8_t* image_data, size_t image_size,
+                           int64_t received_ms) {
+    if (!m_open || image_size > UINT32_MAX) {
+        return -1;
+    }
+    // 接收时刻单调不减，时间索引才能二分查找
+    if (!m_entries.empty()) {
+        received_ms = std::max(received_ms, m_entries.back().received_ms);
+    }
+
+    SarArchiveRecordHeader header;
+    header.magic = kSarArchiveRecordMagic;
+    header.image_bytes = static_cast<uint32_t>(image_size);
+    header.received_ms = received_ms;
+    header.image_number = image_number;
+    header.reserved = 0;
+    const SarArchiveEntry entry = makeEntry(header, info, m_dataSize);
+
+    // 先写数据再写索引：中途退出时数据文件多出的记录在下次打开时补回索引
+    m_dataOut.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_dataOut.write(reinterpret_cast<const char*>(&info), sizeof(info));
+    m_dataOut.write(reinterpret_cast<const char*>(image_data), static_cast<std::streamsize>(image_size));
+    m_dataOut.flush();
+    m_indexOut.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    m_indexOut.flush();
+    if (!m_dataOut || !m_indexOut) {
+        std::cerr << "Error: Failed to append to archive " << m_dir << std::endl;
+        return -1;
+    }
+
+    m_dataSize += kRecordOverhead + image_size;
+    m_entries.push_back(entry);
+    maybeRebuild();
+    return static_cast<int64_t>(m_entries.size() - 1);
+}
+
+bool SarArchive::read(uint64_t id, SAR_DataInfo* info, std::vector<uint8_t>* image_data) {
+    if (!m_open || id >= m_entries.size()) {
+        return false;
+    }
+    const SarArchiveEntry& e = m_entries[id];
+    m_dataIn.clear();
+    m_dataIn.seekg(static_cast<std::streamoff>(e.offset + sizeof(SarArchiveRecordHeader)));
+    SAR_DataInfo stored;
+    m_dataIn.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+    if (info) {
+        *info = stored;
+    }
+    if (image_data) {
+        image_data->resize(e.image_bytes);
+        m_dataIn.read(reinterpret_cast<char*>(image_data->data()), e.image_bytes);
+    }
+    return static_cast<bool>(m_dataIn);
+}
+
+SarArchive::Box SarArchive::entryBox(const SarArchiveEntry& entry) {
+    return Box{ entry.min_lng, entry.min_lat, entry.max_lng, entry.max_lat };
+}
+
+bool SarArchive::intersects(const Box& a, const Box& b) {
+    return a.min_lng <= b.max_lng && b.min_lng <= a.max_lng && a.min_lat <= b.max_lat && b.min_lat <= a.max_lat;
+}
+
+std::vector<uint64_t> SarArchive::queryPoint(double lat_deg, double lng_deg, int64_t from_ms, int64_t to_ms) const {
+    const int32_t lat = toLsb(lat_deg);
+    const int32_t lng = toLsb(lng_deg);
+    return query(Box{ lng, lat, lng, lat }, from_ms, to_ms);
+}
+
+std::vector<uint64_t> SarArchive::queryBox(double min_lat_deg, double min_lng_deg, double max_lat_deg, double max_lng_deg,
+                                           int64_t from_ms, int64_t to_ms) const {
+    return query(Box{ toLsb(min_lng_deg), toLsb(min_lat_deg), toLsb(max_lng_deg), toLsb(max_lat_deg) }, from_ms, to_ms);
+}
+
+std::vector<uint64_t> SarArchive::query(const Box& box, int64_t from_ms, int64_t to_ms) const {
+    std::vector<uint64_t> result;
+    // 时间索引：接收时刻单调不减，二分得到编号范围 [lo, hi)
+    const auto lower = std::lower_bound(m_entries.begin(), m_entries.end(), from_ms,
+                                        [](const SarArchiveEntry& e, int64_t t) { return e.received_ms < t; });
+    const auto upper = std::upper_bound(lower, m_entries.end(), to_ms,
+                                        [](int64_t t, const SarArchiveEntry& e) { return t < e.received_ms; });
+    const uint64_t lo = static_cast<uint64_t>(lower - m_entries.begin());
+    const uint64_t hi = static_cast<uint64_t>(upper - m_entries.begin());
+    if (lo >= hi) {
+        return result;
+    }
+
+    // 时间范围内记录不多，或 R 树没有覆盖该范围：顺序扫描
+    uint64_t scanFrom = lo;
+    if (hi - lo > kScanThreshold && !m_nodes.empty() && lo < m_treeEntries) {
+        std::vector<uint32_t> stack(1, static_cast<uint32_t>(m_nodes.size() - 1));
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = m_nodes[index];
+            if (!intersects(node.box, box)) {
+                continue;
+            }
+            if (index < m_leafCount) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    const uint32_t id = m_leafIds[i];
+                    if (id >= lo && id < hi && intersects(entryBox(m_entries[id]), box)) {
+                        result.push_back(id);
+                    }
+                }
+            } else {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    stack.push_back(i);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        scanFrom = std::max(lo, m_treeEntries);
+    }
+    for (uint64_t id = scanFrom; id < hi; ++id) {
+        if (intersects(entryBox(m_entries[id]), box)) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+void SarArchive::maybeRebuild() {
+    const uint64_t delta = m_entries.size() - m_treeEntries;
+    if (delta >= std::max<uint64_t>(kMinRebuildDelta, m_treeEntries / 16)) {
+        rebuildSpatialIndex();
+    }
+}
+
+void SarArchive::loadSpatialIndex() {
+    m_nodes.clear();
+    m_leafIds.clear();
+    m_leafCount = 0;
+    m_treeEntries = 0;
+
+    const std::string path = m_dir + "/" + kTreeFileName;
+    std::ifstream in(path, std::ios::binary);
+    TreeFileHeader header;
+    if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return;
+    }
+    // 覆盖的记录比索引还多说明索引被截过，R 树作废，稍后重建
+    const uint64_t expected = sizeof(header) + uint64_t(header.node_count) * sizeof(Node) + header.entries * sizeof(uint32_t);
+    if (header.magic != kTreeMagic || header.version != kTreeVersion || header.entries > m_entries.size()
+        || header.leaf_count > header.node_count || fileSize(path) != expected) {
+        std::cerr << "Archive: ignoring stale spatial index " << path << std::endl;
+        return;
+    }
+    std::vector<Node> nodes(header.node_count);
+    std::vector<uint32_t> ids(header.entries);
+    in.read(reinterpret_cast<char*>(nodes.data()), nodes.size() * sizeof(Node));
+    in.read(reinterpret_cast<char*>(ids.data()), ids.size() * sizeof(uint32_t));
+    if (!in) {
+        return;
+    }
+    m_nodes.swap(nodes);
+    m_leafIds.swap(ids);
+    m_leafCount = header.leaf_count;
+    m_treeEntries = header.entries;
+}
+
+bool SarArchive::rebuildSpatialIndex() {
+    if (!m_open || m_entries.size() > UINT32_MAX) {
+        return false;
+    }
+    std::vector<Node> nodes;
+    std::vector<uint32_t> ids(m_entries.size());
+    std::iota(ids.begin(), ids.end(), 0);
+
+    // 叶子层：记录按 STR 顺序排好，每 kNodeFanout 条一个叶子
+    strSort(ids, kNodeFanout, [this](uint32_t id) { return entryBox(m_entries[id]); });
+    for (size_t begin = 0; begin < ids.size(); begin += kNodeFanout) {
+        const size_t end = std::min(ids.size(), begin + kNodeFanout);
+        Node node{ entryBox(m_entries[ids[begin]]), static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin) };
+        for (size_t i = begin + 1; i < end; ++i) {
+            const Box b = entryBox(m_entries[ids[i]]);
+            node.box = Box{ std::min(node.box.min_lng, b.min_lng), std::min(node.box.min_lat, b.min_lat),
+                            std::max(node.box.max_lng, b.max_lng), std::max(node.box.max_lat, b.max_lat) };
+        }
+        nodes.push_back(node);
+    }
+    const uint32_t leafCount = static_cast<uint32_t>(nodes.size());
+
+    // 逐层向上：本层节点按 STR 顺序重排后每 kNodeFanout 个合成一个父节点，直到只剩根
+    size_t levelBegin = 0;
+    size_t levelEnd = nodes.size();
+    while (levelEnd - levelBegin > 1) {
+        std::vector<uint32_t> order(levelEnd - levelBegin);
+        std::iota(order.begin(), order.end(), static_cast<uint32_t>(levelBegin));
+        strSort(order, kNodeFanout, [&nodes](uint32_t index) { return nodes[index].box; });
+        std::vector<Node> level;
+        level.reserve(order.size());
+        for (uint32_t index : order) {
+            level.push_back(nodes[index]);
+        }
+        std::copy(level.begin(), level.end(), nodes.begin() + levelBegin);
+
+        for (size_t begin = levelBegin; begin < levelEnd; begin += kNodeFanout) {
+            const size_t end = std::min(levelEnd, begin + kNodeFanout);
+            Node parent{ nodes[begin].box, static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin) };
+            for (size_t i = begin + 1; i < end; ++i) {
+                const Box& b = nodes[i].box;
+                parent.box = Box{ std::min(parent.box.min_lng, b.min_lng), std::min(parent.box.min_lat, b.min_lat),
+                                  std::max(parent.box.max_lng, b.max_lng), std::max(parent.box.max_lat, b.max_lat) };
+            }
+            nodes.push_back(parent);
+        }
+        levelBegin = levelEnd;
+        levelEnd = nodes.size();
+    }
+
+    // 先写临时文件再替换，写到一半退出时旧的 R 树仍然可用
+    const std::string path = m_dir + "/" + kTreeFileName;
+    const std::string tempPath = path + ".tmp";
+    {
+        TreeFileHeader header{ kTreeMagic, kTreeVersion, ids.size(), leafCount, static_cast<uint32_t>(nodes.size()) };
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+        out.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint32_t));
+        if (!out) {
+            std::cerr << "Error: Cannot write spatial index " << tempPath << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(tempPath, path, ec);
+    }
+    if (ec) {
+        std::cerr << "Error: Cannot replace spatial index " << path << ": " << ec.message() << std::endl;
+    }
+
+    // 即使写盘失败，内存中的 R 树照常使用，下次打开时重建
+    m_nodes.swap(nodes);
+    m_leafIds.swap(ids);
+    m_leafCount = leafCount;
+    m_treeEntries = m_leafIds.size();
+    return !ec;
+}
@@ -0,0 +1,125 @@
+#ifndef SAR_ARCHIVE_H
+#define SAR_ARCHIVE_H
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "package_sar_data.h"
+
+// 协议中经纬度字段的量化当量（度），与 createSarDataInfo 一致
+const double kSarLatLngLsbDeg = 8.38191e-8;
+
+#pragma pack(1)
+
+// frames.dat 中每条记录的记录头，其后依次为 SAR_DataInfo 与图像数据
+struct SarArchiveRecordHeader {
+    uint32_t magic;             // 固定值 kSarArchiveRecordMagic
+    uint32_t image_bytes;       // 图像数据字节数
+    int64_t received_ms;        // 接收时刻（Unix 毫秒）
+    uint16_t image_number;      // SAR_Frame 中的图像编号
+    uint16_t reserved;
+};
+
+// frames.idx 中的一条索引，按编号顺序首尾相接；编号即在文件中的序号
+struct SarArchiveEntry {
+    uint64_t offset;            // 记录头在 frames.dat 中的偏移
+    uint32_t image_bytes;
+    uint16_t image_number;      // SAR_Frame 中的图像编号
+    uint8_t image_kind;         // 见 SarImageKind
+    uint8_t reserved;
+    int64_t received_ms;        // 接收时刻，归档内单调不减，兼作时间索引
+    int32_t min_lng;            // 四个角点的外包矩形，协议量化单位
+    int32_t min_lat;
+    int32_t max_lng;
+    int32_t max_lat;
+};
+
+#pragma pack()
+
+const uint32_t kSarArchiveRecordMagic = 0x41524153; // "SARA"
+
+/**
+ * @class SarArchive
+ * @brief 接收端的图像归档：只追加的数据文件 + 定长索引文件 + 覆盖范围的 R 树文件，目录内三个文件：
+ *   frames.dat       记录头 + SAR_DataInfo + 图像数据，只追加
+ *   frames.idx       每条记录一个 SarArchiveEntry，按接收时刻单调不减，二分查找即为时间索引
+ *   footprints.rtree 按 STR 批量装填的静态 R 树，覆盖前 N 条记录
+ * R 树之后追加的记录（增量）查询时顺序扫描，增量超过已建树记录数的 1/16 时重建并整文件替换，
+ * 重建的代价按追加次数摊薄。时间范围内的记录较少时直接扫描该范围，否则走 R 树再按编号范围过滤。
+ * 打开时检查三个文件的一致性：数据文件尾部写了一半的记录被截掉，索引缺失的完整记录从数据文件补回。
+ * 不跨越 180° 经线的覆盖范围才能正确查询。非线程安全。
+ */
+class SarArchive {
+public:
+    SarArchive();
+    ~SarArchive();
+
+    // 打开（不存在时创建）归档目录
+    bool open(const std::string& dir);
+    void close();
+    bool isOpen() const;
+
+    // 追加一幅图像，received_ms 早于上一条时按上一条记录；返回记录编号，失败返回 -1
+    int64_t append(uint16_t image_number, const SAR_DataInfo& info, const uint8_t* image_data, size_t image_size,
+                   int64_t received_ms);
+
+    size_t size() const;
+    const SarArchiveEntry& entry(uint64_t id) const;
+    // 读回一条记录，info/image_data 可为空
+    bool read(uint64_t id, SAR_DataInfo* info, std::vector<uint8_t>* image_data);
+
+    // 覆盖范围包含该点、接收时刻在 [from_ms, to_ms] 内的记录编号，按编号（接收时刻）升序
+    std::vector<uint64_t> queryPoint(double lat_deg, double lng_deg, int64_t from_ms, int64_t to_ms) const;
+    // 覆盖范围与该矩形相交的记录
+    std::vector<uint64_t> queryBox(double min_lat_deg, double min_lng_deg, double max_lat_deg, double max_lng_deg,
+                                   int64_t from_ms, int64_t to_ms) const;
+
+    // 立即把全部记录装进 R 树并写盘
+    bool rebuildSpatialIndex();
+
+private:
+    struct Box {
+        int32_t min_lng;
+        int32_t min_lat;
+        int32_t max_lng;
+        int32_t max_lat;
+    };
+
+#pragma pack(1)
+    // 前 m_leafCount 个为叶子，first/count 指向 m_leafIds；其余 first/count 指向子节点，根为最后一个
+    struct Node {
+        Box box;
+        uint32_t first;
+        uint32_t count;
+    };
+#pragma pack()
+
+    static constexpr size_t kNodeFanout = 16;
+    static constexpr size_t kScanThreshold = 4096;     // 时间范围内不多于此数时直接扫描
+    static constexpr size_t kMinRebuildDelta = 4096;
+
+    bool loadIndex();
+    bool recoverTail();
+    void loadSpatialIndex();
+    void maybeRebuild();
+    std::vector<uint64_t> query(const Box& box, int64_t from_ms, int64_t to_ms) const;
+    static Box entryBox(const SarArchiveEntry& entry);
+    static bool intersects(const Box& a, const Box& b);
+
+    std::string m_dir;
+    std::ofstream m_dataOut;
+    std::ofstream m_indexOut;
+    std::ifstream m_dataIn;
+    uint64_t m_dataSize;
+    bool m_open;
+    std::vector<SarArchiveEntry> m_entries;
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_leafIds;
+    uint32_t m_leafCount;
+    uint64_t m_treeEntries;            // R 树覆盖的记录数（编号 0 ~ m_treeEntries-1）
+};
+
+#endif // SAR_ARCHIVE_H
@@ -0,0 +1,166 @@
+#include "sar_file_sender.h"
+#include <algorithm>
+#include <cerrno>
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+bool SarFileSender::supported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SarFileSender::open(const QString& path, const SAR_DataInfo& dataInfo, uint16_t imageNumber, QString* error)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        *error = QString("Cannot open %1: %2").arg(path, m_file.errorString());
+        return false;
+    }
+    const qint64 imageSize = m_file.size();
+    const size_t messageSize = sizeof(SAR_DataInfo) + static_cast<size_t>(imageSize);
+    const size_t packets = (messageSize + kPacketDataLength - 1) / kPacketDataLength;
+    if (packets > 0xFFFF) {
+        *error = QString("%1 is too large for one message (%2 bytes)").arg(path).arg(imageSize);
+        return false;
+    }
+
+    // 与 SarPacketizer::appendMessage 相同：修正消息长度后重新计算数据信息的校验和
+    m_dataInfo = dataInfo;
+    m_dataInfo.data_length = static_cast<uint32_t>(messageSize);
+    const uint8_t* info = reinterpret_cast<const uint8_t*>(&m_dataInfo);
+    m_dataInfo.checksum = calculate_checksum(info + 2, sizeof(SAR_DataInfo) - 2 - sizeof(uint8_t));
+
+    // 校验和要读一遍数据部分：只读映射，逐包累加后立即解除映射
+    const uint8_t* image = nullptr;
+    if (imageSize > 0) {
+        image = m_file.map(0, imageSize);
+        if (!image) {
+            *error = QString("Cannot map %1: %2").arg(path, m_file.errorString());
+            return false;
+        }
+    }
+    m_frames.assign(packets, SAR_Frame());
+    for (size_t i = 0; i < packets; ++i) {
+        const size_t offset = i * kPacketDataLength;
+        const size_t length = std::min(messageSize - offset, kPacketDataLength);
+        // 校验和逐字节累加取低 8 位，可以分段求和
+        size_t inInfo = 0;
+        uint8_t checksum = 0;
+        if (offset < sizeof(SAR_DataInfo)) {
+            inInfo = std::min(sizeof(SAR_DataInfo) - offset, length);
+            checksum = calculate_checksum(info + offset, inInfo);
+        }
+        if (inInfo < length) {
+            checksum += calculate_checksum(image + (offset + inInfo - sizeof(SAR_DataInfo)), length - inInfo);
+        }
+
+        SAR_Frame& frame = m_frames[i];
+        frame.fixed_value = kSarFrameMagic;
+        frame.image_number = imageNumber;
+        frame.image_size = static_cast<uint32_t>(imageSize);
+        frame.current_packet = static_cast<uint16_t>(i + 1);
+        frame.total_packets = static_cast<uint16_t>(packets);
+        frame.data_length = static_cast<uint16_t>(length);
+        frame.checksum = checksum;
+    }
+    if (image) {
+        m_file.unmap(const_cast<uchar*>(image));
+    }
+    m_totalBytes = packets * sizeof(SAR_Frame) + messageSize;
+    m_packet = 0;
+    m_packetSent = 0;
+    return true;
+}
+
+size_t SarFileSender::prefixSize(size_t index) const
+{
+    // 数据信息只有 170 字节，总在首包里
+    return sizeof(SAR_Frame) + (index == 0 ? sizeof(SAR_DataInfo) : 0);
+}
+
+qint64 SarFileSender::fileOffset(size_t index) const
+{
+    return index == 0 ? 0 : static_cast<qint64>(index * kPacketDataLength - sizeof(SAR_DataInfo));
+}
+
+qint64 SarFileSender::sendTo(int socketFd, qint64 maxBytes)
+{
+#ifdef Q_OS_LINUX
+    qint64 sent = 0;
+    while (!done() && sent < maxBytes) {
+        SAR_Frame& frame = m_frames[m_packet];
+        const size_t prefix = prefixSize(m_packet);
+        const size_t packetSize = sizeof(SAR_Frame) + frame.data_length;
+        ssize_t written;
+        if (m_packetSent < prefix) {
+            // 帧头与数据信息聚集写出，跳过上次已写出的部分
+            iovec iov[2];
+            int count = 0;
+            if (m_packetSent < sizeof(SAR_Frame)) {
+                iov[count].iov_base = reinterpret_cast<char*>(&frame) + m_packetSent;
+                iov[count].iov_len = sizeof(SAR_Frame) - m_packetSent;
+                ++count;
+            }
+            if (prefix > sizeof(SAR_Frame)) {
+                const size_t infoSent = m_packetSent > sizeof(SAR_Frame) ? m_packetSent - sizeof(SAR_Frame) : 0;
+                iov[count].iov_base = reinterpret_cast<char*>(&m_dataInfo) + infoSent;
+                iov[count].iov_len = sizeof(SAR_DataInfo) - infoSent;
+                ++count;
+            }
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            written = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+        } else {
+            off_t offset = static_cast<off_t>(fileOffset(m_packet) + static_cast<qint64>(m_packetSent - prefix));
+            written = ::sendfile(socketFd, m_file.handle(), &offset, packetSize - m_packetSent);
+            if (written == 0) {
+                // 文件比生成帧头时短，已经被改写
+                errno = EIO;
+                return -1;
+            }
+        }
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += written;
+        m_packetSent += static_cast<size_t>(written);
+        if (m_packetSent == packetSize) {
+            ++m_packet;
+            m_packetSent = 0;
+        }
+    }
+    return sent;
+#else
+    Q_UNUSED(socketFd);
+    Q_UNUSED(maxBytes);
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void SarFileSender::setCork(int socketFd, bool enabled)
+{
+#ifdef Q_OS_LINUX
+    const int value = enabled ? 1 : 0;
+    ::setsockopt(socketFd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+#else
+    Q_UNUSED(socketFd);
+    Q_UNUSED(enabled);
+#endif
+}
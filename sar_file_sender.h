@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <cstddef>
+#include <vector>
+#include "package_sar_data.h"
+
+/**
+ * @class SarFileSender
+ * @brief 磁盘上已编码图像的零拷贝发送：各包的 SAR_Frame 帧头（首包连同 SAR_DataInfo）预先生成，
+ * 图像数据留在文件里。发送时帧头用 sendmsg 聚集写出，紧随其后的数据部分用 sendfile 从页缓存直接送进套接字，
+ * 数据字节不经过用户态缓冲；整个传输期间套接字保持 TCP_CORK，帧头与数据拼成满长度的报文段。
+ * 生成帧头时需要对数据部分求校验和，为此只读映射文件一次，不做拷贝。
+ * 仅 Linux 支持，其他平台 supported() 为 false，调用方照常读入内存再打包。
+ */
+class SarFileSender {
+public:
+    static bool supported();
+
+    // 打开文件并生成全部帧头；文件须在发送结束前保持不变（归档与缓存文件都是写完后改名的）
+    bool open(const QString& path, const SAR_DataInfo& dataInfo, uint16_t imageNumber, QString* error);
+
+    size_t totalPackets() const { return m_frames.size(); }
+    // 含帧头的总字节数，与同一图像 SarPacketizer::getTotalBytes() 相同
+    size_t totalBytes() const { return m_totalBytes; }
+    size_t packetsSent() const { return m_packet; }
+    bool done() const { return m_packet >= m_frames.size(); }
+
+    // 在非阻塞套接字上写出，直到发完、发送缓冲已满或本次写满 maxBytes；
+    // 返回写出的字节数，出错时返回 -1 并保留 errno
+    qint64 sendTo(int socketFd, qint64 maxBytes);
+
+    // 整个传输期间攒满报文段再发出；结束时关闭，把最后不足一个报文段的数据推出去
+    static void setCork(int socketFd, bool enabled);
+
+private:
+    static constexpr size_t kPacketDataLength = 4096;
+
+    // 第 index 包在文件之外的前缀：帧头，首包还有 SAR_DataInfo
+    size_t prefixSize(size_t index) const;
+    qint64 fileOffset(size_t index) const;
+
+    QFile m_file;
+    SAR_DataInfo m_dataInfo = {};
+    std::vector<SAR_Frame> m_frames;
+    size_t m_totalBytes = 0;
+    size_t m_packet = 0;            // 正在发送的包
+    size_t m_packetSent = 0;        // 该包已写出的字节数
+};
@@ -0,0 +1,341 @@
+#include "sar_link.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include "image_transfer.h"
+#include "metrics.h"
+#include "package_sar_data.h"
+
+SarLink& SarLink::instance()
+{
+    static SarLink link;
+    return link;
+}
+
+SarLink::SarLink(QObject* parent)
+    : QObject(parent),
+    m_socket(new QTcpSocket(this)),
+    m_routePort(0),
+    m_routeEnabled(false),
+    m_port(0),
+    m_enabled(false),
+    m_pumping(false),
+    m_burstLeft(0),
+    m_reconnectTimer(new QTimer(this)),
+    m_backoffMs(kInitialBackoffMs),
+    m_connectedSnapshot(false),
+    m_controlSnapshot(0),
+    m_imagesSnapshot(0)
+{
+    connect(m_socket, &QTcpSocket::connected, this, &SarLink::onConnected);
+    connect(m_socket, &QTcpSocket::disconnected, this, &SarLink::onDisconnected);
+    connect(m_socket, &QTcpSocket::bytesWritten, this, &SarLink::onBytesWritten);
+    connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::errorOccurred),
+            this, &SarLink::onErrorOccurred);
+
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &SarLink::reconnect);
+
+    m_clock.start();
+}
+
+void SarLink::configure(const QString& ip, quint16 port, bool enabled)
+{
+    {
+        QMutexLocker locker(&m_routeMutex);
+        if (ip == m_routeIp && port == m_routePort && enabled == m_routeEnabled) {
+            return;
+        }
+        m_routeIp = ip;
+        m_routePort = port;
+        m_routeEnabled = enabled;
+    }
+    QMetaObject::invokeMethod(this, [this]() { applyRoute(); }, Qt::AutoConnection);
+}
+
+void SarLink::applyRoute()
+{
+    // 换地址或关闭时，旧链路上的传输以失败结束；先更新地址，结束时新挂入的传输直接走新链路
+    {
+        QMutexLocker locker(&m_routeMutex);
+        if (m_routeIp == m_ip && m_routePort == m_port && m_routeEnabled == m_enabled) {
+            return;
+        }
+        m_ip = m_routeIp;
+        m_port = m_routePort;
+        m_enabled = m_routeEnabled;
+    }
+    m_backoffMs = kInitialBackoffMs;
+    m_reconnectTimer->stop();
+    if (!m_enabled) {
+        m_control.clear();
+    }
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+    linkDown();
+    pump();
+}
+
+bool SarLink::carries(const QString& ip, quint16 port) const
+{
+    QMutexLocker locker(&m_routeMutex);
+    return m_routeEnabled && ip == m_routeIp && port == m_routePort;
+}
+
+bool SarLink::sendControl(const QByteArray& payload)
+{
+    const std::vector<uint8_t> frame = createSarControlFrame(reinterpret_cast<const uint8_t*>(payload.constData()),
+                                                             static_cast<size_t>(payload.size()));
+    if (frame.empty()) {
+        return false;
+    }
+    ControlFrame queued;
+    queued.frame = QByteArray(reinterpret_cast<const char*>(frame.data()), static_cast<int>(frame.size()));
+    queued.enqueuedNs = m_clock.nsecsElapsed();
+    // 从其他线程调用时排队到链路线程入队
+    QMetaObject::invokeMethod(this, [this, queued]() { enqueueControl(queued); }, Qt::AutoConnection);
+    return true;
+}
+
+void SarLink::enqueueControl(const ControlFrame& queued)
+{
+    m_control.enqueue(queued);
+    while (m_control.size() > kMaxQueuedControl) {
+        m_control.dequeue();
+        Metrics::instance().addCounter(MetricCounter::MessagesDropped);
+    }
+    pump();
+}
+
+void SarLink::attachImage(SarPacketTransferManager* manager)
+{
+    m_images.append(manager);
+    pump();
+}
+
+SarLink::Stats SarLink::stats() const
+{
+    return Stats{m_connectedSnapshot.load(std::memory_order_relaxed), m_controlSnapshot.load(std::memory_order_relaxed),
+                 m_imagesSnapshot.load(std::memory_order_relaxed)};
+}
+
+void SarLink::stop(QThread* target)
+{
+    m_reconnectTimer->stop();
+    m_control.clear();
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+    linkDown();
+    moveToThread(target);
+}
+
+bool SarLink::hasWork() const
+{
+    return !m_control.isEmpty() || !m_images.isEmpty();
+}
+
+void SarLink::ensureConnected()
+{
+    if (m_socket->state() != QAbstractSocket::UnconnectedState || m_reconnectTimer->isActive()) {
+        return;
+    }
+    m_socket->connectToHost(m_ip, m_port);
+}
+
+void SarLink::reconnect()
+{
+    if (!hasWork()) {
+        return;
+    }
+    Metrics::instance().addCounter(MetricCounter::LinkReconnects);
+    ensureConnected();
+}
+
+void SarLink::scheduleReconnect()
+{
+    if (!hasWork() || m_reconnectTimer->isActive()) {
+        return;
+    }
+    emit logMessage(QString("Shared link retrying in %1 ms, %2 control message(s) queued.")
+                        .arg(m_backoffMs).arg(m_control.size()));
+    m_reconnectTimer->start(m_backoffMs);
+    m_backoffMs = qMin(m_backoffMs * 2, kMaxBackoffMs);
+}
+
+void SarLink::onConnected()
+{
+    m_backoffMs = kInitialBackoffMs;
+    // 控制帧要立即发出；内核发送缓冲压小，排在控制帧前面的图像数据不超过几十 KB
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    m_socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, kSendBufferBytes);
+    emit logMessage("Shared link connected to " + m_ip + ":" + QString::number(m_port));
+    pump();
+}
+
+void SarLink::onDisconnected()
+{
+    linkDown();
+    scheduleReconnect();
+}
+
+void SarLink::onErrorOccurred(QAbstractSocket::SocketError socketError)
+{
+    emit logMessage("Shared link error: " + m_socket->errorString());
+    qWarning() << "Shared link error:" << m_socket->errorString() << "Error code:" << socketError;
+    Metrics::instance().recordError(MetricError::SocketError);
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        m_socket->abort();
+        linkDown();
+        scheduleReconnect();
+    }
+}
+
+void SarLink::onBytesWritten(qint64 bytes)
+{
+    // 套接字按写入顺序发出数据，依次归还给对应的传输
+    while (bytes > 0 && !m_segments.isEmpty()) {
+        Segment& head = m_segments.head();
+        const qint64 consumed = qMin(bytes, head.remaining);
+        head.remaining -= consumed;
+        bytes -= consumed;
+        SarPacketTransferManager* manager = head.manager;
+        const bool segmentDone = head.remaining == 0;
+        if (segmentDone) {
+            m_segments.dequeue();
+        }
+        if (manager) {
+            manager->accountBytesWritten(consumed);
+            if (segmentDone && manager->linkDrained()) {
+                removeImage(manager);
+                manager->finish(true);
+            }
+        }
+    }
+    pump();
+}
+
+void SarLink::pump()
+{
+    // 传输结束会经调度器挂入新的传输，重新进入 pump，防止递归
+    if (m_pumping || !m_enabled) {
+        return;
+    }
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        if (hasWork()) {
+            ensureConnected();
+        }
+        publishGauges();
+        return;
+    }
+
+    m_pumping = true;
+    for (;;) {
+        // 控制类不受水位限制，在每个数据包边界上先行写出
+        if (!writeControlFrames()) {
+            break;
+        }
+        if (m_socket->bytesToWrite() >= kWriteWatermark) {
+            break;
+        }
+        SarPacketTransferManager* manager = nextImage();
+        if (!manager) {
+            break;
+        }
+        const SarPacketView packet = manager->takeLinkPacket();
+        if (m_socket->write(reinterpret_cast<const char*>(packet.data), static_cast<qint64>(packet.size)) == -1) {
+            qWarning() << "Failed to write packet to shared link:" << m_socket->errorString();
+            Metrics::instance().recordError(MetricError::WriteFailed);
+            m_socket->abort();
+            break;
+        }
+        m_segments.enqueue(Segment{manager, static_cast<qint64>(packet.size)});
+    }
+    m_pumping = false;
+
+    // 写失败时 abort 不一定触发 disconnected，这里统一收尾
+    if (m_socket->state() == QAbstractSocket::UnconnectedState) {
+        linkDown();
+        scheduleReconnect();
+    }
+    publishGauges();
+}
+
+bool SarLink::writeControlFrames()
+{
+    if (m_control.isEmpty()) {
+        return true;
+    }
+    // 同一时刻排队的控制帧合并为一次写入
+    QByteArray batch;
+    for (const ControlFrame& queued : m_control) {
+        batch.append(queued.frame);
+    }
+    if (m_socket->write(batch) != batch.size()) {
+        qWarning() << "Failed to write control frames to shared link:" << m_socket->errorString();
+        Metrics::instance().recordError(MetricError::WriteFailed);
+        m_socket->abort();
+        return false;
+    }
+
+    const qint64 now = m_clock.nsecsElapsed();
+    const int count = m_control.size();
+    while (!m_control.isEmpty()) {
+        const ControlFrame queued = m_control.dequeue();
+        Metrics::instance().recordStage(PipelineStage::MessageSend, (now - queued.enqueuedNs) / 1000);
+    }
+    m_segments.enqueue(Segment{nullptr, static_cast<qint64>(batch.size())});
+    Metrics::instance().addCounter(MetricCounter::MessagesSent, static_cast<quint64>(count));
+    Metrics::instance().addCounter(MetricCounter::MessageBytesSent, static_cast<quint64>(batch.size()));
+    return true;
+}
+
+SarPacketTransferManager* SarLink::nextImage()
+{
+    // 加权轮询：队首用完本轮份额或已无数据包可取时转到队尾，下一个传输按自己的权重开始新的一轮；
+    // 最多检查一遍整个队列（队首先用剩余份额，其余各用完整份额）
+    if (m_images.isEmpty()) {
+        return nullptr;
+    }
+    for (int i = 0; i <= m_images.size(); ++i) {
+        SarPacketTransferManager* manager = m_images.first();
+        if (m_burstLeft > 0 && manager->hasLinkPacket()) {
+            --m_burstLeft;
+            return manager;
+        }
+        m_images.append(m_images.takeFirst());
+        m_burstLeft = m_images.first()->linkWeight();
+    }
+    return nullptr;
+}
+
+void SarLink::removeImage(SarPacketTransferManager* manager)
+{
+    // 队首被移除时剩余份额作废，新的队首从完整份额开始
+    if (!m_images.isEmpty() && m_images.first() == manager) {
+        m_burstLeft = 0;
+    }
+    m_images.removeOne(manager);
+}
+
+void SarLink::linkDown()
+{
+    // 已写入套接字的数据随连接一起丢失，挂着的传输全部失败；finished 可能挂入新的传输，先取出列表
+    m_segments.clear();
+    const QList<SarPacketTransferManager*> images = m_images;
+    m_images.clear();
+    m_burstLeft = 0;
+    for (SarPacketTransferManager* manager : images) {
+        manager->finish(false);
+    }
+    publishGauges();
+}
+
+void SarLink::publishGauges()
+{
+    m_connectedSnapshot.store(m_socket->state() == QAbstractSocket::ConnectedState, std::memory_order_relaxed);
+    m_controlSnapshot.store(m_control.size(), std::memory_order_relaxed);
+    m_imagesSnapshot.store(m_images.size(), std::memory_order_relaxed);
+    Metrics::instance().setGauge(MetricGauge::LinkControlQueue, m_control.size());
+    Metrics::instance().setGauge(MetricGauge::LinkActiveImages, m_images.size());
+}
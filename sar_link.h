@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QTcpSocket>
+#include <QTimer>
+#include <atomic>
+
+class SarPacketTransferManager;
+
+/**
+ * @class SarLink
+ * @brief 到接收端的复用链路：控制消息与图像数据包共用一条 TCP 连接，按流量类别分别排队。
+ * 控制类优先于图像类：每写出一个图像数据包之前先写出全部待发控制帧，控制消息只需等当前数据包写完。
+ * 图像类内部按加权轮询逐包交错：每个传输轮到时连续写出 linkWeight 个数据包再让给下一个，
+ * 数据包等长，因此各图像按权重分享带宽，小图像的完成时间取决于自身大小而不是排队位置。
+ * 用户态写缓冲与内核发送缓冲都只保留几个数据包，链路饱和时排在控制帧前面的图像数据也很少。
+ * 连接断开时挂在链路上的图像传输全部以失败结束，控制消息保留并按指数退避重连。
+ * 启用网络线程时链路运行在 NetworkThreads 的第 0 个线程上：configure、carries、sendControl、stats 可在任意线程调用，
+ * 其余只在链路所在的线程上使用。
+ */
+class SarLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        bool connected;
+        int controlQueued;      // 等待写出的控制消息数
+        int activeImages;       // 尚未发完的图像传输数
+    };
+
+    static SarLink& instance();
+
+    // enabled 为 false 时不接管任何流量，消息与图像各自建连；新路由立即对 carries 生效，重连在链路线程上进行
+    void configure(const QString& ip, quint16 port, bool enabled);
+    // 发往 ip:port 的流量是否走复用链路
+    bool carries(const QString& ip, quint16 port) const;
+
+    // 控制消息入队，超过 kSarControlPayloadMax 字节时返回 false
+    bool sendControl(const QByteArray& payload);
+    // 接管一个图像传输，由链路逐包取出写出；结束时由 manager 发出 finished。manager 须与链路在同一线程
+    void attachImage(SarPacketTransferManager* manager);
+
+    Stats stats() const;
+
+    // 在链路线程上调用：断开连接、挂着的传输以失败结束，然后移到 target 线程（NetworkThreads 停止时使用）
+    void stop(QThread* target);
+
+signals:
+    void logMessage(const QString& message);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onErrorOccurred(QAbstractSocket::SocketError socketError);
+    void onBytesWritten(qint64 bytes);
+    void reconnect();
+
+private:
+    struct ControlFrame {
+        QByteArray frame;       // 控制帧头 + 消息
+        qint64 enqueuedNs;
+    };
+    // 已写入套接字、尚未确认发出的一段数据，manager 为 nullptr 表示控制帧
+    struct Segment {
+        SarPacketTransferManager* manager;
+        qint64 remaining;
+    };
+
+    static const int kMaxQueuedControl = 1000;      // 超出时丢弃最早的控制消息
+    static const int kInitialBackoffMs = 250;
+    static const int kMaxBackoffMs = 30000;
+    static const qint64 kWriteWatermark = 2 * (21 + 4096);     // 用户态缓冲中最多压两个数据包
+    static const int kSendBufferBytes = 64 * 1024;              // 内核发送缓冲上限
+
+    explicit SarLink(QObject* parent = nullptr);
+    Q_DISABLE_COPY(SarLink)
+
+    void applyRoute();
+    void enqueueControl(const ControlFrame& queued);
+    bool hasWork() const;
+    void ensureConnected();
+    void scheduleReconnect();
+    void pump();
+    bool writeControlFrames();
+    SarPacketTransferManager* nextImage();
+    void removeImage(SarPacketTransferManager* manager);
+    void linkDown();
+    void publishGauges();
+
+    QTcpSocket* m_socket;
+    // configure 写入的路由，carries 在任意线程上读取；链路线程在 applyRoute 中取用
+    mutable QMutex m_routeMutex;
+    QString m_routeIp;
+    quint16 m_routePort;
+    bool m_routeEnabled;
+    // 链路线程当前使用的路由
+    QString m_ip;
+    quint16 m_port;
+    bool m_enabled;
+    bool m_pumping;
+    QQueue<ControlFrame> m_control;
+    QList<SarPacketTransferManager*> m_images;      // 轮询队列，队首为当前传输；发完并确认写出后移除
+    int m_burstLeft;                                // 队首传输本轮还可连续写出的数据包数
+    QQueue<Segment> m_segments;                     // 按写入顺序把 bytesWritten 归到各个传输
+    QTimer* m_reconnectTimer;
+    int m_backoffMs;
+    QElapsedTimer m_clock;
+    // stats() 的快照，由 publishGauges 更新
+    std::atomic<bool> m_connectedSnapshot;
+    std::atomic<int> m_controlSnapshot;
+    std::atomic<int> m_imagesSnapshot;
+};
@@ -0,0 +1,293 @@
+#include "sar_tiff.h"
+#include <QBuffer>
+#include <QFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// TIFF 标签
+const quint16 kTagWidth = 256;
+const quint16 kTagHeight = 257;
+const quint16 kTagBitsPerSample = 258;
+const quint16 kTagCompression = 259;
+const quint16 kTagStripOffsets = 273;
+const quint16 kTagSamplesPerPixel = 277;
+const quint16 kTagRowsPerStrip = 278;
+const quint16 kTagStripByteCounts = 279;
+const quint16 kTagPlanarConfig = 284;
+const quint16 kTagTileWidth = 322;
+const quint16 kTagSampleFormat = 339;
+
+// TIFF 字段类型
+const quint16 kTypeShort = 3;
+const quint16 kTypeLong = 4;
+
+// 像素数据上限，与图像解码的上限（image_codec 的 kMaxDecodedBytes）相同；尺寸来自文件头，不可信
+const quint64 kMaxPixelBytes = quint64(1) << 30;
+
+struct TiffLayout {
+    SarTiffInfo info;
+    int rowsPerStrip = 0;
+    std::vector<quint32> stripOffsets;
+    std::vector<quint32> stripByteCounts;
+    bool bigEndian = false;
+};
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+    return false;
+}
+
+class TiffParser {
+public:
+    TiffParser(QIODevice& file, bool bigEndian) : m_file(file), m_bigEndian(bigEndian) {}
+
+    quint16 u16(const uchar* p) const { return m_bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p); }
+    quint32 u32(const uchar* p) const { return m_bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p); }
+
+    // 读取 SHORT/LONG 数组字段，值可能内联在条目中，也可能在偏移处
+    bool readValues(const uchar* entry, std::vector<quint32>* values)
+    {
+        const quint16 type = u16(entry + 2);
+        const quint32 count = u32(entry + 4);
+        const int size = type == kTypeShort ? 2 : (type == kTypeLong ? 4 : 0);
+        if (size == 0 || count == 0 || count > (1u << 24)) {
+            return false;
+        }
+        QByteArray data;
+        if (count * size <= 4) {
+            data = QByteArray(reinterpret_cast<const char*>(entry + 8), 4);
+        } else {
+            if (!m_file.seek(u32(entry + 8))) {
+                return false;
+            }
+            data = m_file.read(count * size);
+            if (data.size() != static_cast<int>(count * size)) {
+                return false;
+            }
+        }
+        const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+        values->resize(count);
+        for (quint32 i = 0; i < count; ++i) {
+            (*values)[i] = size == 2 ? u16(p + i * 2) : u32(p + i * 4);
+        }
+        return true;
+    }
+
+private:
+    QIODevice& m_file;
+    bool m_bigEndian;
+};
+
+bool parseLayout(QIODevice& file, TiffLayout* layout, QString* errorMessage)
+{
+    uchar header[8];
+    if (file.read(reinterpret_cast<char*>(header), 8) != 8) {
+        return fail(errorMessage, "File too short for a TIFF header.");
+    }
+    if (header[0] == 'I' && header[1] == 'I') {
+        layout->bigEndian = false;
+    } else if (header[0] == 'M' && header[1] == 'M') {
+        layout->bigEndian = true;
+    } else {
+        return fail(errorMessage, "Not a TIFF file.");
+    }
+    TiffParser parser(file, layout->bigEndian);
+    if (parser.u16(header + 2) != 42) {
+        return fail(errorMessage, "Unsupported TIFF variant (BigTIFF?).");
+    }
+
+    if (!file.seek(parser.u32(header + 4))) {
+        return fail(errorMessage, "Invalid IFD offset.");
+    }
+    uchar countBytes[2];
+    if (file.read(reinterpret_cast<char*>(countBytes), 2) != 2) {
+        return fail(errorMessage, "Truncated IFD.");
+    }
+    const int entryCount = parser.u16(countBytes);
+    const QByteArray entries = file.read(entryCount * 12);
+    if (entries.size() != entryCount * 12) {
+        return fail(errorMessage, "Truncated IFD.");
+    }
+
+    int samplesPerPixel = 1;
+    int compression = 1;
+    int planar = 1;
+    int sampleFormat = 1;
+    for (int i = 0; i < entryCount; ++i) {
+        const uchar* entry = reinterpret_cast<const uchar*>(entries.constData()) + i * 12;
+        const quint16 tag = parser.u16(entry);
+        std::vector<quint32> values;
+        switch (tag) {
+        case kTagWidth:
+        case kTagHeight:
+        case kTagBitsPerSample:
+        case kTagCompression:
+        case kTagSamplesPerPixel:
+        case kTagRowsPerStrip:
+        case kTagPlanarConfig:
+        case kTagSampleFormat:
+            if (!parser.readValues(entry, &values)) {
+                return fail(errorMessage, QString("Invalid TIFF tag %1.").arg(tag));
+            }
+            break;
+        case kTagStripOffsets:
+            if (!parser.readValues(entry, &layout->stripOffsets)) {
+                return fail(errorMessage, "Invalid strip offsets.");
+            }
+            continue;
+        case kTagStripByteCounts:
+            if (!parser.readValues(entry, &layout->stripByteCounts)) {
+                return fail(errorMessage, "Invalid strip byte counts.");
+            }
+            continue;
+        case kTagTileWidth:
+            return fail(errorMessage, "Tiled TIFF is not supported.");
+        default:
+            continue;
+        }
+        const int value = static_cast<int>(values[0]);
+        switch (tag) {
+        case kTagWidth: layout->info.width = value; break;
+        case kTagHeight: layout->info.height = value; break;
+        case kTagBitsPerSample: layout->info.bitsPerSample = value; break;
+        case kTagCompression: compression = value; break;
+        case kTagSamplesPerPixel: samplesPerPixel = value; break;
+        case kTagRowsPerStrip: layout->rowsPerStrip = value; break;
+        case kTagPlanarConfig: planar = value; break;
+        case kTagSampleFormat: sampleFormat = value; break;
+        }
+    }
+
+    if (compression != 1) {
+        return fail(errorMessage, "Compressed TIFF is not supported.");
+    }
+    if (samplesPerPixel != 1 || planar != 1) {
+        return fail(errorMessage, "Only single-channel TIFF is supported.");
+    }
+    const int bits = layout->info.bitsPerSample;
+    if (bits != 8 && bits != 16 && bits != 32) {
+        return fail(errorMessage, QString("Unsupported bit depth %1.").arg(bits));
+    }
+    if (sampleFormat == 3 && bits != 32) {
+        return fail(errorMessage, "Only 32-bit float samples are supported.");
+    }
+    layout->info.sampleFormat = sampleFormat == 3 ? SarSampleFormat::Float
+                                : (sampleFormat == 2 ? SarSampleFormat::Int : SarSampleFormat::UInt);
+    if (layout->info.width <= 0 || layout->info.height <= 0) {
+        return fail(errorMessage, "Invalid image size.");
+    }
+    const quint64 pixelBytes = quint64(layout->info.width) * quint64(layout->info.height) * quint64(bits / 8);
+    if (pixelBytes > kMaxPixelBytes) {
+        return fail(errorMessage, QString("Image %1x%2 exceeds the size limit.").arg(layout->info.width).arg(layout->info.height));
+    }
+    if (layout->rowsPerStrip <= 0) {
+        layout->rowsPerStrip = layout->info.height;
+    }
+    if (layout->stripOffsets.empty() || layout->stripOffsets.size() != layout->stripByteCounts.size()) {
+        return fail(errorMessage, "Missing or inconsistent strips.");
+    }
+    // 分配像素缓冲之前确认条带足以覆盖整幅图像，且都在文件范围内（截断的文件在这里就被拒绝）
+    const quint64 fileSize = static_cast<quint64>(file.size());
+    quint64 stripTotal = 0;
+    for (size_t i = 0; i < layout->stripOffsets.size(); ++i) {
+        if (quint64(layout->stripOffsets[i]) + layout->stripByteCounts[i] > fileSize) {
+            return fail(errorMessage, QString("Strip %1 lies beyond the end of the file.").arg(i));
+        }
+        stripTotal += layout->stripByteCounts[i];
+    }
+    if (stripTotal < pixelBytes) {
+        return fail(errorMessage, "Strip byte counts do not cover the image size.");
+    }
+    return true;
+}
+
+bool probeDevice(QIODevice& file, SarTiffInfo* info, QString* errorMessage)
+{
+    TiffLayout layout;
+    if (!parseLayout(file, &layout, errorMessage)) {
+        return false;
+    }
+    *info = layout.info;
+    return true;
+}
+
+bool readDevice(QIODevice& file, SarTiffImage* image, QString* errorMessage)
+{
+    TiffLayout layout;
+    if (!parseLayout(file, &layout, errorMessage)) {
+        return false;
+    }
+
+    image->info = layout.info;
+    const size_t rowBytes = image->rowBytes();
+    const size_t totalBytes = rowBytes * static_cast<size_t>(layout.info.height);
+    image->pixels = BufferPool::instance().acquire(totalBytes);
+
+    // 条带依次拼接；最后一个条带可能不足 rowsPerStrip 行
+    size_t written = 0;
+    for (size_t i = 0; i < layout.stripOffsets.size() && written < totalBytes; ++i) {
+        const size_t stripBytes = std::min<size_t>(layout.stripByteCounts[i], totalBytes - written);
+        if (!file.seek(layout.stripOffsets[i])
+            || file.read(reinterpret_cast<char*>(image->pixels.data() + written), static_cast<qint64>(stripBytes))
+                   != static_cast<qint64>(stripBytes)) {
+            return fail(errorMessage, QString("Truncated strip %1.").arg(i));
+        }
+        written += stripBytes;
+    }
+    if (written != totalBytes) {
+        return fail(errorMessage, "Pixel data shorter than image size.");
+    }
+
+    // 转换为本机字节序
+    if (layout.bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN)) {
+        uint8_t* p = image->pixels.data();
+        const size_t bytes = image->bytesPerSample();
+        for (size_t offset = 0; bytes > 1 && offset < totalBytes; offset += bytes) {
+            std::reverse(p + offset, p + offset + bytes);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool probeSarTiff(const QString& path, SarTiffInfo* info, QString* errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(errorMessage, QString("Cannot open %1.").arg(path));
+    }
+    return probeDevice(file, info, errorMessage);
+}
+
+bool probeSarTiff(const QByteArray& fileData, SarTiffInfo* info, QString* errorMessage)
+{
+    QBuffer buffer;
+    buffer.setData(fileData);
+    buffer.open(QIODevice::ReadOnly);
+    return probeDevice(buffer, info, errorMessage);
+}
+
+bool readSarTiff(const QString& path, SarTiffImage* image, QString* errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(errorMessage, QString("Cannot open %1.").arg(path));
+    }
+    return readDevice(file, image, errorMessage);
+}
+
+bool readSarTiff(const QByteArray& fileData, SarTiffImage* image, QString* errorMessage)
+{
+    QBuffer buffer;
+    buffer.setData(fileData);
+    buffer.open(QIODevice::ReadOnly);
+    return readDevice(buffer, image, errorMessage);
+}
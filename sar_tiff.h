@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include "buffer_pool.h"
+
+// 单通道 SAR 幅度图像的样本格式
+enum class SarSampleFormat {
+    UInt,
+    Int,
+    Float
+};
+
+struct SarTiffInfo {
+    int width = 0;
+    int height = 0;
+    int bitsPerSample = 0;                          // 8 / 16 / 32
+    SarSampleFormat sampleFormat = SarSampleFormat::UInt;
+};
+
+/**
+ * @struct SarTiffImage
+ * @brief 解码后的单通道幅度数据，按行连续存放，已转换为本机字节序。
+ */
+struct SarTiffImage {
+    SarTiffInfo info;
+    PooledBuffer pixels;
+
+    size_t bytesPerSample() const { return static_cast<size_t>(info.bitsPerSample / 8); }
+    size_t rowBytes() const { return static_cast<size_t>(info.width) * bytesPerSample(); }
+    const uint8_t* row(int y) const { return pixels.data() + static_cast<size_t>(y) * rowBytes(); }
+};
+
+// 只解析 IFD，判断是否为本模块支持的格式：未压缩、单通道、按条带存储、8/16/32 位
+bool probeSarTiff(const QString& path, SarTiffInfo* info, QString* errorMessage = nullptr);
+// 读取全部像素
+bool readSarTiff(const QString& path, SarTiffImage* image, QString* errorMessage = nullptr);
+// 同上，解析已读入内存的整个文件（见 FileIngest）
+bool probeSarTiff(const QByteArray& fileData, SarTiffInfo* info, QString* errorMessage = nullptr);
+bool readSarTiff(const QByteArray& fileData, SarTiffImage* image, QString* errorMessage = nullptr);
@@ -0,0 +1,76 @@
+#include "tile_mosaic.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QImageReader>
+#include <cstring>
+#include "image_codec.h"
+
+bool SarTileMosaic::addTile(const SarReassembledMessage& message, QRect* updated)
+{
+    const SAR_DataInfo& info = message.data_info;
+    if (!message.data_info_valid || info.image_kind != SarImageTile
+        || info.tile_count == 0 || info.tile_index >= info.tile_count
+        || info.mosaic_cols == 0 || info.mosaic_rows == 0
+        || info.tile_x >= info.mosaic_cols || info.tile_y >= info.mosaic_rows) {
+        return false;
+    }
+
+    // 第一个到达的分块决定画布尺寸，后续分块必须与之一致；尺寸来自链路，分配前先检查上限
+    if (m_tileCount == 0) {
+        if (static_cast<quint64>(info.mosaic_cols) * info.mosaic_rows > kMaxMosaicPixels) {
+            qWarning() << "Mosaic" << info.mosaic_cols << "x" << info.mosaic_rows << "of image" << info.ref_image_number
+                       << "exceeds the size limit";
+            return false;
+        }
+        m_canvas = QImage(info.mosaic_cols, info.mosaic_rows, QImage::Format_Grayscale8);
+        if (m_canvas.isNull()) {
+            qWarning() << "Cannot allocate mosaic" << info.mosaic_cols << "x" << info.mosaic_rows;
+            return false;
+        }
+        m_canvas.fill(0);
+        m_received.assign(info.tile_count, false);
+        m_tileCount = info.tile_count;
+        m_imageNumber = info.ref_image_number;
+        m_level = info.pyramid_level;
+    } else if (info.tile_count != m_tileCount || info.ref_image_number != m_imageNumber || info.pyramid_level != m_level
+               || info.mosaic_cols != m_canvas.width() || info.mosaic_rows != m_canvas.height()) {
+        qWarning() << "Tile" << info.tile_index << "does not match mosaic of image" << m_imageNumber;
+        return false;
+    }
+    if (m_received[info.tile_index]) {
+        return true;
+    }
+
+    const ImageCodec* codec = imageCodecById(info.codec_id);
+    QByteArray fileData;
+    if (!codec || !codec->decode(QByteArray::fromRawData(reinterpret_cast<const char*>(message.image_data.data()),
+                                                         static_cast<int>(message.image_data.size())), &fileData)) {
+        return false;
+    }
+
+    // 先只读图像头，分块必须完整落在画布内，越界的分块不解码
+    QBuffer buffer(&fileData);
+    QImageReader reader(&buffer);
+    const QRect rect(QPoint(info.tile_x, info.tile_y), reader.size());
+    if (rect.isEmpty() || !m_canvas.rect().contains(rect)) {
+        qWarning() << "Tile" << info.tile_index << rect << "is outside mosaic" << m_canvas.size() << "of image" << m_imageNumber;
+        return false;
+    }
+    QImage tile = reader.read();
+    if (tile.isNull() || tile.size() != rect.size()) {
+        return false;
+    }
+    tile = tile.convertToFormat(QImage::Format_Grayscale8);
+
+    // 按行拷贝到画布上
+    for (int y = 0; y < rect.height(); ++y) {
+        memcpy(m_canvas.scanLine(rect.y() + y) + rect.x(), tile.constScanLine(y), static_cast<size_t>(rect.width()));
+    }
+
+    m_received[info.tile_index] = true;
+    ++m_receivedCount;
+    if (updated) {
+        *updated = rect;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QImage>
+#include <QRect>
+#include <cstdint>
+#include <vector>
+#include "package_sar_data.h"
+
+/**
+ * @class SarTileMosaic
+ * @brief 接收端的分块拼图：每收齐一个分块就解码并画到整幅画布上，不必等整幅图像收完。
+ * 分块之间互不依赖，丢包只会让所在分块缺失，其余分块照常显示。
+ */
+class SarTileMosaic {
+public:
+    // 加入一个分块消息（image_kind 为 SarImageTile）；成功时 updated 返回画布上刚更新的区域。
+    // 与已收分块的整幅尺寸或分块总数不一致、整幅尺寸超过上限、分块超出画布或解码失败时返回 false，
+    // 重复的分块直接忽略
+    bool addTile(const SarReassembledMessage& message, QRect* updated = nullptr);
+
+    bool isComplete() const { return m_tileCount > 0 && m_receivedCount == m_tileCount; }
+    int tilesReceived() const { return m_receivedCount; }
+    int tileCount() const { return m_tileCount; }
+    // 整幅图像编号（分块的 ref_image_number）
+    uint16_t imageNumber() const { return m_imageNumber; }
+    // 金字塔层级，推送的分块为 0
+    int level() const { return m_level; }
+    // 当前画布，尚未收到的分块为黑色
+    const QImage& image() const { return m_canvas; }
+
+private:
+    // 画布像素数上限（8 位灰度 1 GB），整幅尺寸来自链路，不可信
+    static constexpr quint64 kMaxMosaicPixels = quint64(1) << 30;
+
+    QImage m_canvas;
+    std::vector<bool> m_received;
+    int m_receivedCount = 0;
+    int m_tileCount = 0;
+    uint16_t m_imageNumber = 0;
+    int m_level = 0;
+};
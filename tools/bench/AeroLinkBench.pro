@@ -0,0 +1,16 @@
+# 微基准测试：aerolink_bench --output result.json
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = aerolink_bench
+
+include(../../aerolink_core.pri)
+
+INCLUDEPATH += $$PWD/../common
+
+SOURCES += \
+    bench_main.cpp \
+    ../common/synthetic_sar.cpp
+
+HEADERS += \
+    ../common/synthetic_sar.h
@@ -0,0 +1,354 @@
+/*
+ * AeroLink 微基准测试
+ * 用确定性的合成数据测量打包、校验和、AUX 读取、图像转换与各编码方式的耗时，结果输出为 JSON，便于跨提交对比。
+ *
+ *   aerolink_bench --output result.json --label $(git rev-parse --short HEAD)
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+#include "AuxFileReader.h"
+#include "dynamic_range.h"
+#include "image_codec.h"
+#include "image_utils.h"
+#include "package_sar_data.h"
+#include "sar_archive.h"
+#include "synthetic_sar.h"
+
+namespace {
+
+// 防止编译器把被测代码优化掉
+volatile uint64_t g_sink = 0;
+
+struct BenchContext {
+    QString filter;
+    qint64 minTimeMs = 500;
+    QJsonArray results;
+};
+
+/**
+ * @brief 运行一个基准项
+ * 先自动选择批量次数使单个样本不短于 1 ms，再重复采样直到累计时间超过 minTimeMs（至少 5 个样本）。
+ * @param bytesPerOp 每次操作处理的字节数，用于换算 MB/s；为 0 时不输出吞吐
+ */
+void runBenchmark(BenchContext& ctx, const QString& name, const QJsonObject& params,
+                  qint64 bytesPerOp, const std::function<void()>& op)
+{
+    if (!ctx.filter.isEmpty() && !name.contains(ctx.filter)) {
+        return;
+    }
+
+    op(); // 预热
+
+    qint64 batch = 1;
+    QElapsedTimer timer;
+    for (;;) {
+        timer.start();
+        for (qint64 i = 0; i < batch; ++i) {
+            op();
+        }
+        if (timer.nsecsElapsed() >= 1000000 || batch >= (qint64(1) << 24)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    std::vector<double> samples; // 每次操作的纳秒数
+    QElapsedTimer total;
+    total.start();
+    while (samples.size() < 5 || total.elapsed() < ctx.minTimeMs) {
+        timer.start();
+        for (qint64 i = 0; i < batch; ++i) {
+            op();
+        }
+        samples.push_back(static_cast<double>(timer.nsecsElapsed()) / batch);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double median = samples[samples.size() / 2];
+    double mean = 0.0;
+    for (double s : samples) {
+        mean += s;
+    }
+    mean /= samples.size();
+
+    QJsonObject result;
+    result["name"] = name;
+    result["params"] = params;
+    result["iterations"] = static_cast<qint64>(samples.size()) * batch;
+    result["ns_per_op_median"] = median;
+    result["ns_per_op_min"] = samples.front();
+    result["ns_per_op_mean"] = mean;
+    if (bytesPerOp > 0) {
+        result["bytes_per_op"] = bytesPerOp;
+        result["mb_per_s"] = bytesPerOp / median * 1e9 / (1024.0 * 1024.0);
+    }
+    ctx.results.append(result);
+
+    QTextStream(stderr) << QString("%1 %2 ns/op%3\n")
+                               .arg(name, -40)
+                               .arg(median, 14, 'f', 1)
+                               .arg(bytesPerOp > 0 ? QString("  %1 MB/s").arg(result["mb_per_s"].toDouble(), 0, 'f', 1) : QString());
+}
+
+// 被测函数内部的 qDebug 会干扰计时，只保留警告及以上级别
+void quietMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& msg)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        QTextStream(stderr) << msg << '\n';
+    }
+}
+
+std::vector<uint8_t> randomBytes(size_t size, quint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aerolink_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("AeroLink microbenchmarks");
+    parser.addHelpOption();
+    QCommandLineOption outputOption({"o", "output"}, "Write JSON results to <file> (default: stdout).", "file");
+    QCommandLineOption filterOption("filter", "Only run benchmarks whose name contains <text>.", "text");
+    QCommandLineOption minTimeOption("min-time-ms", "Minimum measuring time per benchmark.", "ms", "500");
+    QCommandLineOption seedOption("seed", "Seed for synthetic input.", "n", "42");
+    QCommandLineOption tiffSizeOption("tiff-size", "Synthetic TIFF width and height.", "pixels", "2048");
+    QCommandLineOption tiffBitsOption("tiff-bits", "Comma separated TIFF bit depths.", "list", "8,16");
+    QCommandLineOption pulsesOption("pulses", "pulse_num of the synthetic AUX file.", "n", "4096");
+    QCommandLineOption imageBytesOption("image-bytes", "Encoded image size fed to the packetizer.", "bytes", "1048576");
+    QCommandLineOption labelOption("label", "Free-form label stored in the JSON (e.g. commit id).", "text");
+    QCommandLineOption archiveFramesOption("archive-frames", "Records in the synthetic geo archive, 0 to skip.", "n", "1000000");
+    parser.addOptions({outputOption, filterOption, minTimeOption, seedOption, tiffSizeOption,
+                       tiffBitsOption, pulsesOption, imageBytesOption, labelOption, archiveFramesOption});
+    parser.process(app);
+    qInstallMessageHandler(quietMessageHandler);
+
+    BenchContext ctx;
+    ctx.filter = parser.value(filterOption);
+    ctx.minTimeMs = parser.value(minTimeOption).toLongLong();
+    const quint32 seed = parser.value(seedOption).toUInt();
+    const int tiffSize = parser.value(tiffSizeOption).toInt();
+    const int pulses = parser.value(pulsesOption).toInt();
+    const size_t imageBytes = parser.value(imageBytesOption).toULongLong();
+    const int archiveFrames = parser.value(archiveFramesOption).toInt();
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "Cannot create temporary directory.";
+        return 1;
+    }
+
+    // ---------- 校验和 ----------
+    for (size_t size : {size_t(4096), size_t(1) << 20}) {
+        std::vector<uint8_t> data = randomBytes(size, seed);
+        runBenchmark(ctx, QString("checksum/%1").arg(size), QJsonObject{{"bytes", qint64(size)}}, qint64(size), [&]() {
+            g_sink += calculate_checksum(data.data(), data.size());
+        });
+    }
+
+    // ---------- SAR_DataInfo 封装 ----------
+    const AuxHeader auxHeader = makeSyntheticAuxHeader(pulses, tiffSize, 16);
+    runBenchmark(ctx, "create_sar_data_info", QJsonObject{}, 0, [&]() {
+        SAR_DataInfo info = createSarDataInfo(auxHeader);
+        g_sink += info.checksum;
+    });
+
+    // ---------- 打包：构造全部数据包并按发送顺序取出 ----------
+    {
+        const std::vector<uint8_t> image = randomBytes(imageBytes, seed);
+        const SAR_DataInfo info = createSarDataInfo(auxHeader);
+        runBenchmark(ctx, QString("packetizer/%1").arg(imageBytes), QJsonObject{{"image_bytes", qint64(imageBytes)}},
+                     qint64(imageBytes), [&]() {
+            SarPacketizer packetizer(info, image, 1);
+            while (packetizer.hasNextPacket()) {
+                g_sink += packetizer.nextPacketView().size;
+            }
+        });
+    }
+
+    // ---------- 归档的覆盖范围查询 ----------
+    // 每秒收到一幅 0.05° 见方的图像，随机散布在 10°×10° 的区域内；图像数据只占位。建库较慢，被过滤掉时不建
+    if (archiveFrames > 0 && (ctx.filter.isEmpty() || ctx.filter.contains("archive"))) {
+        SarArchive archive;
+        if (!archive.open(tempDir.filePath("archive").toStdString())) {
+            qCritical() << "Cannot create the benchmark archive.";
+            return 1;
+        }
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> latDist(20.0, 30.0);
+        std::uniform_real_distribution<double> lngDist(100.0, 110.0);
+        const std::vector<uint8_t> image = randomBytes(64, seed);
+        const double span = 0.05 / kSarLatLngLsbDeg;
+        for (int i = 0; i < archiveFrames; ++i) {
+            SAR_DataInfo info = createSarDataInfo(auxHeader);
+            const int32_t lat = static_cast<int32_t>(latDist(rng) / kSarLatLngLsbDeg);
+            const int32_t lng = static_cast<int32_t>(lngDist(rng) / kSarLatLngLsbDeg);
+            info.top_left_lat = info.top_right_lat = lat + static_cast<int32_t>(span);
+            info.bottom_left_lat = info.bottom_right_lat = lat;
+            info.top_left_lng = info.bottom_left_lng = lng;
+            info.top_right_lng = info.bottom_right_lng = lng + static_cast<int32_t>(span);
+            archive.append(static_cast<uint16_t>(i), info, image.data(), image.size(), qint64(i) * 1000);
+        }
+        const qint64 endMs = qint64(archiveFrames) * 1000;
+        const QJsonObject params{{"frames", archiveFrames}};
+        runBenchmark(ctx, QString("archive_query/point_last_hour/%1").arg(archiveFrames), params, 0, [&]() {
+            g_sink += archive.queryPoint(latDist(rng), lngDist(rng), endMs - 3600 * 1000, endMs).size();
+        });
+        runBenchmark(ctx, QString("archive_query/point_all/%1").arg(archiveFrames), params, 0, [&]() {
+            g_sink += archive.queryPoint(latDist(rng), lngDist(rng), 0, endMs).size();
+        });
+        runBenchmark(ctx, QString("archive_query/box_1deg_last_day/%1").arg(archiveFrames), params, 0, [&]() {
+            const double lat = latDist(rng);
+            const double lng = lngDist(rng);
+            g_sink += archive.queryBox(lat, lng, lat + 1.0, lng + 1.0, endMs - 86400 * 1000, endMs).size();
+        });
+    }
+
+    // ---------- AUX 文件读取 ----------
+    {
+        const QString auxPath = tempDir.filePath("bench.dat");
+        QString error;
+        if (!writeSyntheticAux(auxPath, auxHeader, seed, &error)) {
+            qCritical() << error;
+            return 1;
+        }
+        const qint64 auxBytes = QFileInfo(auxPath).size();
+        runBenchmark(ctx, QString("aux_read/pulses=%1").arg(pulses), QJsonObject{{"pulse_num", pulses}, {"file_bytes", auxBytes}},
+                     auxBytes, [&]() {
+            AuxFileReader reader;
+            g_sink += reader.read(auxPath) ? 1 : 0;
+        });
+    }
+
+    // ---------- TIF 转 JPG ----------
+    for (const QString& bitsText : parser.value(tiffBitsOption).split(',', Qt::SkipEmptyParts)) {
+        SyntheticTiffParams tiff;
+        tiff.width = tiffSize;
+        tiff.height = tiffSize;
+        tiff.bitsPerSample = bitsText.toInt();
+        tiff.seed = seed;
+
+        const QString tifPath = tempDir.filePath(QString("bench_%1.tif").arg(tiff.bitsPerSample));
+        const QString jpgPath = tempDir.filePath(QString("jpg/bench_%1.jpg").arg(tiff.bitsPerSample));
+        QString error;
+        if (!writeSyntheticTiff(tifPath, tiff, &error)) {
+            qCritical() << error;
+            return 1;
+        }
+        const qint64 tifBytes = QFileInfo(tifPath).size();
+
+        // 高位深幅度的动态范围压缩（不含读文件与编码）
+        if (tiff.bitsPerSample > 8) {
+            SarTiffImage sarTiff;
+            if (readSarTiff(tifPath, &sarTiff, &error)) {
+                for (int threads : {1, 0}) {
+                    DrcParams drc;
+                    drc.threads = threads;
+                    runBenchmark(ctx, QString("dynamic_range/%1x%1/%2bit/threads=%3").arg(tiffSize).arg(tiff.bitsPerSample)
+                                          .arg(threads == 0 ? QThread::idealThreadCount() : threads),
+                                 QJsonObject{{"width", tiffSize}, {"height", tiffSize}, {"bits", tiff.bitsPerSample}},
+                                 tifBytes, [&]() {
+                        g_sink += compressDynamicRange(sarTiff, tiff.bitsPerSample, drc).width();
+                    });
+                }
+            }
+        }
+
+        // 各编码方式：压缩率与编码吞吐（按源 TIF 字节数计）
+        const TransferOptions codecOptions;
+        for (const QString& codecName : availableImageCodecs()) {
+            const ImageCodec* codec = imageCodecByName(codecName);
+            const QString codecBenchName = QString("codec_encode/%1/%2x%2/%3bit").arg(codecName).arg(tiffSize).arg(tiff.bitsPerSample);
+            const EncodeSource codecSource{tifPath, tiff.bitsPerSample};
+            QByteArray encoded;
+            if (!codec->encode(codecSource, codecOptions, &encoded) || encoded.isEmpty()) {
+                QJsonObject skipped;
+                skipped["name"] = codecBenchName;
+                skipped["skipped"] = "encode failed for this bit depth";
+                ctx.results.append(skipped);
+                continue;
+            }
+            runBenchmark(ctx, codecBenchName,
+                         QJsonObject{{"codec", codecName}, {"width", tiffSize}, {"height", tiffSize},
+                                     {"bits", tiff.bitsPerSample}, {"encoded_bytes", encoded.size()},
+                                     {"ratio", double(tifBytes) / encoded.size()}},
+                         tifBytes, [&]() {
+                QByteArray out;
+                g_sink += codec->encode(codecSource, codecOptions, &out) ? out.size() : 0;
+            });
+        }
+
+        const QString name = QString("convert_tiff_to_jpg/%1x%1/%2bit").arg(tiffSize).arg(tiff.bitsPerSample);
+        if (!convertTiffToJpg(tifPath, jpgPath)) {
+            // 部分平台的 TIFF 插件不支持该位深，记录下来而不是中断整个套件
+            QJsonObject skipped;
+            skipped["name"] = name;
+            skipped["skipped"] = "convertTiffToJpg failed for this bit depth";
+            ctx.results.append(skipped);
+            continue;
+        }
+        runBenchmark(ctx, name, QJsonObject{{"width", tiffSize}, {"height", tiffSize}, {"bits", tiff.bitsPerSample}},
+                     QFileInfo(tifPath).size(), [&]() {
+            g_sink += convertTiffToJpg(tifPath, jpgPath) ? 1 : 0;
+        });
+        runBenchmark(ctx, QString("encode_tiff_to_jpg/%1x%1/%2bit").arg(tiffSize).arg(tiff.bitsPerSample),
+                     QJsonObject{{"width", tiffSize}, {"height", tiffSize}, {"bits", tiff.bitsPerSample}},
+                     QFileInfo(tifPath).size(), [&]() {
+            QByteArray jpgData;
+            g_sink += encodeTiffToJpg(tifPath, jpgData) ? jpgData.size() : 0;
+        });
+    }
+
+    // ---------- 输出 ----------
+    QJsonObject meta;
+    meta["label"] = parser.value(labelOption);
+    meta["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    meta["qt_version"] = QString(qVersion());
+    meta["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    meta["os"] = QSysInfo::prettyProductName();
+    meta["threads"] = QThread::idealThreadCount();
+    meta["seed"] = static_cast<qint64>(seed);
+    meta["min_time_ms"] = ctx.minTimeMs;
+
+    QJsonObject root;
+    root["meta"] = meta;
+    root["results"] = ctx.results;
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QString error;
+        if (!writeBytesToFile(parser.value(outputOption), json, &error)) {
+            qCritical() << error;
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "synthetic_sar.h"
+#include <QDataStream>
+#include <QFile>
+#include <QIODevice>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace {
+
+// 与 createSarDataInfo 中经纬度的量化当量一致
+const double kLatLngLsb = 8.38191e-8;
+// 合成数据的参考航迹起点
+const double kBaseLat = 30.0;
+const double kBaseLng = 114.0;
+
+void appendU16(QByteArray& out, quint16 v)
+{
+    char b[2] = { char(v & 0xFF), char(v >> 8) };
+    out.append(b, 2);
+}
+
+void appendU32(QByteArray& out, quint32 v)
+{
+    char b[4] = { char(v & 0xFF), char((v >> 8) & 0xFF), char((v >> 16) & 0xFF), char(v >> 24) };
+    out.append(b, 4);
+}
+
+// TIFF IFD 条目：SHORT 与 LONG 在小端下都可以直接写成 32 位值
+void appendIfdEntry(QByteArray& out, quint16 tag, quint16 type, quint32 value)
+{
+    appendU16(out, tag);
+    appendU16(out, type);
+    appendU32(out, 1);
+    appendU32(out, value);
+}
+
+} // namespace
+
+QByteArray makeSyntheticTiff(const SyntheticTiffParams& params)
+{
+    const int bytesPerSample = params.bitsPerSample / 8;
+    const quint32 width = static_cast<quint32>(params.width);
+    const quint32 height = static_cast<quint32>(params.height);
+    const quint32 imageBytes = width * height * bytesPerSample;
+
+    const quint16 kShort = 3;
+    const quint16 kLong = 4;
+    const int entryCount = 10;
+    const quint32 ifdOffset = 8;
+    const quint32 dataOffset = ifdOffset + 2 + entryCount * 12 + 4;
+
+    QByteArray out;
+    out.reserve(static_cast<int>(dataOffset + imageBytes));
+
+    // 文件头：小端、魔数 42、首个 IFD 偏移
+    out.append("II", 2);
+    appendU16(out, 42);
+    appendU32(out, ifdOffset);
+
+    // IFD（标签必须升序）
+    appendU16(out, entryCount);
+    appendIfdEntry(out, 256, kLong, width);                       // ImageWidth
+    appendIfdEntry(out, 257, kLong, height);                      // ImageLength
+    appendIfdEntry(out, 258, kShort, params.bitsPerSample);       // BitsPerSample
+    appendIfdEntry(out, 259, kShort, 1);                          // Compression: none
+    appendIfdEntry(out, 262, kShort, 1);                          // Photometric: BlackIsZero
+    appendIfdEntry(out, 273, kLong, dataOffset);                  // StripOffsets
+    appendIfdEntry(out, 277, kShort, 1);                          // SamplesPerPixel
+    appendIfdEntry(out, 278, kLong, height);                      // RowsPerStrip
+    appendIfdEntry(out, 279, kLong, imageBytes);                  // StripByteCounts
+    appendIfdEntry(out, 339, kShort, params.floatSamples ? 3 : 1); // SampleFormat
+    appendU32(out, 0);                                            // 无下一个 IFD
+
+    // 像素：场景纹理（缓慢变化的反射率块）乘以瑞利分布的相干斑
+    out.resize(static_cast<int>(dataOffset + imageBytes));
+    uchar* pixels = reinterpret_cast<uchar*>(out.data()) + dataOffset;
+
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<double> uniform(1e-12, 1.0);
+    const double fullScale = params.floatSamples ? 1.0
+                             : (params.bitsPerSample >= 32 ? 4294967295.0 : std::ldexp(1.0, params.bitsPerSample) - 1.0);
+
+    for (quint32 y = 0; y < height; ++y) {
+        for (quint32 x = 0; x < width; ++x) {
+            double reflectivity = 0.15 + 0.1 * std::sin(x * 0.01) * std::cos(y * 0.013)
+                                  + (((x / 64) ^ (y / 64)) & 1 ? 0.05 : 0.0);
+            double amplitude = reflectivity * std::sqrt(-std::log(uniform(rng)));
+            // 少量强点目标，模拟 SAR 图像的高动态范围
+            if ((rng() & 0xFFF) == 0) {
+                amplitude *= 20.0;
+            }
+
+            const size_t index = (static_cast<size_t>(y) * width + x) * bytesPerSample;
+            if (params.floatSamples) {
+                float v = static_cast<float>(amplitude);
+                std::memcpy(pixels + index, &v, sizeof(v));
+                continue;
+            }
+            double scaled = std::min(fullScale, amplitude * fullScale * 0.25);
+            quint32 v = static_cast<quint32>(scaled);
+            for (int b = 0; b < bytesPerSample; ++b) {
+                pixels[index + b] = static_cast<uchar>((v >> (8 * b)) & 0xFF);
+            }
+        }
+    }
+    return out;
+}
+
+bool writeSyntheticTiff(const QString& path, const SyntheticTiffParams& params, QString* errorMessage)
+{
+    return writeBytesToFile(path, makeSyntheticTiff(params), errorMessage);
+}
+
+AuxHeader makeSyntheticAuxHeader(int rows, int cols, int ampBit, quint32 sequence)
+{
+    AuxHeader h = {};
+    // 雷达参数：X 波段、600 MHz 带宽
+    h.op_mode = 0;
+    h.pp_mode = 0;
+    h.Kr_sign = 1;
+    h.fc = 9.6e9;
+    h.fd = 0.0;
+    h.Br = 600e6;
+    h.Fsr = 720e6;
+    h.Tr = 20e-6;
+    h.theta_bw = 3.0 * M_PI / 180.0;
+    h.Ba = 300.0;
+    h.PRF = 2000.0;
+
+    // 图像参数
+    h.pulse_num = rows;
+    h.pulse_len = cols;
+    h.amp_bit = ampBit;
+    h.Xbin = 0.3;
+    h.Rbin = 0.3;
+
+    // 几何参数
+    h.geo_mode = 2;
+    h.look_mode = 1;
+    h.flag_flat = 1;
+    h.fdc_ref = 0.0;
+    h.fdc0 = 0.0;
+    h.fdc1 = 0.0;
+    h.fdc2 = 0.0;
+    h.v = 80.0;
+    h.Rmin = 5000.0;
+    h.Rref = 5000.0 + cols * h.Rbin / 2.0;
+    h.alt_scene = 50.0;
+    h.alt_path = 3000.0;
+    h.yaw_ref = 0.01;
+    h.pitch_ref = -0.02;
+    h.roll_ref = 0.005;
+
+    // 结构参数
+    h.yaw0 = 0.0;
+    h.pitch0 = 0.0;
+    h.roll0 = 0.0;
+    h.X_APC = 1.2;
+    h.Y_APC = 0.0;
+    h.Z_APC = 0.3;
+    h.X_APC_ref = 1.2;
+    h.Y_APC_ref = 0.0;
+    h.Z_APC_ref = 0.3;
+
+    // 地理参数：图像覆盖范围由行列数与像素间距推算
+    const double metersPerDegLat = 111320.0;
+    const double metersPerDegLng = metersPerDegLat * std::cos(kBaseLat * M_PI / 180.0);
+    const double along = rows * h.Xbin / metersPerDegLat;
+    const double across = cols * h.Rbin / metersPerDegLng;
+    const double nearLng = kBaseLng + h.Rmin / metersPerDegLng;
+
+    h.lng_Gauss = 114.0;
+    h.heading_ref = 0.0;
+    h.lat_s = kBaseLat + sequence * kLatLngLsb;
+    h.lng_s = kBaseLng;
+    h.lat_e = kBaseLat + along;
+    h.lng_e = kBaseLng;
+    h.lat11 = kBaseLat + along;
+    h.lng11 = nearLng;
+    h.lat1N = kBaseLat + along;
+    h.lng1N = nearLng + across;
+    h.latM1 = kBaseLat;
+    h.lngM1 = nearLng;
+    h.latMN = kBaseLat;
+    h.lngMN = nearLng + across;
+    h.IMG_TH = 0.0;
+    h.az_MLK_num = 1;
+    return h;
+}
+
+QByteArray makeSyntheticAux(const AuxHeader& h, quint32 seed)
+{
+    QByteArray out;
+    QDataStream stream(&out, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    // 字段顺序与 AuxFileReader::read 完全一致
+    stream << qint64(h.op_mode) << qint64(h.pp_mode) << qint64(h.Kr_sign);
+    stream << h.fc << h.fd << h.Br << h.Fsr << h.Tr;
+    stream << h.theta_bw << h.Ba << h.PRF << qint64(h.pulse_num);
+    stream << qint64(h.pulse_len) << qint64(h.amp_bit) << h.Xbin << h.Rbin;
+    stream << qint64(h.geo_mode) << qint64(h.look_mode) << qint64(h.flag_flat);
+    stream << h.fdc_ref << h.fdc0 << h.fdc1 << h.fdc2;
+    stream << h.v << h.Rmin << h.Rref << h.alt_scene;
+    stream << h.alt_path << h.yaw_ref << h.pitch_ref << h.roll_ref;
+    stream << h.yaw0 << h.pitch0 << h.roll0 << h.X_APC;
+    stream << h.Y_APC << h.Z_APC << h.X_APC_ref << h.Y_APC_ref;
+    stream << h.Z_APC_ref << h.lng_Gauss << h.heading_ref;
+    stream << h.lat_s << h.lng_s << h.lat_e << h.lng_e;
+    stream << h.lat11 << h.lng11 << h.lat1N << h.lng1N;
+    stream << h.latM1 << h.lngM1 << h.latMN << h.lngMN;
+    stream << h.IMG_TH << qint64(h.az_MLK_num);
+
+    // 运动数据：7 组参考航迹 + 10 组实测数据，每组 pulse_num 个点
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> jitter(0.0, 1e-3);
+    const int64_t n = h.pulse_num;
+    const double dt = 1.0 / h.PRF;
+    for (int group = 0; group < 17; ++group) {
+        for (int64_t i = 0; i < n; ++i) {
+            double t = i * dt;
+            double value;
+            switch (group % 7) {
+            case 0: value = t; break;                        // 时间
+            case 1: value = h.v * t; break;                  // 前向位移
+            case 2: value = 0.0; break;                      // 右向位移
+            case 3: value = -h.alt_path; break;              // 地向位移
+            case 4: value = kBaseLat + h.v * t / 111320.0; break;
+            case 5: value = kBaseLng; break;
+            default: value = h.alt_path; break;
+            }
+            // 实测数据带少量抖动
+            stream << (group >= 7 ? value + jitter(rng) : value);
+        }
+    }
+    return out;
+}
+
+bool writeSyntheticAux(const QString& path, const AuxHeader& header, quint32 seed, QString* errorMessage)
+{
+    return writeBytesToFile(path, makeSyntheticAux(header, seed), errorMessage);
+}
+
+quint32 syntheticSequenceFromNavLat(int32_t navLat)
+{
+    return static_cast<quint32>(navLat - static_cast<int32_t>(std::round(kBaseLat / kLatLngLsb)));
+}
+
+bool writeBytesToFile(const QString& path, const QByteArray& data, QString* errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (errorMessage) {
+            *errorMessage = QString("Cannot open %1: %2").arg(path, file.errorString());
+        }
+        return false;
+    }
+    if (file.write(data) != data.size()) {
+        if (errorMessage) {
+            *errorMessage = QString("Short write to %1: %2").arg(path, file.errorString());
+        }
+        return false;
+    }
+    return true;
+}
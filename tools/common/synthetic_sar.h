@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include "AuxFileReader.h"
+
+// ===================== 合成 SAR 测试数据 =====================
+// 基准测试与压测共用的确定性数据生成器：相同参数与种子总是生成逐字节相同的文件
+
+struct SyntheticTiffParams {
+    int width = 2048;          // 列数（距离点数）
+    int height = 2048;         // 行数（方位点数）
+    int bitsPerSample = 8;     // 8 / 16 / 32
+    bool floatSamples = false; // 32 位时是否写成 IEEE 浮点
+    quint32 seed = 42;
+};
+
+// 生成单条带、无压缩的灰度 TIFF（内容为瑞利分布的斑点噪声叠加场景纹理）
+QByteArray makeSyntheticTiff(const SyntheticTiffParams& params);
+bool writeSyntheticTiff(const QString& path, const SyntheticTiffParams& params, QString* errorMessage = nullptr);
+
+// 生成参数合理的 AUX 头；sequence 会写入 lat_s，使 createSarDataInfo 得到的 nav_lat 恰好等于该序号
+AuxHeader makeSyntheticAuxHeader(int rows, int cols, int ampBit, quint32 sequence = 0);
+
+// 按 AuxFileReader::read 的字段顺序序列化头信息，并附加 7*pulse_num + 10*pulse_num 个运动数据
+QByteArray makeSyntheticAux(const AuxHeader& header, quint32 seed = 42);
+bool writeSyntheticAux(const QString& path, const AuxHeader& header, quint32 seed = 42, QString* errorMessage = nullptr);
+
+// 从 nav_lat 还原 makeSyntheticAuxHeader 写入的序号
+quint32 syntheticSequenceFromNavLat(int32_t navLat);
+
+// 写文件的小工具
+bool writeBytesToFile(const QString& path, const QByteArray& data, QString* errorMessage = nullptr);
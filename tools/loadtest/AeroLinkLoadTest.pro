@@ -0,0 +1,23 @@
+# 端到端回环压测：aerolink_loadtest --ramp --output loadtest.json
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = aerolink_loadtest
+
+include(../../aerolink_core.pri)
+
+INCLUDEPATH += $$PWD/../common
+
+SOURCES += \
+    loadtest_main.cpp \
+    loadtest_runner.cpp \
+    loopback_receiver.cpp \
+    sar_producer.cpp \
+    ../common/synthetic_sar.cpp
+
+HEADERS += \
+    loadtest_clock.h \
+    loadtest_runner.h \
+    loopback_receiver.h \
+    sar_producer.h \
+    ../common/synthetic_sar.h
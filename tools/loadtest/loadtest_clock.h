@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QElapsedTimer>
+
+// 压测各线程共用的单调时钟，保证生产端与接收端的时间戳可以直接相减
+inline qint64 loadTestNowNs()
+{
+    static const QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed();
+}
@@ -0,0 +1,97 @@
+/*
+ * AeroLink 端到端回环压测
+ * 合成生产者按速率写入 .tif/.dat -> 真实的 FileMonitor + processAndTransferImage -> 本机接收端重组。
+ *
+ *   aerolink_loadtest --rate 0.5 --ramp --size 2048 --output loadtest.json
+ *   aerolink_loadtest --roi --size 2048    # 另外核对感兴趣区域拉取的应答
+ *   aerolink_loadtest --capture-dir cap/   # 另外核对最后一条消息能从抓包原样还原
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QImageReader>
+#include <QDebug>
+#include "image_codec.h"
+#include "loadtest_runner.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aerolink_loadtest");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("AeroLink end-to-end loopback load test");
+    parser.addHelpOption();
+    QCommandLineOption rateOption("rate", "Images per second (first step when ramping).", "n", "1");
+    QCommandLineOption stepOption("step-seconds", "Duration of each step.", "s", "10");
+    QCommandLineOption rampOption("ramp", "Increase the rate step by step to find the maximum sustainable rate.");
+    QCommandLineOption factorOption("ramp-factor", "Rate multiplier between steps.", "x", "1.25");
+    QCommandLineOption maxStepsOption("max-steps", "Maximum number of ramp steps.", "n", "12");
+    QCommandLineOption sizeOption("size", "Synthetic image width and height.", "pixels", "2048");
+    QCommandLineOption bitsOption("bits", "Synthetic TIFF bit depth (8/16/32).", "n", "8");
+    QCommandLineOption variantsOption("variants", "Number of distinct image contents.", "n", "4");
+    QCommandLineOption auxAfterOption("aux-after-tif", "Land the .dat after the .tif to exercise the AUX retry path.");
+    QCommandLineOption sloOption("slo-ms", "p99 end-to-end latency limit for a sustainable step.", "ms", "5000");
+    QCommandLineOption deliveryOption("min-delivery", "Minimum delivered ratio for a sustainable step.", "ratio", "0.99");
+    QCommandLineOption drainOption("drain-ms", "How long to wait for stragglers after each step.", "ms", "30000");
+    QCommandLineOption workDirOption("workdir", "Monitored folder (default: temporary directory).", "path");
+    QCommandLineOption keepOption("keep-files", "Keep generated files after each step.");
+    QCommandLineOption noArchiveOption("no-jpg-archive", "Do not archive encoded images to disk.");
+    QCommandLineOption codecOption("codec", "Image codec: jpeg, lz4, zstd or png16.", "name", "jpeg");
+    QCommandLineOption tileSizeOption("tile-size", "Send JPEG images as tiles of this size, 0 to disable.", "pixels", "0");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to <file> (default: stdout).", "file");
+    QCommandLineOption seedOption("seed", "Seed for synthetic input.", "n", "42");
+    QCommandLineOption archiveDirOption("archive-dir", "Store received images in a geo-indexed archive in <dir>.", "dir");
+    QCommandLineOption roiOption("roi", "Build ROI pyramids and, after the first step, request tiles of the last "
+                                        "received image and check them against the pyramid.");
+    QCommandLineOption captureDirOption("capture-dir", "Record sent packets in <dir> and check that the last received "
+                                                       "message can be rebuilt byte for byte from the capture.", "dir");
+    parser.addOptions({rateOption, stepOption, rampOption, factorOption, maxStepsOption, sizeOption, bitsOption,
+                       variantsOption, auxAfterOption, sloOption, deliveryOption, drainOption, workDirOption,
+                       keepOption, noArchiveOption, codecOption, tileSizeOption, outputOption, seedOption,
+                       archiveDirOption, roiOption, captureDirOption});
+    parser.process(app);
+
+    LoadTestOptions options;
+    options.rate = parser.value(rateOption).toDouble();
+    options.stepSeconds = parser.value(stepOption).toDouble();
+    options.ramp = parser.isSet(rampOption);
+    options.rampFactor = parser.value(factorOption).toDouble();
+    options.maxSteps = parser.value(maxStepsOption).toInt();
+    options.tiff.width = parser.value(sizeOption).toInt();
+    options.tiff.height = options.tiff.width;
+    options.tiff.bitsPerSample = parser.value(bitsOption).toInt();
+    options.tiff.floatSamples = options.tiff.bitsPerSample == 32;
+    options.tiff.seed = parser.value(seedOption).toUInt();
+    options.variants = parser.value(variantsOption).toInt();
+    options.auxAfterTif = parser.isSet(auxAfterOption);
+    options.sloMs = parser.value(sloOption).toDouble();
+    options.minDeliveryRatio = parser.value(deliveryOption).toDouble();
+    options.drainMs = parser.value(drainOption).toLongLong();
+    options.workDir = parser.value(workDirOption);
+    options.keepFiles = parser.isSet(keepOption);
+    options.transfer.archiveJpg = !parser.isSet(noArchiveOption);
+    options.transfer.codec = parser.value(codecOption).toLower();
+    if (!imageCodecByName(options.transfer.codec)) {
+        qCritical() << "Codec" << options.transfer.codec << "is not available, choose one of" << availableImageCodecs();
+        return 1;
+    }
+    options.transfer.tileSize = parser.value(tileSizeOption).toInt();
+    options.outputPath = parser.value(outputOption);
+    options.archiveDir = parser.value(archiveDirOption);
+    options.roi = parser.isSet(roiOption);
+    options.captureDir = parser.value(captureDirOption);
+
+    if (options.rate <= 0.0 || options.tiff.width <= 0 || options.transfer.tileSize < 0
+        || (options.tiff.bitsPerSample != 8 && options.tiff.bitsPerSample != 16 && options.tiff.bitsPerSample != 32)) {
+        parser.showHelp(1);
+    }
+
+    QImageReader::setAllocationLimit(1024);
+
+    LoadTestRunner runner(options);
+    QObject::connect(&runner, &LoadTestRunner::finished, &app, [&app](int code) {
+        app.exit(code);
+    }, Qt::QueuedConnection);
+    runner.start();
+    return app.exec();
+}
@@ -0,0 +1,542 @@
+#include "loadtest_runner.h"
+#include <QDateTime>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QDebug>
+#include <cmath>
+#include "image_transfer.h"
+#include "image_utils.h"
+#include "loadtest_clock.h"
+#include "loopback_receiver.h"
+#include "packet_capture.h"
+#include "roi_pyramid.h"
+#include "roi_server.h"
+#include "sar_producer.h"
+
+namespace {
+// 感兴趣区域核对等待应答的最长时间
+const int kRoiCheckTimeoutMs = 10000;
+// 压测抓包的分段大小
+const qint64 kCaptureSegmentBytes = qint64(256) << 20;
+}
+
+LoadTestRunner::LoadTestRunner(const LoadTestOptions& options, QObject* parent)
+    : QObject(parent),
+    m_options(options),
+    m_receiver(new LoopbackReceiver),
+    m_producer(new SyntheticSarProducer(options.tiff, options.variants, options.auxAfterTif)),
+    m_monitor(new FileMonitor(this)),
+    m_port(0),
+    m_drainTimer(new QTimer(this)),
+    m_subDirTimeout(new QTimer(this)),
+    m_stepIndex(0),
+    m_stepProducing(false),
+    m_stepProductionDone(false),
+    m_stepStartNs(0),
+    m_lastReceiveNs(0),
+    m_drainStartNs(0),
+    m_produced(0),
+    m_received(0),
+    m_invalid(0),
+    m_maxSustainableRate(0.0),
+    m_roiServer(new RoiServer(this)),
+    m_roiTimeout(new QTimer(this)),
+    m_roiChecked(false),
+    m_roiWaiting(false),
+    m_roiFailed(false),
+    m_lastImageNumber(0),
+    m_roiImageNumber(0),
+    m_roiRequested(0),
+    m_roiMatched(0),
+    m_roiMismatched(0),
+    m_lastMessageNumber(0)
+{
+    // 接收端与生产者各占一个线程，发送流水线留在主线程，与 GUI/守护进程一致
+    m_receiver->setArchiveDir(options.archiveDir);
+    m_receiver->setReportMessages(!options.captureDir.isEmpty());
+    m_receiver->moveToThread(&m_receiverThread);
+    connect(&m_receiverThread, &QThread::finished, m_receiver, &QObject::deleteLater);
+    connect(m_receiver, &LoopbackReceiver::listening, this, &LoadTestRunner::onReceiverListening);
+    connect(m_receiver, &LoopbackReceiver::listenFailed, this, &LoadTestRunner::onReceiverFailed);
+    connect(m_receiver, &LoopbackReceiver::frameReceived, this, &LoadTestRunner::onFrameReceived);
+    connect(m_receiver, &LoopbackReceiver::imageNumberReceived, this, &LoadTestRunner::onImageNumberReceived);
+    connect(m_receiver, &LoopbackReceiver::messageReceived, this, &LoadTestRunner::onMessageReceived);
+    connect(m_receiver, &LoopbackReceiver::roiTileReceived, this, &LoadTestRunner::onRoiTileReceived);
+    connect(m_receiver, &LoopbackReceiver::roiFailed, this, &LoadTestRunner::onRoiFailed);
+
+    m_producer->moveToThread(&m_producerThread);
+    connect(&m_producerThread, &QThread::finished, m_producer, &QObject::deleteLater);
+    connect(m_producer, &SyntheticSarProducer::imageProduced, this, &LoadTestRunner::onImageProduced);
+    connect(m_producer, &SyntheticSarProducer::stepFinished, this, &LoadTestRunner::onStepProduced);
+
+    connect(m_monitor, &FileMonitor::newTifFileDetected, this, &LoadTestRunner::processAndTransferFile);
+    connect(m_monitor, &FileMonitor::subDirChanged, this, &LoadTestRunner::onSubDirChanged);
+
+    m_drainTimer->setInterval(100);
+    connect(m_drainTimer, &QTimer::timeout, this, &LoadTestRunner::checkDrain);
+
+    // FileMonitor 没有报告新子文件夹时的兜底
+    m_subDirTimeout->setSingleShot(true);
+    m_subDirTimeout->setInterval(2000);
+    connect(m_subDirTimeout, &QTimer::timeout, this, &LoadTestRunner::startProducing);
+
+    m_roiTimeout->setSingleShot(true);
+    m_roiTimeout->setInterval(kRoiCheckTimeoutMs);
+    connect(m_roiTimeout, &QTimer::timeout, this, &LoadTestRunner::finishRoiCheck);
+}
+
+LoadTestRunner::~LoadTestRunner()
+{
+    m_monitor->stop();
+    m_producerThread.quit();
+    m_receiverThread.quit();
+    m_producerThread.wait();
+    m_receiverThread.wait();
+}
+
+void LoadTestRunner::start()
+{
+    if (m_options.workDir.isEmpty()) {
+        m_tempDir = std::make_unique<QTemporaryDir>();
+        if (!m_tempDir->isValid()) {
+            qCritical() << "Cannot create temporary work directory.";
+            emit finished(1);
+            return;
+        }
+        m_rootDir = m_tempDir->path();
+    } else {
+        m_rootDir = m_options.workDir;
+        QDir().mkpath(m_rootDir);
+    }
+
+    // 抓包开启时发送端不走零拷贝，压测结果与不抓包时不可直接比较
+    if (!m_options.captureDir.isEmpty() && !PacketCapture::instance().open(m_options.captureDir, kCaptureSegmentBytes)) {
+        qCritical() << "Cannot open packet capture in" << m_options.captureDir;
+        emit finished(1);
+        return;
+    }
+    if (m_options.roi) {
+        // 金字塔参数与发送端默认配置一致；拉取服务只接受本机接收端的连接
+        const AppConfig defaults;
+        PyramidStore::instance().configure(defaults.roiTileSize, defaults.roiQuality, defaults.roiKeepImages);
+        if (!m_roiServer->start(0, QHostAddress::LocalHost, QHostAddress::LocalHost)) {
+            emit finished(1);
+            return;
+        }
+    }
+
+    m_receiverThread.start();
+    m_producerThread.start();
+    QMetaObject::invokeMethod(m_receiver, "listen", Qt::QueuedConnection, Q_ARG(quint16, 0));
+}
+
+void LoadTestRunner::onReceiverListening(quint16 port)
+{
+    m_port = port;
+    qDebug() << "Loopback receiver listening on port" << port << ", work dir" << m_rootDir;
+
+    m_monitor->setMainFolder(m_rootDir);
+    m_monitor->start();
+    beginStep();
+}
+
+void LoadTestRunner::onReceiverFailed(const QString& error)
+{
+    qCritical() << "Receiver failed to listen:" << error;
+    emit finished(1);
+}
+
+double LoadTestRunner::currentRate() const
+{
+    return m_options.rate * std::pow(m_options.rampFactor, m_stepIndex);
+}
+
+void LoadTestRunner::beginStep()
+{
+    m_produced = 0;
+    m_received = 0;
+    m_invalid = 0;
+    m_lastReceiveNs = 0;
+    m_stepProducing = false;
+    m_stepProductionDone = false;
+    m_producedAt.clear();
+    m_receivedEarly.clear();
+    m_latency = std::make_unique<LatencyHistogram>();
+
+    // 与雷达一样，每档写入一个新的带日期的子文件夹
+    const QString name = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz");
+    m_stepDir = QDir::cleanPath(QDir(m_rootDir).filePath(name));
+    QDir().mkpath(m_stepDir);
+    m_subDirTimeout->start();
+}
+
+void LoadTestRunner::onSubDirChanged(const QString& subDir)
+{
+    if (!m_stepProducing && QDir::cleanPath(subDir) == m_stepDir) {
+        m_subDirTimeout->stop();
+        startProducing();
+    }
+}
+
+void LoadTestRunner::startProducing()
+{
+    if (m_stepProducing) {
+        return;
+    }
+    m_stepProducing = true;
+    const double rate = currentRate();
+    const int count = qMax(1, static_cast<int>(std::lround(rate * m_options.stepSeconds)));
+    qDebug().noquote() << QString("Step %1: %2 images at %3 images/s").arg(m_stepIndex + 1).arg(count).arg(rate, 0, 'f', 2);
+
+    m_stepStartNs = loadTestNowNs();
+    QMetaObject::invokeMethod(m_producer, "startStep", Qt::QueuedConnection,
+                              Q_ARG(QString, m_stepDir), Q_ARG(double, rate), Q_ARG(int, count));
+}
+
+void LoadTestRunner::processAndTransferFile(const QString& filePath)
+{
+    processAndTransferImage(filePath, "127.0.0.1", m_port, m_options.transfer);
+}
+
+void LoadTestRunner::recordLatency(qint64 producedNs, qint64 receivedNs)
+{
+    m_latency->record((receivedNs - producedNs) / 1000);
+}
+
+void LoadTestRunner::onImageProduced(quint32 sequence, qint64 timestampNs)
+{
+    ++m_produced;
+    auto early = m_receivedEarly.find(sequence);
+    if (early != m_receivedEarly.end()) {
+        recordLatency(timestampNs, early.value());
+        m_receivedEarly.erase(early);
+        return;
+    }
+    m_producedAt.insert(sequence, timestampNs);
+}
+
+void LoadTestRunner::onFrameReceived(quint32 sequence, qint64 timestampNs, qint64 imageBytes, bool valid)
+{
+    Q_UNUSED(imageBytes);
+    if (!valid) {
+        ++m_invalid;
+        return;
+    }
+    ++m_received;
+    m_lastReceiveNs = timestampNs;
+    auto produced = m_producedAt.find(sequence);
+    if (produced == m_producedAt.end()) {
+        m_receivedEarly.insert(sequence, timestampNs);
+        return;
+    }
+    recordLatency(produced.value(), timestampNs);
+    m_producedAt.erase(produced);
+}
+
+void LoadTestRunner::onImageNumberReceived(quint16 imageNumber)
+{
+    m_lastImageNumber = imageNumber;
+}
+
+void LoadTestRunner::onMessageReceived(quint16 imageNumber, QByteArray bytes)
+{
+    m_lastMessageNumber = imageNumber;
+    m_lastMessage = bytes;
+}
+
+void LoadTestRunner::onStepProduced(int produced)
+{
+    Q_UNUSED(produced);
+    m_stepProductionDone = true;
+    m_drainStartNs = loadTestNowNs();
+    m_drainTimer->start();
+}
+
+void LoadTestRunner::checkDrain()
+{
+    const bool allReceived = m_producedAt.isEmpty() && m_receivedEarly.isEmpty();
+    const bool timedOut = (loadTestNowNs() - m_drainStartNs) / 1000000 >= m_options.drainMs;
+    if (m_stepProductionDone && (allReceived || timedOut)) {
+        m_drainTimer->stop();
+        finishStep();
+    }
+}
+
+void LoadTestRunner::finishStep()
+{
+    const double rate = currentRate();
+    const int lost = m_producedAt.size();
+    const double deliveryRatio = m_produced > 0 ? static_cast<double>(m_received) / m_produced : 0.0;
+    const double activeSeconds = m_lastReceiveNs > m_stepStartNs ? (m_lastReceiveNs - m_stepStartNs) / 1e9 : 0.0;
+    const double achievedRate = activeSeconds > 0 ? m_received / activeSeconds : 0.0;
+    const double p99Ms = m_latency->percentile(99) / 1000.0;
+    const bool sustainable = deliveryRatio >= m_options.minDeliveryRatio && p99Ms <= m_options.sloMs;
+
+    QJsonObject latency;
+    latency["p50"] = m_latency->percentile(50) / 1000.0;
+    latency["p90"] = m_latency->percentile(90) / 1000.0;
+    latency["p99"] = p99Ms;
+    latency["p99_9"] = m_latency->percentile(99.9) / 1000.0;
+    latency["max"] = m_latency->maxMicros() / 1000.0;
+    latency["mean"] = m_latency->count() > 0 ? m_latency->sumMicros() / 1000.0 / m_latency->count() : 0.0;
+
+    QJsonObject step;
+    step["offered_rate"] = rate;
+    step["achieved_rate"] = achievedRate;
+    step["produced"] = m_produced;
+    step["received"] = m_received;
+    step["invalid"] = m_invalid;
+    step["lost"] = lost;
+    step["latency_ms"] = latency;
+    step["sustainable"] = sustainable;
+    m_steps.append(step);
+
+    qDebug().noquote() << QString("Step %1: offered %2/s achieved %3/s received %4/%5 p50 %6 ms p99 %7 ms -> %8")
+                              .arg(m_stepIndex + 1)
+                              .arg(rate, 0, 'f', 2)
+                              .arg(achievedRate, 0, 'f', 2)
+                              .arg(m_received)
+                              .arg(m_produced)
+                              .arg(latency["p50"].toDouble(), 0, 'f', 1)
+                              .arg(p99Ms, 0, 'f', 1)
+                              .arg(sustainable ? "sustainable" : "NOT sustainable");
+
+    if (sustainable) {
+        m_maxSustainableRate = qMax(m_maxSustainableRate, rate);
+    }
+    // 金字塔在后台读取本档的 .tif，删除文件前先等它们建完
+    if (m_options.roi) {
+        PyramidStore::instance().waitForBuilds(static_cast<int>(m_options.drainMs));
+    }
+    if (!m_options.keepFiles) {
+        waitForArchiveWrites();
+        QDir(m_stepDir).removeRecursively();
+    }
+
+    // 感兴趣区域只在第一档结束后核对一次，核对完成后由 finishRoiCheck 继续
+    if (m_options.roi && !m_roiChecked) {
+        startRoiCheck();
+        return;
+    }
+    advanceStep();
+}
+
+void LoadTestRunner::advanceStep()
+{
+    const bool sustainable = m_steps.last().toObject().value("sustainable").toBool();
+    ++m_stepIndex;
+    if (m_options.ramp && sustainable && m_stepIndex < m_options.maxSteps) {
+        beginStep();
+        return;
+    }
+    report();
+}
+
+void LoadTestRunner::startRoiCheck()
+{
+    m_roiChecked = true;
+    m_roiWaiting = true;
+    m_roiExpected.clear();
+    m_roiRequested = 0;
+    m_roiMatched = 0;
+    m_roiMismatched = 0;
+    m_roiImageNumber = m_lastImageNumber;
+    m_roiTimeout->start();
+
+    // 像地面接收端一样：先要整幅的粗略层（只有一层时退回第 0 层），再要全分辨率层中的一小块
+    if (m_roiImageNumber != 0) {
+        if (expectRoiTiles(1, 0, 0, 0xFFFF, 0xFFFF)) {
+            expectRoiTiles(0, 1, 1, 2, 2);
+        } else {
+            expectRoiTiles(0, 0, 0, 0xFFFF, 0xFFFF);
+        }
+    }
+    if (m_roiExpected.isEmpty()) {
+        qCritical() << "ROI check: no pyramid for the last received image" << m_roiImageNumber;
+        finishRoiCheck();
+    }
+}
+
+bool LoadTestRunner::expectRoiTiles(int level, int col0, int row0, int col1, int row1)
+{
+    QVector<PyramidTile> tiles;
+    ImagePyramid::Level levelInfo;
+    if (!PyramidStore::instance().tiles(m_roiImageNumber, level, col0, row0, col1, row1, &tiles, &levelInfo)) {
+        return false;
+    }
+    for (const PyramidTile& tile : tiles) {
+        RoiExpectedTile expected;
+        expected.jpg = tile.jpg;
+        expected.position = tile.rect.topLeft();
+        expected.tileCount = levelInfo.cols * levelInfo.rows;
+        expected.mosaicSize = levelInfo.size;
+        m_roiExpected.insert((static_cast<quint32>(level) << 16) | static_cast<quint32>(tile.index), expected);
+    }
+    m_roiRequested += tiles.size();
+    QMetaObject::invokeMethod(m_receiver, "requestRoi", Qt::QueuedConnection,
+                              Q_ARG(quint16, m_roiServer->serverPort()), Q_ARG(quint16, m_roiImageNumber),
+                              Q_ARG(int, level), Q_ARG(int, col0), Q_ARG(int, row0), Q_ARG(int, col1), Q_ARG(int, row1));
+    return true;
+}
+
+void LoadTestRunner::onRoiTileReceived(quint16 imageNumber, int level, int tileIndex, int tileCount, QPoint position,
+                                       QSize mosaicSize, QByteArray data, bool valid)
+{
+    if (!m_roiWaiting) {
+        return;
+    }
+    const auto it = m_roiExpected.find((static_cast<quint32>(level) << 16) | static_cast<quint32>(tileIndex));
+    if (imageNumber != m_roiImageNumber || it == m_roiExpected.end()) {
+        qWarning() << "ROI check: unexpected tile" << tileIndex << "at level" << level << "of image" << imageNumber;
+        ++m_roiMismatched;
+    } else {
+        const RoiExpectedTile& expected = it.value();
+        if (valid && data == expected.jpg && position == expected.position && tileCount == expected.tileCount
+            && mosaicSize == expected.mosaicSize) {
+            ++m_roiMatched;
+        } else {
+            qWarning() << "ROI check: tile" << tileIndex << "at level" << level << "does not match the pyramid";
+            ++m_roiMismatched;
+        }
+        m_roiExpected.erase(it);
+    }
+    if (m_roiExpected.isEmpty()) {
+        finishRoiCheck();
+    }
+}
+
+void LoadTestRunner::onRoiFailed(const QString& error)
+{
+    qWarning() << "ROI check: request connection failed:" << error;
+    finishRoiCheck();
+}
+
+void LoadTestRunner::finishRoiCheck()
+{
+    if (!m_roiWaiting) {
+        return;
+    }
+    m_roiWaiting = false;
+    m_roiTimeout->stop();
+
+    const int missing = m_roiExpected.size();
+    const bool passed = m_roiRequested > 0 && m_roiMismatched == 0 && missing == 0;
+    m_roiFailed = !passed;
+    m_roiExpected.clear();
+
+    QJsonObject roi;
+    roi["image_number"] = m_roiImageNumber;
+    roi["requested"] = m_roiRequested;
+    roi["matched"] = m_roiMatched;
+    roi["mismatched"] = m_roiMismatched;
+    roi["missing"] = missing;
+    roi["passed"] = passed;
+    QJsonObject step = m_steps.last().toObject();
+    step["roi"] = roi;
+    m_steps[m_steps.size() - 1] = step;
+
+    qDebug().noquote() << QString("ROI check on image %1: %2/%3 tiles matched, %4 mismatched, %5 missing -> %6")
+                              .arg(m_roiImageNumber)
+                              .arg(m_roiMatched)
+                              .arg(m_roiRequested)
+                              .arg(m_roiMismatched)
+                              .arg(missing)
+                              .arg(passed ? "passed" : "FAILED");
+    advanceStep();
+}
+
+bool LoadTestRunner::checkCaptureRoundTrip(QJsonObject* result)
+{
+    // 写完积压的批次，抓包目录中的索引才完整
+    PacketCapture::instance().close();
+    (*result)["image_number"] = m_lastMessageNumber;
+    (*result)["received_bytes"] = m_lastMessage.size();
+
+    QString error;
+    bool matched = false;
+    PacketCaptureReader reader;
+    if (m_lastMessageNumber == 0) {
+        error = "No message was received";
+    } else if (reader.open(m_options.captureDir, &error)) {
+        // 编号循环使用，从最近一次记录往前找与收到的消息一致的那一条
+        const QVector<int> candidates = reader.findImages(m_lastMessageNumber);
+        for (int i = candidates.size() - 1; i >= 0 && !matched; --i) {
+            QByteArray packets;
+            if (!reader.readImage(candidates.at(i), &packets, &error)) {
+                break;
+            }
+            SarReassembler reassembler;
+            const auto messages = reassembler.feed(reinterpret_cast<const uint8_t*>(packets.constData()),
+                                                   static_cast<size_t>(packets.size()));
+            matched = messages.size() == 1 && messages.front().data_info_valid
+                      && LoopbackReceiver::messageBytes(messages.front()) == m_lastMessage;
+            if (matched) {
+                (*result)["packets"] = reader.images().at(candidates.at(i)).packets;
+                (*result)["captured_bytes"] = packets.size();
+            }
+        }
+        if (!matched && error.isEmpty()) {
+            error = candidates.isEmpty() ? QString("Image %1 is not in the capture").arg(m_lastMessageNumber)
+                                         : QString("Captured packets of image %1 do not reproduce the received message")
+                                               .arg(m_lastMessageNumber);
+        }
+    }
+    (*result)["matched"] = matched;
+    if (!matched) {
+        (*result)["error"] = error;
+        qCritical().noquote() << "Capture check failed:" << error;
+    } else {
+        qDebug().noquote() << QString("Capture check: image %1 round-trips through %2").arg(m_lastMessageNumber)
+                                                                                   .arg(m_options.captureDir);
+    }
+    return matched;
+}
+
+void LoadTestRunner::report()
+{
+    QJsonObject config;
+    config["width"] = m_options.tiff.width;
+    config["height"] = m_options.tiff.height;
+    config["bits"] = m_options.tiff.bitsPerSample;
+    config["start_rate"] = m_options.rate;
+    config["step_seconds"] = m_options.stepSeconds;
+    config["ramp"] = m_options.ramp;
+    config["ramp_factor"] = m_options.rampFactor;
+    config["slo_ms"] = m_options.sloMs;
+    config["min_delivery_ratio"] = m_options.minDeliveryRatio;
+    config["aux_after_tif"] = m_options.auxAfterTif;
+    config["archive_jpg"] = m_options.transfer.archiveJpg;
+    config["codec"] = m_options.transfer.codec;
+    config["tile_size"] = m_options.transfer.tileSize;
+    config["roi"] = m_options.roi;
+    config["capture_dir"] = m_options.captureDir;
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["config"] = config;
+    root["steps"] = m_steps;
+    root["max_sustainable_rate"] = m_maxSustainableRate;
+    root["sender_stage_summary"] = Metrics::instance().summaryText();
+    bool failed = m_roiFailed;
+    if (!m_options.captureDir.isEmpty()) {
+        QJsonObject capture;
+        failed = !checkCaptureRoundTrip(&capture) || failed;
+        root["capture"] = capture;
+    }
+
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    int exitCode = failed ? 1 : 0;
+    if (m_options.outputPath.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else {
+        QString error;
+        if (!writeBytesToFile(m_options.outputPath, json, &error)) {
+            qCritical() << error;
+            exitCode = 1;
+        }
+    }
+    qDebug().noquote() << QString("Max sustainable rate: %1 images/s").arg(m_maxSustainableRate, 0, 'f', 2);
+    emit finished(exitCode);
+}
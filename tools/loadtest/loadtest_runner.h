@@ -0,0 +1,144 @@
+#pragma once
+
+#include <QObject>
+#include <QPoint>
+#include <QSize>
+#include <QThread>
+#include <QTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QTemporaryDir>
+#include <memory>
+#include "app_config.h"
+#include "file_monitor.h"
+#include "metrics.h"
+#include "synthetic_sar.h"
+
+class LoopbackReceiver;
+class RoiServer;
+class SyntheticSarProducer;
+
+struct LoadTestOptions {
+    QString workDir;              // 为空时使用临时目录
+    SyntheticTiffParams tiff;
+    int variants = 4;             // 预生成的图像内容种类
+    bool auxAfterTif = false;     // true 时先落 .tif 再落 .dat，覆盖发送端等待 AUX 的重试路径
+    double rate = 1.0;            // 第一档速率（张/秒）
+    double stepSeconds = 10.0;    // 每档持续时间
+    bool ramp = false;            // 逐档加速，寻找最大可持续速率
+    double rampFactor = 1.25;
+    int maxSteps = 12;
+    qint64 drainMs = 30000;       // 每档生产结束后等待接收完成的最长时间
+    double sloMs = 5000.0;        // 可持续判定：p99 端到端延迟上限
+    double minDeliveryRatio = 0.99;
+    bool keepFiles = false;
+    TransferOptions transfer;     // 发送端编码与归档选项
+    QString outputPath;           // JSON 报告路径，为空时输出到 stdout
+    QString archiveDir;           // 非空时接收端把收到的图像写入该目录下的归档
+    bool roi = false;             // 开启感兴趣区域拉取，第一档结束后按金字塔核对一轮请求的应答
+    QString captureDir;           // 非空时发送端把数据包记录到该目录，结束时核对最后一条消息能从抓包原样还原
+};
+
+// 感兴趣区域核对中一个应答分块的期望值，取自发送端的 PyramidStore
+struct RoiExpectedTile {
+    QByteArray jpg;
+    QPoint position;
+    int tileCount = 0;
+    QSize mosaicSize;
+};
+
+/**
+ * @class LoadTestRunner
+ * @brief 端到端回环压测：合成生产者 -> 真实发送流水线 -> 本机接收端。
+ * 以“.tif 落盘”到“接收端收齐最后一包”为端到端延迟，按档统计分位数，并给出最大可持续速率。
+ */
+class LoadTestRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LoadTestRunner(const LoadTestOptions& options, QObject* parent = nullptr);
+    ~LoadTestRunner() override;
+
+    void start();
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void onReceiverListening(quint16 port);
+    void onReceiverFailed(const QString& error);
+    void onSubDirChanged(const QString& subDir);
+    void onImageProduced(quint32 sequence, qint64 timestampNs);
+    void onFrameReceived(quint32 sequence, qint64 timestampNs, qint64 imageBytes, bool valid);
+    void onStepProduced(int produced);
+    void processAndTransferFile(const QString& filePath);
+    void checkDrain();
+    void onImageNumberReceived(quint16 imageNumber);
+    void onMessageReceived(quint16 imageNumber, QByteArray bytes);
+    void onRoiTileReceived(quint16 imageNumber, int level, int tileIndex, int tileCount, QPoint position,
+                           QSize mosaicSize, QByteArray data, bool valid);
+    void onRoiFailed(const QString& error);
+    void finishRoiCheck();
+
+private:
+    void beginStep();
+    void startProducing();
+    void finishStep();
+    void advanceStep();
+    void startRoiCheck();
+    bool expectRoiTiles(int level, int col0, int row0, int col1, int row1);
+    bool checkCaptureRoundTrip(QJsonObject* result);
+    void report();
+    double currentRate() const;
+    void recordLatency(qint64 producedNs, qint64 receivedNs);
+
+    LoadTestOptions m_options;
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_rootDir;
+
+    QThread m_receiverThread;
+    QThread m_producerThread;
+    LoopbackReceiver* m_receiver;
+    SyntheticSarProducer* m_producer;
+    FileMonitor* m_monitor;
+    quint16 m_port;
+
+    QTimer* m_drainTimer;
+    QTimer* m_subDirTimeout;
+
+    // 当前档的状态
+    int m_stepIndex;
+    QString m_stepDir;
+    bool m_stepProducing;
+    bool m_stepProductionDone;
+    qint64 m_stepStartNs;
+    qint64 m_lastReceiveNs;
+    qint64 m_drainStartNs;
+    int m_produced;
+    int m_received;
+    int m_invalid;
+    QHash<quint32, qint64> m_producedAt;
+    QHash<quint32, qint64> m_receivedEarly;  // 接收先于生产通知到达时暂存
+    std::unique_ptr<LatencyHistogram> m_latency;
+
+    QJsonArray m_steps;
+    double m_maxSustainableRate;
+
+    // 感兴趣区域核对：向 m_roiServer 请求最后收到的一幅图像，应答逐块与金字塔比对
+    RoiServer* m_roiServer;
+    QTimer* m_roiTimeout;
+    bool m_roiChecked;
+    bool m_roiWaiting;
+    bool m_roiFailed;
+    quint16 m_lastImageNumber;
+    quint16 m_roiImageNumber;
+    QHash<quint32, RoiExpectedTile> m_roiExpected;  // 键为 (层级 << 16) | 分块序号
+    int m_roiRequested;
+    int m_roiMatched;
+    int m_roiMismatched;
+
+    // 抓包核对：接收端收齐的最后一条消息
+    quint16 m_lastMessageNumber;
+    QByteArray m_lastMessage;
+};
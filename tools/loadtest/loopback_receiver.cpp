@@ -0,0 +1,175 @@
+#include "loopback_receiver.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QHostAddress>
+#include "image_codec.h"
+#include "loadtest_clock.h"
+#include "synthetic_sar.h"
+
+LoopbackReceiver::LoopbackReceiver(QObject* parent)
+    : QObject(parent),
+    m_server(nullptr)
+{
+}
+
+void LoopbackReceiver::setArchiveDir(const QString& dir)
+{
+    m_archiveDir = dir;
+}
+
+void LoopbackReceiver::setReportMessages(bool report)
+{
+    m_reportMessages = report;
+}
+
+QByteArray LoopbackReceiver::messageBytes(const SarReassembledMessage& message)
+{
+    QByteArray bytes(reinterpret_cast<const char*>(&message.data_info), sizeof(message.data_info));
+    bytes.append(reinterpret_cast<const char*>(message.image_data.data()), static_cast<int>(message.image_data.size()));
+    return bytes;
+}
+
+void LoopbackReceiver::listen(quint16 port)
+{
+    if (!m_archiveDir.isEmpty()) {
+        m_archive = std::make_unique<SarArchive>();
+        if (!m_archive->open(m_archiveDir.toStdString())) {
+            emit listenFailed(QString("Cannot open archive %1").arg(m_archiveDir));
+            return;
+        }
+        qDebug() << "Archiving received images to" << m_archiveDir << "(" << m_archive->size() << "records)";
+    }
+    // 在接收线程内创建服务器，套接字都归属于该线程
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &LoopbackReceiver::onNewConnection);
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        emit listenFailed(m_server->errorString());
+        return;
+    }
+    emit listening(m_server->serverPort());
+}
+
+void LoopbackReceiver::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        // 每个连接一个重组器：连接之间的字节流互不相干
+        auto reassembler = std::make_shared<SarReassembler>();
+        m_reassemblers.insert(socket, reassembler);
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, reassembler]() {
+            const QByteArray data = socket->readAll();
+            const auto messages = reassembler->feed(reinterpret_cast<const uint8_t*>(data.constData()),
+                                                    static_cast<size_t>(data.size()));
+            const qint64 now = loadTestNowNs();
+            const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+            for (const auto& message : messages) {
+                if (m_archive) {
+                    m_archive->append(message.image_number, message.data_info, message.image_data.data(),
+                                      message.image_data.size(), nowMs);
+                }
+                if (m_reportMessages) {
+                    emit messageReceived(message.image_number, messageBytes(message));
+                }
+                // 分块逐块拼到画布上，整幅拼齐时才算收到
+                if (message.data_info.image_kind == SarImageTile) {
+                    onTileReceived(message, now);
+                    continue;
+                }
+                // 端到端延迟以全分辨率图像为准，快视图不参与统计
+                if (message.data_info.image_kind != SarImageFull) {
+                    continue;
+                }
+                emit imageNumberReceived(message.image_number);
+                // 按数据信息中的编码方式解码一次，确认数据段完整可用
+                const ImageCodec* codec = imageCodecById(message.data_info.codec_id);
+                QByteArray fileData;
+                const bool decoded = codec && codec->decode(QByteArray::fromRawData(
+                    reinterpret_cast<const char*>(message.image_data.data()), static_cast<int>(message.image_data.size())), &fileData);
+                emit frameReceived(syntheticSequenceFromNavLat(message.data_info.nav_lat), now,
+                                   static_cast<qint64>(message.image_data.size()), message.data_info_valid && decoded);
+            }
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_reassemblers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void LoopbackReceiver::onTileReceived(const SarReassembledMessage& message, qint64 timestampNs)
+{
+    const uint16_t imageNumber = message.data_info.ref_image_number;
+    SarTileMosaic& mosaic = m_mosaics[imageNumber];
+    const bool added = mosaic.addTile(message);
+    if (added && mosaic.isComplete()) {
+        emit imageNumberReceived(imageNumber);
+    }
+    if (!added || mosaic.isComplete()) {
+        emit frameReceived(syntheticSequenceFromNavLat(message.data_info.nav_lat), timestampNs,
+                           static_cast<qint64>(mosaic.image().sizeInBytes()), added);
+        m_mosaics.remove(imageNumber);
+    }
+}
+
+void LoopbackReceiver::requestRoi(quint16 port, quint16 imageNumber, int level, int col0, int row0, int col1, int row1)
+{
+    if (m_roiSocket && m_roiPort != port) {
+        m_roiSocket->abort();
+        m_roiSocket->deleteLater();
+        m_roiSocket = nullptr;
+    }
+    m_roiPending.enqueue(createSarRoiRequest(imageNumber, static_cast<uint8_t>(level), static_cast<uint16_t>(col0),
+                                             static_cast<uint16_t>(row0), static_cast<uint16_t>(col1),
+                                             static_cast<uint16_t>(row1)));
+    if (m_roiSocket) {
+        if (m_roiSocket->state() == QAbstractSocket::ConnectedState) {
+            const SAR_RoiRequest request = m_roiPending.dequeue();
+            m_roiSocket->write(reinterpret_cast<const char*>(&request), sizeof(request));
+        }
+        return;
+    }
+
+    m_roiPort = port;
+    m_roiReassembler = std::make_unique<SarReassembler>();
+    m_roiMosaics.clear();
+    m_roiSocket = new QTcpSocket(this);
+    QTcpSocket* socket = m_roiSocket;
+    connect(socket, &QTcpSocket::connected, this, [this, socket]() {
+        while (!m_roiPending.isEmpty()) {
+            const SAR_RoiRequest request = m_roiPending.dequeue();
+            socket->write(reinterpret_cast<const char*>(&request), sizeof(request));
+        }
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+        const QByteArray data = socket->readAll();
+        const auto messages = m_roiReassembler->feed(reinterpret_cast<const uint8_t*>(data.constData()),
+                                                     static_cast<size_t>(data.size()));
+        for (const auto& message : messages) {
+            onRoiMessage(message);
+        }
+    });
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::errorOccurred), this, [this, socket]() {
+        emit roiFailed(socket->errorString());
+        if (m_roiSocket == socket) {
+            m_roiSocket = nullptr;
+            m_roiPending.clear();
+        }
+        socket->deleteLater();
+    });
+    socket->connectToHost(QHostAddress::LocalHost, port);
+}
+
+void LoopbackReceiver::onRoiMessage(const SarReassembledMessage& message)
+{
+    const SAR_DataInfo& info = message.data_info;
+    bool valid = message.data_info_valid && info.image_kind == SarImageTile;
+    if (valid) {
+        SarTileMosaic& mosaic = m_roiMosaics[(quint32(info.ref_image_number) << 8) | info.pyramid_level];
+        valid = mosaic.addTile(message);
+    }
+    emit roiTileReceived(info.ref_image_number, info.pyramid_level, info.tile_index, info.tile_count,
+                         QPoint(info.tile_x, info.tile_y), QSize(info.mosaic_cols, info.mosaic_rows),
+                         QByteArray(reinterpret_cast<const char*>(message.image_data.data()),
+                                    static_cast<int>(message.image_data.size())),
+                         valid);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QObject>
+#include <QPoint>
+#include <QSize>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QQueue>
+#include <memory>
+#include "package_sar_data.h"
+#include "sar_archive.h"
+#include "tile_mosaic.h"
+
+/**
+ * @class LoopbackReceiver
+ * @brief 本机接收端：接受发送端的连接，重组 SAR_Frame 并为每张收齐的图像打时间戳。
+ * 运行在独立线程中，避免与发送流水线争抢事件循环。
+ * 也可以像地面接收端一样连到发送端的感兴趣区域服务，发送 SAR_RoiRequest 并收取应答的分块。
+ */
+class LoopbackReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackReceiver(QObject* parent = nullptr);
+    // 收到的每条消息追加到该目录下的归档（见 SarArchive），须在 listen 之前设置
+    void setArchiveDir(const QString& dir);
+    // 为 true 时每收齐一条消息都发出 messageReceived，须在 listen 之前设置
+    void setReportMessages(bool report);
+
+    // 消息的原始字节：数据信息 + 图像数据，与发送端打包前的内容一致
+    static QByteArray messageBytes(const SarReassembledMessage& message);
+
+public slots:
+    void listen(quint16 port);
+    // 向 127.0.0.1:port 的感兴趣区域服务请求分块；同一端口的请求复用一条连接，按顺序发出
+    void requestRoi(quint16 port, quint16 imageNumber, int level, int col0, int row0, int col1, int row1);
+
+signals:
+    void listening(quint16 port);
+    void listenFailed(const QString& error);
+    // sequence 由 nav_lat 还原（见 makeSyntheticAuxHeader）
+    void frameReceived(quint32 sequence, qint64 timestampNs, qint64 imageBytes, bool valid);
+    // 收到一幅全分辨率图像（或拼齐一幅分块图像），imageNumber 即感兴趣区域请求使用的编号
+    void imageNumberReceived(quint16 imageNumber);
+    void messageReceived(quint16 imageNumber, QByteArray bytes);
+    // 感兴趣区域应答中的一个分块：tileCount 与 mosaicSize 为该层的分块总数与尺寸，
+    // valid 表示分块能解码且落在该层画布内
+    void roiTileReceived(quint16 imageNumber, int level, int tileIndex, int tileCount, QPoint position,
+                         QSize mosaicSize, QByteArray data, bool valid);
+    void roiFailed(const QString& error);
+
+private slots:
+    void onNewConnection();
+
+private:
+    void onTileReceived(const SarReassembledMessage& message, qint64 timestampNs);
+    void onRoiMessage(const SarReassembledMessage& message);
+
+    QTcpServer* m_server;
+    // 感兴趣区域请求的连接：连上之前的请求先排队
+    QTcpSocket* m_roiSocket = nullptr;
+    quint16 m_roiPort = 0;
+    QQueue<SAR_RoiRequest> m_roiPending;
+    std::unique_ptr<SarReassembler> m_roiReassembler;
+    QHash<quint32, SarTileMosaic> m_roiMosaics;  // 按 (图像编号, 层级) 组织，只用来校验分块
+    QHash<QTcpSocket*, std::shared_ptr<SarReassembler>> m_reassemblers;
+    QHash<uint16_t, SarTileMosaic> m_mosaics;   // 按整幅图像编号组织的未拼齐图像
+    QString m_archiveDir;
+    std::unique_ptr<SarArchive> m_archive;
+    bool m_reportMessages = false;
+};
@@ -0,0 +1,96 @@
+#include "sar_producer.h"
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#include "loadtest_clock.h"
+
+SyntheticSarProducer::SyntheticSarProducer(const SyntheticTiffParams& tiff, int variants, bool auxAfterTif, QObject* parent)
+    : QObject(parent),
+    m_tiffParams(tiff),
+    m_auxAfterTif(auxAfterTif),
+    m_timer(new QTimer(this)),
+    m_intervalNs(0),
+    m_stepStartNs(0),
+    m_stepCount(0),
+    m_stepProduced(0),
+    m_nextSequence(1)
+{
+    for (int i = 0; i < qMax(1, variants); ++i) {
+        SyntheticTiffParams params = tiff;
+        params.seed = tiff.seed + static_cast<quint32>(i);
+        m_tiffVariants.append(makeSyntheticTiff(params));
+    }
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &SyntheticSarProducer::produceDue);
+}
+
+void SyntheticSarProducer::startStep(const QString& subDir, double imagesPerSecond, int count)
+{
+    m_subDir = subDir;
+    m_intervalNs = 1e9 / imagesPerSecond;
+    m_stepStartNs = loadTestNowNs();
+    m_stepCount = count;
+    m_stepProduced = 0;
+    // 定时器只负责唤醒，按绝对时间表补发，避免定时抖动累积成速率误差
+    m_timer->start(qMax(1, static_cast<int>(m_intervalNs / 1e6 / 4)));
+    produceDue();
+}
+
+void SyntheticSarProducer::stop()
+{
+    m_timer->stop();
+}
+
+void SyntheticSarProducer::produceDue()
+{
+    const qint64 now = loadTestNowNs();
+    while (m_stepProduced < m_stepCount
+           && m_stepStartNs + static_cast<qint64>(m_stepProduced * m_intervalNs) <= now) {
+        if (!produceOne()) {
+            break;
+        }
+        ++m_stepProduced;
+    }
+    if (m_stepProduced >= m_stepCount) {
+        m_timer->stop();
+        emit stepFinished(m_stepProduced);
+    }
+}
+
+bool SyntheticSarProducer::produceOne()
+{
+    const quint32 sequence = m_nextSequence++;
+    const QString baseName = QDir(m_subDir).filePath(QString("sar_%1").arg(sequence, 8, 10, QChar('0')));
+    const AuxHeader aux = makeSyntheticAuxHeader(m_tiffParams.height, m_tiffParams.width, m_tiffParams.bitsPerSample, sequence);
+
+    QString error;
+    auto publish = [&](const QString& suffix, const QByteArray& data) {
+        const QString finalPath = baseName + suffix;
+        const QString partPath = finalPath + ".part";
+        if (!writeBytesToFile(partPath, data, &error)) {
+            return false;
+        }
+        QFile::remove(finalPath);
+        return QFile::rename(partPath, finalPath);
+    };
+
+    const QByteArray auxData = makeSyntheticAux(aux, sequence);
+    const QByteArray& tiffData = m_tiffVariants[sequence % m_tiffVariants.size()];
+
+    bool ok;
+    qint64 landedNs;
+    if (m_auxAfterTif) {
+        ok = publish(".tif", tiffData);
+        landedNs = loadTestNowNs();
+        ok = ok && publish(".dat", auxData);
+    } else {
+        ok = publish(".dat", auxData) && publish(".tif", tiffData);
+        landedNs = loadTestNowNs();
+    }
+    if (!ok) {
+        qWarning() << "Producer failed to write" << baseName << error;
+        return false;
+    }
+    emit imageProduced(sequence, landedNs);
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QByteArray>
+#include "synthetic_sar.h"
+
+/**
+ * @class SyntheticSarProducer
+ * @brief 模拟雷达输出：按给定速率向子文件夹写入成对的 .tif/.dat 文件。
+ * 文件先写成临时名再改名，保证 FileMonitor 看到 .tif 时内容已经完整；改名时刻即“落盘时刻”。
+ */
+class SyntheticSarProducer : public QObject
+{
+    Q_OBJECT
+
+public:
+    SyntheticSarProducer(const SyntheticTiffParams& tiff, int variants, bool auxAfterTif, QObject* parent = nullptr);
+
+public slots:
+    // 向 subDir 以 imagesPerSecond 的速率写入 count 张图像
+    void startStep(const QString& subDir, double imagesPerSecond, int count);
+    void stop();
+
+signals:
+    void imageProduced(quint32 sequence, qint64 timestampNs);
+    void stepFinished(int produced);
+
+private slots:
+    void produceDue();
+
+private:
+    bool produceOne();
+
+    SyntheticTiffParams m_tiffParams;
+    bool m_auxAfterTif;
+    QVector<QByteArray> m_tiffVariants;  // 预先生成的几种图像内容，避免生成耗时干扰速率
+    QTimer* m_timer;
+
+    QString m_subDir;
+    double m_intervalNs;
+    qint64 m_stepStartNs;
+    int m_stepCount;
+    int m_stepProduced;
+    quint32 m_nextSequence;
+};
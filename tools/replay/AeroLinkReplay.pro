@@ -0,0 +1,16 @@
+# 抓包回放：aerolink_replay --speed 4 --streams 2 capture/
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = aerolink_replay
+
+include(../../aerolink_core.pri)
+
+SOURCES += \
+    replay_main.cpp \
+    replay_source.cpp \
+    replay_stream.cpp
+
+HEADERS += \
+    replay_source.h \
+    replay_stream.h
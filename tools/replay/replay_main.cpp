@@ -0,0 +1,182 @@
+/*
+ * AeroLink 抓包回放
+ * 把录下的 SAR 数据包（unpackage_sar_data 读取的帧序列，或 PacketCapture 的抓包目录）重新发给接收端，
+ * 用真实架次的流量考核地面接收端。带 .pkt 索引的分段可按原始节奏或加速回放，也可以全速回放；
+ * 每一路回放独占一个线程与一条连接，各自完整回放全部输入。
+ * 加 --image 时只取抓包目录中该编号最近一次记录的消息，用于向地面重新投递一幅图像；
+ * 再加 --extract 时不回放，把这条消息的数据包写成 unpackage_sar_data 可以直接读取的文件。
+ *
+ *   aerolink_replay --host 10.0.0.2 --port 65432 --speed 4 capture/
+ *   aerolink_replay --max --streams 4 --loops 10 --output replay.json capture/
+ *   aerolink_replay --image 1234 --host 10.0.0.2 capture/
+ *   aerolink_replay --image 1234 --extract image1234.sar capture/
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <memory>
+#include <vector>
+#include "replay_source.h"
+#include "replay_stream.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aerolink_replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay recorded SAR packet captures to a receiver");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Capture files (SAR_Frame sequences) or capture directories.", "<input>...");
+    QCommandLineOption hostOption("host", "Receiver address.", "ip", "127.0.0.1");
+    QCommandLineOption portOption("port", "Receiver port.", "port", "65432");
+    QCommandLineOption speedOption("speed", "Replay at <x> times the recorded pace.", "x", "1");
+    QCommandLineOption maxOption("max", "Ignore recorded timing and send as fast as possible.");
+    QCommandLineOption streamsOption("streams", "Parallel connections, each replaying every input.", "n", "1");
+    QCommandLineOption loopsOption("loops", "Replay the inputs <n> times on each stream.", "n", "1");
+    QCommandLineOption batchOption("batch-kb", "Largest single socket write.", "KiB", "1024");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to <file> (default: stdout).", "file");
+    QCommandLineOption imageOption("image", "Replay only the latest message with image number <n> from a capture "
+                                            "directory.", "n");
+    QCommandLineOption extractOption("extract", "With --image, write the message's packets to <file> for "
+                                                "unpackage_sar_data instead of replaying them.", "file");
+    parser.addOptions({hostOption, portOption, speedOption, maxOption, streamsOption, loopsOption, batchOption,
+                       outputOption, imageOption, extractOption});
+    parser.process(app);
+
+    ReplayOptions options;
+    options.host = parser.value(hostOption);
+    options.port = static_cast<quint16>(parser.value(portOption).toUInt());
+    options.speed = parser.value(speedOption).toDouble();
+    options.maxRate = parser.isSet(maxOption);
+    options.loops = parser.value(loopsOption).toInt();
+    options.batchBytes = parser.value(batchOption).toLongLong() << 10;
+    const int streams = parser.value(streamsOption).toInt();
+    const bool singleImage = parser.isSet(imageOption);
+    bool imageNumberOk = true;
+    const uint imageNumber = parser.value(imageOption).toUInt(&imageNumberOk);
+    // 单幅图像模式只接受一个抓包目录
+    const QStringList files = singleImage ? parser.positionalArguments()
+                                          : ReplaySource::expandInputs(parser.positionalArguments());
+    if (files.isEmpty() || options.port == 0 || options.speed <= 0.0 || options.loops < 1
+        || options.batchBytes <= 0 || streams < 1 || (parser.isSet(extractOption) && !singleImage)
+        || (singleImage && (files.size() != 1 || !imageNumberOk || imageNumber == 0 || imageNumber > 0xFFFF))) {
+        parser.showHelp(1);
+    }
+
+    // 全部输入只映射一次，各路回放共享
+    ReplaySourceList sources;
+    qint64 inputBytes = 0;
+    qint64 inputPackets = 0;
+    bool untimed = false;
+    for (const QString& file : files) {
+        auto source = std::make_shared<ReplaySource>();
+        QString error;
+        const bool opened = singleImage ? source->openCapturedImage(file, static_cast<quint16>(imageNumber), &error)
+                                        : source->open(file, &error);
+        if (!opened) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        inputBytes += source->size();
+        inputPackets += source->packets();
+        untimed = untimed || !source->timed();
+        sources.append(source);
+    }
+    if (parser.isSet(extractOption)) {
+        const ReplaySource& source = *sources.first();
+        QFile file(parser.value(extractOption));
+        if (!file.open(QIODevice::WriteOnly)
+            || file.write(reinterpret_cast<const char*>(source.data()), source.size()) != source.size()) {
+            qCritical() << "Cannot write" << file.fileName();
+            return 1;
+        }
+        QTextStream(stderr) << QString("Extracted image %1: %2 packets, %3 bytes to %4\n")
+                                   .arg(imageNumber).arg(source.packets()).arg(source.size()).arg(file.fileName());
+        return 0;
+    }
+    if (untimed && !options.maxRate && !singleImage) {
+        qWarning() << "Some inputs have no packet index (.pkt); they are replayed at full rate.";
+    }
+    QTextStream(stderr) << QString("Replaying %1 file(s), %2 packets, %3 MiB to %4:%5 on %6 stream(s)\n")
+                               .arg(sources.size()).arg(inputPackets).arg(inputBytes / double(1 << 20), 0, 'f', 1)
+                               .arg(options.host).arg(options.port).arg(streams);
+
+    std::vector<std::unique_ptr<ReplayStream>> workers;
+    for (int i = 0; i < streams; ++i) {
+        workers.push_back(std::make_unique<ReplayStream>(i, sources, options));
+    }
+    for (auto& worker : workers) {
+        worker->start();
+    }
+    for (auto& worker : workers) {
+        worker->wait();
+    }
+
+    // 汇总：总吞吐以最慢的一路为准
+    QJsonArray streamResults;
+    qint64 totalBytes = 0;
+    qint64 totalPackets = 0;
+    qint64 slowestNs = 1;
+    int failed = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const ReplayStream::Result result = workers[i]->result();
+        QJsonObject entry;
+        entry["stream"] = static_cast<int>(i);
+        entry["ok"] = result.ok;
+        entry["bytes"] = result.bytes;
+        entry["packets"] = result.packets;
+        entry["writes"] = result.writes;
+        entry["elapsed_ms"] = result.elapsedNs / 1e6;
+        entry["gbit_per_s"] = result.bytes * 8.0 / qMax<qint64>(1, result.elapsedNs);
+        if (!options.maxRate) {
+            entry["max_lag_ms"] = result.maxLagUs / 1e3;
+        }
+        if (!result.ok) {
+            entry["error"] = result.error;
+            qCritical().noquote() << result.error;
+            ++failed;
+        }
+        streamResults.append(entry);
+        totalBytes += result.bytes;
+        totalPackets += result.packets;
+        slowestNs = qMax(slowestNs, result.elapsedNs);
+    }
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["target"] = QString("%1:%2").arg(options.host).arg(options.port);
+    root["mode"] = options.maxRate ? QString("max") : QString("timed");
+    root["speed"] = options.speed;
+    root["inputs"] = QJsonArray::fromStringList(files);
+    root["input_bytes"] = inputBytes;
+    root["input_packets"] = inputPackets;
+    root["loops"] = options.loops;
+    root["bytes"] = totalBytes;
+    root["packets"] = totalPackets;
+    root["elapsed_ms"] = slowestNs / 1e6;
+    root["gbit_per_s"] = totalBytes * 8.0 / slowestNs;
+    root["streams"] = streamResults;
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    QTextStream(stderr) << QString("Sent %1 packets, %2 MiB in %3 s: %4 Gbit/s\n")
+                               .arg(totalPackets).arg(totalBytes / double(1 << 20), 0, 'f', 1)
+                               .arg(slowestNs / 1e9, 0, 'f', 2).arg(totalBytes * 8.0 / slowestNs, 0, 'f', 2);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            qCritical() << "Cannot write" << file.fileName();
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return failed == 0 ? 0 : 1;
+}
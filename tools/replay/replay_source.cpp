@@ -0,0 +1,100 @@
+#include "replay_source.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <cstring>
+#include "package_sar_data.h"
+
+bool ReplaySource::open(const QString& path, QString* errorMessage)
+{
+    m_path = path;
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(path, m_file.errorString());
+        return false;
+    }
+    const qint64 fileSize = m_file.size();
+    m_data = fileSize > 0 ? m_file.map(0, fileSize) : nullptr;
+    if (!m_data) {
+        *errorMessage = QString("Cannot map %1").arg(path);
+        return false;
+    }
+    if (!scanFrames(fileSize, errorMessage)) {
+        return false;
+    }
+
+    // PacketCapture 的分段：同名 .pkt 与数据包一一对应时使用其中的时刻
+    const QFileInfo info(path);
+    m_indexFile.setFileName(info.absolutePath() + "/" + info.completeBaseName() + ".pkt");
+    if (m_indexFile.exists() && m_indexFile.open(QIODevice::ReadOnly)) {
+        const qint64 entries = m_indexFile.size() / qint64(sizeof(SarCapturePacket));
+        const uchar* index = entries > 0 ? m_indexFile.map(0, entries * qint64(sizeof(SarCapturePacket))) : nullptr;
+        if (index && entries >= m_offsets.size()) {
+            m_timestamps = reinterpret_cast<const SarCapturePacket*>(index);
+        } else {
+            qWarning() << path << ": packet index does not match, replaying without timing";
+        }
+    }
+    return true;
+}
+
+bool ReplaySource::openCapturedImage(const QString& dir, quint16 imageNumber, QString* errorMessage)
+{
+    PacketCaptureReader reader;
+    if (!reader.open(dir, errorMessage)) {
+        return false;
+    }
+    const int index = reader.findImage(imageNumber);
+    if (index < 0) {
+        *errorMessage = QString("Image %1 is not in the capture %2").arg(imageNumber).arg(dir);
+        return false;
+    }
+    if (!reader.readImage(index, &m_buffer, errorMessage)) {
+        return false;
+    }
+    m_path = QString("%1#%2").arg(dir).arg(imageNumber);
+    m_data = reinterpret_cast<const uchar*>(m_buffer.constData());
+    return scanFrames(m_buffer.size(), errorMessage);
+}
+
+bool ReplaySource::scanFrames(qint64 size, QString* errorMessage)
+{
+    // 逐帧走一遍：记下每个数据包的起点，截掉尾部不完整或损坏的部分
+    qint64 offset = 0;
+    while (offset + qint64(sizeof(SAR_Frame)) <= size) {
+        SAR_Frame header;
+        memcpy(&header, m_data + offset, sizeof(header));
+        if ((header.fixed_value != kSarFrameMagic && header.fixed_value != kSarControlFrameMagic)
+            || offset + qint64(sizeof(SAR_Frame)) + header.data_length > size) {
+            break;
+        }
+        m_offsets.append(offset);
+        offset += qint64(sizeof(SAR_Frame)) + header.data_length;
+    }
+    m_size = offset;
+    if (m_offsets.isEmpty()) {
+        *errorMessage = QString("%1 does not start with a SAR_Frame").arg(m_path);
+        return false;
+    }
+    if (m_size < size) {
+        qWarning() << m_path << ": ignoring" << size - m_size << "bytes after the last valid frame";
+    }
+    return true;
+}
+
+QStringList ReplaySource::expandInputs(const QStringList& inputs)
+{
+    QStringList files;
+    for (const QString& input : inputs) {
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            const QDir dir(input);
+            for (const QString& name : dir.entryList(QStringList("seg-*.sar"), QDir::Files, QDir::Name)) {
+                files.append(dir.filePath(name));
+            }
+        } else {
+            files.append(input);
+        }
+    }
+    return files;
+}
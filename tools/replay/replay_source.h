@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "packet_capture.h"
+
+/**
+ * @class ReplaySource
+ * @brief 一个只读映射的抓包文件：SAR_Frame 首尾相接（unpackage_sar_data 读取的格式，或 PacketCapture 的分段）。
+ * 同名 .pkt 索引存在时带有每个数据包的发送时刻，可以按原始节奏回放；否则只能全速回放。
+ * 也可以只取抓包目录中的一条消息（按图像编号，经 PacketCaptureReader 读入内存），这时只能全速回放。
+ * 映射在全部回放线程间共享，只读访问无需加锁。
+ */
+class ReplaySource
+{
+public:
+    // 映射文件并逐帧校验，遇到坏帧时只保留之前的部分
+    bool open(const QString& path, QString* errorMessage);
+    // 读入 PacketCapture 目录中该编号最近一次记录的消息的全部数据包
+    bool openCapturedImage(const QString& dir, quint16 imageNumber, QString* errorMessage);
+
+    QString path() const { return m_path; }
+    const uchar* data() const { return m_data; }
+    qint64 size() const { return m_size; }      // 有效字节数（到最后一个完整的帧为止）
+    int packets() const { return m_offsets.size(); }
+    qint64 packetOffset(int index) const { return m_offsets.at(index); }
+    qint64 packetEnd(int index) const { return index + 1 < m_offsets.size() ? m_offsets.at(index + 1) : m_size; }
+
+    bool timed() const { return m_timestamps != nullptr; }
+    // 第 index 个数据包的发送时刻（Unix 纳秒），仅 timed() 时有效
+    qint64 timestampNs(int index) const { return m_timestamps[index].timestamp_ns; }
+
+    // 展开命令行参数：目录取其中按名字排序的 seg-*.sar，其余按文件处理
+    static QStringList expandInputs(const QStringList& inputs);
+
+private:
+    // 从 m_data 起逐帧校验，记下各数据包的偏移并确定有效长度
+    bool scanFrames(qint64 size, QString* errorMessage);
+
+    QString m_path;
+    QFile m_file;
+    QByteArray m_buffer;                        // openCapturedImage 读入的数据包
+    QFile m_indexFile;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    QVector<qint64> m_offsets;
+    const SarCapturePacket* m_timestamps = nullptr;
+};
+
+using ReplaySourceList = QVector<std::shared_ptr<ReplaySource>>;
@@ -0,0 +1,122 @@
+#include "replay_stream.h"
+#include <QElapsedTimer>
+#include <QTcpSocket>
+
+ReplayStream::ReplayStream(int id, const ReplaySourceList& sources, const ReplayOptions& options, QObject* parent)
+    : QThread(parent),
+    m_id(id),
+    m_sources(sources),
+    m_options(options)
+{
+}
+
+void ReplayStream::run()
+{
+    // 套接字在回放线程内创建，没有事件循环，用 waitFor* 推动写出
+    QTcpSocket socket;
+    socket.connectToHost(m_options.host, m_options.port);
+    if (!socket.waitForConnected(5000)) {
+        m_result.error = QString("stream %1: cannot connect to %2:%3: %4")
+                             .arg(m_id).arg(m_options.host).arg(m_options.port).arg(socket.errorString());
+        return;
+    }
+    socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    // 写入一段连续的数据包并尽量交给内核；用户态缓冲积压过多时等待
+    auto writeRange = [&](const uchar* data, qint64 size) {
+        if (socket.write(reinterpret_cast<const char*>(data), size) != size) {
+            return false;
+        }
+        ++m_result.writes;
+        m_result.bytes += size;
+        socket.flush();
+        while (socket.bytesToWrite() > m_options.maxBufferedBytes) {
+            if (!socket.waitForBytesWritten(5000)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // 等到计划时刻；期间继续把缓冲中的数据写出
+    auto waitUntil = [&](const QElapsedTimer& clock, qint64 dueNs) {
+        for (;;) {
+            const qint64 remainingNs = dueNs - clock.nsecsElapsed();
+            if (remainingNs <= 0) {
+                return socket.state() == QAbstractSocket::ConnectedState;
+            }
+            if (socket.bytesToWrite() > 0) {
+                socket.waitForBytesWritten(static_cast<int>(qMax<qint64>(1, remainingNs / 1000000)));
+                if (socket.state() != QAbstractSocket::ConnectedState) {
+                    return false;
+                }
+            } else {
+                QThread::usleep(static_cast<unsigned long>(qMax<qint64>(1, remainingNs / 1000)));
+            }
+        }
+    };
+
+    QElapsedTimer total;
+    total.start();
+    bool ok = true;
+    for (int loop = 0; ok && loop < m_options.loops; ++loop) {
+        // 每一轮的计划时刻都以本轮第一个带时刻的数据包为零点
+        QElapsedTimer clock;
+        clock.start();
+        qint64 originNs = -1;
+        for (const auto& source : m_sources) {
+            if (!ok) {
+                break;
+            }
+            const uchar* data = source->data();
+            if (m_options.maxRate || !source->timed()) {
+                for (qint64 offset = 0; ok && offset < source->size(); offset += m_options.batchBytes) {
+                    ok = writeRange(data + offset, qMin(m_options.batchBytes, source->size() - offset));
+                }
+                m_result.packets += source->packets();
+                continue;
+            }
+
+            const int count = source->packets();
+            if (originNs < 0) {
+                originNs = source->timestampNs(0);
+            }
+            auto dueNs = [&](int index) {
+                return static_cast<qint64>((source->timestampNs(index) - originNs) / m_options.speed);
+            };
+            int index = 0;
+            while (ok && index < count) {
+                const qint64 due = dueNs(index);
+                ok = waitUntil(clock, due);
+                const qint64 now = clock.nsecsElapsed();
+                m_result.maxLagUs = qMax(m_result.maxLagUs, (now - due) / 1000);
+                // 已经到期的后续数据包在文件中紧挨着，合并成一次写入
+                int end = index + 1;
+                while (end < count && dueNs(end) <= now
+                       && source->packetEnd(end) - source->packetOffset(index) <= m_options.batchBytes) {
+                    ++end;
+                }
+                if (ok) {
+                    const qint64 begin = source->packetOffset(index);
+                    ok = writeRange(data + begin, source->packetEnd(end - 1) - begin);
+                    m_result.packets += end - index;
+                }
+                index = end;
+            }
+        }
+    }
+
+    while (ok && socket.bytesToWrite() > 0) {
+        ok = socket.waitForBytesWritten(5000);
+    }
+    m_result.elapsedNs = total.nsecsElapsed();
+    if (!ok) {
+        m_result.error = QString("stream %1: write failed: %2").arg(m_id).arg(socket.errorString());
+        socket.abort();
+        return;
+    }
+    socket.disconnectFromHost();
+    if (socket.state() != QAbstractSocket::UnconnectedState) {
+        socket.waitForDisconnected(5000);
+    }
+    m_result.ok = true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QString>
+#include <QThread>
+#include "replay_source.h"
+
+struct ReplayOptions {
+    QString host = "127.0.0.1";
+    quint16 port = 65432;
+    double speed = 1.0;             // 按原始节奏回放时的加速倍数
+    bool maxRate = false;           // 忽略时刻，全速回放
+    int loops = 1;                  // 每个流重复回放全部输入的次数
+    qint64 batchBytes = 1 << 20;    // 单次写入套接字的最大字节数
+    qint64 maxBufferedBytes = 8 << 20;  // 套接字用户态缓冲超过此值时等待写出
+};
+
+/**
+ * @class ReplayStream
+ * @brief 一路回放：独占一个线程与一条 TCP 连接，把全部输入依次写给接收端。
+ * 数据包直接从映射的文件写入套接字，相邻的数据包合并成一次写入：
+ * 全速模式按 batchBytes 切块；原始节奏模式把已经到期的连续数据包一次写出，然后睡到下一个数据包的时刻。
+ */
+class ReplayStream : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        bool ok = false;
+        QString error;
+        qint64 bytes = 0;
+        qint64 packets = 0;
+        qint64 writes = 0;          // 套接字写入次数
+        qint64 elapsedNs = 0;
+        qint64 maxLagUs = 0;        // 原始节奏模式下落后于计划的最大时间
+    };
+
+    ReplayStream(int id, const ReplaySourceList& sources, const ReplayOptions& options, QObject* parent = nullptr);
+
+    Result result() const { return m_result; }
+
+protected:
+    void run() override;
+
+private:
+    int m_id;
+    ReplaySourceList m_sources;
+    ReplayOptions m_options;
+    Result m_result;
+};
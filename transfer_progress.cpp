@@ -0,0 +1,68 @@
+#include "transfer_progress.h"
+#include <QMutexLocker>
+
+TransferProgress& TransferProgress::instance()
+{
+    static TransferProgress progress;
+    return progress;
+}
+
+TransferProgress::TransferProgress()
+    : m_nextId(1),
+    m_currentId(0),
+    m_currentSize(0),
+    m_currentSent(0),
+    m_totalSent(0),
+    m_pendingBytes(0),
+    m_activeTransfers(0)
+{
+}
+
+quint64 TransferProgress::beginImage(const QString& fileName, qint64 totalBytes)
+{
+    quint64 id = m_nextId.fetch_add(1, std::memory_order_relaxed);
+    {
+        QMutexLocker locker(&m_nameMutex);
+        m_currentFile = fileName;
+    }
+    m_currentSent.store(0, std::memory_order_relaxed);
+    m_currentSize.store(totalBytes, std::memory_order_relaxed);
+    m_currentId.store(id, std::memory_order_release);
+    m_pendingBytes.fetch_add(totalBytes, std::memory_order_relaxed);
+    m_activeTransfers.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void TransferProgress::addBytes(quint64 id, qint64 bytes)
+{
+    m_totalSent.fetch_add(bytes, std::memory_order_relaxed);
+    m_pendingBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    // 只有最近开始的那张图像驱动单图进度
+    if (m_currentId.load(std::memory_order_acquire) == id) {
+        m_currentSent.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void TransferProgress::endImage(quint64 id, qint64 unsentBytes)
+{
+    Q_UNUSED(id);
+    if (unsentBytes > 0) {
+        m_pendingBytes.fetch_sub(unsentBytes, std::memory_order_relaxed);
+    }
+    m_activeTransfers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+TransferProgress::Snapshot TransferProgress::snapshot() const
+{
+    Snapshot s;
+    {
+        QMutexLocker locker(&m_nameMutex);
+        s.currentFile = m_currentFile;
+    }
+    s.currentSize = m_currentSize.load(std::memory_order_relaxed);
+    s.currentSent = m_currentSent.load(std::memory_order_relaxed);
+    s.totalSent = m_totalSent.load(std::memory_order_relaxed);
+    s.pendingBytes = qMax<qint64>(0, m_pendingBytes.load(std::memory_order_relaxed));
+    s.activeTransfers = m_activeTransfers.load(std::memory_order_relaxed);
+    return s;
+}
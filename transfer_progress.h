@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QString>
+#include <QMutex>
+#include <atomic>
+
+/**
+ * @class TransferProgress
+ * @brief 传输层发布的字节计数器，供界面按定时器采样。
+ * 所有计数均为无锁原子量，发送路径上每个数据包只做原子加法，不发任何信号；
+ * 只有当前文件名在每张图像开始时加锁更新一次。
+ */
+class TransferProgress {
+public:
+    struct Snapshot {
+        QString currentFile;     // 最近开始发送的图像
+        qint64 currentSize;      // 当前图像总字节数（含帧头）
+        qint64 currentSent;      // 当前图像已写入字节数
+        qint64 totalSent;        // 累计写入字节数
+        qint64 pendingBytes;     // 所有进行中的传输尚未写出的字节数
+        int activeTransfers;     // 进行中的传输数
+    };
+
+    static TransferProgress& instance();
+
+    // 开始一张图像，返回本次传输的编号
+    quint64 beginImage(const QString& fileName, qint64 totalBytes);
+    // 写入字节后累加
+    void addBytes(quint64 id, qint64 bytes);
+    // 结束传输，unsentBytes 为失败时未写出的剩余字节
+    void endImage(quint64 id, qint64 unsentBytes);
+
+    Snapshot snapshot() const;
+
+private:
+    TransferProgress();
+    Q_DISABLE_COPY(TransferProgress)
+
+    std::atomic<quint64> m_nextId;
+    std::atomic<quint64> m_currentId;
+    std::atomic<qint64> m_currentSize;
+    std::atomic<qint64> m_currentSent;
+    std::atomic<qint64> m_totalSent;
+    std::atomic<qint64> m_pendingBytes;
+    std::atomic<int> m_activeTransfers;
+
+    mutable QMutex m_nameMutex;
+    QString m_currentFile;
+};
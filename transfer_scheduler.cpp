@@ -0,0 +1,133 @@
+#include "transfer_scheduler.h"
+#include <QDebug>
+#include "image_transfer.h"
+#include "metrics.h"
+
+TransferScheduler& TransferScheduler::instance()
+{
+    static TransferScheduler scheduler;
+    return scheduler;
+}
+
+TransferScheduler::TransferScheduler(QObject* parent)
+    : QObject(parent),
+    m_maxTransfers(4),
+    m_budgetBytes(qint64(256) << 20),
+    m_active(0),
+    m_activeQuickLooks(0),
+    m_inFlightBytes(0),
+    m_pumping(false),
+    m_resuming(false)
+{
+}
+
+void TransferScheduler::configure(int maxTransfers, qint64 budgetBytes)
+{
+    m_maxTransfers = maxTransfers;
+    m_budgetBytes = budgetBytes;
+    pump();
+}
+
+bool TransferScheduler::hasBudget() const
+{
+    return m_budgetBytes <= 0 || m_inFlightBytes < m_budgetBytes;
+}
+
+bool TransferScheduler::canStart(bool quickLook) const
+{
+    if (m_maxTransfers <= 0 || m_active < m_maxTransfers) {
+        return true;
+    }
+    // 保留给快视图的名额：全图占满并发数时仍可再启动一幅快视图
+    return quickLook && m_activeQuickLooks == 0;
+}
+
+bool TransferScheduler::admitOrDefer(std::function<void()> retry)
+{
+    // 已有挂起的请求时新请求也排到后面，保持到达顺序；正在恢复的请求直接放行
+    if (hasBudget() && (m_deferred.isEmpty() || m_resuming)) {
+        return true;
+    }
+    m_deferred.enqueue(std::move(retry));
+    Metrics::instance().addCounter(MetricCounter::ConversionsDeferred);
+    publishGauges();
+    return false;
+}
+
+void TransferScheduler::submit(SarPacketTransferManager* manager, const QString& ip, quint16 port, qint64 bytes,
+                               bool quickLook)
+{
+    m_bytes.insert(manager, bytes);
+    m_inFlightBytes += bytes;
+    connect(manager, &SarPacketTransferManager::finished, this, [this, manager]() {
+        onTransferFinished(manager);
+    });
+    if (quickLook) {
+        m_quickLooks.insert(manager);
+        m_quickLookQueue.enqueue(PendingTransfer{manager, ip, port});
+    } else {
+        m_queue.enqueue(PendingTransfer{manager, ip, port});
+    }
+    pump();
+}
+
+void TransferScheduler::onTransferFinished(SarPacketTransferManager* manager)
+{
+    // manager 随后由 deleteLater 释放，这里只归还它占用的名额与预算
+    --m_active;
+    if (m_quickLooks.remove(manager)) {
+        --m_activeQuickLooks;
+    }
+    m_inFlightBytes -= m_bytes.take(manager);
+    pump();
+}
+
+void TransferScheduler::pump()
+{
+    // 恢复挂起的编码会重新进入 submit，防止递归
+    if (m_pumping) {
+        return;
+    }
+    m_pumping = true;
+    for (;;) {
+        // 快视图通道优先
+        if (!m_quickLookQueue.isEmpty() && canStart(true)) {
+            PendingTransfer next = m_quickLookQueue.dequeue();
+            ++m_active;
+            ++m_activeQuickLooks;
+            next.manager->startTransfer(next.ip, next.port);
+            continue;
+        }
+        if (!m_queue.isEmpty() && canStart(false)) {
+            PendingTransfer next = m_queue.dequeue();
+            ++m_active;
+            next.manager->startTransfer(next.ip, next.port);
+            continue;
+        }
+        if (!m_deferred.isEmpty() && hasBudget()) {
+            std::function<void()> retry = m_deferred.dequeue();
+            m_resuming = true;
+            retry();
+            m_resuming = false;
+            continue;
+        }
+        break;
+    }
+    m_pumping = false;
+    publishGauges();
+}
+
+TransferScheduler::Stats TransferScheduler::stats() const
+{
+    return Stats{m_active, static_cast<int>(m_queue.size()), static_cast<int>(m_quickLookQueue.size()),
+                 static_cast<int>(m_deferred.size()), m_inFlightBytes};
+}
+
+void TransferScheduler::publishGauges()
+{
+    Metrics::instance().setGauge(MetricGauge::TransfersInFlight, m_active);
+    Metrics::instance().setGauge(MetricGauge::TransferQueueDepth, m_queue.size());
+    Metrics::instance().setGauge(MetricGauge::QuickLookQueueDepth, m_quickLookQueue.size());
+    Metrics::instance().setGauge(MetricGauge::ConversionBacklog, m_deferred.size());
+    Metrics::instance().setGauge(MetricGauge::InFlightBytes, m_inFlightBytes);
+}
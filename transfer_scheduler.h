@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <functional>
+
+class SarPacketTransferManager;
+
+/**
+ * @class TransferScheduler
+ * @brief 发送端的传输调度器：限制同时进行的传输数，并以字节预算约束已打包待发的数据量。
+ * 打包好的传输先进入先进先出队列，并发数允许时才发起连接；已占用的字节超过预算时，
+ * 上游新的编码请求被挂起，等传输完成释放预算后再依次恢复。
+ * 快视图走单独的优先通道：总是先于全图启动，另有一个保留名额，全图占满并发数时仍可发出一幅快视图，
+ * 地面看到第一眼的时间不受排队的全图影响。只在主线程上使用。
+ */
+class TransferScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        int active;             // 已发起连接的传输数
+        int queued;             // 已打包、等待发起的传输数（不含快视图）
+        int quickLookQueued;    // 快视图通道中等待发起的传输数
+        int deferred;           // 因预算耗尽而挂起的编码请求数
+        qint64 inFlightBytes;   // 排队与进行中的传输占用的打包字节数
+    };
+
+    static TransferScheduler& instance();
+
+    // maxTransfers <= 0 表示不限并发，budgetBytes <= 0 表示不限字节
+    void configure(int maxTransfers, qint64 budgetBytes);
+
+    // 编码前的准入检查：预算未耗尽时返回 true；否则保存 retry，预算释放后按先后顺序调用，返回 false
+    bool admitOrDefer(std::function<void()> retry);
+
+    // 接管一个尚未启动的传输，占用 bytes 预算，排队直到并发数允许时启动；quickLook 时进入优先通道
+    void submit(SarPacketTransferManager* manager, const QString& ip, quint16 port, qint64 bytes, bool quickLook = false);
+
+    Stats stats() const;
+
+private:
+    struct PendingTransfer {
+        SarPacketTransferManager* manager;
+        QString ip;
+        quint16 port;
+    };
+
+    explicit TransferScheduler(QObject* parent = nullptr);
+    Q_DISABLE_COPY(TransferScheduler)
+
+    bool hasBudget() const;
+    bool canStart(bool quickLook) const;
+    void onTransferFinished(SarPacketTransferManager* manager);
+    void pump();
+    void publishGauges();
+
+    int m_maxTransfers;
+    qint64 m_budgetBytes;
+    int m_active;
+    int m_activeQuickLooks;     // m_active 中的快视图数
+    qint64 m_inFlightBytes;
+    bool m_pumping;
+    bool m_resuming;
+    QQueue<PendingTransfer> m_queue;
+    QQueue<PendingTransfer> m_quickLookQueue;
+    QQueue<std::function<void()>> m_deferred;
+    QHash<SarPacketTransferManager*, qint64> m_bytes;
+    QSet<SarPacketTransferManager*> m_quickLooks;   // 已提交的快视图传输
+};